@@ -0,0 +1,108 @@
+// Heap buffers the bindings hand to the coordinate functions without copying.
+
+#include <math.h>
+#include <stdlib.h>
+
+/*
+ * The WebIDL binder copies float[] arguments into a temporary on every call.
+ * An lfCoordBuffer is instead allocated once in the module heap; JS reads the
+ * results through a Float32Array view of that memory (see coord_buffer.js),
+ * and every Apply method writes at a float offset into it, so rows or tiles
+ * of an image can be computed one by one into the same buffer.
+ */
+class lfCoordBuffer
+{
+public:
+    lfCoordBuffer (int length) : Data (NULL), Length (0)
+    {
+        void *data;
+        if (length > 0 && !posix_memalign (&data, 16, length * sizeof (float)))
+        {
+            Data = (float *)data;
+            Length = length;
+        }
+    }
+
+    ~lfCoordBuffer ()
+    { free (Data); }
+
+    /// Byte offset of the buffer in the module heap, 0 if allocation failed
+    int GetPointer () const
+    { return (int)(size_t)Data; }
+
+    /// Size of the buffer in floats
+    int GetLength () const
+    { return Length; }
+
+    bool ApplyGeometryDistortion (
+        const lfModifier *modifier, float xu, float yu, int width, int height,
+        int offset)
+    {
+        return Fits (offset, width, height, 2) &&
+            modifier->ApplyGeometryDistortion (xu, yu, width, height, Data + offset);
+    }
+
+    bool ApplySubpixelDistortion (
+        const lfModifier *modifier, float xu, float yu, int width, int height,
+        int offset)
+    {
+        return Fits (offset, width, height, 6) &&
+            modifier->ApplySubpixelDistortion (xu, yu, width, height, Data + offset);
+    }
+
+    bool ApplySubpixelGeometryDistortion (
+        const lfModifier *modifier, float xu, float yu, int width, int height,
+        int offset)
+    {
+        return Fits (offset, width, height, 6) &&
+            modifier->ApplySubpixelGeometryDistortion (xu, yu, width, height,
+                                                       Data + offset);
+    }
+
+    /// Maps count points at offset in place, see
+    /// lfModifier::ApplyGeometryDistortionPoints(); points which could not
+    /// be mapped are set to NaN, since JS has no use for their input there
+    bool ApplyGeometryDistortionPoints (
+        const lfModifier *modifier, int offset, int count, bool inverse)
+    {
+        if (!Fits (offset, count, 1, 2) || !count)
+            return false;
+
+        // The status of a block of points at a time, on the stack
+        unsigned char status [1024];
+        for (int first = 0; first < count; first += (int)sizeof (status))
+        {
+            int n = count - first < (int)sizeof (status) ? count - first : (int)sizeof (status);
+            float *points = Data + offset + first * 2;
+            if (!modifier->ApplyGeometryDistortionPoints (points, points, n, inverse,
+                                                          status))
+                return false;
+            for (int i = 0; i < n; i++)
+                if (!status [i])
+                    points [i * 2] = points [i * 2 + 1] = NAN;
+        }
+        return true;
+    }
+
+    /// Writes width*height coordinates at offset, followed by the Jacobian
+    /// of every grid node, see lfModifier::ApplyGeometryDistortionJacobian()
+    bool ApplyGeometryDistortionJacobian (
+        const lfModifier *modifier, float xu, float yu, int width, int height,
+        float step, int offset)
+    {
+        return Fits (offset, width, height, 6) &&
+            modifier->ApplyGeometryDistortionJacobian (
+                xu, yu, width, height, Data + offset,
+                Data + offset + width * height * 2, step);
+    }
+
+private:
+    bool Fits (int offset, int width, int height, int floats) const
+    {
+        return offset >= 0 && width >= 0 && height >= 0 &&
+            (long long)width * height * floats <= (long long)Length - offset;
+    }
+
+    float *Data;
+    int Length;
+};
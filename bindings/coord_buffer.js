@@ -0,0 +1,13 @@
+// Float32Array views of lfCoordBuffer memory; appended to the module with --post-js.
+
+// Returns a view of the whole buffer in the module heap.  The view is kept
+// and reused until the heap grows, which replaces the underlying
+// ArrayBuffer; so calling this after every Apply costs nothing.
+lfCoordBuffer.prototype['view'] = function ()
+{
+    var view = this.__view;
+    if (!view || view.buffer !== HEAPF32.buffer)
+        view = this.__view = new Float32Array (
+            HEAPF32.buffer, this.GetPointer (), this.GetLength ());
+    return view;
+};
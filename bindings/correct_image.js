@@ -0,0 +1,43 @@
+// One-call whole-image correction; appended to the module with --post-js.
+
+// Corrects an image held in a Uint8Array, Uint8ClampedArray (8 bit per
+// component) or Uint16Array (16 bit) of tightly packed RGB or RGBA pixels,
+// and returns the corrected image as a new array of the same type.  The
+// modifier must have been initialized with the matching pixel format.
+// Returns null for any other array type, if the array does not hold exactly
+// width * height * components values, if the layout is not supported, or if
+// the heap has no room for the copies of the image.
+Module['correctImage'] = function (modifier, pixels, width, height, components,
+                                   interpolation, threads)
+{
+    var format;
+    if (pixels instanceof Uint8Array || pixels instanceof Uint8ClampedArray)
+        format = Module['LF_PF_U8'];
+    else if (pixels instanceof Uint16Array)
+        format = Module['LF_PF_U16'];
+    else
+        return null;
+    if (!(width > 0 && height > 0) || pixels.length != width * height * components)
+        return null;
+    if (interpolation === undefined)
+        interpolation = Module['LF_INTERPOLATION_BILINEAR'];
+    var bytes = pixels.byteLength;
+    var stride = bytes / height;
+    var src = _malloc (bytes);
+    var dst = _malloc (bytes);
+    try {
+        if (!src || !dst)
+            return null;
+        HEAPU8.set (new Uint8Array (pixels.buffer, pixels.byteOffset, bytes), src);
+        if (!modifier.ApplyImageCorrection (src, stride, dst, stride, width, height,
+                                            format, components, interpolation,
+                                            threads || 0))
+            return null;
+        var out = new pixels.constructor (pixels.length);
+        new Uint8Array (out.buffer).set (HEAPU8.subarray (dst, dst + bytes));
+        return out;
+    } finally {
+        _free (src);
+        _free (dst);
+    }
+};
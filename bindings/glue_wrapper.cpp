@@ -1,2 +1,3 @@
 #include "../lensfun/lensfun.h"
-#include "../build/glue.cpp"
\ No newline at end of file
+#include "coord_buffer.h"
+#include "../build/glue.cpp"
@@ -0,0 +1,82 @@
+// Page-side client for the worker protocol in worker_protocol.js.
+(function (root) {
+    'use strict';
+
+    // Wraps a worker running a lensfun worker build (see
+    // LensfunLoader.createWorker).  All methods return promises and may be
+    // called without waiting for earlier ones, which pipelines the requests.
+    function LensfunClient (worker)
+    {
+        this.worker = worker;
+        this.nextId = 1;
+        this.pending = {};
+        var self = this;
+        worker.addEventListener ('message', function (e) { self.dispatch (e.data); });
+    }
+
+    LensfunClient.prototype.request = function (message, transfer, onTile)
+    {
+        var self = this;
+        message.id = this.nextId++;
+        return new Promise (function (resolve, reject) {
+            self.pending[message.id] = { resolve: resolve, reject: reject, onTile: onTile };
+            self.worker.postMessage (message, transfer || []);
+        });
+    };
+
+    LensfunClient.prototype.dispatch = function (reply)
+    {
+        var req = reply && this.pending[reply.id];
+        if (!req)
+            return;
+        if (reply.type == 'tile')
+        {
+            if (req.onTile)
+                req.onTile (reply);
+            return;
+        }
+        delete this.pending[reply.id];
+        if (reply.type == 'error')
+            req.reject (new Error (reply.message));
+        else
+            req.resolve (reply);
+    };
+
+    // Resolves to { handle, flags } for a modifier kept in the worker
+    LensfunClient.prototype.createModifier = function (options)
+    {
+        var message = { type: 'createModifier' };
+        for (var key in options)
+            message[key] = options[key];
+        return this.request (message);
+    };
+
+    // Corrects an image held in pixels (an ArrayBuffer, which is
+    // transferred to the worker).  onTile (tile) is called with
+    // { firstRow, rowCount, pixels } for every corrected band as soon as
+    // the worker has it; the promise resolves to { pixels } with the
+    // source buffer handed back.
+    LensfunClient.prototype.correct = function (handle, pixels, options, onTile)
+    {
+        var message = { type: 'correct', handle: handle, pixels: pixels };
+        for (var key in options)
+            message[key] = options[key];
+        return this.request (message, [pixels], onTile);
+    };
+
+    // Loads side modules of the split build, e.g. ['perspective']
+    LensfunClient.prototype.require = function (modules)
+    {
+        return this.request ({ type: 'require', modules: modules });
+    };
+
+    LensfunClient.prototype.destroyModifier = function (handle)
+    {
+        return this.request ({ type: 'destroyModifier', handle: handle });
+    };
+
+    if (typeof module === 'object' && module.exports)
+        module.exports = LensfunClient;
+    else
+        root.LensfunClient = LensfunClient;
+}) (this);
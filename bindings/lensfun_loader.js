@@ -0,0 +1,45 @@
+// Picks the SIMD128 or the scalar lensfun worker depending on what the runtime supports.
+(function (root) {
+    'use strict';
+
+    // Smallest module using a SIMD128 instruction:
+    // (func (result v128) i32.const 0 i8x16.splat i8x16.popcnt)
+    var SIMD_PROBE = new Uint8Array ([
+        0, 97, 115, 109, 1, 0, 0, 0, 1, 5, 1, 96, 0, 1, 123, 3, 2, 1, 0, 10,
+        10, 1, 8, 0, 65, 0, 253, 15, 253, 98, 11
+    ]);
+
+    function hasSimd ()
+    {
+        try {
+            return typeof WebAssembly === 'object' &&
+                   WebAssembly.validate (SIMD_PROBE);
+        } catch (e) {
+            return false;
+        }
+    }
+
+    // Returns the worker script to use; base is the directory both builds
+    // live in (defaults to the current one).
+    function workerUrl (base)
+    {
+        var prefix = base ? base.replace (/\/?$/, '/') : '';
+        return prefix + (hasSimd () ? 'lensfun_wasm_simd.js' : 'lensfun_wasm.js');
+    }
+
+    function createWorker (base)
+    {
+        return new Worker (workerUrl (base));
+    }
+
+    var api = {
+        hasSimd: hasSimd,
+        workerUrl: workerUrl,
+        createWorker: createWorker
+    };
+
+    if (typeof module === 'object' && module.exports)
+        module.exports = api;
+    else
+        root.LensfunLoader = api;
+}) (this);
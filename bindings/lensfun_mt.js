@@ -0,0 +1,61 @@
+// Whole-image helpers for the pthreads build; appended to the module with --post-js.
+//
+// Each call copies its input into the shared heap, lets the thread pool
+// correct the image in bands of rows and copies the result back.  The pool
+// is joined synchronously, so in a browser call these from a worker rather
+// than from the page itself.  Under Node they can be called directly.
+
+function lfCorrectCoords (method, modifier, width, height, pairs, threads)
+{
+    var count = width * height * pairs;
+    var ptr = _malloc (count * 4);
+    try {
+        if (!modifier[method] (0, 0, width, height, ptr, threads || 0))
+            return null;
+        return HEAPF32.slice (ptr >> 2, (ptr >> 2) + count);
+    } finally {
+        _free (ptr);
+    }
+}
+
+// Returns a Float32Array with the distorted X, Y of every pixel, or null
+// if the modifier has nothing to do.
+Module['applyGeometryDistortion'] = function (modifier, width, height, threads)
+{
+    return lfCorrectCoords ('ApplyGeometryDistortionParallel',
+                            modifier, width, height, 2, threads);
+};
+
+// Returns a Float32Array with the distorted R, G, B coordinate pairs of
+// every pixel, or null if the modifier has nothing to do.
+Module['applySubpixelDistortion'] = function (modifier, width, height, threads)
+{
+    return lfCorrectCoords ('ApplySubpixelDistortionParallel',
+                            modifier, width, height, 6, threads);
+};
+
+Module['applySubpixelGeometryDistortion'] = function (modifier, width, height, threads)
+{
+    return lfCorrectCoords ('ApplySubpixelGeometryDistortionParallel',
+                            modifier, width, height, 6, threads);
+};
+
+// Corrects the colors of pixels, a typed array holding height tightly
+// packed rows, in place.  Returns false if the modifier has nothing to do.
+Module['applyColorModification'] = function (modifier, pixels, width, height,
+                                             compRole, threads)
+{
+    var bytes = pixels.byteLength;
+    var ptr = _malloc (bytes);
+    try {
+        var src = new Uint8Array (pixels.buffer, pixels.byteOffset, bytes);
+        HEAPU8.set (src, ptr);
+        if (!modifier.ApplyColorModificationParallel (
+                ptr, 0, 0, width, height, compRole, bytes / height, threads || 0))
+            return false;
+        src.set (HEAPU8.subarray (ptr, ptr + bytes));
+        return true;
+    } finally {
+        _free (ptr);
+    }
+};
@@ -0,0 +1,42 @@
+// On-demand loading of the side modules of the split build; appended to the core with --post-js.
+//
+//   database     lfDatabase, lfCamera, lens name parsing and model
+//                descriptions (lfLens::GuessParameters, Check, Get*Desc)
+//   perspective  perspective correction
+//   projections  lens projection conversions (LF_MODIFY_GEOMETRY between
+//                different lens types)
+//
+// Calling into a side module before it is loaded aborts, so load what a
+// task needs first.  The one exception is lfModifier.Initialize(): until
+// projections is loaded, it leaves LF_MODIFY_GEOMETRY out of the
+// corrections it sets up and of the flags it returns.
+//
+// Module.sideModuleTimes records how many milliseconds fetching, compiling
+// and instantiating every module took.
+
+var lfSideModuleFiles = {
+    'database': 'lensfun_database.wasm',
+    'perspective': 'lensfun_perspective.wasm',
+    'projections': 'lensfun_projections.wasm'
+};
+var lfSideModulePromises = {};
+
+Module['sideModuleTimes'] = {};
+
+// Returns a promise which resolves once the named side module is usable
+Module['loadSideModule'] = function (name)
+{
+    if (!lfSideModulePromises[name])
+    {
+        var file = lfSideModuleFiles[name];
+        if (!file)
+            return Promise.reject (new Error ('unknown side module ' + name));
+        var start = performance.now ();
+        lfSideModulePromises[name] = loadDynamicLibrary (
+            locateFile (file), { loadAsync: true, global: true, nodelete: true }
+        ).then (function () {
+            Module['sideModuleTimes'][name] = performance.now () - start;
+        });
+    }
+    return lfSideModulePromises[name];
+};
@@ -0,0 +1,221 @@
+// Message protocol of the worker builds; appended to the module with --post-js.
+//
+// Every request is an object { id, type, ... } and every reply carries the
+// id of its request.  Pixel buffers travel as transferable ArrayBuffers in
+// both directions, so neither side copies them.
+//
+// Requests run one at a time, in the order they arrive.  A page may post
+// several before the first one is answered, but they are only queued: a
+// 'correct' request sends all of its tiles before the next request starts,
+// and tiles of different requests never interleave.  This keeps a single
+// copy of a source image on the heap at a time.  Pages which want to see
+// several images progress at once, or to put a small image ahead of a big
+// one, use one worker per image.
+//
+//   { type: 'createModifier', lens, crop, width, height, format, focal,
+//     aperture, distance, scale, geometry, flags, reverse }
+//       -> { type: 'modifier', handle, flags }
+//     lens is { cropFactor, aspectRatio, centerX, centerY, distortion,
+//     tca, vignetting }, the last three being arrays of calibrations
+//     like { model: 'LF_DIST_MODEL_PTLENS', focal, terms: [...] }.
+//     format and geometry are lfPixelFormat and lfLensType names; a scale
+//     of 0, the default, fits the corrected image into the frame.
+//
+//   { type: 'correct', handle, pixels, width, height, components,
+//     interpolation, tileRows }
+//       -> { type: 'tile', firstRow, rowCount, pixels } for every band of
+//          tileRows rows (all rows by default), as soon as it is done
+//       -> { type: 'done', pixels }, returning the source buffer
+//
+//   { type: 'destroyModifier', handle } -> { type: 'destroyed' }
+//
+//   { type: 'require', modules: ['perspective', ...] } -> { type: 'loaded' }
+//     loads side modules of the split build (see side_modules.js); later
+//     requests wait for them.  Other builds contain everything already.
+//
+// Failures are answered with { type: 'error', message }.  Messages using
+// the emscripten worker API (with a funcName) are passed on to it.
+
+var lfWorkerModifiers = {};
+var lfWorkerNextHandle = 1;
+var lfWorkerQueue = [];
+
+function lfWorkerEnum (name)
+{
+    var value = Module[name];
+    if (value === undefined)
+        throw new Error ('unknown constant ' + name);
+    return value;
+}
+
+function lfWorkerSetTerms (calib, terms)
+{
+    for (var i = 0; terms && i < terms.length; i++)
+        calib.set_Terms (i, terms[i]);
+}
+
+function lfWorkerMakeLens (desc)
+{
+    var lens = new Module.lfLens ();
+    if (desc.cropFactor !== undefined) lens.set_CropFactor (desc.cropFactor);
+    if (desc.aspectRatio !== undefined) lens.set_AspectRatio (desc.aspectRatio);
+    if (desc.centerX !== undefined) lens.set_CenterX (desc.centerX);
+    if (desc.centerY !== undefined) lens.set_CenterY (desc.centerY);
+
+    (desc.distortion || []).forEach (function (d) {
+        var calib = new Module.lfLensCalibDistortion ();
+        calib.set_Model (lfWorkerEnum (d.model));
+        calib.set_Focal (d.focal);
+        calib.set_RealFocal (d.realFocal || 0);
+        calib.set_RealFocalMeasured (d.realFocal ? 1 : 0);
+        lfWorkerSetTerms (calib, d.terms);
+        lens.AddCalibDistortion (calib);
+        Module.destroy (calib);
+    });
+    (desc.tca || []).forEach (function (t) {
+        var calib = new Module.lfLensCalibTCA ();
+        calib.set_Model (lfWorkerEnum (t.model));
+        calib.set_Focal (t.focal);
+        lfWorkerSetTerms (calib, t.terms);
+        lens.AddCalibTCA (calib);
+        Module.destroy (calib);
+    });
+    (desc.vignetting || []).forEach (function (v) {
+        var calib = new Module.lfLensCalibVignetting ();
+        calib.set_Model (lfWorkerEnum (v.model));
+        calib.set_Focal (v.focal);
+        calib.set_Aperture (v.aperture);
+        calib.set_Distance (v.distance);
+        lfWorkerSetTerms (calib, v.terms);
+        lens.AddCalibVignetting (calib);
+        Module.destroy (calib);
+    });
+    return lens;
+}
+
+function lfWorkerCreateModifier (req)
+{
+    var lens = lfWorkerMakeLens (req.lens || {});
+    var format = req.format || 'LF_PF_U8';
+    var modifier = new Module.lfModifier (lens, req.crop, req.width, req.height);
+    var flags = modifier.Initialize (
+        lens, lfWorkerEnum (format), req.focal, req.aperture || 0,
+        req.distance || 1000, req.scale || 0,
+        lfWorkerEnum (req.geometry || 'LF_RECTILINEAR'),
+        req.flags === undefined ? -1 : req.flags, !!req.reverse);
+    var handle = lfWorkerNextHandle++;
+    lfWorkerModifiers[handle] = {
+        modifier: modifier,
+        lens: lens,
+        bytes: format == 'LF_PF_U16' ? 2 : 1,
+        format: lfWorkerEnum (format)
+    };
+    postMessage ({ id: req.id, type: 'modifier', handle: handle, flags: flags });
+}
+
+function lfWorkerCorrect (req)
+{
+    var entry = lfWorkerModifiers[req.handle];
+    if (!entry)
+        throw new Error ('unknown modifier handle ' + req.handle);
+
+    var width = req.width, height = req.height, components = req.components || 4;
+    var stride = width * components * entry.bytes;
+    var bytes = stride * height;
+    if (req.pixels.byteLength < bytes)
+        throw new Error ('pixel buffer too small');
+    var interpolation = lfWorkerEnum (req.interpolation || 'LF_INTERPOLATION_BILINEAR');
+    var tileRows = Math.min (req.tileRows || height, height);
+    // LF_CR_3 (RED, GREEN, BLUE) and LF_CR_4 (RED, GREEN, BLUE, UNKNOWN)
+    var comp_role = components == 3 ? 0x654 : 0x2654;
+
+    var src = _malloc (bytes);
+    var dst = _malloc (stride * tileRows);
+    try {
+        HEAPU8.set (new Uint8Array (req.pixels, 0, bytes), src);
+        entry.modifier.ApplyColorModification (src, 0, 0, width, height,
+                                               comp_role, stride);
+        for (var first = 0; first < height; first += tileRows)
+        {
+            var rows = Math.min (tileRows, height - first);
+            if (!entry.modifier.ApplyImageResampling (
+                    src, stride, dst, stride, width, height, entry.format,
+                    components, interpolation, first, rows, 0))
+                throw new Error ('unsupported pixel layout');
+            var tile = HEAPU8.slice (dst, dst + stride * rows).buffer;
+            postMessage ({ id: req.id, type: 'tile', firstRow: first,
+                           rowCount: rows, pixels: tile }, [tile]);
+        }
+    } finally {
+        _free (src);
+        _free (dst);
+    }
+    postMessage ({ id: req.id, type: 'done', pixels: req.pixels }, [req.pixels]);
+}
+
+function lfWorkerDestroyModifier (req)
+{
+    var entry = lfWorkerModifiers[req.handle];
+    if (entry)
+    {
+        Module.destroy (entry.modifier);
+        Module.destroy (entry.lens);
+        delete lfWorkerModifiers[req.handle];
+    }
+    postMessage ({ id: req.id, type: 'destroyed' });
+}
+
+function lfWorkerRequire (req)
+{
+    var load = Module['loadSideModule'];
+    return Promise.all ((req.modules || []).map (function (name) {
+        return load ? load (name) : null;
+    })).then (function () {
+        postMessage ({ id: req.id, type: 'loaded' });
+    });
+}
+
+function lfWorkerError (req, e)
+{
+    postMessage ({ id: req.id, type: 'error', message: String (e && e.message || e) });
+}
+
+// Requests run one after the other, see the protocol above; a pending
+// 'require' holds back the requests behind it
+var lfWorkerChain = Promise.resolve ();
+
+function lfWorkerHandle (req)
+{
+    lfWorkerChain = lfWorkerChain.then (function () {
+        switch (req.type)
+        {
+            case 'createModifier': return lfWorkerCreateModifier (req);
+            case 'correct': return lfWorkerCorrect (req);
+            case 'destroyModifier': return lfWorkerDestroyModifier (req);
+            case 'require': return lfWorkerRequire (req);
+            default: throw new Error ('unknown request ' + req.type);
+        }
+    }).catch (function (e) {
+        lfWorkerError (req, e);
+    });
+}
+
+(function () {
+    var emscriptenHandler = self.onmessage;
+
+    self.onmessage = function (msg) {
+        var req = msg.data;
+        if (!req || req.funcName !== undefined)
+            return emscriptenHandler && emscriptenHandler (msg);
+        // Hold requests until the module has finished loading
+        if (!runtimeInitialized)
+            lfWorkerQueue.push (req);
+        else
+            lfWorkerHandle (req);
+    };
+
+    addOnPostRun (function () {
+        while (lfWorkerQueue.length)
+            lfWorkerHandle (lfWorkerQueue.shift ());
+    });
+}) ();
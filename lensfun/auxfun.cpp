@@ -10,13 +10,17 @@
 #include <ctype.h>
 #include <stdlib.h>
 #include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <new>
 
 typedef char gchar;
 
+// The language of lf_mlstr_get(); a constant, so that nothing is shared
+// between threads
 static const char *_lf_get_lang ()
 {
-    static char lang [16];
-    return strcpy (lang, "en");
+    return "en";
 }
 
 void lf_free (void *data)
@@ -26,11 +30,14 @@ void lf_free (void *data)
 
 const char *lf_mlstr_get (const lfMLstr str)
 {
-    if (!str)
+    return lf_mlstr_get_lang (str, _lf_get_lang ());
+}
+
+const char *lf_mlstr_get_lang (const lfMLstr str, const char *lang)
+{
+    if (!str || !lang)
         return str;
 
-    /* Get the current locale for messages */
-    const char *lang = _lf_get_lang ();
     /* Default value if no language matches */
     const char *def = str;
     /* Find the corresponding string in the lot */
@@ -103,6 +110,9 @@ lfMLstr lf_mlstr_dup (const lfMLstr str)
         str_len++;
     }
 
+    if (!str)
+        return NULL;
+
     gchar *ret = (char *)malloc (str_len);
     memcpy (ret, str, str_len);
     return ret;
@@ -175,6 +185,262 @@ bool _lf_delobj (void ***var, int idx)
     return true;
 }
 
+// The records of a calibration table as plain arrays, from which tables
+// are built
+struct lfCalibRecords
+{
+    int Fields, Stride;
+    /// Fields values per record
+    std::vector<float> Values;
+    /// Stride terms per record
+    std::vector<float> Terms;
+    std::vector<unsigned char> Models;
+
+    int Count () const { return (int)Models.size (); }
+};
+
+static void calib_table_read (const lfCalibTable *table, lfCalibRecords &records)
+{
+    records.Fields = table->Fields;
+    records.Stride = table->Stride;
+    records.Values.resize (size_t (table->Count) * table->Fields);
+    for (int f = 0; f < table->Fields; f++)
+    {
+        lfCalibField field = table->Field (f);
+        for (int i = 0; i < table->Count; i++)
+            records.Values [i * table->Fields + f] = field [i];
+    }
+    records.Terms.assign (table->Terms (), table->Terms () + table->Count * table->Stride);
+    records.Models.assign (table->Models (), table->Models () + table->Count);
+}
+
+// Changes the number of terms per record to stride
+static void calib_records_restride (lfCalibRecords &records, int stride)
+{
+    std::vector<float> terms (size_t (records.Count ()) * stride, 0.0f);
+    for (int i = 0; i < records.Count (); i++)
+        memcpy (&terms [i * stride], &records.Terms [i * records.Stride],
+                std::min (stride, records.Stride) * sizeof (float));
+    records.Terms.swap (terms);
+    records.Stride = stride;
+}
+
+// The index of x in a dictionary, or -1.  Values are told apart by their
+// bits, so that they come back exactly.
+static int calib_dict_find (const float *dict, int size, float x)
+{
+    for (int i = 0; i < size; i++)
+        if (!memcmp (&dict [i], &x, sizeof (float)))
+            return i;
+    return -1;
+}
+
+// A new table of the given layout, with all but Refs uninitialized
+static lfCalibTable *calib_table_alloc (int count, int fields, int stride,
+                                        const int *dict_size)
+{
+    size_t floats = size_t (count) * stride, bytes = count;
+    for (int f = 0; f < fields; f++)
+        if (dict_size [f])
+        {
+            floats += dict_size [f];
+            bytes += count;
+        }
+        else
+            floats += count;
+
+    char *block = (char *)malloc (sizeof (lfCalibTable) + floats * sizeof (float) + bytes);
+    lfCalibTable *table = new (block) lfCalibTable ();
+    table->Refs.store (1, std::memory_order_relaxed);
+    table->Count = count;
+    table->Fields = (unsigned char)fields;
+    table->Stride = (unsigned char)stride;
+    for (int f = 0; f < LF_CALIB_MAX_FIELDS; f++)
+        table->DictSize [f] = (unsigned char)(f < fields ? dict_size [f] : 0);
+    return table;
+}
+
+// Packs records into a new table.  Fields get a dictionary if that takes
+// less memory than the plain values.
+static lfCalibTable *calib_table_build (const lfCalibRecords &records)
+{
+    const int count = records.Count ();
+    if (!count)
+        return NULL;
+
+    std::vector<float> dict [LF_CALIB_MAX_FIELDS];
+    int dict_size [LF_CALIB_MAX_FIELDS] = { 0 };
+    for (int f = 0; f < records.Fields; f++)
+    {
+        for (int i = 0; i < count && dict [f].size () <= 255; i++)
+        {
+            float x = records.Values [i * records.Fields + f];
+            if (calib_dict_find (dict [f].data (), (int)dict [f].size (), x) < 0)
+                dict [f].push_back (x);
+        }
+        if (dict [f].size () <= 255 &&
+            dict [f].size () * sizeof (float) + count < count * sizeof (float))
+            dict_size [f] = (int)dict [f].size ();
+    }
+
+    lfCalibTable *table = calib_table_alloc (count, records.Fields, records.Stride, dict_size);
+    if (!records.Terms.empty ())
+        memcpy ((float *)table->Terms (), records.Terms.data (),
+                records.Terms.size () * sizeof (float));
+    for (int f = 0; f < records.Fields; f++)
+    {
+        lfCalibField field = table->Field (f);
+        float *values = (float *)field.Values;
+        unsigned char *index = (unsigned char *)field.Index;
+        if (index)
+            memcpy (values, dict [f].data (), dict_size [f] * sizeof (float));
+        for (int i = 0; i < count; i++)
+        {
+            float x = records.Values [i * records.Fields + f];
+            if (index)
+                index [i] = (unsigned char)calib_dict_find (values, dict_size [f], x);
+            else
+                values [i] = x;
+        }
+    }
+    memcpy ((unsigned char *)table->Models (), records.Models.data (), count);
+    return table;
+}
+
+// A copy of table with a record appended, in the same layout, or NULL if
+// the record does not fit into it
+static lfCalibTable *calib_table_append (const lfCalibTable *table, int model,
+                                         const float *values, const float *terms,
+                                         int term_count)
+{
+    if (term_count > table->Stride)
+        return NULL;
+
+    int dict_size [LF_CALIB_MAX_FIELDS], entry [LF_CALIB_MAX_FIELDS];
+    for (int f = 0; f < table->Fields; f++)
+    {
+        dict_size [f] = table->DictSize [f];
+        if (!dict_size [f])
+            continue;
+        entry [f] = calib_dict_find (table->Field (f).Values, dict_size [f], values [f]);
+        if (entry [f] < 0)
+        {
+            if (dict_size [f] == 255)
+                return NULL;
+            entry [f] = dict_size [f]++;
+        }
+    }
+
+    const int count = table->Count;
+    lfCalibTable *copy = calib_table_alloc (count + 1, table->Fields, table->Stride, dict_size);
+    float *copy_terms = (float *)copy->Terms ();
+    memcpy (copy_terms, table->Terms (), count * table->Stride * sizeof (float));
+    memset (copy_terms + count * table->Stride, 0, table->Stride * sizeof (float));
+    if (term_count)
+        memcpy (copy_terms + count * table->Stride, terms, term_count * sizeof (float));
+    for (int f = 0; f < table->Fields; f++)
+    {
+        lfCalibField from = table->Field (f), to = copy->Field (f);
+        if (to.Index)
+        {
+            memcpy ((float *)to.Values, from.Values, table->DictSize [f] * sizeof (float));
+            ((float *)to.Values) [entry [f]] = values [f];
+            memcpy ((unsigned char *)to.Index, from.Index, count);
+            ((unsigned char *)to.Index) [count] = (unsigned char)entry [f];
+        }
+        else
+        {
+            memcpy ((float *)to.Values, from.Values, count * sizeof (float));
+            ((float *)to.Values) [count] = values [f];
+        }
+    }
+    memcpy ((unsigned char *)copy->Models (), table->Models (), count);
+    ((unsigned char *)copy->Models ()) [count] = (unsigned char)model;
+    return copy;
+}
+
+void _lf_calib_table_add (lfCalibTable **var, int model, const float *values,
+                          int fields, int key_fields, const float *terms, int term_count)
+{
+    const lfCalibTable *table = *var;
+    int idx = 0, count = table ? table->Count : 0;
+    for (; idx < count; idx++)
+    {
+        int f = 0;
+        while (f < key_fields && table->Field (f) [idx] == values [f])
+            f++;
+        if (f == key_fields)
+            break;
+    }
+
+    // New records are appended in the layout of the table, except when the
+    // number of records reaches a power of two: then the layout is chosen
+    // anew for all records, like after replacing or removing one
+    lfCalibTable *copy = NULL;
+    if (idx == count && count & (count + 1))
+        copy = calib_table_append (table, model, values, terms, term_count);
+
+    if (!copy)
+    {
+        lfCalibRecords records;
+        records.Fields = fields;
+        records.Stride = 0;
+        if (table)
+            calib_table_read (table, records);
+        if (term_count > records.Stride)
+            calib_records_restride (records, term_count);
+        if (idx == count)
+        {
+            records.Values.resize (records.Values.size () + fields);
+            records.Terms.resize (records.Terms.size () + records.Stride);
+            records.Models.push_back (0);
+        }
+
+        std::copy (values, values + fields, &records.Values [idx * fields]);
+        std::fill_n (records.Terms.begin () + idx * records.Stride, records.Stride, 0.0f);
+        std::copy (terms, terms + term_count, records.Terms.begin () + idx * records.Stride);
+        records.Models [idx] = (unsigned char)model;
+        copy = calib_table_build (records);
+    }
+
+    _lf_calib_table_free (*var);
+    *var = copy;
+}
+
+bool _lf_calib_table_del (lfCalibTable **var, int idx)
+{
+    if (!*var || idx < 0 || idx >= (*var)->Count)
+        return false;
+
+    lfCalibRecords records;
+    calib_table_read (*var, records);
+    records.Values.erase (records.Values.begin () + idx * records.Fields,
+                          records.Values.begin () + (idx + 1) * records.Fields);
+    records.Terms.erase (records.Terms.begin () + idx * records.Stride,
+                         records.Terms.begin () + (idx + 1) * records.Stride);
+    records.Models.erase (records.Models.begin () + idx);
+
+    _lf_calib_table_free (*var);
+    *var = calib_table_build (records);
+    return true;
+}
+
+lfCalibTable *_lf_calib_table_ref (lfCalibTable *table)
+{
+    if (table)
+        table->Refs.fetch_add (1, std::memory_order_relaxed);
+    return table;
+}
+
+void _lf_calib_table_free (lfCalibTable *table)
+{
+    if (!table || table->Refs.fetch_sub (1, std::memory_order_acq_rel) != 1)
+        return;
+
+    table->~lfCalibTable ();
+    free (table);
+}
+
 float _lf_interpolate (float y1, float y2, float y3, float y4, float t)
 {
     float tg2, tg3;
@@ -6,6 +6,7 @@
 #include "config.h"
 #include "lensfun.h"
 #include "lensfunprv.h"
+#include <utility>
 
 lfCamera::lfCamera ()
 {
@@ -24,6 +25,49 @@ lfCamera::~lfCamera ()
     lf_free (Mount);
 }
 
+lfCamera::lfCamera (const lfCamera &other)
+{
+    memset (this, 0, sizeof (*this));
+    *this = other;
+}
+
+lfCamera::lfCamera (lfCamera &&other)
+{
+    memcpy (this, &other, sizeof (*this));
+    memset (&other, 0, sizeof (other));
+}
+
+lfCamera &lfCamera::operator = (const lfCamera &other)
+{
+    if (this == &other)
+        return *this;
+
+    lf_free (Maker);
+    Maker = lf_mlstr_dup (other.Maker);
+    lf_free (Model);
+    Model = lf_mlstr_dup (other.Model);
+    lf_free (Variant);
+    Variant = lf_mlstr_dup (other.Variant);
+    lf_free (Mount);
+    Mount = other.Mount ? strdup (other.Mount) : NULL;
+    CropFactor = other.CropFactor;
+    Score = other.Score;
+
+    return *this;
+}
+
+lfCamera &lfCamera::operator = (lfCamera &&other)
+{
+    if (this != &other)
+    {
+        // The old contents go with the temporary
+        lfCamera old (std::move (*this));
+        memcpy (this, &other, sizeof (*this));
+        memset (&other, 0, sizeof (other));
+    }
+    return *this;
+}
+
 void lfCamera::SetMaker (const char *val, const char *lang)
 {
     Maker = lf_mlstr_add (Maker, lang, val);
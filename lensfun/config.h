@@ -26,8 +26,27 @@
 // add a macro to know we're compiling Lensfun, not a client library
 #define CONF_LENSFUN_INTERNAL
 
+// The SSE kernels are compiled with per-function target attributes and
+// selected at runtime by _lf_detect_cpu_features()
+#if (defined(__i386__) || defined(__x86_64__)) && defined(__GNUC__)
 #define VECTORIZATION_SSE
 #define VECTORIZATION_SSE2
+#define VECTORIZATION_SSE4_1
+#define VECTORIZATION_AVX2
+#endif
+
+// WebAssembly has no runtime feature detection; the SIMD128 kernels are
+// used whenever the module is built with -msimd128
+#ifdef __wasm_simd128__
+#define VECTORIZATION_SIMD128
+#endif
+
+// Batch functions run on std::thread where threads exist; the WebAssembly
+// module only has them when built with -s USE_PTHREADS
+#if __cplusplus >= 201103L && \
+    (!defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__))
+#define LF_HAVE_THREADS
+#endif
 
 #define HAVE_ENDIAN_H
 
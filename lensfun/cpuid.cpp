@@ -0,0 +1,77 @@
+/*
+    CPU features detection for runtime selection of vectorized kernels
+*/
+
+#include "config.h"
+#include "lensfun.h"
+#include "lensfunprv.h"
+
+#if (defined(__i386__) || defined(__x86_64__)) && defined(__GNUC__)
+#include <cpuid.h>
+
+static unsigned int detect_cpu_features ()
+{
+    unsigned int eax, ebx, ecx, edx;
+    unsigned int flags = 0;
+
+    if (!__get_cpuid (1, &eax, &ebx, &ecx, &edx))
+        return 0;
+
+    if (edx & bit_MMX)
+        flags |= LF_CPU_FLAG_MMX;
+    if (edx & bit_SSE)
+        flags |= LF_CPU_FLAG_SSE;
+    if (edx & bit_CMOV)
+        flags |= LF_CPU_FLAG_CMOV;
+    if (edx & bit_SSE2)
+        flags |= LF_CPU_FLAG_SSE2;
+    if (ecx & bit_SSE3)
+        flags |= LF_CPU_FLAG_SSE3;
+    if (ecx & bit_SSSE3)
+        flags |= LF_CPU_FLAG_SSSE3;
+    if (ecx & bit_SSE4_1)
+        flags |= LF_CPU_FLAG_SSE4_1;
+    if (ecx & bit_SSE4_2)
+        flags |= LF_CPU_FLAG_SSE4_2;
+
+    // AVX is only usable if the OS saves the YMM registers on context switch
+    if ((ecx & bit_OSXSAVE) && (ecx & bit_AVX))
+    {
+        unsigned int xcr0_lo, xcr0_hi;
+        __asm__ ("xgetbv" : "=a" (xcr0_lo), "=d" (xcr0_hi) : "c" (0));
+        if ((xcr0_lo & 6) == 6)
+        {
+            flags |= LF_CPU_FLAG_AVX;
+            if (__get_cpuid_max (0, NULL) >= 7)
+            {
+                __cpuid_count (7, 0, eax, ebx, ecx, edx);
+                if (ebx & bit_AVX2)
+                    flags |= LF_CPU_FLAG_AVX2;
+            }
+        }
+    }
+
+    return flags;
+}
+
+#else
+
+static unsigned int detect_cpu_features ()
+{
+    return 0;
+}
+
+#endif
+
+static std::atomic<unsigned int> cpu_features_mask (~0u);
+
+unsigned int _lf_detect_cpu_features ()
+{
+    static unsigned int cpuflags = detect_cpu_features ();
+    return cpuflags & cpu_features_mask.load (std::memory_order_relaxed);
+}
+
+void _lf_mask_cpu_features (unsigned int mask)
+{
+    cpu_features_mask.store (mask, std::memory_order_relaxed);
+}
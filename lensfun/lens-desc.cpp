@@ -0,0 +1,379 @@
+/*
+    Human-readable descriptions of the lens models
+*/
+
+#include "config.h"
+#include "lensfun.h"
+#include "lensfunprv.h"
+
+const char *lfLens::GetDistortionModelDesc (
+    lfDistortionModel model, const char **details, const lfParameter ***params)
+{
+    static const lfParameter *param_none [] = { NULL };
+
+    static const lfParameter param_poly3_k1 = { "k1", -0.2F, 0.2F, 0.0F };
+    static const lfParameter *param_poly3 [] = { &param_poly3_k1, NULL };
+
+    static const lfParameter param_poly5_k2 = { "k2", -0.2F, 0.2F, 0.0F };
+    static const lfParameter *param_poly5 [] = { &param_poly3_k1, &param_poly5_k2, NULL };
+
+    static const lfParameter param_ptlens_a = { "a", -0.5F, 0.5F, 0.0F };
+    static const lfParameter param_ptlens_b = { "b", -1.0F, 1.0F, 0.0F };
+    static const lfParameter param_ptlens_c = { "c", -1.0F, 1.0F, 0.0F };
+    static const lfParameter *param_ptlens [] = {
+        &param_ptlens_a, &param_ptlens_b, &param_ptlens_c, NULL };
+
+    static const lfParameter param_acm_k3 = { "k3", -1.0F, 1.0F, 0.0F };
+    static const lfParameter param_acm_k4 = { "k4", -1.0F, 1.0F, 0.0F };
+    static const lfParameter param_acm_k5 = { "k5", -1.0F, 1.0F, 0.0F };
+    static const lfParameter *param_acm [] = {
+        &param_poly3_k1, &param_poly5_k2, &param_acm_k3,
+        &param_acm_k4, &param_acm_k5, NULL };
+
+    switch (model)
+    {
+        case LF_DIST_MODEL_NONE:
+            if (details)
+                *details = "No distortion model";
+            if (params)
+                *params = param_none;
+            return "None";
+
+        case LF_DIST_MODEL_POLY3:
+            if (details)
+                *details = "Rd = Ru * (1 - k1 + k1 * Ru^2)\n"
+                    "Ref: http://www.imatest.com/docs/distortion.html";
+            if (params)
+                *params = param_poly3;
+            return "3rd order polynomial";
+
+        case LF_DIST_MODEL_POLY5:
+            if (details)
+                *details = "Rd = Ru * (1 + k1 * Ru^2 + k2 * Ru^4)\n"
+                    "Ref: http://www.imatest.com/docs/distortion.html";
+            if (params)
+                *params = param_poly5;
+            return "5th order polynomial";
+
+        case LF_DIST_MODEL_PTLENS:
+            if (details)
+                *details = "Rd = Ru * (a * Ru^3 + b * Ru^2 + c * Ru + 1 - (a + b + c))\n"
+                    "Ref: http://wiki.panotools.org/Lens_correction_model";
+            if (params)
+                *params = param_ptlens;
+            return "PanoTools lens model";
+
+        case LF_DIST_MODEL_ACM:
+            if (details)
+                *details = "x_d = x_u (1 + k_1 r^2 + k_2 r^4 + k_3 r^6) + 2x(k_4y + k_5x) + k_5 r^2\n"
+                    "y_d = y_u (1 + k_1 r^2 + k_2 r^4 + k_3 r^6) + 2y(k_4y + k_5x) + k_4 r^2\n"
+                    "Coordinates are in units of focal length.\n"
+                    "Ref: http://download.macromedia.com/pub/labs/lensprofile_creator/lensprofile_creator_cameramodel.pdf";
+            if (params)
+                *params = param_acm;
+            return "Adobe camera model";
+
+        default:
+            // keep gcc 4.4 happy
+            break;
+    }
+
+    if (details)
+        *details = NULL;
+    if (params)
+        *params = NULL;
+    return NULL;
+}
+
+const char *lfLens::GetTCAModelDesc (
+    lfTCAModel model, const char **details, const lfParameter ***params)
+{
+    static const lfParameter *param_none [] = { NULL };
+
+    static const lfParameter param_linear_kr = { "kr", 0.99F, 1.01F, 1.0F };
+    static const lfParameter param_linear_kb = { "kb", 0.99F, 1.01F, 1.0F };
+    static const lfParameter *param_linear [] =
+    { &param_linear_kr, &param_linear_kb, NULL };
+
+    static const lfParameter param_poly3_br = { "br", -0.01F, 0.01F, 0.0F };
+    static const lfParameter param_poly3_cr = { "cr", -0.01F, 0.01F, 0.0F };
+    static const lfParameter param_poly3_vr = { "vr",  0.99F, 1.01F, 1.0F };
+    static const lfParameter param_poly3_bb = { "bb", -0.01F, 0.01F, 0.0F };
+    static const lfParameter param_poly3_cb = { "cb", -0.01F, 0.01F, 0.0F };
+    static const lfParameter param_poly3_vb = { "vb",  0.99F, 1.01F, 1.0F };
+    static const lfParameter *param_poly3 [] =
+    {
+        &param_poly3_vr, &param_poly3_vb,
+        &param_poly3_cr, &param_poly3_cb,
+        &param_poly3_br, &param_poly3_bb,
+        NULL
+    };
+
+    static const lfParameter param_acm_alpha0 = { "alpha0", 0.99F, 1.01F, 1.0F };
+    static const lfParameter param_acm_beta0 = { "beta0", 0.99F, 1.01F, 1.0F };
+    static const lfParameter param_acm_alpha1 = { "alpha1", -0.01F, 0.01F, 0.0F };
+    static const lfParameter param_acm_beta1 = { "beta1", -0.01F, 0.01F, 0.0F };
+    static const lfParameter param_acm_alpha2 = { "alpha2", -0.01F, 0.01F, 0.0F };
+    static const lfParameter param_acm_beta2 = { "beta2", -0.01F, 0.01F, 0.0F };
+    static const lfParameter param_acm_alpha3 = { "alpha3", -0.01F, 0.01F, 0.0F };
+    static const lfParameter param_acm_beta3 = { "beta3", -0.01F, 0.01F, 0.0F };
+    static const lfParameter param_acm_alpha4 = { "alpha4", -0.01F, 0.01F, 0.0F };
+    static const lfParameter param_acm_beta4 = { "beta4", -0.01F, 0.01F, 0.0F };
+    static const lfParameter param_acm_alpha5 = { "alpha5", -0.01F, 0.01F, 0.0F };
+    static const lfParameter param_acm_beta5 = { "beta5", -0.01F, 0.01F, 0.0F };
+    static const lfParameter *param_acm [] =
+    {
+        &param_acm_alpha0, &param_acm_beta0,
+        &param_acm_alpha1, &param_acm_beta1,
+        &param_acm_alpha2, &param_acm_beta2,
+        &param_acm_alpha3, &param_acm_beta3,
+        &param_acm_alpha4, &param_acm_beta4,
+        &param_acm_alpha5, &param_acm_beta5,
+        NULL
+    };
+
+    switch (model)
+    {
+        case LF_TCA_MODEL_NONE:
+            if (details)
+                *details = "No transversal chromatic aberration model";
+            if (params)
+                *params = param_none;
+            return "None";
+
+        case LF_TCA_MODEL_LINEAR:
+            if (details)
+                *details = "Cd = Cs * k\n"
+                    "Ref: http://cipa.icomos.org/fileadmin/papers/Torino2005/403.pdf";
+            if (params)
+                *params = param_linear;
+            return "Linear";
+
+        case LF_TCA_MODEL_POLY3:
+            if (details)
+                *details = "Cd = Cs^3 * b + Cs^2 * c + Cs * v\n"
+                    "Ref: http://wiki.panotools.org/Tca_correct";
+            if (params)
+                *params = param_poly3;
+            return "3rd order polynomial";
+
+        case LF_TCA_MODEL_ACM:
+            if (details)
+                *details = "x_{d,R} = α_0 ((1 + α_1 r_{u,R}^2 + α_2 r_{u,R}^4 + α_3 r_{u,R}^6) x_{u,R} +\n"
+                           "          2(α_4 y_{u,R} + α_5 x_{u,R}) x_{u,R} + α_5 r_{u,R}^2)\n"
+                           "y_{d,R} = α_0 ((1 + α_1 r_{u,R}^2 + α_2 r_{u,R}^4 + α_3 r_{u,R}^6) y_{u,R} +\n"
+                           "          2(α_4 y_{u,R} + α_5 x_{u,R}) y_{u,R} + α_4 r_{u,R}^2)\n"
+                           "x_{d,B} = β_0 ((1 + β_1 r_{u,B}^2 + β_2 r_{u,B}^4 + β_3 r_{u,B}^6) x_{u,B} +\n"
+                           "          2(β_4 y_{u,B} + β_5 x_{u,B}) x_{u,B} + β_5 r_{u,B}^2)\n"
+                           "y_{d,B} = β_0 ((1 + β_1 r_{u,B}^2 + β_2 r_{u,B}^4 + β_3 r_{u,B}^6) y_{u,B} +\n"
+                           "          2(β_4 y_{u,B} + β_5 x_{u,B}) y_{u,B} + β_4 r_{u,B}^2)\n"
+                    "Ref: http://download.macromedia.com/pub/labs/lensprofile_creator/lensprofile_creator_cameramodel.pdf";
+            if (params)
+                *params = param_acm;
+            return "Adobe camera model";
+
+        default:
+            // keep gcc 4.4 happy
+            break;
+    }
+
+    if (details)
+        *details = NULL;
+    if (params)
+        *params = NULL;
+    return NULL;
+}
+
+const char *lfLens::GetVignettingModelDesc (
+    lfVignettingModel model, const char **details, const lfParameter ***params)
+{
+    static const lfParameter *param_none [] = { NULL };
+
+    static const lfParameter param_pa_k1 = { "k1", -3.0, 1.0, 0.0 };
+    static const lfParameter param_pa_k2 = { "k2", -5.0, 10.0, 0.0 };
+    static const lfParameter param_pa_k3 = { "k3", -5.0, 10.0, 0.0 };
+    static const lfParameter *param_pa [] =
+    { &param_pa_k1, &param_pa_k2, &param_pa_k3, NULL };
+
+    static const lfParameter param_acm_alpha1 = { "alpha1", -1.0, 1.0, 0.0 };
+    static const lfParameter param_acm_alpha2 = { "alpha2", -5.0, 10.0, 0.0 };
+    static const lfParameter param_acm_alpha3 = { "alpha3", -5.0, 10.0, 0.0 };
+    static const lfParameter *param_acm [] =
+    { &param_acm_alpha1, &param_acm_alpha2, &param_acm_alpha3, NULL };
+
+    switch (model)
+    {
+        case LF_VIGNETTING_MODEL_NONE:
+            if (details)
+                *details = "No vignetting model";
+            if (params)
+                *params = param_none;
+            return "None";
+
+        case LF_VIGNETTING_MODEL_PA:
+            if (details)
+                *details = "Pablo D'Angelo vignetting model\n"
+                    "(which is a more general variant of the cos^4 law):\n"
+                    "Cd = Cs * (1 + k1 * R^2 + k2 * R^4 + k3 * R^6)\n"
+                    "Ref: http://hugin.sourceforge.net/tech/";
+            if (params)
+                *params = param_pa;
+            return "6th order polynomial (Pablo D'Angelo)";
+
+        case LF_VIGNETTING_MODEL_ACM:
+            if (details)
+                *details = "Adobe's vignetting model\n"
+                    "(which differs from D'Angelo's only in the coordinate system):\n"
+                    "Cd = Cs * (1 + k1 * R^2 + k2 * R^4 + k3 * R^6)\n"
+                    "Ref: http://download.macromedia.com/pub/labs/lensprofile_creator/lensprofile_creator_cameramodel.pdf";
+            if (params)
+                *params = param_acm;
+            return "6th order polynomial (Adobe)";
+
+        default:
+            // keep gcc 4.4 happy
+            break;
+    }
+
+    if (details)
+        *details = "";
+    if (params)
+        *params = NULL;
+    return NULL;
+}
+
+const char *lfLens::GetCropDesc (
+    lfCropMode mode , const char **details, const lfParameter ***params)
+{
+    static const lfParameter *param_none [] = { NULL };
+
+    static const lfParameter param_crop_left = { "left", -1.0F, 1.0F, 0.0F };
+    static const lfParameter param_crop_right = { "right", 0.0F, 2.0F, 0.0F };
+    static const lfParameter param_crop_top = { "top", -1.0F, 1.0F, 0.0F };
+    static const lfParameter param_crop_bottom = { "bottom", 0.0F, 2.0F, 0.0F };
+    static const lfParameter *param_crop [] = { &param_crop_left, &param_crop_right, &param_crop_top, &param_crop_bottom, NULL };
+
+    switch (mode)
+    {
+        case LF_NO_CROP:
+            if (details)
+                *details = "No crop";
+            if (params)
+                *params = param_none;
+            return "No crop";
+
+        case LF_CROP_RECTANGLE:
+            if (details)
+                *details = "Rectangular crop area";
+            if (params)
+                *params = param_crop;
+            return "rectangular crop";
+
+        case LF_CROP_CIRCLE:
+            if (details)
+                *details = "Circular crop area";
+            if (params)
+                *params = param_crop;
+            return "circular crop";
+
+        default:
+            // keep gcc 4.4 happy
+            break;
+    }
+
+    if (details)
+        *details = NULL;
+    if (params)
+        *params = NULL;
+    return NULL;
+}
+
+const char *lfLens::GetLensTypeDesc (lfLensType type, const char **details)
+{
+    switch (type)
+    {
+        case LF_UNKNOWN:
+            if (details)
+                *details = "";
+            return "Unknown";
+
+        case LF_RECTILINEAR:
+            if (details)
+                *details = "Ref: http://wiki.panotools.org/Rectilinear_Projection";
+            return "Rectilinear";
+
+        case LF_FISHEYE:
+            if (details)
+                *details = "Ref: http://wiki.panotools.org/Fisheye_Projection";
+            return "Fish-Eye";
+
+        case LF_PANORAMIC:
+            if (details)
+                *details = "Ref: http://wiki.panotools.org/Cylindrical_Projection";
+            return "Panoramic";
+
+        case LF_EQUIRECTANGULAR:
+            if (details)
+                *details = "Ref: http://wiki.panotools.org/Equirectangular_Projection";
+            return "Equirectangular";
+
+        case LF_FISHEYE_ORTHOGRAPHIC:
+            if (details)
+                *details = "Ref: http://wiki.panotools.org/Fisheye_Projection";
+            return "Fisheye, orthographic";
+
+        case LF_FISHEYE_STEREOGRAPHIC:
+            if (details)
+                *details = "Ref: http://wiki.panotools.org/Stereographic_Projection";
+            return "Fisheye, stereographic";
+
+        case LF_FISHEYE_EQUISOLID:
+            if (details)
+                *details = "Ref: http://wiki.panotools.org/Fisheye_Projection";
+            return "Fisheye, equisolid";
+
+        case LF_FISHEYE_THOBY:
+            if (details)
+                *details = "Ref: http://groups.google.com/group/hugin-ptx/browse_thread/thread/bd822d178e3e239d";
+            return "Thoby-Fisheye";
+
+        default:
+            // keep gcc 4.4 happy
+            break;
+    }
+
+    if (details)
+        *details = "";
+    return NULL;
+}
+
+//---------------------------// The C interface //---------------------------//
+
+const char *lf_get_distortion_model_desc (
+    enum lfDistortionModel model, const char **details, const lfParameter ***params)
+{
+    return lfLens::GetDistortionModelDesc (model, details, params);
+}
+
+const char *lf_get_tca_model_desc (
+    enum lfTCAModel model, const char **details, const lfParameter ***params)
+{
+    return lfLens::GetTCAModelDesc (model, details, params);
+}
+
+const char *lf_get_vignetting_model_desc (
+    enum lfVignettingModel model, const char **details, const lfParameter ***params)
+{
+    return lfLens::GetVignettingModelDesc (model, details, params);
+}
+
+const char *lf_get_crop_desc (
+    enum lfCropMode mode, const char **details, const lfParameter ***params)
+{
+    return lfLens::GetCropDesc (mode, details, params);
+}
+
+const char *lf_get_lens_type_desc (enum lfLensType type, const char **details)
+{
+    return lfLens::GetLensTypeDesc (type, details);
+}
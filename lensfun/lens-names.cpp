@@ -0,0 +1,204 @@
+/*
+    Guessing lens parameters from the lens name
+*/
+
+#include "config.h"
+#include "lensfun.h"
+#include "lensfunprv.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <regex.h>
+
+typedef unsigned char guchar;
+
+static const struct
+{
+    const char *regex;
+    guchar matchidx [3];
+} lens_name_patterns [] =
+{
+    {
+        // [min focal]-[max focal]mm f/[min aperture]-[max aperture]
+        "([[:space:]]+|^)([0-9]+[0-9.]*)(-[0-9]+[0-9.]*)?(mm)?[[:space:]]+(f/|f|1/|1:)?([0-9.]+)(-[0-9.]+)?",
+        { 2, 3, 6 }
+    },
+    {
+        // 1:[min aperture]-[max aperture] [min focal]-[max focal]mm
+        "[[:space:]]+1:([0-9.]+)(-[0-9.]+)?[[:space:]]+([0-9.]+)(-[0-9.]+)?(mm)?",
+        { 3, 4, 1 }
+    },
+    {
+        // [min aperture]-[max aperture]/[min focal]-[max focal]
+        "([0-9.]+)(-[0-9.]+)?[[:space:]]*/[[:space:]]*([0-9.]+)(-[0-9.]+)?",
+        { 3, 4, 1 }
+    },
+};
+
+// The compiled expressions.  They are built once, by whichever thread needs
+// them first, and only read afterwards; regexec() does not change them.
+struct lfLensNameRegex
+{
+    regex_t name [ARRAY_LEN (lens_name_patterns)];
+    regex_t extender_magnification;
+
+    lfLensNameRegex ()
+    {
+        for (size_t i = 0; i < ARRAY_LEN (lens_name_patterns); i++)
+            regcomp (&name [i], lens_name_patterns [i].regex, REG_EXTENDED | REG_ICASE);
+        regcomp (&extender_magnification, "[0-9](\\.[0.9]+)?x",
+                 REG_EXTENDED | REG_ICASE);
+    }
+
+    ~lfLensNameRegex ()
+    {
+        for (size_t i = 0; i < ARRAY_LEN (lens_name_patterns); i++)
+            regfree (&name [i]);
+        regfree (&extender_magnification);
+    }
+};
+
+static const lfLensNameRegex &_lf_lens_name_regex ()
+{
+    // Initialization of local statics is thread-safe since C++11
+    static const lfLensNameRegex regex;
+    return regex;
+}
+
+// Numbers in lens names always have a dot as decimal separator.  They are
+// parsed by hand, since the locale is process-wide and setting LC_NUMERIC
+// for atof() would race with other threads.
+static float _lf_parse_float (const char *model, const regmatch_t &match)
+{
+    const char *src = model + match.rm_so;
+    const char *end = model + match.rm_eo;
+
+    // Skip '-' since it's not a minus sign but rather the separator
+    if (src < end && *src == '-')
+        src++;
+
+    float value = 0, divisor = 0;
+    for (; src < end; src++)
+        if (*src == '.')
+        {
+            if (divisor)
+                break;
+            divisor = 1;
+        }
+        else if (*src >= '0' && *src <= '9')
+        {
+            value = value * 10 + (*src - '0');
+            if (divisor)
+                divisor *= 10;
+        }
+        else
+            break;
+
+    return divisor ? value / divisor : value;
+}
+
+static bool _lf_parse_lens_name (const char *model,
+                                 float &minf, float &maxf,
+                                 float &mina)
+{
+    if (!model)
+        return false;
+
+    const lfLensNameRegex &regex = _lf_lens_name_regex ();
+    for (size_t i = 0; i < ARRAY_LEN (lens_name_patterns); i++)
+    {
+        regmatch_t matches [10];
+        if (regexec (&regex.name [i], model, 10, matches, 0))
+            continue;
+
+        const guchar *matchidx = lens_name_patterns [i].matchidx;
+        if (matches [matchidx [0]].rm_so != -1)
+            minf = _lf_parse_float (model, matches [matchidx [0]]);
+        if (matches [matchidx [1]].rm_so != -1)
+            maxf = _lf_parse_float (model, matches [matchidx [1]]);
+        if (matches [matchidx [2]].rm_so != -1)
+            mina = _lf_parse_float (model, matches [matchidx [2]]);
+        return true;
+    }
+
+    return false;
+}
+
+void lfLens::GuessParameters ()
+{
+    float minf = float (INT_MAX), maxf = float (INT_MIN);
+    float mina = float (INT_MAX), maxa = float (INT_MIN);
+
+    if (Model && (!MinAperture || !MinFocal) &&
+        !strstr (Model, "adapter") &&
+        !strstr (Model, "reducer") &&
+        !strstr (Model, "booster") &&
+        !strstr (Model, "extender") &&
+        !strstr (Model, "converter") &&
+        regexec (&_lf_lens_name_regex ().extender_magnification, Model, 0, NULL, 0))
+        _lf_parse_lens_name (Model, minf, maxf, mina);
+
+    if (!MinAperture || !MinFocal)
+    {
+        // Try to find out the range of focal lengths using calibration data;
+        // the tables keep the focal lengths in an array of their own
+        const lfCalibTable *tables [] =
+            { CalibDistortion, CalibTCA, CalibVignetting, CalibCrop, CalibFov };
+        for (size_t t = 0; t < ARRAY_LEN (tables); t++)
+            if (tables [t])
+                for (int i = 0; i < tables [t]->Count; i++)
+                {
+                    float f = tables [t]->Field (0) [i];
+                    if (f < minf)
+                        minf = f;
+                    if (f > maxf)
+                        maxf = f;
+                }
+        if (CalibVignetting)
+            for (int i = 0; i < CalibVignetting->Count; i++)
+            {
+                float a = CalibVignetting->Field (1) [i];
+                if (a < mina)
+                    mina = a;
+                if (a > maxa)
+                    maxa = a;
+            }
+
+    }
+
+    if (minf != INT_MAX && !MinFocal)
+        MinFocal = minf;
+    if (maxf != INT_MIN && !MaxFocal)
+        MaxFocal = maxf;
+    if (mina != INT_MAX && !MinAperture)
+        MinAperture = mina;
+    if (maxa != INT_MIN && !MaxAperture)
+        MaxAperture = maxa;
+
+    if (!MaxFocal)
+        MaxFocal = MinFocal;
+}
+
+bool lfLens::Check ()
+{
+    GuessParameters ();
+
+    if (!Model || !Mounts || CropFactor <= 0 ||
+        MinFocal > MaxFocal || (MaxAperture && MinAperture > MaxAperture) ||
+        AspectRatio < 1)
+        return false;
+
+    return true;
+}
+
+//---------------------------// The C interface //---------------------------//
+
+void lf_lens_guess_parameters (lfLens *lens)
+{
+    lens->GuessParameters ();
+}
+
+cbool lf_lens_check (lfLens *lens)
+{
+    return lens->Check ();
+}
@@ -6,115 +6,12 @@
 #include "config.h"
 #include "lensfun.h"
 #include "lensfunprv.h"
-#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
-#include <locale.h>
 #include <math.h>
 #include "windows/mathconstants.h"
 #include <algorithm>
-#include <regex.h>
-
-typedef unsigned char guchar;
-
-static struct
-{
-    const char *regex;
-    guchar matchidx [3];
-    bool compiled;
-    regex_t rex;
-} lens_name_regex [] =
-{
-    {
-        // [min focal]-[max focal]mm f/[min aperture]-[max aperture]
-        "([[:space:]]+|^)([0-9]+[0-9.]*)(-[0-9]+[0-9.]*)?(mm)?[[:space:]]+(f/|f|1/|1:)?([0-9.]+)(-[0-9.]+)?",
-        { 2, 3, 6 },
-        false
-    },
-    {
-        // 1:[min aperture]-[max aperture] [min focal]-[max focal]mm
-        "[[:space:]]+1:([0-9.]+)(-[0-9.]+)?[[:space:]]+([0-9.]+)(-[0-9.]+)?(mm)?",
-        { 3, 4, 1 },
-        false
-    },
-    {
-        // [min aperture]-[max aperture]/[min focal]-[max focal]
-        "([0-9.]+)(-[0-9.]+)?[[:space:]]*/[[:space:]]*([0-9.]+)(-[0-9.]+)?",
-        { 3, 4, 1 },
-        false
-    },
-};
-
-static struct
-{
-    bool compiled;
-    regex_t rex;
-} extender_magnification_regex =
-{
-    false
-};
-
-static float _lf_parse_float (const char *model, const regmatch_t &match)
-{
-    char tmp [100];
-    const char *src = model + match.rm_so;
-    int len = match.rm_eo - match.rm_so;
-
-    // Skip '-' since it's not a minus sign but rather the separator
-    if (*src == '-')
-        src++, len--;
-    strncpy (tmp, src, len);
-    tmp [len] = 0;
-
-    return atof (tmp);
-}
-
-static bool _lf_parse_lens_name (const char *model,
-                                 float &minf, float &maxf,
-                                 float &mina)
-{
-    if (!model)
-        return false;
-
-    for (size_t i = 0; i < ARRAY_LEN (lens_name_regex); i++)
-    {
-        if (!lens_name_regex [i].compiled)
-        {
-            regcomp (&lens_name_regex [i].rex, lens_name_regex [i].regex,
-                     REG_EXTENDED | REG_ICASE);
-            lens_name_regex [i].compiled = true;
-        }
-
-        regmatch_t matches [10];
-        if (regexec (&lens_name_regex [i].rex, model, 10, matches, 0))
-            continue;
-
-        guchar *matchidx = lens_name_regex [i].matchidx;
-        if (matches [matchidx [0]].rm_so != -1)
-            minf = _lf_parse_float (model, matches [matchidx [0]]);
-        if (matches [matchidx [1]].rm_so != -1)
-            maxf = _lf_parse_float (model, matches [matchidx [1]]);
-        if (matches [matchidx [2]].rm_so != -1)
-            mina = _lf_parse_float (model, matches [matchidx [2]]);
-        return true;
-    }
-
-    return false;
-}
-
-static void _lf_free_lens_regex ()
-{
-    for (size_t i = 0; i < ARRAY_LEN (lens_name_regex); i++)
-        if (lens_name_regex [i].compiled)
-        {
-            regfree (&lens_name_regex [i].rex);
-            lens_name_regex [i].compiled = false;
-        }
-}
-
-//------------------------------------------------------------------------//
-
-static int _lf_lens_regex_refs = 0;
+#include <utility>
 
 lfLens::lfLens ()
 {
@@ -124,7 +21,6 @@ lfLens::lfLens ()
     // reading the database.
     memset (this, 0, sizeof (*this));
     Type = LF_UNKNOWN;
-    _lf_lens_regex_refs++;
 }
 
 lfLens::~lfLens ()
@@ -132,59 +28,33 @@ lfLens::~lfLens ()
     lf_free (Maker);
     lf_free (Model);
     _lf_list_free ((void **)Mounts);
-    _lf_list_free ((void **)CalibDistortion);
-    _lf_list_free ((void **)CalibTCA);
-    _lf_list_free ((void **)CalibVignetting);
-    _lf_list_free ((void **)CalibCrop);
-    _lf_list_free ((void **)CalibFov);
-    if (!--_lf_lens_regex_refs)
-        _lf_free_lens_regex ();
+    _lf_calib_table_free (CalibDistortion);
+    _lf_calib_table_free (CalibTCA);
+    _lf_calib_table_free (CalibVignetting);
+    _lf_calib_table_free (CalibCrop);
+    _lf_calib_table_free (CalibFov);
 }
 
 lfLens::lfLens (const lfLens &other)
 {
-    Maker = lf_mlstr_dup (other.Maker);
-    Model = lf_mlstr_dup (other.Model);
-    MinFocal = other.MinFocal;
-    MaxFocal = other.MaxFocal;
-    MinAperture = other.MinAperture;
-    MaxAperture = other.MaxAperture;
-
-    Mounts = NULL;
-    if (other.Mounts)
-        for (int i = 0; other.Mounts [i]; i++)
-            AddMount (other.Mounts [i]);
-
-    CenterX = other.CenterX;
-    CenterY = other.CenterY;
-    CropFactor = other.CropFactor;
-    AspectRatio = other.AspectRatio;
-    Type = other.Type;
+    memset (this, 0, sizeof (*this));
+    *this = other;
+}
 
-    CalibDistortion = NULL;
-    if (other.CalibDistortion)
-        for (int i = 0; other.CalibDistortion [i]; i++)
-            AddCalibDistortion (other.CalibDistortion [i]);
-    CalibTCA = NULL;
-    if (other.CalibTCA)
-        for (int i = 0; other.CalibTCA [i]; i++)
-            AddCalibTCA (other.CalibTCA [i]);
-    CalibVignetting = NULL;
-    if (other.CalibVignetting)
-        for (int i = 0; other.CalibVignetting [i]; i++)
-            AddCalibVignetting (other.CalibVignetting [i]);
-    CalibCrop = NULL;
-    if (other.CalibCrop)
-        for (int i = 0; other.CalibCrop [i]; i++)
-            AddCalibCrop (other.CalibCrop [i]);
-    CalibFov = NULL;
-    if (other.CalibFov)
-        for (int i = 0; other.CalibFov [i]; i++)
-            AddCalibFov (other.CalibFov [i]);
+lfLens::lfLens (lfLens &&other)
+{
+    // The fields are plain data, so that the lens is moved by taking them
+    // over and leaving a default lens behind
+    memcpy (this, &other, sizeof (*this));
+    memset (&other, 0, sizeof (other));
+    other.Type = LF_UNKNOWN;
 }
 
 lfLens &lfLens::operator = (const lfLens &other)
 {
+    if (this == &other)
+        return *this;
+
     lf_free (Maker);
     Maker = lf_mlstr_dup (other.Maker);
     lf_free (Model);
@@ -194,7 +64,7 @@ lfLens &lfLens::operator = (const lfLens &other)
     MinAperture = other.MinAperture;
     MaxAperture = other.MaxAperture;
 
-    lf_free (Mounts); Mounts = NULL;
+    _lf_list_free ((void **)Mounts); Mounts = NULL;
     if (other.Mounts)
         for (int i = 0; other.Mounts [i]; i++)
             AddMount (other.Mounts [i]);
@@ -204,28 +74,33 @@ lfLens &lfLens::operator = (const lfLens &other)
     CropFactor = other.CropFactor;
     AspectRatio = other.AspectRatio;
     Type = other.Type;
+    Score = other.Score;
+
+    // Calibration data is shared with other until either lens changes it
+    _lf_calib_table_free (CalibDistortion);
+    CalibDistortion = _lf_calib_table_ref (other.CalibDistortion);
+    _lf_calib_table_free (CalibTCA);
+    CalibTCA = _lf_calib_table_ref (other.CalibTCA);
+    _lf_calib_table_free (CalibVignetting);
+    CalibVignetting = _lf_calib_table_ref (other.CalibVignetting);
+    _lf_calib_table_free (CalibCrop);
+    CalibCrop = _lf_calib_table_ref (other.CalibCrop);
+    _lf_calib_table_free (CalibFov);
+    CalibFov = _lf_calib_table_ref (other.CalibFov);
 
-    lf_free (CalibDistortion); CalibDistortion = NULL;
-    if (other.CalibDistortion)
-        for (int i = 0; other.CalibDistortion [i]; i++)
-            AddCalibDistortion (other.CalibDistortion [i]);
-    lf_free (CalibTCA); CalibTCA = NULL;
-    if (other.CalibTCA)
-        for (int i = 0; other.CalibTCA [i]; i++)
-            AddCalibTCA (other.CalibTCA [i]);
-    lf_free (CalibVignetting); CalibVignetting = NULL;
-    if (other.CalibVignetting)
-        for (int i = 0; other.CalibVignetting [i]; i++)
-            AddCalibVignetting (other.CalibVignetting [i]);
-    lf_free (CalibCrop); CalibCrop = NULL;
-    if (other.CalibCrop)
-        for (int i = 0; other.CalibCrop [i]; i++)
-            AddCalibCrop (other.CalibCrop [i]);
-    lf_free (CalibFov); CalibFov = NULL;
-    if (other.CalibFov)
-        for (int i = 0; other.CalibFov [i]; i++)
-            AddCalibFov (other.CalibFov [i]);
+    return *this;
+}
 
+lfLens &lfLens::operator = (lfLens &&other)
+{
+    if (this != &other)
+    {
+        // The old contents go with the temporary
+        lfLens old (std::move (*this));
+        memcpy (this, &other, sizeof (*this));
+        memset (&other, 0, sizeof (other));
+        other.Type = LF_UNKNOWN;
+    }
     return *this;
 }
 
@@ -245,604 +120,210 @@ void lfLens::AddMount (const char *val)
         _lf_addstr (&Mounts, val);
 }
 
-void lfLens::GuessParameters ()
+// The number of terms of every model, as stored in the calibration tables
+static int __distortion_terms (int model)
 {
-    if (!extender_magnification_regex.compiled)
-    {
-        regcomp (&extender_magnification_regex.rex, "[0-9](\\.[0.9]+)?x",
-                 REG_EXTENDED | REG_ICASE);
-        extender_magnification_regex.compiled = true;
-    }
-
-    float minf = float (INT_MAX), maxf = float (INT_MIN);
-    float mina = float (INT_MAX), maxa = float (INT_MIN);
-
-    char *old_numeric = setlocale (LC_NUMERIC, NULL);
-    old_numeric = strdup (old_numeric);
-    setlocale (LC_NUMERIC, "C");
-
-    if (Model && (!MinAperture || !MinFocal) &&
-        !strstr (Model, "adapter") &&
-        !strstr (Model, "reducer") &&
-        !strstr (Model, "booster") &&
-        !strstr (Model, "extender") &&
-        !strstr (Model, "converter") &&
-        regexec (&extender_magnification_regex.rex, Model, 0, NULL, 0))
-        _lf_parse_lens_name (Model, minf, maxf, mina);
-
-    if (!MinAperture || !MinFocal)
-    {
-        // Try to find out the range of focal lengths using calibration data
-        if (CalibDistortion)
-            for (int i = 0; CalibDistortion [i]; i++)
-            {
-                float f = CalibDistortion [i]->Focal;
-                if (f < minf)
-                    minf = f;
-                if (f > maxf)
-                    maxf = f;
-            }
-        if (CalibTCA)
-            for (int i = 0; CalibTCA [i]; i++)
-            {
-                float f = CalibTCA [i]->Focal;
-                if (f < minf)
-                    minf = f;
-                if (f > maxf)
-                    maxf = f;
-            }
-        if (CalibVignetting)
-            for (int i = 0; CalibVignetting [i]; i++)
-            {
-                float f = CalibVignetting [i]->Focal;
-                float a = CalibVignetting [i]->Aperture;
-                if (f < minf)
-                    minf = f;
-                if (f > maxf)
-                    maxf = f;
-                if (a < mina)
-                    mina = a;
-                if (a > maxa)
-                    maxa = a;
-            }
-        if (CalibCrop)
-            for (int i=0; CalibCrop [i]; i++)
-            {
-                float f = CalibCrop [i]->Focal;
-                if (f < minf)
-                    minf = f;
-                if (f > maxf)
-                    maxf = f;
-            }
-        if (CalibFov)
-            for (int i=0; CalibFov [i]; i++)
-            {
-                float f = CalibFov [i]->Focal;
-                if (f < minf)
-                    minf = f;
-                if (f > maxf)
-                    maxf = f;
-            }
-
-    }
-
-    if (minf != INT_MAX && !MinFocal)
-        MinFocal = minf;
-    if (maxf != INT_MIN && !MaxFocal)
-        MaxFocal = maxf;
-    if (mina != INT_MAX && !MinAperture)
-        MinAperture = mina;
-    if (maxa != INT_MIN && !MaxAperture)
-        MaxAperture = maxa;
-
-    if (!MaxFocal)
-        MaxFocal = MinFocal;
-
-    setlocale (LC_NUMERIC, old_numeric);
-    free (old_numeric);
-}
-
-bool lfLens::Check ()
-{
-    GuessParameters ();
-
-    if (!Model || !Mounts || CropFactor <= 0 ||
-        MinFocal > MaxFocal || (MaxAperture && MinAperture > MaxAperture) ||
-        AspectRatio < 1)
-        return false;
-
-    return true;
-}
-
-const char *lfLens::GetDistortionModelDesc (
-    lfDistortionModel model, const char **details, const lfParameter ***params)
-{
-    static const lfParameter *param_none [] = { NULL };
-
-    static const lfParameter param_poly3_k1 = { "k1", -0.2F, 0.2F, 0.0F };
-    static const lfParameter *param_poly3 [] = { &param_poly3_k1, NULL };
-
-    static const lfParameter param_poly5_k2 = { "k2", -0.2F, 0.2F, 0.0F };
-    static const lfParameter *param_poly5 [] = { &param_poly3_k1, &param_poly5_k2, NULL };
-
-    static const lfParameter param_ptlens_a = { "a", -0.5F, 0.5F, 0.0F };
-    static const lfParameter param_ptlens_b = { "b", -1.0F, 1.0F, 0.0F };
-    static const lfParameter param_ptlens_c = { "c", -1.0F, 1.0F, 0.0F };
-    static const lfParameter *param_ptlens [] = {
-        &param_ptlens_a, &param_ptlens_b, &param_ptlens_c, NULL };
-
-    static const lfParameter param_acm_k3 = { "k3", -1.0F, 1.0F, 0.0F };
-    static const lfParameter param_acm_k4 = { "k4", -1.0F, 1.0F, 0.0F };
-    static const lfParameter param_acm_k5 = { "k5", -1.0F, 1.0F, 0.0F };
-    static const lfParameter *param_acm [] = {
-        &param_poly3_k1, &param_poly5_k2, &param_acm_k3,
-        &param_acm_k4, &param_acm_k5, NULL };
-
     switch (model)
     {
-        case LF_DIST_MODEL_NONE:
-            if (details)
-                *details = "No distortion model";
-            if (params)
-                *params = param_none;
-            return "None";
-
         case LF_DIST_MODEL_POLY3:
-            if (details)
-                *details = "Rd = Ru * (1 - k1 + k1 * Ru^2)\n"
-                    "Ref: http://www.imatest.com/docs/distortion.html";
-            if (params)
-                *params = param_poly3;
-            return "3rd order polynomial";
-
+            return 1;
         case LF_DIST_MODEL_POLY5:
-            if (details)
-                *details = "Rd = Ru * (1 + k1 * Ru^2 + k2 * Ru^4)\n"
-                    "Ref: http://www.imatest.com/docs/distortion.html";
-            if (params)
-                *params = param_poly5;
-            return "5th order polynomial";
-
+            return 2;
         case LF_DIST_MODEL_PTLENS:
-            if (details)
-                *details = "Rd = Ru * (a * Ru^3 + b * Ru^2 + c * Ru + 1 - (a + b + c))\n"
-                    "Ref: http://wiki.panotools.org/Lens_correction_model";
-            if (params)
-                *params = param_ptlens;
-            return "PanoTools lens model";
-
+            return 3;
         case LF_DIST_MODEL_ACM:
-            if (details)
-                *details = "x_d = x_u (1 + k_1 r^2 + k_2 r^4 + k_3 r^6) + 2x(k_4y + k_5x) + k_5 r^2\n"
-                    "y_d = y_u (1 + k_1 r^2 + k_2 r^4 + k_3 r^6) + 2y(k_4y + k_5x) + k_4 r^2\n"
-                    "Coordinates are in units of focal length.\n"
-                    "Ref: http://download.macromedia.com/pub/labs/lensprofile_creator/lensprofile_creator_cameramodel.pdf";
-            if (params)
-                *params = param_acm;
-            return "Adobe camera model";
-
+            return 5;
         default:
-            // keep gcc 4.4 happy
-            break;
+            return 0;
     }
-
-    if (details)
-        *details = NULL;
-    if (params)
-        *params = NULL;
-    return NULL;
 }
 
-const char *lfLens::GetTCAModelDesc (
-    lfTCAModel model, const char **details, const lfParameter ***params)
+static int __tca_terms (int model)
 {
-    static const lfParameter *param_none [] = { NULL };
-
-    static const lfParameter param_linear_kr = { "kr", 0.99F, 1.01F, 1.0F };
-    static const lfParameter param_linear_kb = { "kb", 0.99F, 1.01F, 1.0F };
-    static const lfParameter *param_linear [] =
-    { &param_linear_kr, &param_linear_kb, NULL };
-
-    static const lfParameter param_poly3_br = { "br", -0.01F, 0.01F, 0.0F };
-    static const lfParameter param_poly3_cr = { "cr", -0.01F, 0.01F, 0.0F };
-    static const lfParameter param_poly3_vr = { "vr",  0.99F, 1.01F, 1.0F };
-    static const lfParameter param_poly3_bb = { "bb", -0.01F, 0.01F, 0.0F };
-    static const lfParameter param_poly3_cb = { "cb", -0.01F, 0.01F, 0.0F };
-    static const lfParameter param_poly3_vb = { "vb",  0.99F, 1.01F, 1.0F };
-    static const lfParameter *param_poly3 [] =
-    {
-        &param_poly3_vr, &param_poly3_vb,
-        &param_poly3_cr, &param_poly3_cb,
-        &param_poly3_br, &param_poly3_bb,
-        NULL
-    };
-
-    static const lfParameter param_acm_alpha0 = { "alpha0", 0.99F, 1.01F, 1.0F };
-    static const lfParameter param_acm_beta0 = { "beta0", 0.99F, 1.01F, 1.0F };
-    static const lfParameter param_acm_alpha1 = { "alpha1", -0.01F, 0.01F, 0.0F };
-    static const lfParameter param_acm_beta1 = { "beta1", -0.01F, 0.01F, 0.0F };
-    static const lfParameter param_acm_alpha2 = { "alpha2", -0.01F, 0.01F, 0.0F };
-    static const lfParameter param_acm_beta2 = { "beta2", -0.01F, 0.01F, 0.0F };
-    static const lfParameter param_acm_alpha3 = { "alpha3", -0.01F, 0.01F, 0.0F };
-    static const lfParameter param_acm_beta3 = { "beta3", -0.01F, 0.01F, 0.0F };
-    static const lfParameter param_acm_alpha4 = { "alpha4", -0.01F, 0.01F, 0.0F };
-    static const lfParameter param_acm_beta4 = { "beta4", -0.01F, 0.01F, 0.0F };
-    static const lfParameter param_acm_alpha5 = { "alpha5", -0.01F, 0.01F, 0.0F };
-    static const lfParameter param_acm_beta5 = { "beta5", -0.01F, 0.01F, 0.0F };
-    static const lfParameter *param_acm [] =
-    {
-        &param_acm_alpha0, &param_acm_beta0,
-        &param_acm_alpha1, &param_acm_beta1,
-        &param_acm_alpha2, &param_acm_beta2,
-        &param_acm_alpha3, &param_acm_beta3,
-        &param_acm_alpha4, &param_acm_beta4,
-        &param_acm_alpha5, &param_acm_beta5,
-        NULL
-    };
-
     switch (model)
     {
-        case LF_TCA_MODEL_NONE:
-            if (details)
-                *details = "No transversal chromatic aberration model";
-            if (params)
-                *params = param_none;
-            return "None";
-
         case LF_TCA_MODEL_LINEAR:
-            if (details)
-                *details = "Cd = Cs * k\n"
-                    "Ref: http://cipa.icomos.org/fileadmin/papers/Torino2005/403.pdf";
-            if (params)
-                *params = param_linear;
-            return "Linear";
-
+            return 2;
         case LF_TCA_MODEL_POLY3:
-            if (details)
-                *details = "Cd = Cs^3 * b + Cs^2 * c + Cs * v\n"
-                    "Ref: http://wiki.panotools.org/Tca_correct";
-            if (params)
-                *params = param_poly3;
-            return "3rd order polynomial";
-
+            return 6;
         case LF_TCA_MODEL_ACM:
-            if (details)
-                *details = "x_{d,R} = α_0 ((1 + α_1 r_{u,R}^2 + α_2 r_{u,R}^4 + α_3 r_{u,R}^6) x_{u,R} +\n"
-                           "          2(α_4 y_{u,R} + α_5 x_{u,R}) x_{u,R} + α_5 r_{u,R}^2)\n"
-                           "y_{d,R} = α_0 ((1 + α_1 r_{u,R}^2 + α_2 r_{u,R}^4 + α_3 r_{u,R}^6) y_{u,R} +\n"
-                           "          2(α_4 y_{u,R} + α_5 x_{u,R}) y_{u,R} + α_4 r_{u,R}^2)\n"
-                           "x_{d,B} = β_0 ((1 + β_1 r_{u,B}^2 + β_2 r_{u,B}^4 + β_3 r_{u,B}^6) x_{u,B} +\n"
-                           "          2(β_4 y_{u,B} + β_5 x_{u,B}) x_{u,B} + β_5 r_{u,B}^2)\n"
-                           "y_{d,B} = β_0 ((1 + β_1 r_{u,B}^2 + β_2 r_{u,B}^4 + β_3 r_{u,B}^6) y_{u,B} +\n"
-                           "          2(β_4 y_{u,B} + β_5 x_{u,B}) y_{u,B} + β_4 r_{u,B}^2)\n"
-                    "Ref: http://download.macromedia.com/pub/labs/lensprofile_creator/lensprofile_creator_cameramodel.pdf";
-            if (params)
-                *params = param_acm;
-            return "Adobe camera model";
-
+            return 12;
         default:
-            // keep gcc 4.4 happy
-            break;
+            return 0;
     }
-
-    if (details)
-        *details = NULL;
-    if (params)
-        *params = NULL;
-    return NULL;
 }
 
-const char *lfLens::GetVignettingModelDesc (
-    lfVignettingModel model, const char **details, const lfParameter ***params)
+static int __vignetting_terms (int model)
 {
-    static const lfParameter *param_none [] = { NULL };
-
-    static const lfParameter param_pa_k1 = { "k1", -3.0, 1.0, 0.0 };
-    static const lfParameter param_pa_k2 = { "k2", -5.0, 10.0, 0.0 };
-    static const lfParameter param_pa_k3 = { "k3", -5.0, 10.0, 0.0 };
-    static const lfParameter *param_pa [] =
-    { &param_pa_k1, &param_pa_k2, &param_pa_k3, NULL };
-
-    static const lfParameter param_acm_alpha1 = { "alpha1", -1.0, 1.0, 0.0 };
-    static const lfParameter param_acm_alpha2 = { "alpha2", -5.0, 10.0, 0.0 };
-    static const lfParameter param_acm_alpha3 = { "alpha3", -5.0, 10.0, 0.0 };
-    static const lfParameter *param_acm [] =
-    { &param_acm_alpha1, &param_acm_alpha2, &param_acm_alpha3, NULL };
-
-    switch (model)
-    {
-        case LF_VIGNETTING_MODEL_NONE:
-            if (details)
-                *details = "No vignetting model";
-            if (params)
-                *params = param_none;
-            return "None";
-
-        case LF_VIGNETTING_MODEL_PA:
-            if (details)
-                *details = "Pablo D'Angelo vignetting model\n"
-                    "(which is a more general variant of the cos^4 law):\n"
-                    "Cd = Cs * (1 + k1 * R^2 + k2 * R^4 + k3 * R^6)\n"
-                    "Ref: http://hugin.sourceforge.net/tech/";
-            if (params)
-                *params = param_pa;
-            return "6th order polynomial (Pablo D'Angelo)";
-
-        case LF_VIGNETTING_MODEL_ACM:
-            if (details)
-                *details = "Adobe's vignetting model\n"
-                    "(which differs from D'Angelo's only in the coordinate system):\n"
-                    "Cd = Cs * (1 + k1 * R^2 + k2 * R^4 + k3 * R^6)\n"
-                    "Ref: http://download.macromedia.com/pub/labs/lensprofile_creator/lensprofile_creator_cameramodel.pdf";
-            if (params)
-                *params = param_acm;
-            return "6th order polynomial (Adobe)";
-
-        default:
-            // keep gcc 4.4 happy
-            break;
-    }
-
-    if (details)
-        *details = "";
-    if (params)
-        *params = NULL;
-    return NULL;
+    return model == LF_VIGNETTING_MODEL_NONE ? 0 : 3;
 }
 
-const char *lfLens::GetCropDesc (
-    lfCropMode mode , const char **details, const lfParameter ***params)
+static int __crop_terms (int mode)
 {
-    static const lfParameter *param_none [] = { NULL };
-
-    static const lfParameter param_crop_left = { "left", -1.0F, 1.0F, 0.0F };
-    static const lfParameter param_crop_right = { "right", 0.0F, 2.0F, 0.0F };
-    static const lfParameter param_crop_top = { "top", -1.0F, 1.0F, 0.0F };
-    static const lfParameter param_crop_bottom = { "bottom", 0.0F, 2.0F, 0.0F };
-    static const lfParameter *param_crop [] = { &param_crop_left, &param_crop_right, &param_crop_top, &param_crop_bottom, NULL };
-
-    switch (mode)
-    {
-        case LF_NO_CROP:
-            if (details)
-                *details = "No crop";
-            if (params)
-                *params = param_none;
-            return "No crop";
-
-        case LF_CROP_RECTANGLE:
-            if (details)
-                *details = "Rectangular crop area";
-            if (params)
-                *params = param_crop;
-            return "rectangular crop";
-
-        case LF_CROP_CIRCLE:
-            if (details)
-                *details = "Circular crop area";
-            if (params)
-                *params = param_crop;
-            return "circular crop";
-
-        default:
-            // keep gcc 4.4 happy
-            break;
-    }
-
-    if (details)
-        *details = NULL;
-    if (params)
-        *params = NULL;
-    return NULL;
+    return mode == LF_NO_CROP ? 0 : 4;
 }
 
-const char *lfLens::GetLensTypeDesc (lfLensType type, const char **details)
+// Fills count terms from record idx of table; those it has not are set to 0
+static void __get_terms (const lfCalibTable *table, int idx, float *terms, int count)
 {
-    switch (type)
-    {
-        case LF_UNKNOWN:
-            if (details)
-                *details = "";
-            return "Unknown";
-
-        case LF_RECTILINEAR:
-            if (details)
-                *details = "Ref: http://wiki.panotools.org/Rectilinear_Projection";
-            return "Rectilinear";
-
-        case LF_FISHEYE:
-            if (details)
-                *details = "Ref: http://wiki.panotools.org/Fisheye_Projection";
-            return "Fish-Eye";
-
-        case LF_PANORAMIC:
-            if (details)
-                *details = "Ref: http://wiki.panotools.org/Cylindrical_Projection";
-            return "Panoramic";
-
-        case LF_EQUIRECTANGULAR:
-            if (details)
-                *details = "Ref: http://wiki.panotools.org/Equirectangular_Projection";
-            return "Equirectangular";
-
-        case LF_FISHEYE_ORTHOGRAPHIC:
-            if (details)
-                *details = "Ref: http://wiki.panotools.org/Fisheye_Projection";
-            return "Fisheye, orthographic";
-
-        case LF_FISHEYE_STEREOGRAPHIC:
-            if (details)
-                *details = "Ref: http://wiki.panotools.org/Stereographic_Projection";
-            return "Fisheye, stereographic";
-
-        case LF_FISHEYE_EQUISOLID:
-            if (details)
-                *details = "Ref: http://wiki.panotools.org/Fisheye_Projection";
-            return "Fisheye, equisolid";
-
-        case LF_FISHEYE_THOBY:
-            if (details)
-                *details = "Ref: http://groups.google.com/group/hugin-ptx/browse_thread/thread/bd822d178e3e239d";
-            return "Thoby-Fisheye";
-
-        default:
-            // keep gcc 4.4 happy
-            break;
-    }
-
-    if (details)
-        *details = "";
-    return NULL;
+    memset (terms, 0, count * sizeof (float));
+    memcpy (terms, table->RecordTerms (idx), table->Stride * sizeof (float));
 }
 
-static bool cmp_distortion (const void *x1, const void *x2)
+void lfLens::AddCalibDistortion (const lfLensCalibDistortion *dc)
 {
-    const lfLensCalibDistortion *d1 = static_cast<const lfLensCalibDistortion *> (x1);
-    const lfLensCalibDistortion *d2 = static_cast<const lfLensCalibDistortion *> (x2);
-    return (d1->Focal == d2->Focal);
+    // Distortion records are identified by their focal length
+    float values [2] = { dc->Focal, dc->RealFocal };
+    int model = dc->Model;
+    if (dc->RealFocalMeasured)
+        model |= lfCalibTable::LF_CALIB_TABLE_FLAG;
+    _lf_calib_table_add (&CalibDistortion, model, values, 2, 1,
+                         dc->Terms, __distortion_terms (dc->Model));
 }
 
-void lfLens::AddCalibDistortion (const lfLensCalibDistortion *dc)
+bool lfLens::RemoveCalibDistortion (int idx)
 {
-    // Avoid "dereferencing type-punned pointer will break strict-aliasing rules" warning
-    union
-    {
-        lfLensCalibDistortion ***cd;
-        void ***arr;
-    } x = { &CalibDistortion };
-    _lf_addobj (x.arr, dc, sizeof (*dc), cmp_distortion);
+    return _lf_calib_table_del (&CalibDistortion, idx);
 }
 
-bool lfLens::RemoveCalibDistortion (int idx)
+int lfLens::GetCalibDistortionCount () const
 {
-    // Avoid "dereferencing type-punned pointer will break strict-aliasing rules" warning
-    union
-    {
-        lfLensCalibDistortion ***cd;
-        void ***arr;
-    } x = { &CalibDistortion };
-    return _lf_delobj (x.arr, idx);
+    return CalibDistortion ? CalibDistortion->Count : 0;
 }
 
-static bool cmp_tca (const void *x1, const void *x2)
+bool lfLens::GetCalibDistortion (int idx, lfLensCalibDistortion &res) const
 {
-    const lfLensCalibTCA *t1 = static_cast<const lfLensCalibTCA *> (x1);
-    const lfLensCalibTCA *t2 = static_cast<const lfLensCalibTCA *> (x2);
-    return (t1->Focal == t2->Focal);
+    const lfCalibTable *table = CalibDistortion;
+    if (!table || idx < 0 || idx >= table->Count)
+        return false;
+
+    res.Model = (lfDistortionModel)table->Model (idx);
+    res.Focal = table->Field (0) [idx];
+    res.RealFocal = table->Field (1) [idx];
+    res.RealFocalMeasured = table->Flag (idx);
+    __get_terms (table, idx, res.Terms, ARRAY_LEN (res.Terms));
+    return true;
 }
 
 void lfLens::AddCalibTCA (const lfLensCalibTCA *tcac)
 {
-    // Avoid "dereferencing type-punned pointer will break strict-aliasing rules" warning
-    union
-    {
-        lfLensCalibTCA ***ctca;
-        void ***arr;
-    } x = { &CalibTCA };
-    _lf_addobj (x.arr, tcac, sizeof (*tcac), cmp_tca);
+    _lf_calib_table_add (&CalibTCA, tcac->Model, &tcac->Focal, 1, 1,
+                         tcac->Terms, __tca_terms (tcac->Model));
 }
 
 bool lfLens::RemoveCalibTCA (int idx)
 {
-    // Avoid "dereferencing type-punned pointer will break strict-aliasing rules" warning
-    union
-    {
-        lfLensCalibTCA ***ctca;
-        void ***arr;
-    } x = { &CalibTCA };
-    return _lf_delobj (x.arr, idx);
+    return _lf_calib_table_del (&CalibTCA, idx);
+}
+
+int lfLens::GetCalibTCACount () const
+{
+    return CalibTCA ? CalibTCA->Count : 0;
 }
 
-static bool cmp_vignetting (const void *x1, const void *x2)
+bool lfLens::GetCalibTCA (int idx, lfLensCalibTCA &res) const
 {
-    const lfLensCalibVignetting *v1 = static_cast<const lfLensCalibVignetting *> (x1);
-    const lfLensCalibVignetting *v2 = static_cast<const lfLensCalibVignetting *> (x2);
-    return (v1->Focal == v2->Focal) &&
-           (v1->Distance == v2->Distance) &&
-           (v1->Aperture == v2->Aperture);
+    const lfCalibTable *table = CalibTCA;
+    if (!table || idx < 0 || idx >= table->Count)
+        return false;
+
+    res.Model = (lfTCAModel)table->Model (idx);
+    res.Focal = table->Field (0) [idx];
+    __get_terms (table, idx, res.Terms, ARRAY_LEN (res.Terms));
+    return true;
 }
 
 void lfLens::AddCalibVignetting (const lfLensCalibVignetting *vc)
 {
-    // Avoid "dereferencing type-punned pointer will break strict-aliasing rules" warning
-    union
-    {
-        lfLensCalibVignetting ***cv;
-        void ***arr;
-    } x = { &CalibVignetting };
-    _lf_addobj (x.arr, vc, sizeof (*vc), cmp_vignetting);
+    // Vignetting records are identified by all three values
+    float values [3] = { vc->Focal, vc->Aperture, vc->Distance };
+    _lf_calib_table_add (&CalibVignetting, vc->Model, values, 3, 3,
+                         vc->Terms, __vignetting_terms (vc->Model));
 }
 
 bool lfLens::RemoveCalibVignetting (int idx)
 {
-    // Avoid "dereferencing type-punned pointer will break strict-aliasing rules" warning
-    union
-    {
-        lfLensCalibVignetting ***cv;
-        void ***arr;
-    } x = { &CalibVignetting };
-    return _lf_delobj (x.arr, idx);
+    return _lf_calib_table_del (&CalibVignetting, idx);
+}
+
+int lfLens::GetCalibVignettingCount () const
+{
+    return CalibVignetting ? CalibVignetting->Count : 0;
 }
 
-static bool cmp_lenscrop (const void *x1, const void *x2)
+bool lfLens::GetCalibVignetting (int idx, lfLensCalibVignetting &res) const
 {
-    const lfLensCalibCrop *d1 = static_cast<const lfLensCalibCrop *> (x1);
-    const lfLensCalibCrop *d2 = static_cast<const lfLensCalibCrop *> (x2);
-    return (d1->Focal == d2->Focal);
+    const lfCalibTable *table = CalibVignetting;
+    if (!table || idx < 0 || idx >= table->Count)
+        return false;
+
+    res.Model = (lfVignettingModel)table->Model (idx);
+    res.Focal = table->Field (0) [idx];
+    res.Aperture = table->Field (1) [idx];
+    res.Distance = table->Field (2) [idx];
+    __get_terms (table, idx, res.Terms, ARRAY_LEN (res.Terms));
+    return true;
 }
 
 void lfLens::AddCalibCrop (const lfLensCalibCrop *lcc)
 {
-    // Avoid "dereferencing type-punned pointer will break strict-aliasing rules" warning
-    union
-    {
-        lfLensCalibCrop ***cd;
-        void ***arr;
-    } x = { &CalibCrop };
-    _lf_addobj (x.arr, lcc, sizeof (*lcc), cmp_lenscrop);
+    _lf_calib_table_add (&CalibCrop, lcc->CropMode, &lcc->Focal, 1, 1,
+                         lcc->Crop, __crop_terms (lcc->CropMode));
 }
 
 bool lfLens::RemoveCalibCrop (int idx)
 {
-    // Avoid "dereferencing type-punned pointer will break strict-aliasing rules" warning
-    union
-    {
-        lfLensCalibCrop ***cd;
-        void ***arr;
-    } x = { &CalibCrop };
-    return _lf_delobj (x.arr, idx);
+    return _lf_calib_table_del (&CalibCrop, idx);
+}
+
+int lfLens::GetCalibCropCount () const
+{
+    return CalibCrop ? CalibCrop->Count : 0;
 }
 
-static bool cmp_lensfov (const void *x1, const void *x2)
+bool lfLens::GetCalibCrop (int idx, lfLensCalibCrop &res) const
 {
-    const lfLensCalibFov *d1 = static_cast<const lfLensCalibFov *> (x1);
-    const lfLensCalibFov *d2 = static_cast<const lfLensCalibFov *> (x2);
-    return (d1->Focal == d2->Focal);
+    const lfCalibTable *table = CalibCrop;
+    if (!table || idx < 0 || idx >= table->Count)
+        return false;
+
+    res.CropMode = (lfCropMode)table->Model (idx);
+    res.Focal = table->Field (0) [idx];
+    __get_terms (table, idx, res.Crop, ARRAY_LEN (res.Crop));
+    return true;
 }
 
 void lfLens::AddCalibFov (const lfLensCalibFov *lcf)
 {
-    // Avoid "dereferencing type-punned pointer will break strict-aliasing rules" warning
-    union
-    {
-        lfLensCalibFov ***cd;
-        void ***arr;
-    } x = { &CalibFov };
-    _lf_addobj (x.arr, lcf, sizeof (*lcf), cmp_lensfov);
+    // The field of view is a value rather than a term, there is no model
+    float values [2] = { lcf->Focal, lcf->FieldOfView };
+    _lf_calib_table_add (&CalibFov, 0, values, 2, 1, NULL, 0);
 }
 
 bool lfLens::RemoveCalibFov (int idx)
 {
-    // Avoid "dereferencing type-punned pointer will break strict-aliasing rules" warning
-    union
-    {
-        lfLensCalibFov ***cd;
-        void ***arr;
-    } x = { &CalibFov };
-    return _lf_delobj (x.arr, idx);
+    return _lf_calib_table_del (&CalibFov, idx);
+}
+
+int lfLens::GetCalibFovCount () const
+{
+    return CalibFov ? CalibFov->Count : 0;
+}
+
+bool lfLens::GetCalibFov (int idx, lfLensCalibFov &res) const
+{
+    const lfCalibTable *table = CalibFov;
+    if (!table || idx < 0 || idx >= table->Count)
+        return false;
+
+    res.Focal = table->Field (0) [idx];
+    res.FieldOfView = table->Field (1) [idx];
+    return true;
 }
 
-static int __insert_spline (void **spline, float *spline_dist, float dist, void *val)
+// Keeps the indices of the records which are closest to the wanted focal
+// length, two on either side, in spline
+static int __insert_spline (int *spline, float *spline_dist, float dist, int val)
 {
     if (dist < 0)
     {
@@ -1001,77 +482,81 @@ static void __parameter_scales (float values [], int number_of_values,
     }
 }
 
+// The value of field f of the record at spline point i, or FLT_MAX if
+// there is no such point
+static inline float __spline_value (const lfCalibField &field, const int *spline, int i)
+{
+    return spline [i] >= 0 ? field [spline [i]] : FLT_MAX;
+}
+
 bool lfLens::InterpolateDistortion (float focal, lfLensCalibDistortion &res) const
 {
-    if (!CalibDistortion)
+    const lfCalibTable *table = CalibDistortion;
+    if (!table)
         return false;
 
-    union
-    {
-        lfLensCalibDistortion *spline [4];
-        void *spline_ptr [4];
-    };
+    int spline [4] = { -1, -1, -1, -1 };
     float spline_dist [4] = { -FLT_MAX, -FLT_MAX, FLT_MAX, FLT_MAX };
     lfDistortionModel dm = LF_DIST_MODEL_NONE;
 
-    memset (spline, 0, sizeof (spline));
-    for (int i = 0; CalibDistortion [i]; i++)
+    lfCalibField focals = table->Field (0);
+    for (int i = 0; i < table->Count; i++)
     {
-        lfLensCalibDistortion *c = CalibDistortion [i];
-        if (c->Model == LF_DIST_MODEL_NONE)
+        lfDistortionModel model = (lfDistortionModel)table->Model (i);
+        if (model == LF_DIST_MODEL_NONE)
             continue;
 
         // Take into account just the first encountered lens model
         if (dm == LF_DIST_MODEL_NONE)
-            dm = c->Model;
-        else if (dm != c->Model)
+            dm = model;
+        else if (dm != model)
         {
             continue;
         }
 
-        float df = focal - c->Focal;
+        float df = focal - focals [i];
         if (df == 0.0)
         {
             // Exact match found, don't care to interpolate
-            res = *c;
-            return true;
+            return GetCalibDistortion (i, res);
         }
 
-        __insert_spline (spline_ptr, spline_dist, df, c);
+        __insert_spline (spline, spline_dist, df, i);
     }
 
-    if (!spline [1] || !spline [2])
+    if (spline [1] < 0 || spline [2] < 0)
     {
-        if (spline [1])
-            res = *spline [1];
-        else if (spline [2])
-            res = *spline [2];
+        if (spline [1] >= 0)
+            return GetCalibDistortion (spline [1], res);
+        else if (spline [2] >= 0)
+            return GetCalibDistortion (spline [2], res);
         else
             return false;
-
-        return true;
     }
 
     // No exact match found, interpolate the model parameters
     res.Model = dm;
     res.Focal = focal;
 
-    float t = (focal - spline [1]->Focal) / (spline [2]->Focal - spline [1]->Focal);
+    float t = (focal - focals [spline [1]]) / (focals [spline [2]] - focals [spline [1]]);
 
     res.RealFocal = _lf_interpolate (
-        spline [0] ? spline [0]->RealFocal : FLT_MAX,
-        spline [1]->RealFocal, spline [2]->RealFocal,
-        spline [3] ? spline [3]->RealFocal : FLT_MAX, t);
-    for (size_t i = 0; i < ARRAY_LEN (res.Terms); i++)
+        __spline_value (table->Field (1), spline, 0),
+        __spline_value (table->Field (1), spline, 1),
+        __spline_value (table->Field (1), spline, 2),
+        __spline_value (table->Field (1), spline, 3), t);
+    memset (res.Terms, 0, sizeof (res.Terms));
+    for (int i = 0; i < table->Stride; i++)
     {
-        float values [5] = {spline [0] ? spline [0]->Focal : NAN, spline [1]->Focal,
-                            spline [2]->Focal, spline [3] ? spline [3]->Focal : NAN,
+        float values [5] = {spline [0] >= 0 ? focals [spline [0]] : NAN, focals [spline [1]],
+                            focals [spline [2]], spline [3] >= 0 ? focals [spline [3]] : NAN,
                             focal};
         __parameter_scales (values, 5, LF_MODIFY_DISTORTION, dm, i);
         res.Terms [i] = _lf_interpolate (
-            spline [0] ? spline [0]->Terms [i] * values [0] : FLT_MAX,
-            spline [1]->Terms [i] * values [1], spline [2]->Terms [i] * values [2],
-            spline [3] ? spline [3]->Terms [i] * values [3] : FLT_MAX,
+            spline [0] >= 0 ? table->RecordTerms (spline [0]) [i] * values [0] : FLT_MAX,
+            table->RecordTerms (spline [1]) [i] * values [1],
+            table->RecordTerms (spline [2]) [i] * values [2],
+            spline [3] >= 0 ? table->RecordTerms (spline [3]) [i] * values [3] : FLT_MAX,
             t) / values [4];
     }
 
@@ -1080,71 +565,67 @@ bool lfLens::InterpolateDistortion (float focal, lfLensCalibDistortion &res) con
 
 bool lfLens::InterpolateTCA (float focal, lfLensCalibTCA &res) const
 {
-    if (!CalibTCA)
+    const lfCalibTable *table = CalibTCA;
+    if (!table)
         return false;
 
-    union
-    {
-        lfLensCalibTCA *spline [4];
-        void *spline_ptr [4];
-    };
+    int spline [4] = { -1, -1, -1, -1 };
     float spline_dist [4] = { -FLT_MAX, -FLT_MAX, FLT_MAX, FLT_MAX };
     lfTCAModel tcam = LF_TCA_MODEL_NONE;
 
-    memset (&spline, 0, sizeof (spline));
-    for (int i = 0; CalibTCA [i]; i++)
+    lfCalibField focals = table->Field (0);
+    for (int i = 0; i < table->Count; i++)
     {
-        lfLensCalibTCA *c = CalibTCA [i];
-        if (c->Model == LF_TCA_MODEL_NONE)
+        lfTCAModel model = (lfTCAModel)table->Model (i);
+        if (model == LF_TCA_MODEL_NONE)
             continue;
 
         // Take into account just the first encountered lens model
         if (tcam == LF_TCA_MODEL_NONE)
-            tcam = c->Model;
-        else if (tcam != c->Model)
+            tcam = model;
+        else if (tcam != model)
         {
             continue;
         }
 
-        float df = focal - c->Focal;
+        float df = focal - focals [i];
         if (df == 0.0)
         {
             // Exact match found, don't care to interpolate
-            res = *c;
-            return true;
+            return GetCalibTCA (i, res);
         }
 
-        __insert_spline (spline_ptr, spline_dist, df, c);
+        __insert_spline (spline, spline_dist, df, i);
     }
 
-    if (!spline [1] || !spline [2])
+    if (spline [1] < 0 || spline [2] < 0)
     {
-        if (spline [1])
-            res = *spline [1];
-        else if (spline [2])
-            res = *spline [2];
+        if (spline [1] >= 0)
+            return GetCalibTCA (spline [1], res);
+        else if (spline [2] >= 0)
+            return GetCalibTCA (spline [2], res);
         else
             return false;
-
-        return true;
     }
 
     // No exact match found, interpolate the model parameters
     res.Model = tcam;
     res.Focal = focal;
 
-    float t = (focal - spline [1]->Focal) / (spline [2]->Focal - spline [1]->Focal);
+    float t = (focal - focals [spline [1]]) / (focals [spline [2]] - focals [spline [1]]);
 
-    for (size_t i = 0; i < ARRAY_LEN (res.Terms); i++)
+    memset (res.Terms, 0, sizeof (res.Terms));
+    for (int i = 0; i < table->Stride; i++)
     {
-        float values [5] = {spline [0] ? spline [0]->Focal : NAN, spline [1]->Focal,
-                            spline [2]->Focal, spline [3] ? spline [3]->Focal : NAN,
+        float values [5] = {spline [0] >= 0 ? focals [spline [0]] : NAN, focals [spline [1]],
+                            focals [spline [2]], spline [3] >= 0 ? focals [spline [3]] : NAN,
                             focal};
         __parameter_scales (values, 5, LF_MODIFY_TCA, tcam, i);
         res.Terms [i] = _lf_interpolate (
-            spline [0] ? spline [0]->Terms [i] * values [0] : FLT_MAX,
-            spline [1]->Terms [i] * values [1], spline [2]->Terms [i] * values [2],
-            spline [3] ? spline [3]->Terms [i] * values [3] : FLT_MAX,
+            spline [0] >= 0 ? table->RecordTerms (spline [0]) [i] * values [0] : FLT_MAX,
+            table->RecordTerms (spline [1]) [i] * values [1],
+            table->RecordTerms (spline [2]) [i] * values [2],
+            spline [3] >= 0 ? table->RecordTerms (spline [3]) [i] * values [3] : FLT_MAX,
             t) / values [4];
     }
 
@@ -1152,12 +633,13 @@ bool lfLens::InterpolateTCA (float focal, lfLensCalibTCA &res) const
 }
 
 static float __vignetting_dist (
-    const lfLens *l, const lfLensCalibVignetting &x, float focal, float aperture, float distance)
+    const lfLens *l, float x_focal, float x_aperture, float x_distance,
+    float focal, float aperture, float distance)
 {
     // translate every value to linear scale and normalize
     // approximatively to range 0..1
     float f1 = focal - l->MinFocal;
-    float f2 = x.Focal - l->MinFocal;
+    float f2 = x_focal - l->MinFocal;
     float df = l->MaxFocal - l->MinFocal;
     if (df != 0)
     {
@@ -1165,9 +647,9 @@ static float __vignetting_dist (
         f2 /= df;
     }
     float a1 = 4.0 / aperture;
-    float a2 = 4.0 / x.Aperture;
+    float a2 = 4.0 / x_aperture;
     float d1 = 0.1 / distance;
-    float d2 = 0.1 / x.Distance;
+    float d2 = 0.1 / x_distance;
 
     return sqrt (square (f2 - f1) + square (a2 - a1) + square (d2 - d1));
 }
@@ -1175,7 +657,8 @@ static float __vignetting_dist (
 bool lfLens::InterpolateVignetting (
     float focal, float aperture, float distance, lfLensCalibVignetting &res) const
 {
-    if (!CalibVignetting)
+    const lfCalibTable *table = CalibVignetting;
+    if (!table)
         return false;
 
     lfVignettingModel vm = LF_VIGNETTING_MODEL_NONE;
@@ -1190,34 +673,38 @@ bool lfLens::InterpolateVignetting (
     float total_weighting = 0;
     const float power = 3.5;
 
+    lfCalibField focals = table->Field (0);
+    lfCalibField apertures = table->Field (1);
+    lfCalibField distances = table->Field (2);
+    const int terms = std::min ((int)table->Stride, (int)ARRAY_LEN (res.Terms));
     float smallest_interpolation_distance = FLT_MAX;
-    for (int i = 0; CalibVignetting [i]; i++)
+    for (int i = 0; i < table->Count; i++)
     {
-        const lfLensCalibVignetting* c = CalibVignetting [i];
         // Take into account just the first encountered lens model
         if (vm == LF_VIGNETTING_MODEL_NONE)
         {
-            vm = c->Model;
+            vm = (lfVignettingModel)table->Model (i);
             res.Model = vm;
         } 
-        else if (vm != c->Model)
+        else if (vm != table->Model (i))
         {
             continue;
         }
 
-        float interpolation_distance = __vignetting_dist (this, *c, focal, aperture, distance);
+        float interpolation_distance = __vignetting_dist (
+            this, focals [i], apertures [i], distances [i], focal, aperture, distance);
         if (interpolation_distance < 0.0001) {
-            res = *c;
-            return true;
+            return GetCalibVignetting (i, res);
         }
 
         smallest_interpolation_distance = std::min(smallest_interpolation_distance, interpolation_distance);
         float weighting = fabs (1.0 / pow (interpolation_distance, power));
-        for (size_t i = 0; i < ARRAY_LEN (res.Terms); i++)
+        const float *c = table->RecordTerms (i);
+        for (int j = 0; j < terms; j++)
         {
-            float values [1] = {c->Focal};
-            __parameter_scales (values, 1, LF_MODIFY_VIGNETTING, vm, i);
-            res.Terms [i] += weighting * c->Terms [i] * values [0];
+            float values [1] = {focals [i]};
+            __parameter_scales (values, 1, LF_MODIFY_VIGNETTING, vm, j);
+            res.Terms [j] += weighting * c [j] * values [0];
         }
         total_weighting += weighting;
     }
@@ -1227,7 +714,7 @@ bool lfLens::InterpolateVignetting (
     
     if (total_weighting > 0 && smallest_interpolation_distance < FLT_MAX)
     {
-        for (size_t i = 0; i < ARRAY_LEN (res.Terms); i++)
+        for (int i = 0; i < terms; i++)
         {
             float values [1] = {focal};
             __parameter_scales (values, 1, LF_MODIFY_VIGNETTING, vm, i);
@@ -1240,127 +727,115 @@ bool lfLens::InterpolateVignetting (
 
 bool lfLens::InterpolateCrop (float focal, lfLensCalibCrop &res) const
 {
-    if (!CalibCrop)
+    const lfCalibTable *table = CalibCrop;
+    if (!table)
         return false;
 
-    union
-    {
-        lfLensCalibCrop *spline [4];
-        void *spline_ptr [4];
-    };
+    int spline [4] = { -1, -1, -1, -1 };
     float spline_dist [4] = { -FLT_MAX, -FLT_MAX, FLT_MAX, FLT_MAX };
     lfCropMode cm = LF_NO_CROP;
 
-    memset (spline, 0, sizeof (spline));
-    for (int i = 0; CalibCrop [i]; i++)
+    lfCalibField focals = table->Field (0);
+    for (int i = 0; i < table->Count; i++)
     {
-        lfLensCalibCrop *c = CalibCrop [i];
-        if (c->CropMode == LF_NO_CROP)
+        lfCropMode mode = (lfCropMode)table->Model (i);
+        if (mode == LF_NO_CROP)
             continue;
 
         // Take into account just the first encountered crop mode
         if (cm == LF_NO_CROP)
-            cm = c->CropMode;
-        else if (cm != c->CropMode)
+            cm = mode;
+        else if (cm != mode)
         {
             continue;
         }
 
-        float df = focal - c->Focal;
+        float df = focal - focals [i];
         if (df == 0.0)
         {
             // Exact match found, don't care to interpolate
-            res = *c;
-            return true;
+            return GetCalibCrop (i, res);
         }
 
-        __insert_spline (spline_ptr, spline_dist, df, c);
+        __insert_spline (spline, spline_dist, df, i);
     }
 
-    if (!spline [1] || !spline [2])
+    if (spline [1] < 0 || spline [2] < 0)
     {
-        if (spline [1])
-            res = *spline [1];
-        else if (spline [2])
-            res = *spline [2];
+        if (spline [1] >= 0)
+            return GetCalibCrop (spline [1], res);
+        else if (spline [2] >= 0)
+            return GetCalibCrop (spline [2], res);
         else
             return false;
-
-        return true;
     }
 
     // No exact match found, interpolate the model parameters
     res.CropMode = cm;
     res.Focal = focal;
 
-    float t = (focal - spline [1]->Focal) / (spline [2]->Focal - spline [1]->Focal);
+    float t = (focal - focals [spline [1]]) / (focals [spline [2]] - focals [spline [1]]);
 
+    // Every crop mode but LF_NO_CROP has all four values
     for (size_t i = 0; i < ARRAY_LEN (res.Crop); i++)
         res.Crop [i] = _lf_interpolate (
-            spline [0] ? spline [0]->Crop [i] : FLT_MAX,
-            spline [1]->Crop [i], spline [2]->Crop [i],
-            spline [3] ? spline [3]->Crop [i] : FLT_MAX, t);
+            spline [0] >= 0 ? table->RecordTerms (spline [0]) [i] : FLT_MAX,
+            table->RecordTerms (spline [1]) [i], table->RecordTerms (spline [2]) [i],
+            spline [3] >= 0 ? table->RecordTerms (spline [3]) [i] : FLT_MAX, t);
 
     return true;
 }
 
 bool lfLens::InterpolateFov (float focal, lfLensCalibFov &res) const
 {
-    if (!CalibFov)
+    const lfCalibTable *table = CalibFov;
+    if (!table)
         return false;
 
-    union
-    {
-        lfLensCalibFov *spline [4];
-        void *spline_ptr [4];
-    };
+    int spline [4] = { -1, -1, -1, -1 };
     float spline_dist [4] = { -FLT_MAX, -FLT_MAX, FLT_MAX, FLT_MAX };
 
-    memset (spline, 0, sizeof (spline));
+    lfCalibField focals = table->Field (0);
+    lfCalibField fovs = table->Field (1);
     int counter=0;
-    for (int i = 0; CalibFov [i]; i++)
+    for (int i = 0; i < table->Count; i++)
     {
-        lfLensCalibFov *c = CalibFov [i];
-        if (c->FieldOfView == 0)
+        if (fovs [i] == 0)
             continue;
 
         counter++;
-        float df = focal - c->Focal;
+        float df = focal - focals [i];
         if (df == 0.0)
         {
             // Exact match found, don't care to interpolate
-            res = *c;
-            return true;
+            return GetCalibFov (i, res);
         }
 
-        __insert_spline (spline_ptr, spline_dist, df, c);
+        __insert_spline (spline, spline_dist, df, i);
     }
 
     //no valid data found
     if (counter==0)
         return false;
 
-    if (!spline [1] || !spline [2])
+    if (spline [1] < 0 || spline [2] < 0)
     {
-        if (spline [1])
-            res = *spline [1];
-        else if (spline [2])
-            res = *spline [2];
+        if (spline [1] >= 0)
+            return GetCalibFov (spline [1], res);
+        else if (spline [2] >= 0)
+            return GetCalibFov (spline [2], res);
         else
             return false;
-
-        return true;
     }
 
     // No exact match found, interpolate the model parameters
     res.Focal = focal;
 
-    float t = (focal - spline [1]->Focal) / (spline [2]->Focal - spline [1]->Focal);
+    float t = (focal - focals [spline [1]]) / (focals [spline [2]] - focals [spline [1]]);
 
     res.FieldOfView = _lf_interpolate (
-        spline [0] ? spline [0]->FieldOfView : FLT_MAX,
-        spline [1]->FieldOfView, spline [2]->FieldOfView,
-        spline [3] ? spline [3]->FieldOfView : FLT_MAX, t);
+        __spline_value (fovs, spline, 0), __spline_value (fovs, spline, 1),
+        __spline_value (fovs, spline, 2), __spline_value (fovs, spline, 3), t);
 
     return true;
 }
@@ -1545,45 +1020,6 @@ void lf_lens_copy (lfLens *dest, const lfLens *source)
     *dest = *source;
 }
 
-void lf_lens_guess_parameters (lfLens *lens)
-{
-    lens->GuessParameters ();
-}
-
-cbool lf_lens_check (lfLens *lens)
-{
-    return lens->Check ();
-}
-
-const char *lf_get_distortion_model_desc (
-    enum lfDistortionModel model, const char **details, const lfParameter ***params)
-{
-    return lfLens::GetDistortionModelDesc (model, details, params);
-}
-
-const char *lf_get_tca_model_desc (
-    enum lfTCAModel model, const char **details, const lfParameter ***params)
-{
-    return lfLens::GetTCAModelDesc (model, details, params);
-}
-
-const char *lf_get_vignetting_model_desc (
-    enum lfVignettingModel model, const char **details, const lfParameter ***params)
-{
-    return lfLens::GetVignettingModelDesc (model, details, params);
-}
-
-const char *lf_get_crop_desc (
-    enum lfCropMode mode, const char **details, const lfParameter ***params)
-{
-    return lfLens::GetCropDesc (mode, details, params);
-}
-
-const char *lf_get_lens_type_desc (enum lfLensType type, const char **details)
-{
-    return lfLens::GetLensTypeDesc (type, details);
-}
-
 cbool lf_lens_interpolate_distortion (const lfLens *lens, float focal,
     lfLensCalibDistortion *res)
 {
@@ -1623,6 +1059,16 @@ cbool lf_lens_remove_calib_distortion (lfLens *lens, int idx)
     return lens->RemoveCalibDistortion (idx);
 }
 
+int lf_lens_get_calib_distortion_count (const lfLens *lens)
+{
+    return lens->GetCalibDistortionCount ();
+}
+
+cbool lf_lens_get_calib_distortion (const lfLens *lens, int idx, lfLensCalibDistortion *res)
+{
+    return lens->GetCalibDistortion (idx, *res);
+}
+
 void lf_lens_add_calib_tca (lfLens *lens, const lfLensCalibTCA *tcac)
 {
     lens->AddCalibTCA (tcac);
@@ -1633,6 +1079,16 @@ cbool lf_lens_remove_calib_tca (lfLens *lens, int idx)
     return lens->RemoveCalibTCA (idx);
 }
 
+int lf_lens_get_calib_tca_count (const lfLens *lens)
+{
+    return lens->GetCalibTCACount ();
+}
+
+cbool lf_lens_get_calib_tca (const lfLens *lens, int idx, lfLensCalibTCA *res)
+{
+    return lens->GetCalibTCA (idx, *res);
+}
+
 void lf_lens_add_calib_vignetting (lfLens *lens, const lfLensCalibVignetting *vc)
 {
     lens->AddCalibVignetting (vc);
@@ -1643,6 +1099,16 @@ cbool lf_lens_remove_calib_vignetting (lfLens *lens, int idx)
     return lens->RemoveCalibVignetting (idx);
 }
 
+int lf_lens_get_calib_vignetting_count (const lfLens *lens)
+{
+    return lens->GetCalibVignettingCount ();
+}
+
+cbool lf_lens_get_calib_vignetting (const lfLens *lens, int idx, lfLensCalibVignetting *res)
+{
+    return lens->GetCalibVignetting (idx, *res);
+}
+
 void lf_lens_add_calib_crop (lfLens *lens, const lfLensCalibCrop *lcc)
 {
     lens->AddCalibCrop (lcc);
@@ -1653,6 +1119,16 @@ cbool lf_lens_remove_calib_crop (lfLens *lens, int idx)
     return lens->RemoveCalibCrop (idx);
 }
 
+int lf_lens_get_calib_crop_count (const lfLens *lens)
+{
+    return lens->GetCalibCropCount ();
+}
+
+cbool lf_lens_get_calib_crop (const lfLens *lens, int idx, lfLensCalibCrop *res)
+{
+    return lens->GetCalibCrop (idx, *res);
+}
+
 
 void lf_lens_add_calib_fov (lfLens *lens, const lfLensCalibFov *lcf)
 {
@@ -1663,3 +1139,13 @@ cbool lf_lens_remove_calib_fov (lfLens *lens, int idx)
 {
     return lens->RemoveCalibFov (idx);
 }
+
+int lf_lens_get_calib_fov_count (const lfLens *lens)
+{
+    return lens->GetCalibFovCount ();
+}
+
+cbool lf_lens_get_calib_fov (const lfLens *lens, int idx, lfLensCalibFov *res)
+{
+    return lens->GetCalibFov (idx, *res);
+}
@@ -57,6 +57,13 @@ extern "C" {
 #define LF_VERSION_BUGFIX	0
 /// Full library version
 #define LF_VERSION	((LF_VERSION_MAJOR << 24) | (LF_VERSION_MINOR << 16) | (LF_VERSION_MICRO << 8) | LF_VERSION_BUGFIX)
+/**
+ * Defined since the Calib* fields of lfLens point to opaque tables instead
+ * of NULL-terminated lists of lfLensCalib* structures.  Code which builds
+ * against older versions as well reads the records with the GetCalib*()
+ * methods if this is defined, and through the lists otherwise.
+ */
+#define LF_CALIB_TABLES
 
 #define LF_EXPORT    
 /// C-compatible bool type; don't bother to define Yet Another Boolean Type
@@ -107,15 +114,27 @@ typedef double lf_f64;
 LF_EXPORT void lf_free (void *data);
 
 /**
- * @brief Get a string corresponding to current locale from a multi-language
- * string.
+ * @brief Get the English string from a multi-language string.
  *
- * Current locale is determined from LC_MESSAGES category at the time of
- * the call, e.g. if you change LC_MESSAGES at runtime, next calls to
- * lf_mlstr_get() will return the string for the new locale.
+ * Falls back to the default string if there is no English one.  Use
+ * lf_mlstr_get_lang() for other languages.
  */
 LF_EXPORT const char *lf_mlstr_get (const lfMLstr str);
 
+/**
+ * @brief Get the string of a given language from a multi-language string.
+ *
+ * The language is passed with every call rather than taken from global
+ * state, so that threads may ask for different languages at the same time.
+ * @param str
+ *     The multi-language string.
+ * @param lang
+ *     The language code, e.g. "de".  NULL asks for the default string.
+ * @return
+ *     The translation, else the English string, else the default string.
+ */
+LF_EXPORT const char *lf_mlstr_get_lang (const lfMLstr str, const char *lang);
+
 /**
  * @brief Add a new translated string to a multi-language string.
  *
@@ -185,11 +204,21 @@ struct LF_EXPORT lfMount
      */
     lfMount (const lfMount &other);
 
+    /**
+     * Move constructor.  other is left as a new mount.
+     */
+    lfMount (lfMount &&other);
+
     /**
      * Assignment operator
      */
     lfMount &operator = (const lfMount &other);
 
+    /**
+     * Move assignment operator.  other is left as a new mount.
+     */
+    lfMount &operator = (lfMount &&other);
+
     /**
      * @brief Destroy a mount object. All allocated fields are freed.
      */
@@ -292,7 +321,12 @@ struct LF_EXPORT lfCamera
     char *Mount;
     /** @brief Camera crop factor (ex: 1.0). Must be defined. */
     float CropFactor;
-    /** @brief Camera matching score, used while searching: not actually a camera parameter */
+    /**
+     * @brief Camera matching score: not actually a camera parameter.
+     *
+     * The library does not write this field, so that cameras can be shared
+     * between threads; it is kept for compatibility.
+     */
     int Score;
 
 #ifdef __cplusplus
@@ -306,6 +340,11 @@ struct LF_EXPORT lfCamera
      */
     lfCamera (const lfCamera &other);
 
+    /**
+     * Move constructor.  other is left as a new camera.
+     */
+    lfCamera (lfCamera &&other);
+
     /**
      * @brief Destroy a camera object. All allocated fields are freed.
      */
@@ -316,6 +355,11 @@ struct LF_EXPORT lfCamera
      */
     lfCamera &operator = (const lfCamera &other);
 
+    /**
+     * Move assignment operator.  other is left as a new camera.
+     */
+    lfCamera &operator = (lfCamera &&other);
+
     /**
      * @brief Add a string to camera maker.
      * 
@@ -802,6 +846,21 @@ C_TYPEDEF (enum, lfLensType)
  * have data, and invoke the lfLens::Check() or lf_lens_check() function, 
  * which will check if existing data is enough and will automatically fill
  * some fields using information extracted from lens name.
+ *
+ * A const lfLens may be used from any number of threads at once, including
+ * copying it and initializing modifiers from it.  Methods which change the
+ * lens, like GuessParameters() or AddCalibDistortion(), need the lens to
+ * themselves.
+ *
+ * The calibration data is kept in packed tables: one array per field, and
+ * for each record only as many terms as its model has.  Read it with
+ * GetCalibDistortion() and the like, which return the usual lfLensCalib*
+ * structures, with the terms which the model does not use set to 0.
+ *
+ * Copies of a lens share the calibration data, so that copying takes the
+ * same time however much data the lens has.  The data of a copy is
+ * duplicated when it is changed through AddCalibDistortion(),
+ * RemoveCalibDistortion() and the like.
  */
 struct LF_EXPORT lfLens
 {
@@ -837,17 +896,27 @@ struct LF_EXPORT lfLens
     float AspectRatio;
     /** Lens type */
     lfLensType Type;
-    /** Lens distortion calibration data, NULL-terminated (unsorted) */
-    lfLensCalibDistortion **CalibDistortion;
-    /** Lens TCA calibration data, NULL-terminated (unsorted) */
-    lfLensCalibTCA **CalibTCA;
-    /** Lens vignetting calibration data, NULL-terminated (unsorted) */
-    lfLensCalibVignetting **CalibVignetting;
-    /** Crop data, NULL-terminated (unsorted) */
-    lfLensCalibCrop **CalibCrop;
-    /** Field of view calibration data, NULL-terminated (unsorted) */
-    lfLensCalibFov **CalibFov;
-    /** Lens matching score, used while searching: not actually a lens parameter */
+    /**
+     * Lens distortion calibration data (unsorted), see GetCalibDistortion().
+     * This and the following Calib* fields used to be NULL-terminated lists
+     * of lfLensCalib* structures.  They are opaque now: read the records
+     * with GetCalib*Count() and GetCalib*(), change them with AddCalib*()
+     * and RemoveCalib*().  See also LF_CALIB_TABLES.
+     */
+    struct lfCalibTable *CalibDistortion;
+    /** Lens TCA calibration data (unsorted), see GetCalibTCA() */
+    struct lfCalibTable *CalibTCA;
+    /** Lens vignetting calibration data (unsorted), see GetCalibVignetting() */
+    struct lfCalibTable *CalibVignetting;
+    /** Crop data (unsorted), see GetCalibCrop() */
+    struct lfCalibTable *CalibCrop;
+    /** Field of view calibration data (unsorted), see GetCalibFov() */
+    struct lfCalibTable *CalibFov;
+    /**
+     * Lens matching score: not actually a lens parameter.  The library does
+     * not write this field, so that lenses can be shared between threads; it
+     * is kept for compatibility.
+     */
     int Score;
 
 #ifdef __cplusplus
@@ -857,10 +926,16 @@ struct LF_EXPORT lfLens
     lfLens ();
 
     /**
-     * Copy constructor.
+     * Copy constructor.  The calibration data is shared with other until
+     * either lens changes it.
      */
     lfLens (const lfLens &other);
 
+    /**
+     * Move constructor.  other is left as a new lens.
+     */
+    lfLens (lfLens &&other);
+
     /**
      * @brief Destroy this and all associated objects.
      */
@@ -871,6 +946,11 @@ struct LF_EXPORT lfLens
      */
     lfLens &operator = (const lfLens &other);
 
+    /**
+     * Move assignment operator.  other is left as a new lens.
+     */
+    lfLens &operator = (lfLens &&other);
+
     /**
      * @brief Add a string to camera maker.
      *
@@ -921,6 +1001,22 @@ struct LF_EXPORT lfLens
      */
     bool RemoveCalibDistortion (int idx);
 
+    /**
+     * @brief Return the number of distortion calibration entries.
+     */
+    int GetCalibDistortionCount () const;
+
+    /**
+     * @brief Get a distortion calibration entry.
+     * @param idx
+     *     The calibration data index (zero-based).
+     * @param res
+     *     The entry, with the terms which its model does not use set to 0.
+     * @return
+     *     false if idx is out of range.
+     */
+    bool GetCalibDistortion (int idx, lfLensCalibDistortion &res) const;
+
     /**
      * @brief Add a new transversal chromatic aberration calibration structure
      * to the pool.
@@ -939,6 +1035,22 @@ struct LF_EXPORT lfLens
      */
     bool RemoveCalibTCA (int idx);
 
+    /**
+     * @brief Return the number of TCA calibration entries.
+     */
+    int GetCalibTCACount () const;
+
+    /**
+     * @brief Get a TCA calibration entry.
+     * @param idx
+     *     The calibration data index (zero-based).
+     * @param res
+     *     The entry, with the terms which its model does not use set to 0.
+     * @return
+     *     false if idx is out of range.
+     */
+    bool GetCalibTCA (int idx, lfLensCalibTCA &res) const;
+
     /**
      * @brief Add a new vignetting calibration structure to the pool.
      *
@@ -956,6 +1068,22 @@ struct LF_EXPORT lfLens
      */
     bool RemoveCalibVignetting (int idx);
 
+    /**
+     * @brief Return the number of vignetting calibration entries.
+     */
+    int GetCalibVignettingCount () const;
+
+    /**
+     * @brief Get a vignetting calibration entry.
+     * @param idx
+     *     The calibration data index (zero-based).
+     * @param res
+     *     The entry, with the terms which its model does not use set to 0.
+     * @return
+     *     false if idx is out of range.
+     */
+    bool GetCalibVignetting (int idx, lfLensCalibVignetting &res) const;
+
     /**
      * @brief Add a new lens crop structure to the pool.
      *
@@ -973,6 +1101,22 @@ struct LF_EXPORT lfLens
      */
     bool RemoveCalibCrop (int idx);
 
+    /**
+     * @brief Return the number of lens crop entries.
+     */
+    int GetCalibCropCount () const;
+
+    /**
+     * @brief Get a lens crop entry.
+     * @param idx
+     *     The calibration data index (zero-based).
+     * @param res
+     *     The entry.
+     * @return
+     *     false if idx is out of range.
+     */
+    bool GetCalibCrop (int idx, lfLensCalibCrop &res) const;
+
     /**
      * @brief Add a new lens fov structure to the pool. 
      *
@@ -997,6 +1141,26 @@ struct LF_EXPORT lfLens
      */
     bool RemoveCalibFov (int idx);
 
+    /**
+     * @brief Return the number of field of view entries.
+     */
+    int GetCalibFovCount () const;
+
+    /**
+     * @brief Get a field of view entry.
+     *
+     * The Field of View (FOV) database entry is deprecated since Lensfun
+     * version 0.3 and will be removed in future releases.
+     *
+     * @param idx
+     *     The calibration data index (zero-based).
+     * @param res
+     *     The entry.
+     * @return
+     *     false if idx is out of range.
+     */
+    bool GetCalibFov (int idx, lfLensCalibFov &res) const;
+
     /**
      * @brief This method fills some fields if they are missing but
      * can be derived from other fields.
@@ -1240,30 +1404,60 @@ LF_EXPORT void lf_lens_add_calib_distortion (lfLens *lens, const lfLensCalibDist
 /** @sa lfLens::RemoveCalibDistortion */
 LF_EXPORT cbool lf_lens_remove_calib_distortion (lfLens *lens, int idx);
 
+/** @sa lfLens::GetCalibDistortionCount */
+LF_EXPORT int lf_lens_get_calib_distortion_count (const lfLens *lens);
+
+/** @sa lfLens::GetCalibDistortion */
+LF_EXPORT cbool lf_lens_get_calib_distortion (const lfLens *lens, int idx, lfLensCalibDistortion *res);
+
 /** @sa lfLens::AddCalibTCA */
 LF_EXPORT void lf_lens_add_calib_tca (lfLens *lens, const lfLensCalibTCA *tcac);
 
 /** @sa lfLens::RemoveCalibTCA */
 LF_EXPORT cbool lf_lens_remove_calib_tca (lfLens *lens, int idx);
 
+/** @sa lfLens::GetCalibTCACount */
+LF_EXPORT int lf_lens_get_calib_tca_count (const lfLens *lens);
+
+/** @sa lfLens::GetCalibTCA */
+LF_EXPORT cbool lf_lens_get_calib_tca (const lfLens *lens, int idx, lfLensCalibTCA *res);
+
 /** @sa lfLens::AddCalibVignetting */
 LF_EXPORT void lf_lens_add_calib_vignetting (lfLens *lens, const lfLensCalibVignetting *vc);
 
 /** @sa lfLens::RemoveCalibVignetting */
 LF_EXPORT cbool lf_lens_remove_calib_vignetting (lfLens *lens, int idx);
 
+/** @sa lfLens::GetCalibVignettingCount */
+LF_EXPORT int lf_lens_get_calib_vignetting_count (const lfLens *lens);
+
+/** @sa lfLens::GetCalibVignetting */
+LF_EXPORT cbool lf_lens_get_calib_vignetting (const lfLens *lens, int idx, lfLensCalibVignetting *res);
+
 /** @sa lfLens::AddCalibCrop */
 LF_EXPORT void lf_lens_add_calib_crop (lfLens *lens, const lfLensCalibCrop *cc);
 
 /** @sa lfLens::RemoveCalibCrop */
 LF_EXPORT cbool lf_lens_remove_calib_crop (lfLens *lens, int idx);
 
+/** @sa lfLens::GetCalibCropCount */
+LF_EXPORT int lf_lens_get_calib_crop_count (const lfLens *lens);
+
+/** @sa lfLens::GetCalibCrop */
+LF_EXPORT cbool lf_lens_get_calib_crop (const lfLens *lens, int idx, lfLensCalibCrop *res);
+
 /** @sa lfLens::AddCalibFov */
 LF_EXPORT void lf_lens_add_calib_fov (lfLens *lens, const lfLensCalibFov *cf);
 
 /** @sa lfLens::RemoveCalibFov */
 LF_EXPORT cbool lf_lens_remove_calib_fov (lfLens *lens, int idx);
 
+/** @sa lfLens::GetCalibFovCount */
+LF_EXPORT int lf_lens_get_calib_fov_count (const lfLens *lens);
+
+/** @sa lfLens::GetCalibFov */
+LF_EXPORT cbool lf_lens_get_calib_fov (const lfLens *lens, int idx, lfLensCalibFov *res);
+
 /** @} */
 
 /**
@@ -1630,6 +1824,66 @@ C_TYPEDEF (enum, lfComponentRole)
                                  ((LF_CR_ ## e) << 16) | ((LF_CR_ ## f) << 20) | \
                                  ((LF_CR_ ## g) << 24) | ((LF_CR_ ## h) << 28))
 
+/**
+ * @brief Storage formats for packed subpixel coordinates.
+ *
+ * The packed formats keep the coordinates of the green component as two
+ * absolute floats, and store red and blue as offsets from green.  Since TCA
+ * displaces red and blue by a few pixels at most, the offsets fit into 16-bit
+ * values, which shrinks the output from 24 to 16 bytes per pixel.
+ */
+enum lfSubpixelFormat
+{
+    /**
+     * The offsets are IEEE 754 half-precision floats.  Their absolute error
+     * is at most 2^(e-11) pixels for an offset smaller than 2^e pixels, e.g.
+     * 1/256 pixel for offsets below 8 pixels.  Offsets beyond ±65504 pixels
+     * are clamped.
+     */
+    LF_SUBPIXEL_DELTA_F16,
+    /**
+     * The offsets are signed 16-bit fixed-point values in units of
+     * 1/LF_SUBPIXEL_I16_SCALE pixel.  Their absolute error is at most half
+     * a unit, i.e. 1/512 pixel.  Offsets beyond ±128 pixels are clamped.
+     */
+    LF_SUBPIXEL_DELTA_I16
+};
+
+C_TYPEDEF (enum, lfSubpixelFormat)
+
+/** @brief Interpolation used by lfModifier::ApplyImageCorrection() */
+enum lfInterpolation
+{
+    /** Take the nearest source pixel */
+    LF_INTERPOLATION_NEAREST,
+    /** Blend the four surrounding pixels linearly */
+    LF_INTERPOLATION_BILINEAR,
+    /** Cubic convolution over the surrounding 4x4 pixels (Keys, a = -0.5) */
+    LF_INTERPOLATION_BICUBIC
+};
+
+C_TYPEDEF (enum, lfInterpolation)
+
+/** @brief Number of LF_SUBPIXEL_DELTA_I16 units per pixel */
+#define LF_SUBPIXEL_I16_SCALE   256
+
+/**
+ * @brief Packed subpixel coordinates of one pixel.
+ *
+ * See lfSubpixelFormat for the encodings of the offsets.  Use
+ * lfModifier::UnpackSubpixelCoords() to get back the six floats which
+ * lfModifier::ApplySubpixelDistortion() would have returned.
+ */
+struct lfSubpixelCoord
+{
+    /** Absolute X and Y coordinates of the green component */
+    float Green [2];
+    /** Offsets of the red (X, Y) and blue (X, Y) components from green */
+    lf_u16 Delta [4];
+};
+
+C_TYPEDEF (struct, lfSubpixelCoord)
+
 /**
  * @brief A callback function which modifies the separate coordinates for all color
  * components for every pixel in a strip.
@@ -1688,6 +1942,146 @@ typedef void (*lfModifyColorFunc) (void *data, float x, float y,
  */
 typedef void (*lfModifyCoordFunc) (void *data, float *iocoord, int count);
 
+/**
+ * @brief A callback which transforms a whole row of coordinates at once.
+ *
+ * Some coordinate callbacks can transform a row of evenly spaced pixels
+ * cheaper than one coordinate after the other.  Such a function fills
+ * @a res with what its companion lfModifyCoordFunc returns for the pixels
+ * (x + i*step, y), i = 0 ... count-1.
+ */
+typedef void (*lfModifyCoordRowFunc) (void *data, float x, float y, float step,
+                                      float *res, int count);
+
+/**
+ * @brief A callback which transforms coordinates together with their
+ * Jacobian.
+ *
+ * Does what its companion lfModifyCoordFunc does to @a iocoord, and
+ * multiplies every 2x2 matrix of @a jacobian from the left with the
+ * derivative of the callback at the coordinates it was given.  The matrices
+ * are stored row by row: dx'/dx, dx'/dy, dy'/dx, dy'/dy.
+ */
+typedef void (*lfModifyCoordJacobianFunc) (void *data, float *iocoord,
+                                           float *jacobian, int count);
+
+/**
+ * @brief The solved geometry of a perspective correction.
+ *
+ * Solving the control points is the expensive part of the perspective
+ * correction, while the strength parameter d only enters when the homography
+ * is generated from the solution.  So, interactive tools solve once with
+ * lfModifier::SolvePerspectiveCorrection() and then only change the strength
+ * with lfModifier::SetPerspectiveCorrectionStrength().
+ *
+ * All values are in the normalized coordinate system of the modifier that
+ * solved them.  A plan may be used with any modifier created for the same
+ * lens, crop factor, image size and focal length.
+ */
+struct lfPerspectivePlan
+{
+    /** First rotation around the y axis, in radians */
+    double Rho;
+    /** Rotation around the x axis which moves the vertex into the zenith */
+    double Delta;
+    /** Second rotation around the y axis, in radians */
+    double RhoH;
+    /** Final rotation around the z axis, in radians */
+    double Alpha;
+    /** Focal length in normalized units; refined if 8 control points were given */
+    double FocalLengthNormalized;
+    /** Center of gravity of the control points in normalized coordinates */
+    double ControlPointsCenterX, ControlPointsCenterY;
+};
+
+C_TYPEDEF (struct, lfPerspectivePlan)
+
+/**
+ * @brief The outcome of solving the control points of a perspective
+ * correction.
+ */
+enum lfPerspectiveStatus
+{
+    /** The control points were solved. */
+    LF_PERSPECTIVE_OK = 0,
+    /** The number of control points is not between 4 and 8. */
+    LF_PERSPECTIVE_INVALID_COUNT,
+    /** The focal length is unknown, and less than 8 control points were given. */
+    LF_PERSPECTIVE_NO_FOCAL_LENGTH,
+    /** The ellipse fit through 5 or 7 control points did not converge. */
+    LF_PERSPECTIVE_NO_CONVERGENCE,
+    /** The control lines have no vanishing point, e.g. they are parallel. */
+    LF_PERSPECTIVE_DEGENERATE,
+    /** The modifier was initialized for the reverse direction. */
+    LF_PERSPECTIVE_REVERSE
+};
+
+C_TYPEDEF (enum, lfPerspectiveStatus)
+
+/**
+ * @brief One image of a batch perspective correction.
+ *
+ * The first fields describe the image like the arguments of the lfModifier
+ * constructor and of lfModifier::Initialize() do.  The plan is valid for
+ * every modifier created with the same values.
+ */
+struct lfPerspectiveTask
+{
+    /** The lens the image was taken with */
+    const lfLens *Lens;
+    /** The crop factor of the camera */
+    float Crop;
+    /** The size of the image in pixels */
+    int Width, Height;
+    /** The nominal focal length in mm */
+    float Focal;
+    /** The control points, see lfModifier::EnablePerspectiveCorrection() */
+    const float *X, *Y;
+    /** The number of control points */
+    int Count;
+    /** Receives the solution if Status is LF_PERSPECTIVE_OK */
+    lfPerspectivePlan Plan;
+    /** Receives the outcome */
+    lfPerspectiveStatus Status;
+};
+
+C_TYPEDEF (struct, lfPerspectiveTask)
+
+/** @brief Number of bins of the Newton iteration histogram in lfProfileCounters */
+#define LF_PROFILE_NEWTON_BINS 8
+
+/**
+ * @brief Profiling counters of one callback.
+ *
+ * The library collects these only when it is compiled with LF_PROFILING
+ * defined; otherwise the instrumentation is not compiled in at all.  The
+ * counters are process-wide and add up the work of all modifiers and
+ * threads.  See lfModifier::GetProfileCounters().
+ */
+struct lfProfileCounters
+{
+    /** @brief Name of the stock callback, or "custom" */
+    const char *Name;
+    /** @brief The callback function itself */
+    const void *Callback;
+    /** @brief Number of times the Apply* methods have called the callback */
+    unsigned long long Calls;
+    /** @brief Number of image pixels handed to the callback */
+    unsigned long long Pixels;
+    /** @brief Time spent in the callback, in nanoseconds */
+    unsigned long long Nanoseconds;
+    /**
+     * @brief For callbacks which invert their model with Newton's method:
+     * the number of solutions found after i steps, in bin i.  The last bin
+     * also counts all longer searches.
+     */
+    unsigned long long NewtonSteps [LF_PROFILE_NEWTON_BINS];
+    /** @brief Number of Newton searches which gave up without a solution */
+    unsigned long long NewtonFailures;
+};
+
+C_TYPEDEF (struct, lfProfileCounters)
+
 // @cond
     
 /// Common ancestor for lfCoordCallbackData and lfColorCallbackData
@@ -1698,8 +2092,16 @@ struct lfCallbackData
     size_t data_size;
 };
 
-// A test point in the autoscale algorithm
-typedef struct { float angle, dist; } lfPoint;
+/// Fills table with two values per pixel x + i*step, i = 0 ... count-1,
+/// for the lfCoordTableRowFunc of the same callback
+typedef void (*lfCoordColumnsFunc) (void *data, float x, float step,
+                                    float *table, int count);
+/// Transforms a row of count pixels at height y like the lfModifyCoordFunc
+/// of the callback, from the table of its lfCoordColumnsFunc
+typedef void (*lfCoordTableRowFunc) (void *data, float y, const float *table,
+                                     float *res, int count);
+
+struct lfCoordColumns;
 
 // @endcond
 
@@ -1785,6 +2187,14 @@ typedef struct { float angle, dist; } lfPoint;
  * stage 2, which treats the colour channels equally, are fed directly into
  * stage 3, which will correct the R,G,B coordinates further.
  * ApplySubpixelGeometryDistortion() does this in a convenient fashion.
+ *
+ * Once it is set up, a modifier may be shared between threads: the const
+ * methods, i.e. all Apply* functions, keep no state between calls, and any
+ * number of threads may call them at the same time, for example on
+ * different bands of the same image.  Initialize(), the Enable* and Add*
+ * functions, and the destructor need the modifier to themselves.  The
+ * library has no other mutable global state apart from the optional
+ * profiling counters, which are atomic.
  */
 #ifdef __cplusplus
 }
@@ -1918,6 +2328,76 @@ struct LF_EXPORT lfModifier
      */
     bool EnablePerspectiveCorrection (float *x, float *y, int count, float d);
 
+    /**
+     * @brief Solve the control points of a perspective correction.
+     *
+     * This does the expensive part of EnablePerspectiveCorrection() without
+     * enabling anything.  See there for the meaning of the control points.
+     * @param x
+     *     The x coordinates of the control points.
+     * @param y
+     *     The y coordinates of the control points.
+     * @param count
+     *     The number of control points.
+     * @param plan
+     *     Receives the solution.
+     * @return
+     *     True if the control points could be solved.
+     */
+    bool SolvePerspectiveCorrection (float *x, float *y, int count,
+                                     lfPerspectivePlan &plan) const;
+
+    /**
+     * @brief Enable the perspective correction from a solved plan.
+     *
+     * This is EnablePerspectiveCorrection() without solving the control
+     * points again.
+     * @param plan
+     *     The plan as returned by SolvePerspectiveCorrection().
+     * @param d
+     *     The strength of the correction, see EnablePerspectiveCorrection().
+     * @return
+     *     True if the perspective correction was enabled.
+     */
+    bool EnablePerspectiveCorrection (const lfPerspectivePlan &plan, float d);
+
+    /**
+     * @brief Solve the control points of many images.
+     *
+     * The images are solved in parallel if the library was built with
+     * threads.  Failures are reported by the status of every task and not
+     * by exceptions, so one bad set of control points does not affect the
+     * others.  The resulting plans can be passed to
+     * EnablePerspectiveCorrection(const lfPerspectivePlan &, float).
+     * @param tasks
+     *     The images to solve.  Their Plan and Status fields are written.
+     * @param count
+     *     The number of tasks.
+     * @param threads
+     *     The number of threads to use, or 0 for one per CPU core.
+     * @return
+     *     The number of tasks which were solved.
+     */
+    static int SolvePerspectiveCorrections (lfPerspectiveTask *tasks, int count,
+                                            int threads = 0);
+
+    /**
+     * @brief Change the strength of the enabled perspective correction.
+     *
+     * The homography of the perspective correction callback is regenerated
+     * in place from its plan, so the modifier does not need to be set up
+     * again.  This is cheap enough to be called for every tick of a slider.
+     * It must not be called while another thread is applying the modifier.
+     * @param d
+     *     The new strength of the correction, see
+     *     EnablePerspectiveCorrection().
+     * @return
+     *     True if the homography was updated.  False if no perspective
+     *     correction is enabled, or if the new strength is not possible, in
+     *     which case the old one is kept.
+     */
+    bool SetPerspectiveCorrectionStrength (float d);
+
     /**
      * @brief Add a user-defined callback to the coordinate correction chain.
      * @param callback
@@ -2073,6 +2553,29 @@ struct LF_EXPORT lfModifier
      */
     float GetAutoScale (bool reverse);
 
+    /**
+     * @brief Find the largest rectangle of valid pixels in the corrected
+     * image.
+     *
+     * A pixel is valid if the coordinate callbacks map it into the original
+     * image.  Unlike the crop in lfLensCalibCrop, this follows the actual
+     * callback chain, including scaling and perspective correction.  Only
+     * the boundary of the valid region is traced, so this is cheap enough
+     * to be called after every change of the parameters.  The region is
+     * expected to contain the image centre, and to be star-shaped around
+     * it, which is the case for all lens corrections.
+     * @param aspect
+     *     The ratio of width and height of the rectangle, or 0 for the
+     *     rectangle of largest area.
+     * @param crop
+     *     Receives the left, right, top, and bottom pixel of the rectangle,
+     *     inclusively.  The order is the same as in lfLensCalibCrop.
+     * @return
+     *     True if a rectangle was found.  False if the image centre itself
+     *     is not valid.
+     */
+    bool GetValidCrop (float aspect, float *crop) const;
+
     /**
      * @brief Image correction step 1: fix image colors.
      *
@@ -2138,6 +2641,101 @@ struct LF_EXPORT lfModifier
     bool ApplyGeometryDistortion (float xu, float yu, int width, int height,
                                   float *res) const;
 
+    /**
+     * @brief Apply the transforms, or their inverse, to a list of arbitrary
+     * pixel coordinates.
+     *
+     * This is ApplyGeometryDistortion() for scattered points such as
+     * keypoints of feature tracking.  The points are processed in blocks,
+     * and every callback is applied to a whole block at once.
+     *
+     * Forward, every point of the corrected image is mapped to its position
+     * in the original image, exactly as by ApplyGeometryDistortion().
+     * Inverse, every point of the original image is mapped to the point of
+     * the corrected image which the forward transform moves onto it.  There
+     * is no closed form for this in general, so it is searched for with
+     * Newton's method on the whole callback chain, all points of a block
+     * together.  Points for which the search does not converge (e.g. beyond
+     * the rim of a fisheye, where no corrected point maps to them) are
+     * left unchanged.
+     *
+     * This routine has been designed to be safe to use in parallel from
+     * several threads.
+     * @param coord
+     *     count (X,Y) pixel coordinates, of the corrected image when
+     *     forward, of the original image when inverse.
+     * @param res
+     *     Receives count (X,Y) pixel coordinates of the other image.  This
+     *     may be the same array as coord.
+     * @param count
+     *     The number of points.
+     * @param inverse
+     *     false to map from the corrected to the original image like
+     *     ApplyGeometryDistortion(), true for the opposite direction.
+     * @param status
+     *     If not NULL, receives for every point 1 if it has been mapped, and
+     *     0 if the inverse search did not converge or a projection has no
+     *     valid result for the point.
+     * @return
+     *     true if return buffer has been filled, false if nothing to do
+     */
+    bool ApplyGeometryDistortionPoints (const float *coord, float *res, int count,
+                                        bool inverse = false,
+                                        unsigned char *status = NULL) const;
+
+    /**
+     * @brief Apply the transforms to a grid of pixels, with the Jacobian of
+     * the mapping at every grid node.
+     *
+     * The Jacobian tells how a small neighbourhood of a pixel of the
+     * corrected image is stretched and sheared on the original image, which
+     * is what resamplers with elliptical weighted average (EWA) or other
+     * anisotropic filters need for the footprint of every output pixel.  It
+     * is computed analytically by every callback of the chain together with
+     * the coordinates, and multiplied up by the chain rule, so this costs far
+     * less than evaluating the mapping at neighbouring points.
+     *
+     * The grid nodes are \f$(x_u + i \cdot \mathrm{step}, y_u + j \cdot
+     * \mathrm{step})\f$ for i = 0 ... width-1 and j = 0 ... height-1; with a
+     * step of 1 this is ApplyGeometryDistortion() for a block of pixels.
+     * Where a projection or the perspective correction has no valid result
+     * for a node, e.g. a point behind the camera, the node gets the same
+     * coordinates as with ApplyGeometryDistortion() and all four entries of
+     * its Jacobian are NaN.  The same goes for nodes where the Newton search
+     * of an inverse distortion model finds no solution; they keep their
+     * coordinates.  So such nodes can be told from valid ones.
+     *
+     * This routine has been designed to be safe to use in parallel from
+     * several threads.
+     * @param xu
+     *     The undistorted X coordinate of the first grid node.
+     * @param yu
+     *     The undistorted Y coordinate of the first grid node.
+     * @param width
+     *     The number of grid nodes per row.
+     * @param height
+     *     The number of rows of grid nodes.
+     * @param res
+     *     A pointer to an output array which receives the respective X and Y
+     *     distorted coordinates for every grid node, like for
+     *     ApplyGeometryDistortion().  The size of this array must be at least
+     *     width*height*2 elements.
+     * @param jacobian
+     *     A pointer to an output array which receives for every grid node
+     *     the derivatives of the distorted coordinates by the undistorted
+     *     ones, in pixels per pixel: dx/dxu, dx/dyu, dy/dxu, dy/dyu.  The
+     *     size of this array must be at least width*height*4 elements.
+     * @param step
+     *     The distance between neighbouring grid nodes in pixels.
+     * @return
+     *     true if the return buffers have been filled, false if nothing to
+     *     do or if a callback added with AddCoordCallback() has no
+     *     derivative
+     */
+    bool ApplyGeometryDistortionJacobian (float xu, float yu, int width, int height,
+                                          float *res, float *jacobian,
+                                          float step = 1) const;
+
     /**
      * @brief Image correction step 3: apply subpixel distortions.
      *
@@ -2205,6 +2803,322 @@ struct LF_EXPORT lfModifier
     bool ApplySubpixelGeometryDistortion (float xu, float yu, int width, int height,
                                           float *res) const;
 
+    /**
+     * @brief Apply subpixel distortions into a packed output buffer.
+     *
+     * This is the same as ApplySubpixelDistortion(), but the results are
+     * stored as one lfSubpixelCoord per pixel, which takes 16 bytes instead
+     * of 24.  The precision of the red and blue coordinates is given by the
+     * chosen format.
+     * @param xu
+     *     The undistorted X coordinate of the start of the block of pixels.
+     * @param yu
+     *     The undistorted Y coordinate of the start of the block of pixels.
+     * @param width
+     *     The width of the block in pixels.
+     * @param height
+     *     The height of the block in pixels.
+     * @param res
+     *     A pointer to an output array of at least width*height elements.
+     * @param format
+     *     The encoding of the red and blue offsets.
+     * @return
+     *     true if return buffer has been filled, false if nothing to do
+     */
+    bool ApplySubpixelDistortionPacked (float xu, float yu, int width, int height,
+                                        lfSubpixelCoord *res,
+                                        lfSubpixelFormat format) const;
+
+    /**
+     * @brief Apply stage 2 & 3 in one step into a packed output buffer.
+     *
+     * This is the same as ApplySubpixelGeometryDistortion(), but the results
+     * are stored as one lfSubpixelCoord per pixel.
+     * @param xu
+     *     The undistorted X coordinate of the start of the block of pixels.
+     * @param yu
+     *     The undistorted Y coordinate of the start of the block of pixels.
+     * @param width
+     *     The width of the block in pixels.
+     * @param height
+     *     The height of the block in pixels.
+     * @param res
+     *     A pointer to an output array of at least width*height elements.
+     * @param format
+     *     The encoding of the red and blue offsets.
+     * @return
+     *     true if return buffer has been filled, false if nothing to do
+     */
+    bool ApplySubpixelGeometryDistortionPacked (float xu, float yu, int width,
+                                                int height, lfSubpixelCoord *res,
+                                                lfSubpixelFormat format) const;
+
+    /**
+     * @brief Apply ApplyColorModification() to a whole image using several
+     * threads.
+     *
+     * The image is split into bands of rows which are corrected in parallel.
+     * Where the library is built without thread support (e.g. a WebAssembly
+     * module without -s USE_PTHREADS) this is the same as
+     * ApplyColorModification().
+     * @param pixels
+     *     See ApplyColorModification().
+     * @param x
+     *     See ApplyColorModification().
+     * @param y
+     *     See ApplyColorModification().
+     * @param width
+     *     See ApplyColorModification().
+     * @param height
+     *     See ApplyColorModification().
+     * @param comp_role
+     *     See ApplyColorModification().
+     * @param row_stride
+     *     See ApplyColorModification().
+     * @param threads
+     *     The number of threads to use, including the calling one.  Zero
+     *     uses one thread per CPU core.
+     * @return
+     *     true if return buffer has been altered, false if nothing to do
+     */
+    bool ApplyColorModificationParallel (void *pixels, float x, float y,
+                                         int width, int height, int comp_role,
+                                         int row_stride, int threads = 0) const;
+
+    /**
+     * @brief Apply ApplyGeometryDistortion() to a whole image using several
+     * threads.
+     *
+     * See ApplyColorModificationParallel() for how the work is split.
+     * @param xu
+     *     The undistorted X coordinate of the start of the block of pixels.
+     * @param yu
+     *     The undistorted Y coordinate of the start of the block of pixels.
+     * @param width
+     *     The width of the block in pixels.
+     * @param height
+     *     The height of the block in pixels.
+     * @param res
+     *     The output array, like for ApplyGeometryDistortion().
+     * @param threads
+     *     The number of threads to use, including the calling one.  Zero
+     *     uses one thread per CPU core.
+     * @return
+     *     true if return buffer has been filled, false if nothing to do
+     */
+    bool ApplyGeometryDistortionParallel (float xu, float yu, int width,
+                                          int height, float *res,
+                                          int threads = 0) const;
+
+    /**
+     * @brief Apply ApplySubpixelDistortion() to a whole image using several
+     * threads.
+     *
+     * See ApplyColorModificationParallel() for how the work is split.
+     * @param xu
+     *     The undistorted X coordinate of the start of the block of pixels.
+     * @param yu
+     *     The undistorted Y coordinate of the start of the block of pixels.
+     * @param width
+     *     The width of the block in pixels.
+     * @param height
+     *     The height of the block in pixels.
+     * @param res
+     *     The output array, like for ApplySubpixelDistortion().
+     * @param threads
+     *     The number of threads to use, including the calling one.  Zero
+     *     uses one thread per CPU core.
+     * @return
+     *     true if return buffer has been filled, false if nothing to do
+     */
+    bool ApplySubpixelDistortionParallel (float xu, float yu, int width,
+                                          int height, float *res,
+                                          int threads = 0) const;
+
+    /**
+     * @brief Apply ApplySubpixelGeometryDistortion() to a whole image using
+     * several threads.
+     *
+     * See ApplyColorModificationParallel() for how the work is split.
+     * @param xu
+     *     The undistorted X coordinate of the start of the block of pixels.
+     * @param yu
+     *     The undistorted Y coordinate of the start of the block of pixels.
+     * @param width
+     *     The width of the block in pixels.
+     * @param height
+     *     The height of the block in pixels.
+     * @param res
+     *     The output array, like for ApplySubpixelGeometryDistortion().
+     * @param threads
+     *     The number of threads to use, including the calling one.  Zero
+     *     uses one thread per CPU core.
+     * @return
+     *     true if return buffer has been filled, false if nothing to do
+     */
+    bool ApplySubpixelGeometryDistortionParallel (float xu, float yu, int width,
+                                                  int height, float *res,
+                                                  int threads = 0) const;
+
+    /**
+     * @brief Correct a whole image in one call.
+     *
+     * This runs all steps set up by Initialize(): the colors of the source
+     * are corrected first, in a temporary copy of the source, then every
+     * destination pixel is resampled from
+     * the source at the coordinates given by ApplySubpixelGeometryDistortion(),
+     * separately for red, green and blue.  An alpha component is sampled
+     * like green and is not changed otherwise.  Destination pixels whose
+     * source lies outside of the image are set to zero.
+     * @param src
+     *     The source pixels; they are not changed.  If vignetting is
+     *     corrected, a copy of the whole source is held while the image is
+     *     corrected.  Callers who do not need the source afterwards can
+     *     save that memory by calling ApplyColorModificationParallel() on
+     *     it and then ApplyImageResampling().
+     * @param src_stride
+     *     The size of a source row in bytes.
+     * @param dst
+     *     The destination pixels, in the same format as the source.  It must
+     *     not overlap the source.
+     * @param dst_stride
+     *     The size of a destination row in bytes.
+     * @param width
+     *     The width of the image in pixels.
+     * @param height
+     *     The height of the image in pixels.
+     * @param format
+     *     The component type; LF_PF_U8 and LF_PF_U16 are supported.  If
+     *     colors are corrected, this must be the format which was given to
+     *     Initialize().
+     * @param components
+     *     3 for R,G,B pixels or 4 for R,G,B,A pixels.
+     * @param interpolation
+     *     The resampling filter.
+     * @param threads
+     *     The number of threads to use, including the calling one.  Zero
+     *     uses one thread per CPU core.
+     * @return
+     *     true if the destination has been filled, false if the pixel
+     *     layout is not supported, the format does not match the one the
+     *     colors are corrected for, or the copy of the source could not be
+     *     allocated
+     */
+    bool ApplyImageCorrection (const void *src, int src_stride, void *dst,
+                               int dst_stride, int width, int height,
+                               lfPixelFormat format, int components,
+                               lfInterpolation interpolation,
+                               int threads = 0) const;
+
+    /**
+     * @brief Resample some rows of a corrected image.
+     *
+     * This is the second half of ApplyImageCorrection(): it fills the
+     * destination rows first_row ... first_row + row_count - 1 from a source
+     * whose colors have already been corrected with
+     * ApplyColorModification().  Calling it for consecutive bands of rows
+     * lets a caller hand out parts of the image as they are done.
+     * @param src
+     *     The whole source image.
+     * @param src_stride
+     *     The size of a source row in bytes.
+     * @param dst
+     *     The destination of the first row to fill; row_count rows are
+     *     written from there on.
+     * @param dst_stride
+     *     The size of a destination row in bytes.
+     * @param width
+     *     The width of the image in pixels.
+     * @param height
+     *     The height of the image in pixels.
+     * @param format
+     *     See ApplyImageCorrection().
+     * @param components
+     *     See ApplyImageCorrection().
+     * @param interpolation
+     *     The resampling filter.
+     * @param first_row
+     *     The first image row to fill.
+     * @param row_count
+     *     The number of rows to fill.
+     * @param threads
+     *     The number of threads to use, including the calling one.  Zero
+     *     uses one thread per CPU core.
+     * @return
+     *     true if the rows have been filled, false if the pixel layout or
+     *     the range of rows is not supported
+     */
+    bool ApplyImageResampling (const void *src, int src_stride, void *dst,
+                               int dst_stride, int width, int height,
+                               lfPixelFormat format, int components,
+                               lfInterpolation interpolation, int first_row,
+                               int row_count, int threads = 0) const;
+
+    /**
+     * @brief Let ApplyImageCorrection() and ApplyImageResampling() hold the
+     * source coordinates in the packed format.
+     *
+     * Every thread of the resampling computes the coordinates of a few rows
+     * at a time into a block of 24 bytes per pixel, see
+     * ApplySubpixelGeometryDistortion().  With packed coordinates the block
+     * takes 16 bytes per pixel and is expanded strip by strip with
+     * UnpackSubpixelCoords(), at the precision of the format for red and
+     * blue.  Packing and expanding take about a quarter more time, so this
+     * only pays off where memory is tight, e.g. in a WebAssembly module
+     * with a small heap and many threads.  The default is not to pack them.
+     * @param packed
+     *     true to resample from packed coordinates
+     * @param format
+     *     The encoding of the red and blue offsets.
+     */
+    void SetPackedResampling (bool packed,
+                              lfSubpixelFormat format = LF_SUBPIXEL_DELTA_I16);
+
+    /**
+     * @brief Expand packed subpixel coordinates.
+     *
+     * Resamplers which work on the packed output call this for every strip
+     * of pixels they are about to interpolate, like ApplyImageResampling()
+     * does after SetPackedResampling().
+     * @param packed
+     *     The packed coordinates, as returned by
+     *     ApplySubpixelDistortionPacked() or
+     *     ApplySubpixelGeometryDistortionPacked().
+     * @param count
+     *     The number of pixels to expand.
+     * @param format
+     *     The format which was used when packing.
+     * @param res
+     *     A pointer to an output array of at least count*2*3 elements which
+     *     receives the R, G, B coordinate pairs like
+     *     ApplySubpixelDistortion() does.
+     */
+    static void UnpackSubpixelCoords (const lfSubpixelCoord *packed, int count,
+                                      lfSubpixelFormat format, float *res);
+
+    /**
+     * @brief Read the profiling counters of the callbacks.
+     *
+     * Every callback which the Apply* methods have run since the last
+     * ResetProfileCounters() has an entry, stock and custom callbacks alike.
+     * Setup work, like the automatic scaling in Initialize(), is not
+     * counted.  Counting is only compiled in if the library is built with
+     * LF_PROFILING defined.
+     * @param counters
+     *     Receives up to count entries.  May be NULL if count is 0.
+     * @param count
+     *     The number of entries counters has room for.
+     * @return
+     *     the number of callbacks with counters, which may be more than
+     *     count, or -1 if the library was built without LF_PROFILING
+     */
+    static int GetProfileCounters (lfProfileCounters *counters, int count);
+
+    /**
+     * @brief Set all profiling counters back to zero.
+     */
+    static void ResetProfileCounters ();
+
 private:
     /**
      * @brief Determine the real focal length.
@@ -2241,6 +3155,83 @@ private:
     void AddCallback (void *arr, lfCallbackData *d,
                       int priority, void *data, size_t data_size);
 
+    /// Like AddCoordCallback(), with the version of the callback which
+    /// ApplyGeometryDistortionJacobian() uses
+    void AddCoordCallback (lfModifyCoordFunc callback,
+                           lfModifyCoordJacobianFunc jacobian_callback,
+                           int priority, void *data, size_t data_size);
+
+    /// Like AddCoordCallback(), with a row version of the callback which
+    /// GenerateCoordRow() uses when the callback is first in the chain
+    void AddCoordRowCallback (lfModifyCoordFunc callback,
+                              lfModifyCoordRowFunc row_callback,
+                              lfModifyCoordJacobianFunc jacobian_callback,
+                              int priority, void *data, size_t data_size);
+
+    /// Like AddCoordCallback(), for callbacks which are separable in x and
+    /// y: when such a callback is first in the chain, its per-column part
+    /// is tabulated once per request by PrepareCoordColumns(), and
+    /// GenerateCoordRow() applies it to each row from the table
+    void AddCoordTableCallback (lfModifyCoordFunc callback,
+                                lfCoordColumnsFunc columns_callback,
+                                lfCoordTableRowFunc table_row_callback,
+                                lfModifyCoordJacobianFunc jacobian_callback,
+                                int priority, void *data, size_t data_size);
+
+    /**
+     * @brief Tabulate the per-column part of the first coordinate callback
+     * for a request of rows starting at the same x.
+     *
+     * columns is left empty unless the first callback after a leading scale
+     * was added with AddCoordTableCallback().  The table belongs to the
+     * request, so that concurrent requests do not share any state.
+     * @param x
+     *     The normalized X coordinate of the first pixel.
+     * @param count
+     *     The number of pixels per row.
+     * @param columns
+     *     Receives the table for GenerateCoordRow().
+     */
+    void PrepareCoordColumns (float x, int count, lfCoordColumns &columns) const;
+
+    /**
+     * @brief Generate a row of normalized coordinates for the coordinate
+     * callbacks.
+     *
+     * If the callback chain starts with a scale and/or a perspective
+     * correction, these are evaluated while generating the row: the scale
+     * factor is folded into the row, and the homography is evaluated
+     * incrementally since it is linear in x along a row.  A separable
+     * projection is applied from the table in columns instead.
+     * @param x
+     *     The normalized X coordinate of the first pixel.
+     * @param y
+     *     The normalized Y coordinate of the row.
+     * @param res
+     *     Receives count coordinate pairs.
+     * @param count
+     *     The number of pixels in the row.
+     * @param columns
+     *     The table of PrepareCoordColumns() for the same x and count, or
+     *     NULL.
+     * @return
+     *     The index of the first coordinate callback which still has to be
+     *     applied to the row.
+     */
+    int GenerateCoordRow (float x, float y, float *res, int count,
+                          const lfCoordColumns *columns = NULL) const;
+
+    /// One row of ApplySubpixelGeometryDistortion() at normalized x, y
+    void SubpixelGeometryRow (float x, float y, float *res, int count,
+                              const lfCoordColumns *columns) const;
+
+    /// SolvePerspectiveCorrection() with the reason of a failure.
+    lfPerspectiveStatus SolvePerspective (const float *x, const float *y, int count,
+                                          lfPerspectivePlan &plan) const;
+    /// Solves the tasks first, first + stride, ... of the array.
+    static void SolvePerspectiveTasks (lfPerspectiveTask *tasks, int count,
+                                       int first, int stride);
+
     /**
      * @brief Calculate distance between point and image edge.
      *
@@ -2256,26 +3247,108 @@ private:
      */
     double AutoscaleResidualDistance (float *coord) const;
     /**
-     * @brief Calculate distance of the corrected edge point from the centre.
+     * @brief Calculate distances of corrected edge points from the centre.
+     *
+     * This is an internal function used for autoscaling.  For every given
+     * direction, it finds the distance from the origin of the point on the
+     * edge of the corrected image which lies in that direction.  This way,
+     * the necessary autoscaling value for the direction can be calculated by
+     * the calling routine.  All directions are searched together, so that
+     * the callbacks process them in batches.
+     * @param dir
+     *     The directions as unit vectors, i.e. count (X,Y) pairs.
+     * @param ru
+     *     On input, the initial approximations of the distances.  On output,
+     *     the distances, or -1 for directions in which the search did not
+     *     converge.
+     * @param count
+     *     The number of directions.
+     */
+    void GetTransformedDistances (const float *dir, float *ru, int count) const;
+    /**
+     * @brief Calculate the autoscaling values for points on the image edge.
      *
-     * This is an internal function used for autoscaling.  It returns the
-     * distance of the point on the edge of the corrected image which lies in
-     * the direction of the given coordinates.  "Distance" means "distance from
-     * origin".  This way, the necessary autoscaling value for this direction
-     * can be calculated by the calling routine.
-     * @param point
-     *     The polar coordinates of the point for which the distance of the
-     *     corrected counterpart should be calculated.
+     * @param u
+     *     The positions on the edge of the uncorrected image.  The integers
+     *     0 to 7 are the right axis, the lower right corner, the lower axis
+     *     and so on, and the edge is linear in between.
+     * @param scale
+     *     On input, the expected scales, or values <= 0 if unknown.  On
+     *     output, the scales which move the corrected edge onto the given
+     *     points, or -1 where they could not be found.
+     * @param count
+     *     The number of points.
+     */
+    void GetEdgeScales (const double *u, double *scale, int count) const;
+    /**
+     * @brief Calculate the autoscaling value for a distance from the centre.
+     *
+     * This is GetEdgeScales() for modifiers whose coordinate callbacks are
+     * all radial (see IsRadialCallback()).  The callbacks are inverted one
+     * by one, without searching along the whole chain.
+     * @param dist
+     *     The distance of a point on the edge of the uncorrected image from
+     *     the centre, in normalized coordinates.
      * @return
-     *     The distance of the corrected image edge from the origin.
+     *     The scale which moves the corrected edge onto the point, or -1 if
+     *     it could not be found.
      */
-    float GetTransformedDistance (lfPoint point) const;
+    double GetRadialScale (double dist) const;
+    /// GetAutoScale() for radial callbacks, without the safety margin
+    double GetRadialAutoScale () const;
+    /// GetAutoScale() for any callbacks, without the safety margin
+    double GetEdgeAutoScale () const;
+    /**
+     * @brief Check whether pixels are mapped into the original image.
+     *
+     * @param coord
+     *     count (X,Y) pixel coordinates of the corrected image.  They are
+     *     overwritten.
+     * @param count
+     *     The number of pixels.
+     * @param valid
+     *     Receives 1 for every pixel which is mapped into the original
+     *     image, and 0 for the others.
+     */
+    void TestValidPixels (float *coord, int count, unsigned char *valid) const;
+    /**
+     * @brief Invert the coordinate callbacks for a block of points.
+     *
+     * The inverse direction of ApplyGeometryDistortionPoints(), in
+     * normalized coordinates.
+     * @param coord
+     *     count (X,Y) normalized coordinates of the original image.  Every
+     *     point for which the search converges is replaced by the point of
+     *     the corrected image which the callbacks move onto it.
+     * @param count
+     *     The number of points, at most 256; the state of the search lives
+     *     on the stack.
+     * @param status
+     *     Receives 1 for every point which has been replaced, and 0 for the
+     *     others.
+     */
+    void InvertCoordPoints (float *coord, int count, unsigned char *status) const;
 
     static void ModifyCoord_UnTCA_Linear (void *data, float *iocoord, int count);
     static void ModifyCoord_TCA_Linear (void *data, float *iocoord, int count);
     static void ModifyCoord_UnTCA_Poly3 (void *data, float *iocoord, int count);
     static void ModifyCoord_TCA_Poly3 (void *data, float *iocoord, int count);
     static void ModifyCoord_TCA_ACM (void *data, float *iocoord, int count);
+#ifdef VECTORIZATION_SSE4_1
+    static void ModifyCoord_UnTCA_Poly3_SSE4 (void *data, float *iocoord, int count);
+    static void ModifyCoord_TCA_Poly3_SSE4 (void *data, float *iocoord, int count);
+    static void ModifyCoord_TCA_ACM_SSE4 (void *data, float *iocoord, int count);
+#endif
+#ifdef VECTORIZATION_AVX2
+    static void ModifyCoord_UnTCA_Poly3_AVX2 (void *data, float *iocoord, int count);
+    static void ModifyCoord_TCA_Poly3_AVX2 (void *data, float *iocoord, int count);
+    static void ModifyCoord_TCA_ACM_AVX2 (void *data, float *iocoord, int count);
+#endif
+#ifdef VECTORIZATION_SIMD128
+    static void ModifyCoord_UnTCA_Poly3_SIMD128 (void *data, float *iocoord, int count);
+    static void ModifyCoord_TCA_Poly3_SIMD128 (void *data, float *iocoord, int count);
+    static void ModifyCoord_TCA_ACM_SIMD128 (void *data, float *iocoord, int count);
+#endif
 
     static void ModifyCoord_UnDist_Poly3 (void *data, float *iocoord, int count);
     static void ModifyCoord_Dist_Poly3 (void *data, float *iocoord, int count);
@@ -2293,16 +3366,35 @@ private:
     static void ModifyCoord_Dist_ACM (void *data, float *iocoord, int count);
     static void ModifyCoord_Geom_FishEye_Rect (void *data, float *iocoord, int count);
     static void ModifyCoord_Geom_Panoramic_Rect (void *data, float *iocoord, int count);
+    static void ModifyCoordColumns_Geom_Panoramic_Rect (
+        void *data, float x, float step, float *table, int count);
+    static void ModifyCoordTableRow_Geom_Panoramic_Rect (
+        void *data, float y, const float *table, float *res, int count);
     static void ModifyCoord_Geom_ERect_Rect (void *data, float *iocoord, int count);
     static void ModifyCoord_Geom_Rect_FishEye (void *data, float *iocoord, int count);
     static void ModifyCoord_Geom_Panoramic_FishEye (void *data, float *iocoord, int count);
     static void ModifyCoord_Geom_ERect_FishEye (void *data, float *iocoord, int count);
     static void ModifyCoord_Geom_Rect_Panoramic (void *data, float *iocoord, int count);
+    static void ModifyCoordColumns_Geom_Rect_Panoramic (
+        void *data, float x, float step, float *table, int count);
+    static void ModifyCoordTableRow_Geom_Rect_Panoramic (
+        void *data, float y, const float *table, float *res, int count);
     static void ModifyCoord_Geom_FishEye_Panoramic (void *data, float *iocoord, int count);
     static void ModifyCoord_Geom_ERect_Panoramic (void *data, float *iocoord, int count);
+    static void ModifyCoordTableRow_Geom_ERect_Panoramic (
+        void *data, float y, const float *table, float *res, int count);
     static void ModifyCoord_Geom_Rect_ERect (void *data, float *iocoord, int count);
+    static void ModifyCoordColumns_Geom_Rect_ERect (
+        void *data, float x, float step, float *table, int count);
+    static void ModifyCoordTableRow_Geom_Rect_ERect (
+        void *data, float y, const float *table, float *res, int count);
     static void ModifyCoord_Geom_FishEye_ERect (void *data, float *iocoord, int count);
     static void ModifyCoord_Geom_Panoramic_ERect (void *data, float *iocoord, int count);
+    static void ModifyCoordTableRow_Geom_Panoramic_ERect (
+        void *data, float y, const float *table, float *res, int count);
+    /// Columns of the callbacks which keep x as it is
+    static void ModifyCoordColumns_Geom_Identity (
+        void *data, float x, float step, float *table, int count);
     static void ModifyCoord_Geom_Orthographic_ERect (void *data, float *iocoord, int count);
     static void ModifyCoord_Geom_ERect_Orthographic (void *data, float *iocoord, int count);
     static void ModifyCoord_Geom_Stereographic_ERect (void *data, float *iocoord, int count);
@@ -2312,6 +3404,89 @@ private:
     static void ModifyCoord_Geom_Thoby_ERect (void *data, float *iocoord, int count);
     static void ModifyCoord_Geom_ERect_Thoby (void *data, float *iocoord, int count);
     static void ModifyCoord_Perspective_Correction (void *data, float *iocoord, int count);
+    static void ModifyCoordRow_Perspective_Correction (
+        void *data, float x, float y, float step, float *res, int count);
+#ifdef VECTORIZATION_SSE
+    static void ModifyCoord_Perspective_Correction_SSE (void *data, float *iocoord, int count);
+    static void ModifyCoordRow_Perspective_Correction_SSE (
+        void *data, float x, float y, float step, float *res, int count);
+#endif
+#ifdef VECTORIZATION_SIMD128
+    static void ModifyCoord_Dist_Poly3_SIMD128 (void *data, float *iocoord, int count);
+    static void ModifyCoord_Dist_Poly5_SIMD128 (void *data, float *iocoord, int count);
+    static void ModifyCoord_Dist_PTLens_SIMD128 (void *data, float *iocoord, int count);
+    static void ModifyCoord_Perspective_Correction_SIMD128 (void *data, float *iocoord, int count);
+    static void ModifyCoordRow_Perspective_Correction_SIMD128 (
+        void *data, float x, float y, float step, float *res, int count);
+#endif
+    static void ModifyCoordJacobian_Scale (
+        void *data, float *iocoord, float *jacobian, int count);
+    static void ModifyCoordJacobian_UnDist_Poly3 (
+        void *data, float *iocoord, float *jacobian, int count);
+    static void ModifyCoordJacobian_Dist_Poly3 (
+        void *data, float *iocoord, float *jacobian, int count);
+    static void ModifyCoordJacobian_UnDist_Poly5 (
+        void *data, float *iocoord, float *jacobian, int count);
+    static void ModifyCoordJacobian_Dist_Poly5 (
+        void *data, float *iocoord, float *jacobian, int count);
+    static void ModifyCoordJacobian_UnDist_PTLens (
+        void *data, float *iocoord, float *jacobian, int count);
+    static void ModifyCoordJacobian_Dist_PTLens (
+        void *data, float *iocoord, float *jacobian, int count);
+    static void ModifyCoordJacobian_Dist_ACM (
+        void *data, float *iocoord, float *jacobian, int count);
+    static void ModifyCoordJacobian_Geom_FishEye_Rect (
+        void *data, float *iocoord, float *jacobian, int count);
+    static void ModifyCoordJacobian_Geom_Panoramic_Rect (
+        void *data, float *iocoord, float *jacobian, int count);
+    static void ModifyCoordJacobian_Geom_ERect_Rect (
+        void *data, float *iocoord, float *jacobian, int count);
+    static void ModifyCoordJacobian_Geom_Rect_FishEye (
+        void *data, float *iocoord, float *jacobian, int count);
+    static void ModifyCoordJacobian_Geom_Panoramic_FishEye (
+        void *data, float *iocoord, float *jacobian, int count);
+    static void ModifyCoordJacobian_Geom_ERect_FishEye (
+        void *data, float *iocoord, float *jacobian, int count);
+    static void ModifyCoordJacobian_Geom_Rect_Panoramic (
+        void *data, float *iocoord, float *jacobian, int count);
+    static void ModifyCoordJacobian_Geom_FishEye_Panoramic (
+        void *data, float *iocoord, float *jacobian, int count);
+    static void ModifyCoordJacobian_Geom_ERect_Panoramic (
+        void *data, float *iocoord, float *jacobian, int count);
+    static void ModifyCoordJacobian_Geom_Rect_ERect (
+        void *data, float *iocoord, float *jacobian, int count);
+    static void ModifyCoordJacobian_Geom_FishEye_ERect (
+        void *data, float *iocoord, float *jacobian, int count);
+    static void ModifyCoordJacobian_Geom_Panoramic_ERect (
+        void *data, float *iocoord, float *jacobian, int count);
+    static void ModifyCoordJacobian_Geom_Orthographic_ERect (
+        void *data, float *iocoord, float *jacobian, int count);
+    static void ModifyCoordJacobian_Geom_ERect_Orthographic (
+        void *data, float *iocoord, float *jacobian, int count);
+    static void ModifyCoordJacobian_Geom_Stereographic_ERect (
+        void *data, float *iocoord, float *jacobian, int count);
+    static void ModifyCoordJacobian_Geom_ERect_Stereographic (
+        void *data, float *iocoord, float *jacobian, int count);
+    static void ModifyCoordJacobian_Geom_Equisolid_ERect (
+        void *data, float *iocoord, float *jacobian, int count);
+    static void ModifyCoordJacobian_Geom_ERect_Equisolid (
+        void *data, float *iocoord, float *jacobian, int count);
+    static void ModifyCoordJacobian_Geom_Thoby_ERect (
+        void *data, float *iocoord, float *jacobian, int count);
+    static void ModifyCoordJacobian_Geom_ERect_Thoby (
+        void *data, float *iocoord, float *jacobian, int count);
+    static void ModifyCoordJacobian_Perspective_Correction (
+        void *data, float *iocoord, float *jacobian, int count);
+    static bool IsPerspectiveCallback (lfModifyCoordFunc callback);
+    /// Whether a stock callback maps every point to a point in the same
+    /// direction, at a distance which depends only on its own distance
+    static bool IsRadialCallback (lfModifyCoordFunc callback);
+    /// Replaces r by the distance which a radial callback maps to r; false
+    /// if there is none
+    static bool InvertRadialCallback (lfModifyCoordFunc callback, const void *data,
+                                      double &r);
+    /// The name of a stock callback for lfProfileCounters, or "custom"
+    static const char *ProfileName (const void *callback);
 #ifdef VECTORIZATION_SSE
     static void ModifyColor_DeVignetting_PA_SSE (
       void *data, float _x, float _y, lf_f32 *pixels, int comp_role, int count);
@@ -2320,6 +3495,12 @@ private:
     static void ModifyColor_DeVignetting_PA_SSE2 (
       void *data, float _x, float _y, lf_u16 *pixels, int comp_role, int count);
 #endif
+#ifdef VECTORIZATION_SIMD128
+    template<typename T> static void ModifyColor_Vignetting_PA_SIMD128 (
+      void *data, float _x, float _y, T *pixels, int comp_role, int count);
+    template<typename T> static void ModifyColor_DeVignetting_PA_SIMD128 (
+      void *data, float _x, float _y, T *pixels, int comp_role, int count);
+#endif
 
     template<typename T> static void ModifyColor_Vignetting_PA (
         void *data, float x, float y, T *rgb, int comp_role, int count);
@@ -2361,6 +3542,13 @@ private:
     double FocalLengthNormalized;
     /// Whether the transformations are applied reversely
     bool Reverse;
+    /// The pixel format the color callbacks were set up for
+    lfPixelFormat PixelFormat;
+    /// Whether ApplyImageResampling() works on packed subpixel coordinates,
+    /// see SetPackedResampling()
+    bool PackedResampling;
+    /// The format of the packed coordinates of ApplyImageResampling()
+    lfSubpixelFormat ResamplingFormat;
 };
 
 #ifdef __cplusplus
@@ -2386,6 +3574,23 @@ LF_EXPORT int lf_modifier_initialize (
 LF_EXPORT cbool lf_modifier_enable_perspective_correction (
     lfModifier *modifier, float *x, float *y, int count, float d);
 
+/** @sa lfModifier::SolvePerspectiveCorrection */
+LF_EXPORT cbool lf_modifier_solve_perspective_correction (
+    const lfModifier *modifier, float *x, float *y, int count,
+    lfPerspectivePlan *plan);
+
+/** @sa lfModifier::EnablePerspectiveCorrection(const lfPerspectivePlan &, float) */
+LF_EXPORT cbool lf_modifier_enable_perspective_correction_plan (
+    lfModifier *modifier, const lfPerspectivePlan *plan, float d);
+
+/** @sa lfModifier::SolvePerspectiveCorrections */
+LF_EXPORT int lf_modifier_solve_perspective_corrections (
+    lfPerspectiveTask *tasks, int count, int threads);
+
+/** @sa lfModifier::SetPerspectiveCorrectionStrength */
+LF_EXPORT cbool lf_modifier_set_perspective_correction_strength (
+    lfModifier *modifier, float d);
+
 /** @sa lfModifier::AddCoordCallback */
 LF_EXPORT void lf_modifier_add_coord_callback (
     lfModifier *modifier, lfModifyCoordFunc callback, int priority,
@@ -2426,6 +3631,10 @@ LF_EXPORT cbool lf_modifier_add_coord_callback_scale (
 LF_EXPORT float lf_modifier_get_auto_scale (
     lfModifier *modifier, cbool reverse);
 
+/** @sa lfModifier::GetValidCrop */
+LF_EXPORT cbool lf_modifier_get_valid_crop (
+    const lfModifier *modifier, float aspect, float *crop);
+
 /** @sa lfModifier::ApplySubpixelDistortion */
 LF_EXPORT cbool lf_modifier_apply_subpixel_distortion (
     lfModifier *modifier, float xu, float yu, int width, int height, float *res);
@@ -2439,10 +3648,77 @@ LF_EXPORT cbool lf_modifier_apply_color_modification (
 LF_EXPORT cbool lf_modifier_apply_geometry_distortion (
     lfModifier *modifier, float xu, float yu, int width, int height, float *res);
 
+/** @sa lfModifier::ApplyGeometryDistortionPoints */
+LF_EXPORT cbool lf_modifier_apply_geometry_distortion_points (
+    const lfModifier *modifier, const float *coord, float *res, int count,
+    cbool inverse, unsigned char *status);
+
+/** @sa lfModifier::ApplyGeometryDistortionJacobian */
+LF_EXPORT cbool lf_modifier_apply_geometry_distortion_jacobian (
+    const lfModifier *modifier, float xu, float yu, int width, int height,
+    float *res, float *jacobian, float step);
+
 /** @sa lfModifier::ApplySubpixelGeometryDistortion */
 LF_EXPORT cbool lf_modifier_apply_subpixel_geometry_distortion (
     lfModifier *modifier, float xu, float yu, int width, int height, float *res);
 
+/** @sa lfModifier::ApplySubpixelDistortionPacked */
+LF_EXPORT cbool lf_modifier_apply_subpixel_distortion_packed (
+    lfModifier *modifier, float xu, float yu, int width, int height,
+    lfSubpixelCoord *res, lfSubpixelFormat format);
+
+/** @sa lfModifier::ApplySubpixelGeometryDistortionPacked */
+LF_EXPORT cbool lf_modifier_apply_subpixel_geometry_distortion_packed (
+    lfModifier *modifier, float xu, float yu, int width, int height,
+    lfSubpixelCoord *res, lfSubpixelFormat format);
+
+/** @sa lfModifier::ApplyColorModificationParallel */
+LF_EXPORT cbool lf_modifier_apply_color_modification_parallel (
+    lfModifier *modifier, void *pixels, float x, float y, int width, int height,
+    int comp_role, int row_stride, int threads);
+
+/** @sa lfModifier::ApplyGeometryDistortionParallel */
+LF_EXPORT cbool lf_modifier_apply_geometry_distortion_parallel (
+    lfModifier *modifier, float xu, float yu, int width, int height, float *res,
+    int threads);
+
+/** @sa lfModifier::ApplySubpixelDistortionParallel */
+LF_EXPORT cbool lf_modifier_apply_subpixel_distortion_parallel (
+    lfModifier *modifier, float xu, float yu, int width, int height, float *res,
+    int threads);
+
+/** @sa lfModifier::ApplySubpixelGeometryDistortionParallel */
+LF_EXPORT cbool lf_modifier_apply_subpixel_geometry_distortion_parallel (
+    lfModifier *modifier, float xu, float yu, int width, int height, float *res,
+    int threads);
+
+/** @sa lfModifier::ApplyImageCorrection */
+LF_EXPORT cbool lf_modifier_apply_image_correction (
+    lfModifier *modifier, const void *src, int src_stride, void *dst, int dst_stride,
+    int width, int height, lfPixelFormat format, int components,
+    lfInterpolation interpolation, int threads);
+
+/** @sa lfModifier::ApplyImageResampling */
+LF_EXPORT cbool lf_modifier_apply_image_resampling (
+    lfModifier *modifier, const void *src, int src_stride, void *dst,
+    int dst_stride, int width, int height, lfPixelFormat format, int components,
+    lfInterpolation interpolation, int first_row, int row_count, int threads);
+
+/** @sa lfModifier::SetPackedResampling */
+LF_EXPORT void lf_modifier_set_packed_resampling (
+    lfModifier *modifier, cbool packed, lfSubpixelFormat format);
+
+/** @sa lfModifier::UnpackSubpixelCoords */
+LF_EXPORT void lf_subpixel_coords_unpack (
+    const lfSubpixelCoord *packed, int count, lfSubpixelFormat format,
+    float *res);
+
+/** @sa lfModifier::GetProfileCounters */
+LF_EXPORT int lf_modifier_get_profile_counters (lfProfileCounters *counters, int count);
+
+/** @sa lfModifier::ResetProfileCounters */
+LF_EXPORT void lf_modifier_reset_profile_counters ();
+
 /** @} */
 
 #undef cbool
@@ -7,6 +7,7 @@
 #define __LENSFUNPRV_H__
 
 #include <string.h>
+#include <atomic>
 #include <vector>
 
 #define MEMBER_OFFSET(s,f)   ((unsigned int)(char *)&((s *)0)->f)
@@ -62,6 +63,27 @@ template<typename T> static inline T clampd (double x, double min, double max)
     return static_cast<T> (x);
 }
 
+/**
+ * @brief Apply the chain rule for one more coordinate callback.
+ *
+ * Multiplies the Jacobian of the callbacks so far from the left with the
+ * derivative of the next one, see lfModifyCoordJacobianFunc.
+ * @param jacobian
+ *     The 2x2 matrix dx/du, dx/dv, dy/du, dy/dv, replaced by the product.
+ * @param xx, xy, yx, yy
+ *     The derivative dx'/dx, dx'/dy, dy'/dx, dy'/dy of the next callback.
+ */
+static inline void _lf_chain_jacobian (float *jacobian, double xx, double xy,
+                                       double yx, double yy)
+{
+    float j0 = jacobian [0], j1 = jacobian [1];
+    float j2 = jacobian [2], j3 = jacobian [3];
+    jacobian [0] = xx * j0 + xy * j2;
+    jacobian [1] = xx * j1 + xy * j3;
+    jacobian [2] = yx * j0 + yy * j2;
+    jacobian [3] = yx * j1 + yy * j3;
+}
+
 /**
  * @brief Free a list of pointers.
  * @param list
@@ -168,6 +190,170 @@ extern void _lf_addobj (void ***var, const void *val, size_t val_size,
  */
 extern bool _lf_delobj (void ***var, int idx);
 
+/// The largest number of value fields of a calibration table
+#define LF_CALIB_MAX_FIELDS 3
+
+/// One value field of a calibration table, see lfCalibTable::Field()
+struct lfCalibField
+{
+    /// The values of all records, or the dictionary if Index is set
+    const float *Values;
+    /// The dictionary entry of every record, or NULL
+    const unsigned char *Index;
+
+    float operator [] (int idx) const { return Index ? Values [Index [idx]] : Values [idx]; }
+};
+
+/**
+ * @brief Calibration records of one kind, packed field by field.
+ *
+ * This is what the Calib* fields of lfLens point to.  Each value field of
+ * the records (focal length, then aperture and distance or the like) has an
+ * array of its own, so that scans over the records read only the fields
+ * they need.  A field with few distinct values, like the apertures and
+ * distances of vignetting data, is kept as a dictionary of the values plus
+ * a byte per record.  The terms of a record take Stride floats, which is
+ * the number of terms of the largest model in the table; in the usual case
+ * of a single model this is exactly the number that model has.
+ *
+ * The arrays follow the header in one block of memory: the terms, the
+ * values and dictionaries of the fields, the dictionary entries and the
+ * models.
+ *
+ * Tables are shared between lens copies.  They are not changed any more
+ * once created: _lf_calib_table_add() and _lf_calib_table_del() replace a
+ * table by a new one.
+ */
+struct lfCalibTable
+{
+    /// A flag per record which the kind of calibration may use
+    enum { LF_CALIB_TABLE_FLAG = 0x80 };
+
+    /// The number of owners, see _lf_calib_table_ref()
+    std::atomic<int> Refs;
+    /// The number of records, at least 1
+    int Count;
+    /// The number of value fields per record
+    unsigned char Fields;
+    /// The number of terms per record
+    unsigned char Stride;
+    /// The size of the dictionary of every field, or 0 for plain values
+    unsigned char DictSize [LF_CALIB_MAX_FIELDS];
+
+    /// The terms of all records
+    const float *Terms () const { return (const float *)(this + 1); }
+    /// The terms of record idx
+    const float *RecordTerms (int idx) const { return Terms () + idx * Stride; }
+
+    /// The values of field f of all records
+    lfCalibField Field (int f) const
+    {
+        const float *values = Terms () + Count * Stride;
+        const unsigned char *index = IndexStart ();
+        for (int i = 0; i < f; i++)
+            if (DictSize [i])
+            {
+                values += DictSize [i];
+                index += Count;
+            }
+            else
+                values += Count;
+        lfCalibField field = { values, DictSize [f] ? index : NULL };
+        return field;
+    }
+
+    /// The model of every record
+    const unsigned char *Models () const
+    {
+        const unsigned char *index = IndexStart ();
+        for (int i = 0; i < Fields; i++)
+            if (DictSize [i])
+                index += Count;
+        return index;
+    }
+    /// The model of record idx, without the flag
+    int Model (int idx) const { return Models () [idx] & ~LF_CALIB_TABLE_FLAG; }
+    /// The flag of record idx
+    bool Flag (int idx) const { return (Models () [idx] & LF_CALIB_TABLE_FLAG) != 0; }
+
+private:
+    const unsigned char *IndexStart () const
+    {
+        const float *values = Terms () + Count * Stride;
+        for (int i = 0; i < Fields; i++)
+            values += DictSize [i] ? DictSize [i] : Count;
+        return (const unsigned char *)values;
+    }
+};
+
+/**
+ * @brief Add a record to a calibration table.
+ *
+ * If the table has a record whose first key_fields values equal those of
+ * the new record, it is replaced; otherwise the new record is appended.
+ * @param var
+ *     A pointer to a table, or to NULL.  It gets a new table, and the old
+ *     one loses a reference.
+ * @param model
+ *     The model of the record, with lfCalibTable::LF_CALIB_TABLE_FLAG if
+ *     the flag is set.
+ * @param values
+ *     The value fields of the record.
+ * @param fields
+ *     The number of value fields, up to LF_CALIB_MAX_FIELDS; the same for
+ *     all records of a table.
+ * @param key_fields
+ *     The number of value fields which identify a record.
+ * @param terms
+ *     The terms of the record.
+ * @param term_count
+ *     The number of terms of the model.
+ */
+extern void _lf_calib_table_add (lfCalibTable **var, int model, const float *values,
+    int fields, int key_fields, const float *terms, int term_count);
+
+/**
+ * @brief Remove a record from a calibration table.
+ * @param var
+ *     A pointer to a table, or to NULL.  It gets a new table, or NULL if
+ *     the last record was removed.
+ * @param idx
+ *     The index of the record to remove (zero-based).
+ * @return
+ *     false if idx is out of range.
+ */
+extern bool _lf_calib_table_del (lfCalibTable **var, int idx);
+
+/**
+ * @brief Take another reference to a calibration table.
+ *
+ * This is safe while other threads take or drop references to the same
+ * table.
+ * @param table
+ *     A table, or NULL.
+ * @return
+ *     table
+ */
+extern lfCalibTable *_lf_calib_table_ref (lfCalibTable *table);
+
+/**
+ * @brief Drop a reference to a calibration table, freeing it with the last
+ * one.
+ * @param table
+ *     A table, or NULL.
+ */
+extern void _lf_calib_table_free (lfCalibTable *table);
+
+#ifdef LF_SPLIT_MODULES
+/// Adds the callbacks of lfModifier::AddCoordCallbackGeometry() for
+/// lfModifier::Initialize() of the split build.  The projections side
+/// module sets it when it is loaded; until then, Initialize() leaves the
+/// geometry conversion out.  Other builds call AddCoordCallbackGeometry()
+/// directly, so that static links keep mod-geometry.o.
+extern bool (*_lf_add_coord_callback_geometry) (
+    lfModifier *modifier, lfLensType from, lfLensType to);
+#endif
+
 // /**
 //  * @brief Appends a formatted string to a dynamically-growing string
 //  * using g_markup_printf_escaped() internally.
@@ -367,14 +553,28 @@ enum
     LF_CPU_FLAG_SSE3            = 0x00000080,
     LF_CPU_FLAG_SSSE3           = 0x00000100,
     LF_CPU_FLAG_SSE4_1          = 0x00000200,
-    LF_CPU_FLAG_SSE4_2          = 0x00000400
+    LF_CPU_FLAG_SSE4_2          = 0x00000400,
+    LF_CPU_FLAG_AVX             = 0x00000800,
+    LF_CPU_FLAG_AVX2            = 0x00001000
 };
 
-// /**
-//  * @brief Detect supported CPU features (used for runtime selection of accelerated
-//  * functions for specific architecture extensions).
-//  */
-// extern guint _lf_detect_cpu_features ();
+/**
+ * @brief Detect supported CPU features (used for runtime selection of accelerated
+ * functions for specific architecture extensions).
+ */
+extern unsigned int _lf_detect_cpu_features ();
+
+/**
+ * @brief Restrict the detected CPU features to those in a mask.
+ *
+ * This lets the accuracy checks run the scalar fallbacks on a CPU which has
+ * the vectorized kernels.  Some callbacks pick their kernel when they are
+ * added, so set the mask before setting up the modifier.  A mask of ~0
+ * restores the detected features.
+ * @param mask
+ *     A combination of LF_CPU_FLAG_* values.
+ */
+extern void _lf_mask_cpu_features (unsigned int mask);
 
 // /**
 //  * @brief Google-in-your-pocket: a fuzzy string comparator.
@@ -449,6 +649,24 @@ struct lfSubpixelCallbackData : public lfCallbackData
 struct lfCoordCallbackData : public lfCallbackData
 {
     lfModifyCoordFunc callback;
+    /// Optional whole-row version of callback, see lfModifyCoordRowFunc
+    lfModifyCoordRowFunc row_callback;
+    /// Optional separable version of callback, see AddCoordTableCallback()
+    lfCoordColumnsFunc columns_callback;
+    lfCoordTableRowFunc table_row_callback;
+    /// Version of callback with its derivative, NULL for user callbacks
+    lfModifyCoordJacobianFunc jacobian_callback;
+};
+
+/// The per-column table of lfModifier::PrepareCoordColumns()
+struct lfCoordColumns
+{
+    /// The index of the coordinate callback which the table is for, or -1
+    int Index;
+    /// Two values per column
+    std::vector<float> Table;
+
+    lfCoordColumns () : Index (-1) { }
 };
 
 /// A single pixel color modifier callback.
@@ -457,12 +675,109 @@ struct lfColorCallbackData : public lfCallbackData
     lfModifyColorFunc callback;
 };
 
+/// Callback data of the perspective correction callback
+struct lfPerspectiveParams
+{
+    /// The homography terms which ModifyCoord_Perspective_Correction uses
+    float Terms [11];
+    /// The solution the terms were generated from
+    lfPerspectivePlan Plan;
+};
+
+// Profiling instrumentation, see lfModifier::GetProfileCounters().  Without
+// LF_PROFILING all of these expand to nothing.
+#ifdef LF_PROFILING
+
+#include <chrono>
+
+/// Adds one call of callback over pixels pixels, taking ns nanoseconds
+void _lf_profile_add_call (const void *callback, int pixels, unsigned long long ns);
+
+/// Newton iteration statistics which a kernel gathers during one call
+struct lfNewtonProfile
+{
+    unsigned long long Steps [LF_PROFILE_NEWTON_BINS];
+    unsigned long long Failures;
+
+    lfNewtonProfile () { memset (this, 0, sizeof (*this)); }
+    void Step (int step) { Steps [step < LF_PROFILE_NEWTON_BINS ? step : LF_PROFILE_NEWTON_BINS - 1]++; }
+};
+
+/// Adds the Newton statistics of one call of callback
+void _lf_profile_add_newton (const void *callback, const lfNewtonProfile &newton);
+
+/// Times the rest of the enclosing block as a call of a callback
+class lfProfileScope
+{
+public:
+    lfProfileScope (const void *callback, int pixels) :
+        Callback (callback), Pixels (pixels), Start (std::chrono::steady_clock::now ()) {}
+    ~lfProfileScope ()
+    {
+        _lf_profile_add_call (Callback, Pixels, std::chrono::duration_cast<std::chrono::nanoseconds> (
+            std::chrono::steady_clock::now () - Start).count ());
+    }
+
+private:
+    const void *Callback;
+    int Pixels;
+    std::chrono::steady_clock::time_point Start;
+};
+
+#define LF_PROFILE_CALLBACK(callback, pixels) \
+    lfProfileScope _lf_profile_scope ((const void *)(callback), pixels)
+#define LF_PROFILE_NEWTON_BEGIN() lfNewtonProfile _lf_newton
+#define LF_PROFILE_NEWTON_STEP(step) _lf_newton.Step (step)
+#define LF_PROFILE_NEWTON_FAIL() _lf_newton.Failures++
+#define LF_PROFILE_NEWTON_END(callback) \
+    _lf_profile_add_newton ((const void *)(callback), _lf_newton)
+// Vector helpers take the statistics of their caller as an extra argument
+// and count lanes by their bit masks
+#define LF_PROFILE_NEWTON_PARAM , lfNewtonProfile &_lf_newton
+#define LF_PROFILE_NEWTON_ARG , _lf_newton
+#define LF_PROFILE_NEWTON_LANES(step, mask) \
+    _lf_newton.Steps [step < LF_PROFILE_NEWTON_BINS ? step : LF_PROFILE_NEWTON_BINS - 1] += \
+        __builtin_popcount (mask)
+#define LF_PROFILE_NEWTON_FAIL_LANES(mask) _lf_newton.Failures += __builtin_popcount (mask)
+
+#else
+
+#define LF_PROFILE_CALLBACK(callback, pixels)
+#define LF_PROFILE_NEWTON_BEGIN()
+#define LF_PROFILE_NEWTON_STEP(step)
+#define LF_PROFILE_NEWTON_FAIL()
+#define LF_PROFILE_NEWTON_END(callback)
+#define LF_PROFILE_NEWTON_PARAM
+#define LF_PROFILE_NEWTON_ARG
+#define LF_PROFILE_NEWTON_LANES(step, mask)
+#define LF_PROFILE_NEWTON_FAIL_LANES(mask)
+
+#endif
+
 // `dvector`, `matrix`, and `svg` are declared here to be able to test `svd` in
-// unit tests.
+// unit tests.  They have a fixed size and live on the stack, so that solving
+// the perspective correction for a set of control points doesn't allocate.
 
-typedef std::vector<double> dvector;
-typedef std::vector<dvector> matrix;
+template<int N> struct dvector
+{
+    double data [N];
+
+    double &operator [] (int i) { return data [i]; }
+    const double &operator [] (int i) const { return data [i]; }
+    static int size () { return N; }
+};
+
+template<int Rows, int Cols> struct matrix
+{
+    dvector<Cols> rows [Rows];
+
+    dvector<Cols> &operator [] (int i) { return rows [i]; }
+    const dvector<Cols> &operator [] (int i) const { return rows [i]; }
+};
 
-dvector svd (matrix M);
+/// Stores the right singular vector of M for the smallest singular value in
+/// result.  Returns false if the iterations did not converge.  Rows must not
+/// be larger than N.  Instantiated for the 5×6 ellipse fit.
+template<int Rows, int N> bool svd (const matrix<Rows, N> &M, dvector<N> &result);
 
 #endif /* __LENSFUNPRV_H__ */
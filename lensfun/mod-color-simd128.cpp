@@ -0,0 +1,232 @@
+/*
+    WebAssembly SIMD128 versions of the vignetting callbacks, for the 8 and
+    16 bit integer and the float pixel formats
+*/
+
+#include "config.h"
+
+#ifdef VECTORIZATION_SIMD128
+
+#include "lensfun.h"
+#include "lensfunprv.h"
+#include <wasm_simd128.h>
+#include <math.h>
+
+// Computes the vignetting factors c of four consecutive pixels, starting at
+// the pixel at x.  Like in the scalar version, r^2 is computed from the pixel
+// position directly, so that rounding errors do not build up along the row.
+static inline v128_t vignetting_factor (const float *param, v128_t x, float y)
+{
+    v128_t r2 = wasm_f32x4_add (wasm_f32x4_mul (x, x), wasm_f32x4_splat (y * y));
+    v128_t r4 = wasm_f32x4_mul (r2, r2);
+    v128_t r6 = wasm_f32x4_mul (r4, r2);
+    return wasm_f32x4_add (
+        wasm_f32x4_add (wasm_f32x4_splat (1.0f),
+                        wasm_f32x4_mul (wasm_f32x4_splat (param [0]), r2)),
+        wasm_f32x4_add (wasm_f32x4_mul (wasm_f32x4_splat (param [1]), r4),
+                        wasm_f32x4_mul (wasm_f32x4_splat (param [2]), r6)));
+}
+
+// Spreads the factors c of four RGB or RGBA pixels over the vectors which
+// hold their components; alpha channels get the factor one.  Returns the
+// number of vectors.
+static inline int spread_factors (v128_t c, v128_t one, bool alpha, v128_t *m)
+{
+    if (alpha)
+    {
+        m [0] = wasm_i32x4_shuffle (c, one, 0, 0, 0, 4);
+        m [1] = wasm_i32x4_shuffle (c, one, 1, 1, 1, 4);
+        m [2] = wasm_i32x4_shuffle (c, one, 2, 2, 2, 4);
+        m [3] = wasm_i32x4_shuffle (c, one, 3, 3, 3, 4);
+        return 4;
+    }
+
+    m [0] = wasm_i32x4_shuffle (c, c, 0, 0, 0, 1);
+    m [1] = wasm_i32x4_shuffle (c, c, 1, 1, 2, 2);
+    m [2] = wasm_i32x4_shuffle (c, c, 2, 3, 3, 3);
+    return 3;
+}
+
+// Multiplies four RGB or RGBA pixels with their factors c, and clamps
+// negative results to zero like the scalar version does.  Alpha channels are
+// left alone.
+static inline void apply_factors (lf_f32 *pixels, v128_t c, bool alpha)
+{
+    const v128_t zero = alpha ? wasm_f32x4_make (0.0f, 0.0f, 0.0f, -HUGE_VALF) :
+                                wasm_f32x4_splat (0.0f);
+    v128_t m [4];
+    int vectors = spread_factors (c, wasm_f32x4_splat (1.0f), alpha, m);
+
+    for (int i = 0; i < vectors; i++)
+    {
+        v128_t p = wasm_f32x4_mul (wasm_v128_load (pixels + 4 * i), m [i]);
+        wasm_v128_store (pixels + 4 * i, wasm_f32x4_max (p, zero));
+    }
+}
+
+// The integer formats use the fixed point math of apply_multiplier (): the
+// factors are scaled by 2^bits, truncated and limited to max, and the
+// products are rounded back.  Negative factors give zero there, so they are
+// raised to zero here, which keeps the products between 0 and 2^31.
+static inline v128_t fixed_factors (v128_t c, int bits, int max)
+{
+    v128_t f = wasm_i32x4_trunc_sat_f32x4 (
+        wasm_f32x4_mul (c, wasm_f32x4_splat (float (1 << bits))));
+    return wasm_i32x4_min (wasm_i32x4_max (f, wasm_i32x4_splat (0)), wasm_i32x4_splat (max));
+}
+
+static inline v128_t fixed_multiply (v128_t p, v128_t m, int bits)
+{
+    return wasm_i32x4_shr (
+        wasm_i32x4_add (wasm_i32x4_mul (p, m), wasm_i32x4_splat (1 << (bits - 1))), bits);
+}
+
+// 8 bit pixels in 20.12 fixed point.  Four RGB pixels are 12 bytes, which are
+// loaded and stored in two parts so that nothing after them is touched.  The
+// saturating narrowing clamps to 0..255 like clampbits () does.
+static inline void apply_factors (lf_u8 *pixels, v128_t c, bool alpha)
+{
+    v128_t m [4];
+    int vectors = spread_factors (fixed_factors (c, 12, 2047 << 12),
+                                  wasm_i32x4_splat (1 << 12), alpha, m);
+
+    v128_t p = alpha ? wasm_v128_load (pixels) :
+        wasm_v128_load32_lane (pixels + 8, wasm_v128_load64_zero (pixels), 2);
+    v128_t lo = wasm_u16x8_extend_low_u8x16 (p);
+    v128_t hi = wasm_u16x8_extend_high_u8x16 (p);
+    v128_t v [4] =
+    {
+        wasm_u32x4_extend_low_u16x8 (lo), wasm_u32x4_extend_high_u16x8 (lo),
+        wasm_u32x4_extend_low_u16x8 (hi), wasm_u32x4_extend_high_u16x8 (hi)
+    };
+    for (int i = 0; i < vectors; i++)
+        v [i] = fixed_multiply (v [i], m [i], 12);
+
+    p = wasm_u8x16_narrow_i16x8 (wasm_i16x8_narrow_i32x4 (v [0], v [1]),
+                                 wasm_i16x8_narrow_i32x4 (v [2], v [3]));
+    if (alpha)
+        wasm_v128_store (pixels, p);
+    else
+    {
+        wasm_v128_store64_lane (pixels, p, 0);
+        wasm_v128_store32_lane (pixels + 8, p, 2);
+    }
+}
+
+// 16 bit pixels in 22.10 fixed point, clamped to 0..65535 by the narrowing
+static inline void apply_factors (lf_u16 *pixels, v128_t c, bool alpha)
+{
+    v128_t m [4];
+    int vectors = spread_factors (fixed_factors (c, 10, 31 << 10),
+                                  wasm_i32x4_splat (1 << 10), alpha, m);
+
+    v128_t p0 = wasm_v128_load (pixels);
+    v128_t p1 = alpha ? wasm_v128_load (pixels + 8) : wasm_v128_load64_zero (pixels + 8);
+    v128_t v [4] =
+    {
+        wasm_u32x4_extend_low_u16x8 (p0), wasm_u32x4_extend_high_u16x8 (p0),
+        wasm_u32x4_extend_low_u16x8 (p1), wasm_u32x4_extend_high_u16x8 (p1)
+    };
+    for (int i = 0; i < vectors; i++)
+        v [i] = fixed_multiply (v [i], m [i], 10);
+
+    wasm_v128_store (pixels, wasm_u16x8_narrow_i32x4 (v [0], v [1]));
+    p1 = wasm_u16x8_narrow_i32x4 (v [2], v [3]);
+    if (alpha)
+        wasm_v128_store (pixels + 8, p1);
+    else
+        wasm_v128_store64_lane (pixels + 8, p1, 0);
+}
+
+static inline bool simd_comp_role (int comp_role, bool &alpha)
+{
+    if (comp_role == LF_CR_3 (RED, GREEN, BLUE))
+        alpha = false;
+    else if (comp_role == LF_CR_4 (RED, GREEN, BLUE, UNKNOWN))
+        alpha = true;
+    else
+        return false;
+    return true;
+}
+
+template<typename T> void lfModifier::ModifyColor_Vignetting_PA_SIMD128 (
+    void *data, float _x, float _y, T *pixels, int comp_role, int count)
+{
+    bool alpha;
+    if (!simd_comp_role (comp_role, alpha))
+    {
+        ModifyColor_Vignetting_PA<T> (data, _x, _y, pixels, comp_role, count);
+        return;
+    }
+
+    const float *param = (float *)data;
+    const float x = _x * param [4], y = _y * param [4];
+    const v128_t x0 = wasm_f32x4_splat (x);
+    const v128_t step = wasm_f32x4_splat (param [3]);
+    const v128_t four = wasm_f32x4_splat (4.0f);
+    // Pixel indices are exact in float, so every pixel position is computed
+    // from the row start and rounding errors do not build up along the row
+    v128_t idx = wasm_f32x4_make (0.0f, 1.0f, 2.0f, 3.0f);
+    const int components = alpha ? 4 : 3;
+
+    int i;
+    for (i = 0; i + 4 <= count; i += 4, idx = wasm_f32x4_add (idx, four))
+    {
+        v128_t xs = wasm_f32x4_add (x0, wasm_f32x4_mul (idx, step));
+        apply_factors (pixels, vignetting_factor (param, xs, y), alpha);
+        pixels += 4 * components;
+    }
+
+    if (i < count)
+        ModifyColor_Vignetting_PA<T> (
+            data, _x + i * param [3] / param [4], _y, pixels, comp_role, count - i);
+}
+
+template<typename T> void lfModifier::ModifyColor_DeVignetting_PA_SIMD128 (
+    void *data, float _x, float _y, T *pixels, int comp_role, int count)
+{
+    bool alpha;
+    if (!simd_comp_role (comp_role, alpha))
+    {
+        ModifyColor_DeVignetting_PA<T> (data, _x, _y, pixels, comp_role, count);
+        return;
+    }
+
+    const float *param = (float *)data;
+    const float x = _x * param [4], y = _y * param [4];
+    const v128_t one = wasm_f32x4_splat (1.0f);
+    const v128_t x0 = wasm_f32x4_splat (x);
+    const v128_t step = wasm_f32x4_splat (param [3]);
+    const v128_t four = wasm_f32x4_splat (4.0f);
+    // Pixel indices are exact in float, so every pixel position is computed
+    // from the row start and rounding errors do not build up along the row
+    v128_t idx = wasm_f32x4_make (0.0f, 1.0f, 2.0f, 3.0f);
+    const int components = alpha ? 4 : 3;
+
+    int i;
+    for (i = 0; i + 4 <= count; i += 4, idx = wasm_f32x4_add (idx, four))
+    {
+        v128_t xs = wasm_f32x4_add (x0, wasm_f32x4_mul (idx, step));
+        apply_factors (pixels, wasm_f32x4_div (one, vignetting_factor (param, xs, y)), alpha);
+        pixels += 4 * components;
+    }
+
+    if (i < count)
+        ModifyColor_DeVignetting_PA<T> (
+            data, _x + i * param [3] / param [4], _y, pixels, comp_role, count - i);
+}
+
+template void lfModifier::ModifyColor_Vignetting_PA_SIMD128<lf_u8> (
+    void *data, float _x, float _y, lf_u8 *pixels, int comp_role, int count);
+template void lfModifier::ModifyColor_DeVignetting_PA_SIMD128<lf_u8> (
+    void *data, float _x, float _y, lf_u8 *pixels, int comp_role, int count);
+template void lfModifier::ModifyColor_Vignetting_PA_SIMD128<lf_u16> (
+    void *data, float _x, float _y, lf_u16 *pixels, int comp_role, int count);
+template void lfModifier::ModifyColor_DeVignetting_PA_SIMD128<lf_u16> (
+    void *data, float _x, float _y, lf_u16 *pixels, int comp_role, int count);
+template void lfModifier::ModifyColor_Vignetting_PA_SIMD128<lf_f32> (
+    void *data, float _x, float _y, lf_f32 *pixels, int comp_role, int count);
+template void lfModifier::ModifyColor_DeVignetting_PA_SIMD128<lf_f32> (
+    void *data, float _x, float _y, lf_f32 *pixels, int comp_role, int count);
+
+#endif
@@ -47,11 +47,19 @@ bool lfModifier::AddColorCallbackVignetting (
                 switch (format)
                 {
                     case LF_PF_U8:
+#ifdef VECTORIZATION_SIMD128
+                        ADD_CALLBACK (ModifyColor_Vignetting_PA_SIMD128, lf_u8, 250);
+#else
                         ADD_CALLBACK (ModifyColor_Vignetting_PA, lf_u8, 250);
+#endif
                         break;
 
                     case LF_PF_U16:
+#ifdef VECTORIZATION_SIMD128
+                        ADD_CALLBACK (ModifyColor_Vignetting_PA_SIMD128, lf_u16, 250);
+#else
                         ADD_CALLBACK (ModifyColor_Vignetting_PA, lf_u16, 250);
+#endif
                         break;
 
                     case LF_PF_U32:
@@ -59,7 +67,11 @@ bool lfModifier::AddColorCallbackVignetting (
                         break;
 
                     case LF_PF_F32:
+#ifdef VECTORIZATION_SIMD128
+                        ADD_CALLBACK (ModifyColor_Vignetting_PA_SIMD128, lf_f32, 250);
+#else
                         ADD_CALLBACK (ModifyColor_Vignetting_PA, lf_f32, 250);
+#endif
                         break;
 
                     case LF_PF_F64:
@@ -82,11 +94,19 @@ bool lfModifier::AddColorCallbackVignetting (
                 switch (format)
                 {
                     case LF_PF_U8:
+#ifdef VECTORIZATION_SIMD128
+                        ADD_CALLBACK (ModifyColor_DeVignetting_PA_SIMD128, lf_u8, 750);
+#else
                         ADD_CALLBACK (ModifyColor_DeVignetting_PA, lf_u8, 750);
+#endif
                         break;
 
                     case LF_PF_U16:
+#ifdef VECTORIZATION_SIMD128
+                        ADD_CALLBACK (ModifyColor_DeVignetting_PA_SIMD128, lf_u16, 750);
+#else
                         ADD_CALLBACK (ModifyColor_DeVignetting_PA, lf_u16, 750);
+#endif
                         break;
 
                     case LF_PF_U32:
@@ -94,7 +114,11 @@ bool lfModifier::AddColorCallbackVignetting (
                         break;
 
                     case LF_PF_F32:
+#ifdef VECTORIZATION_SIMD128
+                        ADD_CALLBACK (ModifyColor_DeVignetting_PA_SIMD128, lf_f32, 750);
+#else
                         ADD_CALLBACK (ModifyColor_DeVignetting_PA, lf_f32, 750);
+#endif
                         break;
 
                     case LF_PF_F64:
@@ -112,6 +136,7 @@ bool lfModifier::AddColorCallbackVignetting (
 
 #undef ADD_CALLBACK
 
+    PixelFormat = format;
     return true;
 }
 
@@ -123,14 +148,17 @@ bool lfModifier::ApplyColorModification (
         return false; // nothing to do
 
     x = x * NormScale - CenterX;
-    y = y * NormScale - CenterY;
 
-    for (; height; y += NormScale, height--)
+    // Every row starts from its own pixel coordinate rather than adding up
+    // steps, so a block gives the same result however it is split in bands
+    for (int row = 0; row < height; row++)
     {
+        float yn = (y + row) * NormScale - CenterY;
         for (int i = 0; i < callbacks->size(); i++)
         {
             lfColorCallbackData *cd = (lfColorCallbackData*)callbacks->at(i);
-            cd->callback (cd->data, x, y, pixels, comp_role, width);
+            LF_PROFILE_CALLBACK (cd->callback, width);
+            cd->callback (cd->data, x, yn, pixels, comp_role, width);
         }
         pixels = ((char *)pixels) + row_stride;
     }
@@ -258,19 +286,16 @@ template<typename T> void lfModifier::ModifyColor_Vignetting_PA (
     x *= param [4];
     y *= param [4];
 
-    // For faster computation we will compute r^2 here, and
-    // further compute just the delta:
-    // ((x+1)*(x+1)+y*y) - (x*x + y*y) = 2 * x + 1
-    // But since we work in a normalized coordinate system, a step of
-    // 1.0 pixels should be multiplied by NormScale, so it's really:
-    // ((x+ns)*(x+ns)+y*y) - (x*x + y*y) = 2 * ns * x + ns^2
-    float r2 = x * x + y * y;
-    float d1 = 2.0 * param [3];
-    float d2 = param [3] * param [3];
+    // r^2 is computed from the pixel position for every pixel.  Adding up
+    // the delta 2 * ns * x + ns^2 along the row saves a multiplication, but
+    // its rounding errors build up over wide rows.
+    float y2 = y * y;
 
     int cr = 0;
-    while (count--)
+    for (int i = 0; i < count; i++)
     {
+        float xi = x + i * param [3];
+        float r2 = xi * xi + y2;
         float r4 = r2 * r2;
         float r6 = r4 * r2;
         float c = 1.0 + param [0] * r2 + param [1] * r4 + param [2] * r6;
@@ -278,9 +303,6 @@ template<typename T> void lfModifier::ModifyColor_Vignetting_PA (
             cr = comp_role;
 
         pixels = apply_multiplier<T> (pixels, c, cr);
-
-        r2 += d1 * x + d2;
-        x += param [3];
     }
 }
 
@@ -292,19 +314,16 @@ template<typename T> void lfModifier::ModifyColor_DeVignetting_PA (
     x *= param [4];
     y *= param [4];
 
-    // For faster computation we will compute r^2 here, and
-    // further compute just the delta:
-    // ((x+1)*(x+1)+y*y) - (x*x + y*y) = 2 * x + 1
-    // But since we work in a normalized coordinate system, a step of
-    // 1.0 pixels should be multiplied by NormScale, so it's really:
-    // ((x+ns)*(x+ns)+y*y) - (x*x + y*y) = 2 * ns * x + ns^2
-    float r2 = x * x + y * y;
-    float d1 = 2.0 * param [3];
-    float d2 = param [3] * param [3];
+    // r^2 is computed from the pixel position for every pixel.  Adding up
+    // the delta 2 * ns * x + ns^2 along the row saves a multiplication, but
+    // its rounding errors build up over wide rows.
+    float y2 = y * y;
 
     int cr = 0;
-    while (count--)
+    for (int i = 0; i < count; i++)
     {
+        float xi = x + i * param [3];
+        float r2 = xi * xi + y2;
         float r4 = r2 * r2;
         float r6 = r4 * r2;
         float c = 1.0 + param [0] * r2 + param [1] * r4 + param [2] * r6;
@@ -312,12 +331,23 @@ template<typename T> void lfModifier::ModifyColor_DeVignetting_PA (
             cr = comp_role;
 
         pixels = apply_multiplier<T> (pixels, 1.0f / c, cr);
-
-        r2 += d1 * x + d2;
-        x += param [3];
     }
 }
 
+// The SIMD128 callbacks fall back to these for other pixel layouts
+template void lfModifier::ModifyColor_Vignetting_PA<lf_u8> (
+    void *data, float x, float y, lf_u8 *pixels, int comp_role, int count);
+template void lfModifier::ModifyColor_DeVignetting_PA<lf_u8> (
+    void *data, float x, float y, lf_u8 *pixels, int comp_role, int count);
+template void lfModifier::ModifyColor_Vignetting_PA<lf_u16> (
+    void *data, float x, float y, lf_u16 *pixels, int comp_role, int count);
+template void lfModifier::ModifyColor_DeVignetting_PA<lf_u16> (
+    void *data, float x, float y, lf_u16 *pixels, int comp_role, int count);
+template void lfModifier::ModifyColor_Vignetting_PA<lf_f32> (
+    void *data, float x, float y, lf_f32 *pixels, int comp_role, int count);
+template void lfModifier::ModifyColor_DeVignetting_PA<lf_f32> (
+    void *data, float x, float y, lf_f32 *pixels, int comp_role, int count);
+
 //---------------------------// The C interface //---------------------------//
 
 void lf_modifier_add_color_callback (
@@ -0,0 +1,105 @@
+/*
+    WebAssembly SIMD128 versions of the distortion callbacks
+*/
+
+#include "config.h"
+
+#ifdef VECTORIZATION_SIMD128
+
+#include "lensfun.h"
+#include "lensfunprv.h"
+#include <wasm_simd128.h>
+
+// A vector holds the coordinates of two pixels as (x0, y0, x1, y1).  The
+// squared radius is summed up by adding the squares with their pair
+// neighbours, which leaves it in both lanes of the pixel.  So, the radial
+// factor can be applied without deinterleaving.
+static inline v128_t radius2 (v128_t c)
+{
+    v128_t sq = wasm_f32x4_mul (c, c);
+    return wasm_f32x4_add (sq, wasm_i32x4_shuffle (sq, sq, 1, 0, 3, 2));
+}
+
+void lfModifier::ModifyCoord_Dist_Poly3_SIMD128 (void *data, float *iocoord, int count)
+{
+    // See "Note about PT-based distortion models" in mod-coord.cpp.
+    // Rd = Ru * (1 + k1_ * Ru^2)
+    const v128_t k1_ = wasm_f32x4_splat (*(float *)data);
+    const v128_t one = wasm_f32x4_splat (1.0f);
+
+    for (; count >= 4; count -= 4, iocoord += 8)
+    {
+        v128_t c0 = wasm_v128_load (iocoord);
+        v128_t c1 = wasm_v128_load (iocoord + 4);
+        v128_t poly2_0 = wasm_f32x4_add (one, wasm_f32x4_mul (k1_, radius2 (c0)));
+        v128_t poly2_1 = wasm_f32x4_add (one, wasm_f32x4_mul (k1_, radius2 (c1)));
+        wasm_v128_store (iocoord, wasm_f32x4_mul (c0, poly2_0));
+        wasm_v128_store (iocoord + 4, wasm_f32x4_mul (c1, poly2_1));
+    }
+
+    if (count)
+        ModifyCoord_Dist_Poly3 (data, iocoord, count);
+}
+
+void lfModifier::ModifyCoord_Dist_Poly5_SIMD128 (void *data, float *iocoord, int count)
+{
+    // Rd = Ru * (1 + k1 * Ru^2 + k2 * Ru^4)
+    const float *param = (float *)data;
+    const v128_t k1 = wasm_f32x4_splat (param [0]);
+    const v128_t k2 = wasm_f32x4_splat (param [1]);
+    const v128_t one = wasm_f32x4_splat (1.0f);
+
+    for (; count >= 4; count -= 4, iocoord += 8)
+    {
+        v128_t c0 = wasm_v128_load (iocoord);
+        v128_t c1 = wasm_v128_load (iocoord + 4);
+        v128_t ru2_0 = radius2 (c0);
+        v128_t ru2_1 = radius2 (c1);
+        v128_t poly4_0 = wasm_f32x4_add (
+            wasm_f32x4_add (one, wasm_f32x4_mul (k1, ru2_0)),
+            wasm_f32x4_mul (k2, wasm_f32x4_mul (ru2_0, ru2_0)));
+        v128_t poly4_1 = wasm_f32x4_add (
+            wasm_f32x4_add (one, wasm_f32x4_mul (k1, ru2_1)),
+            wasm_f32x4_mul (k2, wasm_f32x4_mul (ru2_1, ru2_1)));
+        wasm_v128_store (iocoord, wasm_f32x4_mul (c0, poly4_0));
+        wasm_v128_store (iocoord + 4, wasm_f32x4_mul (c1, poly4_1));
+    }
+
+    if (count)
+        ModifyCoord_Dist_Poly5 (data, iocoord, count);
+}
+
+static inline v128_t ptlens_factor (v128_t ru2, v128_t a_, v128_t b_, v128_t c_, v128_t one)
+{
+    // a_ * Ru^3 + b_ * Ru^2 + c_ * Ru + 1
+    v128_t r = wasm_f32x4_sqrt (ru2);
+    return wasm_f32x4_add (
+        wasm_f32x4_add (wasm_f32x4_mul (wasm_f32x4_mul (a_, ru2), r),
+                        wasm_f32x4_mul (b_, ru2)),
+        wasm_f32x4_add (wasm_f32x4_mul (c_, r), one));
+}
+
+void lfModifier::ModifyCoord_Dist_PTLens_SIMD128 (void *data, float *iocoord, int count)
+{
+    // See "Note about PT-based distortion models" in mod-coord.cpp.
+    const float *param = (float *)data;
+    const v128_t a_ = wasm_f32x4_splat (param [0]);
+    const v128_t b_ = wasm_f32x4_splat (param [1]);
+    const v128_t c_ = wasm_f32x4_splat (param [2]);
+    const v128_t one = wasm_f32x4_splat (1.0f);
+
+    for (; count >= 4; count -= 4, iocoord += 8)
+    {
+        v128_t c0 = wasm_v128_load (iocoord);
+        v128_t c1 = wasm_v128_load (iocoord + 4);
+        wasm_v128_store (iocoord, wasm_f32x4_mul (
+            c0, ptlens_factor (radius2 (c0), a_, b_, c_, one)));
+        wasm_v128_store (iocoord + 4, wasm_f32x4_mul (
+            c1, ptlens_factor (radius2 (c1), a_, b_, c_, one)));
+    }
+
+    if (count)
+        ModifyCoord_Dist_PTLens (data, iocoord, count);
+}
+
+#endif
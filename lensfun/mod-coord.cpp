@@ -29,6 +29,7 @@
 #include "lensfun.h"
 #include "lensfunprv.h"
 #include <math.h>
+#include <algorithm>
 #include "windows/mathconstants.h"
 
 void lfModifier::AddCoordCallback (
@@ -39,6 +40,50 @@ void lfModifier::AddCoordCallback (
     AddCallback (CoordCallbacks, d, priority, data, data_size);
 }
 
+void lfModifier::AddCoordCallback (
+    lfModifyCoordFunc callback, lfModifyCoordJacobianFunc jacobian_callback,
+    int priority, void *data, size_t data_size)
+{
+    lfCoordCallbackData *d = new lfCoordCallbackData ();
+    d->callback = callback;
+    d->jacobian_callback = jacobian_callback;
+    AddCallback (CoordCallbacks, d, priority, data, data_size);
+}
+
+void lfModifier::AddCoordRowCallback (
+    lfModifyCoordFunc callback, lfModifyCoordRowFunc row_callback,
+    lfModifyCoordJacobianFunc jacobian_callback, int priority,
+    void *data, size_t data_size)
+{
+    lfCoordCallbackData *d = new lfCoordCallbackData ();
+    d->callback = callback;
+    d->row_callback = row_callback;
+    d->jacobian_callback = jacobian_callback;
+    AddCallback (CoordCallbacks, d, priority, data, data_size);
+}
+
+void lfModifier::AddCoordTableCallback (
+    lfModifyCoordFunc callback, lfCoordColumnsFunc columns_callback,
+    lfCoordTableRowFunc table_row_callback,
+    lfModifyCoordJacobianFunc jacobian_callback, int priority, void *data,
+    size_t data_size)
+{
+    lfCoordCallbackData *d = new lfCoordCallbackData ();
+    d->callback = callback;
+    d->columns_callback = columns_callback;
+    d->table_row_callback = table_row_callback;
+    d->jacobian_callback = jacobian_callback;
+    AddCallback (CoordCallbacks, d, priority, data, data_size);
+}
+
+// The WebAssembly SIMD128 build has vectorized versions of the forward
+// distortion callbacks
+#ifdef VECTORIZATION_SIMD128
+#define DIST_KERNEL(func) func##_SIMD128
+#else
+#define DIST_KERNEL(func) func
+#endif
+
 bool lfModifier::AddCoordCallbackDistortion (lfLensCalibDistortion &model, bool reverse)
 {
     float tmp [7];
@@ -52,12 +97,14 @@ bool lfModifier::AddCoordCallbackDistortion (lfLensCalibDistortion &model, bool
                 // See "Note about PT-based distortion models" at the top of
                 // this file.
                 tmp [0] = pow (1 - model.Terms [0], 3) / model.Terms [0];
-                AddCoordCallback (ModifyCoord_UnDist_Poly3, 250,
+                AddCoordCallback (ModifyCoord_UnDist_Poly3,
+                                  ModifyCoordJacobian_UnDist_Poly3, 250,
                                   tmp, sizeof (float));
                 break;
 
             case LF_DIST_MODEL_POLY5:
-                AddCoordCallback (ModifyCoord_UnDist_Poly5, 250,
+                AddCoordCallback (ModifyCoord_UnDist_Poly5,
+                                  ModifyCoordJacobian_UnDist_Poly5, 250,
                                   model.Terms, sizeof (float) * 2);
                 break;
 
@@ -69,7 +116,8 @@ bool lfModifier::AddCoordCallbackDistortion (lfLensCalibDistortion &model, bool
                 tmp [0] = model.Terms [0] / pow (d, 4);
                 tmp [1] = model.Terms [1] / pow (d, 3);
                 tmp [2] = model.Terms [2] / pow (d, 2);
-                AddCoordCallback (ModifyCoord_UnDist_PTLens, 250,
+                AddCoordCallback (ModifyCoord_UnDist_PTLens,
+                                  ModifyCoordJacobian_UnDist_PTLens, 250,
                                   tmp, sizeof (float) * 3);
                 break;
             }
@@ -86,12 +134,14 @@ bool lfModifier::AddCoordCallbackDistortion (lfLensCalibDistortion &model, bool
                 // See "Note about PT-based distortion models" at the top of
                 // this file.
                 tmp [0] = model.Terms [0] / pow (1 - model.Terms [0], 3);
-                AddCoordCallback (ModifyCoord_Dist_Poly3, 750,
+                AddCoordCallback (DIST_KERNEL (ModifyCoord_Dist_Poly3),
+                                  ModifyCoordJacobian_Dist_Poly3, 750,
                                   tmp, sizeof (float));
                 break;
 
             case LF_DIST_MODEL_POLY5:
-                AddCoordCallback (ModifyCoord_Dist_Poly5, 750,
+                AddCoordCallback (DIST_KERNEL (ModifyCoord_Dist_Poly5),
+                                  ModifyCoordJacobian_Dist_Poly5, 750,
                                   model.Terms, sizeof (float) * 2);
                 break;
 
@@ -103,7 +153,8 @@ bool lfModifier::AddCoordCallbackDistortion (lfLensCalibDistortion &model, bool
                 tmp [0] = model.Terms [0] / pow (d, 4);
                 tmp [1] = model.Terms [1] / pow (d, 3);
                 tmp [2] = model.Terms [2] / pow (d, 2);
-                AddCoordCallback (ModifyCoord_Dist_PTLens, 750,
+                AddCoordCallback (DIST_KERNEL (ModifyCoord_Dist_PTLens),
+                                  ModifyCoordJacobian_Dist_PTLens, 750,
                                   tmp, sizeof (float) * 3);
                 break;
             }
@@ -111,7 +162,7 @@ bool lfModifier::AddCoordCallbackDistortion (lfLensCalibDistortion &model, bool
                 memcpy (tmp, model.Terms, sizeof (float) * 5);
                 tmp [5] = 1 / FocalLengthNormalized;
                 tmp [6] = FocalLengthNormalized;
-                AddCoordCallback (ModifyCoord_Dist_ACM, 750,
+                AddCoordCallback (ModifyCoord_Dist_ACM, ModifyCoordJacobian_Dist_ACM, 750,
                                   tmp, sizeof (float) * 7);
                 break;
 
@@ -122,6 +173,32 @@ bool lfModifier::AddCoordCallbackDistortion (lfLensCalibDistortion &model, bool
     return true;
 }
 
+// The number of distances from the centre at which GetAutoScale() samples
+// the edge if all callbacks are radial, and the number of golden section
+// steps which refine the highest sample
+#define AUTOSCALE_RADIAL_SAMPLES 8
+#define AUTOSCALE_RADIAL_ROUNDS 6
+
+// The number of directions in which GetAutoScale() samples the image
+// boundary otherwise.  A multiple of 8, so that the corners and the axes
+// are among them.
+#define AUTOSCALE_SAMPLES 16
+// How many of the highest maxima found with them are refined, in how many
+// rounds, and with how many new samples per round
+#define AUTOSCALE_CANDIDATES 1
+#define AUTOSCALE_ROUNDS 1
+#define AUTOSCALE_REFINE 2
+
+// The number of rays along which GetValidCrop() traces the valid region, the
+// number of coarse steps on every ray, and the number of bisection steps
+// which refine the boundary found by them
+#define CROP_RAYS 256
+#define CROP_MARCH 16
+#define CROP_BISECT 10
+// How often GetValidCrop() shrinks the rectangle by one pixel at every side
+// if its rim is not valid
+#define CROP_ATTEMPTS 8
+
 double lfModifier::AutoscaleResidualDistance (float *coord) const
 {
     double result = coord [0] - MaxX;
@@ -133,64 +210,302 @@ double lfModifier::AutoscaleResidualDistance (float *coord) const
     return intermediate > result ? intermediate : result;
 }
 
-float lfModifier::GetTransformedDistance (lfPoint point) const
+void lfModifier::GetTransformedDistances (const float *dir, float *ru, int count) const
 {
-    double dist = point.dist;
-    double sa = sin (point.angle);
-    double ca = cos (point.angle);
-
-    // We have to find the radius ru in the direction of the given point which
-    // distorts to the original (distorted) image edge.  We will use Newton's
-    // method for minimizing the distance between the distorted point at ru and
-    // the original edge.
-    float ru = dist; // Initial approximation
-    float dx = 0.0001F;
-    for (int countdown = 50; ; countdown--)
+    std::vector<lfCallbackData*>* callbacks = (std::vector<lfCallbackData*>*)CoordCallbacks;
+
+    // We have to find the radius ru in every given direction which distorts
+    // to the original (distorted) image edge.  We will use Newton's method
+    // for minimizing the distance between the distorted point at ru and the
+    // original edge.  All directions are iterated together, so that every
+    // step pushes the points of all unfinished directions through the
+    // callbacks in one go.
+    const double ru_max = 100 * sqrt (Width * Width + Height * Height) * 0.5 * NormScale;
+    std::vector<float> dx (count, 0.0001F);
+    std::vector<float> coord (count * 4);
+    std::vector<int> active (count);
+    for (int i = 0; i < count; i++)
+        active [i] = i;
+
+    int n = count;
+    for (int countdown = 50; n; countdown--)
     {
-        float res [2];
-
-        res [0] = ca * ru; res [1] = sa * ru;
-
-        std::vector<lfCallbackData*>* callbacks = (std::vector<lfCallbackData*>*)CoordCallbacks;
+        // Every direction contributes the point at ru and, for the
+        // approximative function prime, the point at ru + dx
+        for (int k = 0; k < n; k++)
+        {
+            int i = active [k];
+            float *res = &coord [k * 4];
+            res [0] = dir [i * 2] * ru [i];
+            res [1] = dir [i * 2 + 1] * ru [i];
+            res [2] = dir [i * 2] * (ru [i] + dx [i]);
+            res [3] = dir [i * 2 + 1] * (ru [i] + dx [i]);
+        }
 
         for (int j = 0; j < callbacks->size(); j++)
         {
             lfCoordCallbackData *cd = (lfCoordCallbackData *)callbacks->at(j);
-            cd->callback (cd->data, res, 1);
+            cd->callback (cd->data, &coord [0], n * 2);
         }
-        double rd = AutoscaleResidualDistance (res);
-        if (rd > -NEWTON_EPS * 100 && rd < NEWTON_EPS * 100)
-            break;
 
-        if (!countdown)
+        int unfinished = 0;
+        for (int k = 0; k < n; k++)
+        {
+            int i = active [k];
+            double rd = AutoscaleResidualDistance (&coord [k * 4]);
+            if (rd > -NEWTON_EPS && rd < NEWTON_EPS)
+                continue;
+
             // e.g. for some ultrawide fisheyes corners extend to infinity
-            // so function never converge ...
+            // so function never converge ...  A search which has left the
+            // valid range of the callbacks never comes back either, and one
+            // beyond ru_max would give a scale below what GetAutoScale()
+            // accepts anyway.
+            if (!countdown || !(ru [i] > 0 && ru [i] < ru_max) || rd != rd)
+            {
+                ru [i] = -1;
+                continue;
+            }
+
+            double rd1 = AutoscaleResidualDistance (&coord [k * 4 + 2]);
+            // If rd1 is very close to rd, this means our delta is too small
+            // and we can hit the precision limit of the float format...
+            if (absolute (rd1 - rd) < 0.00001)
+                dx [i] *= 2;
+            else
+                ru [i] -= rd / ((rd1 - rd) / dx [i]);
+            active [unfinished++] = i;
+        }
+        n = unfinished;
+    }
+}
+
+void lfModifier::GetEdgeScales (const double *u, double *scale, int count) const
+{
+    // The edge is walked along the axes and corners in this order:
+    // 3 2 1
+    // 4   0
+    // 5 6 7
+    static const signed char edge_x [9] = { 1, 1, 0, -1, -1, -1, 0, 1, 1 };
+    static const signed char edge_y [9] = { 0, 1, 1, 1, 0, -1, -1, -1, 0 };
+
+    std::vector<float> dir (count * 2), ru (count);
+    std::vector<double> dist (count);
+    for (int i = 0; i < count; i++)
+    {
+        double v = fmod (u [i], 8.0);
+        if (v < 0)
+            v += 8.0;
+        int k = int (v);
+        double t = v - k;
+        double x = (edge_x [k] + (edge_x [k + 1] - edge_x [k]) * t) * Width * 0.5 * NormScale;
+        double y = (edge_y [k] + (edge_y [k + 1] - edge_y [k]) * t) * Height * 0.5 * NormScale;
+        dist [i] = sqrt (x * x + y * y);
+        dir [i * 2] = x / dist [i];
+        dir [i * 2 + 1] = y / dist [i];
+        ru [i] = scale [i] > 0 ? dist [i] / scale [i] : dist [i];
+    }
+
+    GetTransformedDistances (&dir [0], &ru [0], count);
+
+    for (int i = 0; i < count; i++)
+        scale [i] = ru [i] > 0 ? dist [i] / ru [i] : -1;
+}
+
+double lfModifier::GetRadialScale (double dist) const
+{
+    std::vector<lfCallbackData*>* callbacks = (std::vector<lfCallbackData*>*)CoordCallbacks;
+
+    // The callbacks are applied from the first to the last, so they are
+    // inverted from the last to the first
+    double r = dist;
+    for (int j = int (callbacks->size ()) - 1; j >= 0; j--)
+    {
+        lfCoordCallbackData *cd = (lfCoordCallbackData *)callbacks->at(j);
+        if (!InvertRadialCallback (cd->callback, cd->data, r))
             return -1;
+    }
+    return r > 0 ? dist / r : -1;
+}
 
-        // Compute approximative function prime in (x,y)
-        res [0] = ca * (ru + dx); res [1] = sa * (ru + dx);
-        for (int j = 0; j < callbacks->size(); j++)
+double lfModifier::GetRadialAutoScale () const
+{
+    // The scale depends only on the distance of the edge point from the
+    // centre, which runs from the nearer axis to the corners.  So the
+    // distances in between are sampled evenly, and the bracket around the
+    // highest sample is narrowed by a golden section search.
+    double d0 = (Width < Height ? Width : Height) * 0.5 * NormScale;
+    double d1 = sqrt (Width * Width + Height * Height) * 0.5 * NormScale;
+    double step = (d1 - d0) / (AUTOSCALE_RADIAL_SAMPLES - 1);
+
+    double scale = 0.01, best_dist = d0;
+    for (int i = 0; i < AUTOSCALE_RADIAL_SAMPLES; i++)
+    {
+        double dist = d0 + step * i;
+        double s = GetRadialScale (dist);
+        if (s > scale)
         {
-            lfCoordCallbackData *cd = (lfCoordCallbackData *)callbacks->at(j);
-            cd->callback (cd->data, res, 1);
+            scale = s;
+            best_dist = dist;
         }
-        double rd1 = AutoscaleResidualDistance (res);
+    }
 
-        // If rd1 is very close to rd, this means our delta is too small
-        // and we can hit the precision limit of the float format...
-        if (absolute (rd1 - rd) < 0.00001)
+    const double golden = 0.5 * (sqrt (5.0) - 1);
+    double a = std::max (best_dist - step, d0), b = std::min (best_dist + step, d1);
+    double c = b - golden * (b - a), d = a + golden * (b - a);
+    double sc = GetRadialScale (c), sd = GetRadialScale (d);
+    for (int round = 0; round < AUTOSCALE_RADIAL_ROUNDS; round++)
+        if (sc > sd)
         {
-            dx *= 2;
-            continue;
+            b = d; d = c; sd = sc;
+            c = b - golden * (b - a);
+            sc = GetRadialScale (c);
+        }
+        else
+        {
+            a = c; c = d; sc = sd;
+            d = a + golden * (b - a);
+            sd = GetRadialScale (d);
+        }
+
+    return std::max (scale, std::max (sc, sd));
+}
+
+double lfModifier::GetEdgeAutoScale () const
+{
+    std::vector<lfCallbackData*>* callbacks = (std::vector<lfCallbackData*>*)CoordCallbacks;
+
+    // Chains which are mirror symmetric in both axes, like the distortion
+    // models and the lens projections, have the same scales in every
+    // quadrant.  This is checked with the mirror images of two points; then
+    // only the first quadrant is searched, and its ends are mirrored.
+    static const float probe [2][2] = { { 0.37F, 0.83F }, { 0.91F, 0.29F } };
+    float mirrored [2 * 4 * 2];
+    for (int p = 0; p < 2; p++)
+        for (int m = 0; m < 4; m++)
+        {
+            mirrored [(p * 4 + m) * 2] = (m & 1 ? -MaxX : MaxX) * probe [p][0];
+            mirrored [(p * 4 + m) * 2 + 1] = (m & 2 ? -MaxY : MaxY) * probe [p][1];
         }
+    for (int j = 0; j < callbacks->size(); j++)
+    {
+        lfCoordCallbackData *cd = (lfCoordCallbackData *)callbacks->at(j);
+        cd->callback (cd->data, mirrored, 2 * 4);
+    }
+    bool symmetric = true;
+    for (int p = 0; p < 2; p++)
+        for (int m = 1; m < 4; m++)
+            for (int c = 0; c < 2; c++)
+            {
+                float a = mirrored [p * 8 + c];
+                float b = mirrored [(p * 4 + m) * 2 + c] * ((m >> c) & 1 ? -1 : 1);
+                symmetric &= absolute (a - b) <= NEWTON_EPS * (1 + absolute (a));
+            }
 
-        // dy/dx;
-        double prime = (rd1 - rd) / dx;
+    // First, the axes and the corners are searched, starting at the
+    // uncorrected edge.
+    static const int mirror [9] = { 0, 1, 2, 1, 0, 1, 2, 1, 0 };
+    const int keys = symmetric ? 3 : 8;
+    double key [9], key_scale [9];
+    for (int k = 0; k < keys; k++)
+    {
+        key [k] = k;
+        key_scale [k] = -1;
+    }
+    GetEdgeScales (key, key_scale, keys);
+    for (int k = keys; k < 9; k++)
+        key_scale [k] = key_scale [symmetric ? mirror [k] : 0];
+
+    // Then, the edge is sampled evenly between them.  The searches start at
+    // the scale interpolated between the neighbouring axis and corner, so that
+    // most of them converge in one or two steps.
+    const int per_octant = AUTOSCALE_SAMPLES / 8;
+    const int samples = symmetric ? 2 * per_octant + 1 : AUTOSCALE_SAMPLES;
+    double u [AUTOSCALE_SAMPLES], point_scale [AUTOSCALE_SAMPLES];
+    double between_u [AUTOSCALE_SAMPLES], between_scale [AUTOSCALE_SAMPLES];
+    int between = 0;
+    for (int i = 0; i < samples; i++)
+    {
+        int k = i / per_octant, j = i % per_octant;
+        double t = double (j) / per_octant;
+        u [i] = k + t;
+        point_scale [i] = key_scale [k];
+        if (!j)
+            continue;
+        between_u [between] = u [i];
+        between_scale [between++] = key_scale [k] > 0 && key_scale [k + 1] > 0 ?
+            key_scale [k] * (1 - t) + key_scale [k + 1] * t : -1;
+    }
+    GetEdgeScales (between_u, between_scale, between);
+    for (int i = 0, b = 0; i < samples; i++)
+        if (i % per_octant)
+            point_scale [i] = between_scale [b++];
+
+    double scale = 0.01;
+    for (int i = 0; i < samples; i++)
+        if (point_scale [i] > scale)
+            scale = point_scale [i];
+
+    // The true maximum may lie between two samples.  So, the highest local
+    // maxima are bracketed by their neighbours, and the brackets are
+    // narrowed by sampling them again, all of them in one batch per round.
+    double center [AUTOSCALE_CANDIDATES] = { 0 }, best [AUTOSCALE_CANDIDATES] = { 0 };
+    int candidates = 0;
+    for (int i = 0; i < samples; i++)
+    {
+        double left = i > 0 ? point_scale [i - 1] :
+            point_scale [symmetric ? 1 : samples - 1];
+        double right = i < samples - 1 ? point_scale [i + 1] :
+            point_scale [symmetric ? samples - 2 : 0];
+        if (point_scale [i] <= 0 || point_scale [i] < left || point_scale [i] <= right)
+            continue;
+        // Insertion into the list of candidates, which is sorted by scale
+        int c = candidates < AUTOSCALE_CANDIDATES ? candidates++ : AUTOSCALE_CANDIDATES;
+        for (; c > 0 && best [c - 1] < point_scale [i]; c--)
+            if (c < AUTOSCALE_CANDIDATES)
+            {
+                center [c] = center [c - 1];
+                best [c] = best [c - 1];
+            }
+        if (c < AUTOSCALE_CANDIDATES)
+        {
+            center [c] = u [i];
+            best [c] = point_scale [i];
+        }
+    }
 
-        ru -= rd / prime;
+    double refine_u [AUTOSCALE_CANDIDATES * AUTOSCALE_REFINE];
+    double refine_scale [AUTOSCALE_CANDIDATES * AUTOSCALE_REFINE];
+    double step = 1.0 / per_octant;
+    for (int round = 0; round < AUTOSCALE_ROUNDS && candidates; round++)
+    {
+        for (int c = 0; c < candidates; c++)
+            for (int j = 0; j < AUTOSCALE_REFINE; j++)
+            {
+                int i = c * AUTOSCALE_REFINE + j;
+                refine_u [i] = center [c] +
+                    step * (2.0 * (j + 1) / (AUTOSCALE_REFINE + 1) - 1.0);
+                refine_scale [i] = best [c];
+            }
+        GetEdgeScales (refine_u, refine_scale, candidates * AUTOSCALE_REFINE);
+        for (int c = 0; c < candidates; c++)
+        {
+            for (int j = 0; j < AUTOSCALE_REFINE; j++)
+            {
+                int i = c * AUTOSCALE_REFINE + j;
+                if (refine_scale [i] > best [c])
+                {
+                    best [c] = refine_scale [i];
+                    center [c] = refine_u [i];
+                }
+            }
+            if (best [c] > scale)
+                scale = best [c];
+        }
+        step *= 2.0 / (AUTOSCALE_REFINE + 1);
     }
 
-    return ru;
+    return scale;
 }
 
 float lfModifier::GetAutoScale (bool reverse)
@@ -204,250 +519,249 @@ float lfModifier::GetAutoScale (bool reverse)
     if (coordCallbacks->size()== 0)
         return subpixel_scale;
 
-    // 3 2 1
-    // 4   0
-    // 5 6 7
-    lfPoint point [8];
-
-    point [1].angle = atan2 (Height, Width);
-    point [3].angle = M_PI - point [1].angle;
-    point [5].angle = M_PI + point [1].angle;
-    point [7].angle = 2 * M_PI - point [1].angle;
-
-    point [0].angle = 0.0F;
-    point [2].angle = float (M_PI / 2.0);
-    point [4].angle = float (M_PI);
-    point [6].angle = float (M_PI * 3.0 / 2.0);
+    bool radial = true;
+    for (int j = 0; j < coordCallbacks->size(); j++)
+        radial &= IsRadialCallback (((lfCoordCallbackData *)coordCallbacks->at(j))->callback);
 
-    point [1].dist = point [3].dist = point [5].dist = point [7].dist =
-        sqrt (pow (Width, 2) + pow (Height, 2)) * 0.5 * NormScale;
-    point [0].dist = point [4].dist = Width * 0.5 * NormScale;
-    point [2].dist = point [6].dist = Height * 0.5 * NormScale;
+    double scale = radial ? GetRadialAutoScale () : GetEdgeAutoScale ();
 
-    float scale = 0.01F;
-    for (int i = 0; i < 8; i++)
-    {
-        float transformed_distance = GetTransformedDistance (point [i]);
-        float point_scale = point [i].dist / transformed_distance;
-        if (point_scale > scale)
-            scale = point_scale;
-    }
-    // 1 permille is our limit of accuracy (in rare cases, we may be even
-    // worse, depending on what happens between the test points), so assure
-    // that we really have no black borders left.
-    scale *= 1.001;
+    // What remains is the tolerance of the Newton search, and float
+    // rounding in the callbacks.
+    scale *= 1 + 10 * NEWTON_EPS;
     scale *= subpixel_scale;
 
     return reverse ? 1.0 / scale : scale;
 }
 
-bool lfModifier::AddCoordCallbackScale (float scale, bool reverse)
+void lfModifier::TestValidPixels (float *coord, int count, unsigned char *valid) const
 {
-    float tmp [1];
+    std::vector<lfCallbackData*>* callbacks = (std::vector<lfCallbackData*>*)CoordCallbacks;
 
-    // Inverse scale factor
-    if (scale == 0.0)
+    for (int i = 0; i < count * 2; i += 2)
     {
-        scale = GetAutoScale (reverse);
-        if (scale == 0.0)
-            return false;
+        coord [i] = coord [i] * NormScale - CenterX;
+        coord [i + 1] = coord [i + 1] * NormScale - CenterY;
     }
 
-    tmp [0] = reverse ? scale : 1.0 / scale;
-    int priority = reverse ? 900 : 100;
-    AddCoordCallback (ModifyCoord_Scale, priority, tmp, sizeof (tmp));
-    return true;
+    for (int j = 0; j < callbacks->size(); j++)
+    {
+        lfCoordCallbackData *cd = (lfCoordCallbackData *)callbacks->at(j);
+        cd->callback (cd->data, coord, count);
+    }
+
+    // NaNs and the marker of invalid coordinates fail these comparisons
+    const double max_x = Width * NormScale - CenterX;
+    const double max_y = Height * NormScale - CenterY;
+    for (int i = 0; i < count; i++)
+        valid [i] = coord [i * 2] >= -CenterX && coord [i * 2] <= max_x &&
+                    coord [i * 2 + 1] >= -CenterY && coord [i * 2 + 1] <= max_y;
+}
+
+struct lfCropObstacle
+{
+    double x, y;
+};
+
+static bool _lf_obstacle_above (const lfCropObstacle &a, const lfCropObstacle &b)
+{
+    return a.y > b.y;
 }
 
-bool lfModifier::AddCoordCallbackGeometry (lfLensType from, lfLensType to, float focal /*=0*/)
+static bool _lf_obstacle_below (const lfCropObstacle &a, const lfCropObstacle &b)
 {
-    float tmp [2];
-    tmp [0] = 1 / FocalLengthNormalized;
-    tmp [1] = FocalLengthNormalized;
+    return a.y < b.y;
+}
 
-    if(from == to)
-        return false;
-    if(from == LF_UNKNOWN)
-        return false;
-    if(to == LF_UNKNOWN)
+bool lfModifier::GetValidCrop (float aspect, float *crop) const
+{
+    // The valid region is traced along rays from the image centre.  Every
+    // ray is marched in coarse steps up to the image edge, and the step at
+    // which it leaves the valid region is refined by bisection.  All rays
+    // are evaluated together in every step.
+    const double seed_x = Width * 0.5, seed_y = Height * 0.5;
+    float coord [2] = { float (seed_x), float (seed_y) };
+    unsigned char seed_valid;
+    TestValidPixels (coord, 1, &seed_valid);
+    if (!seed_valid)
         return false;
-    // handle special cases
-    switch (from)
+
+    double dir_x [CROP_RAYS], dir_y [CROP_RAYS], lo [CROP_RAYS], hi [CROP_RAYS];
+    std::vector<float> points (CROP_RAYS * CROP_MARCH * 2);
+    std::vector<unsigned char> valid (CROP_RAYS * CROP_MARCH);
+    for (int r = 0; r < CROP_RAYS; r++)
     {
-        case LF_RECTILINEAR:
-            switch (to)
+        double angle = 2 * M_PI * r / CROP_RAYS;
+        dir_x [r] = cos (angle);
+        dir_y [r] = sin (angle);
+        double len_x = absolute (dir_x [r]) > 1e-9 ? seed_x / absolute (dir_x [r]) : HUGE_VAL;
+        double len_y = absolute (dir_y [r]) > 1e-9 ? seed_y / absolute (dir_y [r]) : HUGE_VAL;
+        double len = len_x < len_y ? len_x : len_y;
+        for (int k = 0; k < CROP_MARCH; k++)
+        {
+            double t = len * (k + 1) / CROP_MARCH;
+            points [(r * CROP_MARCH + k) * 2] = seed_x + dir_x [r] * t;
+            points [(r * CROP_MARCH + k) * 2 + 1] = seed_y + dir_y [r] * t;
+        }
+        lo [r] = hi [r] = len;
+    }
+    TestValidPixels (&points [0], CROP_RAYS * CROP_MARCH, &valid [0]);
+
+    // Rays which stay valid up to the image edge have lo == hi
+    for (int r = 0; r < CROP_RAYS; r++)
+        for (int k = 0; k < CROP_MARCH; k++)
+            if (!valid [r * CROP_MARCH + k])
             {
-                case LF_FISHEYE:
-                    AddCoordCallback (ModifyCoord_Geom_FishEye_Rect,
-                                      500, tmp, sizeof (tmp));
-                    return true;
-
-                case LF_PANORAMIC:
-                    AddCoordCallback (ModifyCoord_Geom_Panoramic_Rect,
-                                      500, tmp, sizeof (tmp));
-                    return true;
-
-                case LF_EQUIRECTANGULAR:
-                    AddCoordCallback (ModifyCoord_Geom_ERect_Rect,
-                                      500, tmp, sizeof (tmp));
-                    return true;
-
-                default:
-                    // keep gcc 4.4+ happy
-                    break;
+                hi [r] = lo [r] * (k + 1) / CROP_MARCH;
+                lo [r] = lo [r] * k / CROP_MARCH;
+                break;
             }
-            break;
 
-        case LF_FISHEYE:
-            switch (to)
+    for (int step = 0; step < CROP_BISECT; step++)
+    {
+        for (int r = 0; r < CROP_RAYS; r++)
+        {
+            double t = (lo [r] + hi [r]) * 0.5;
+            points [r * 2] = seed_x + dir_x [r] * t;
+            points [r * 2 + 1] = seed_y + dir_y [r] * t;
+        }
+        TestValidPixels (&points [0], CROP_RAYS, &valid [0]);
+        for (int r = 0; r < CROP_RAYS; r++)
+            if (lo [r] < hi [r])
             {
-                case LF_RECTILINEAR:
-                    AddCoordCallback (ModifyCoord_Geom_Rect_FishEye,
-                                      500, tmp, sizeof (tmp));
-                    return true;
-
-                case LF_PANORAMIC:
-                    AddCoordCallback (ModifyCoord_Geom_Panoramic_FishEye,
-                                      500, tmp, sizeof (tmp));
-                    return true;
-
-                case LF_EQUIRECTANGULAR:
-                    AddCoordCallback (ModifyCoord_Geom_ERect_FishEye,
-                                      500, tmp, sizeof (tmp));
-                    return true;
-
-                default:
-                    // keep gcc 4.4+ happy
-                    break;
+                if (valid [r])
+                    lo [r] = (lo [r] + hi [r]) * 0.5;
+                else
+                    hi [r] = (lo [r] + hi [r]) * 0.5;
             }
-            break;
+    }
 
-        case LF_PANORAMIC:
-            switch (to)
+    // The first invalid point of every ray is an obstacle which the
+    // rectangle must not contain.  The obstacles are split into those above
+    // and below the centre, each sorted by their distance from it.
+    std::vector<lfCropObstacle> above, below;
+    double left = 0, right = Width;
+    for (int r = 0; r < CROP_RAYS; r++)
+    {
+        if (lo [r] == hi [r])
+            continue;
+        lfCropObstacle o;
+        o.x = seed_x + dir_x [r] * hi [r];
+        o.y = seed_y + dir_y [r] * hi [r];
+        if (o.y < seed_y)
+            above.push_back (o);
+        else if (o.y > seed_y)
+            below.push_back (o);
+        else if (o.x < seed_x)
+            left = o.x > left ? o.x : left;
+        else
+            right = o.x < right ? o.x : right;
+    }
+    std::sort (above.begin (), above.end (), _lf_obstacle_above);
+    std::sort (below.begin (), below.end (), _lf_obstacle_below);
+
+    // Every obstacle above the centre, and the image edge, is a candidate
+    // for the top of the rectangle, and likewise for the bottom.  For a
+    // given top, the candidates for the bottom are walked outwards while the
+    // obstacles between top and bottom narrow the rectangle.
+    double best_area = -1, box [4] = { 0, 0, 0, 0 };
+    for (size_t a = 0; a <= above.size (); a++)
+    {
+        double top = a < above.size () ? above [a].y : 0;
+        double l = left, r = right;
+        for (size_t b = 0; b <= below.size () && r > l; b++)
+        {
+            double bottom = b < below.size () ? below [b].y : Height;
+            double w = r - l, h = bottom - top;
+            if (aspect > 0)
             {
-                case LF_RECTILINEAR:
-                    AddCoordCallback (ModifyCoord_Geom_Rect_Panoramic,
-                                      500, tmp, sizeof (tmp));
-                    return true;
-
-                case LF_FISHEYE:
-                    AddCoordCallback (ModifyCoord_Geom_FishEye_Panoramic,
-                                      500, tmp, sizeof (tmp));
-                    return true;
-
-                case LF_EQUIRECTANGULAR:
-                    AddCoordCallback (ModifyCoord_Geom_ERect_Panoramic,
-                                      500, tmp, sizeof (tmp));
-                    return true;
-
-                default:
-                    // keep gcc 4.4+ happy
-                    break;
+                if (w < h * aspect)
+                    h = w / aspect;
+                w = h * aspect;
             }
-            break;
-
-        case LF_EQUIRECTANGULAR:
-            switch (to)
+            if (w * h > best_area)
+            {
+                best_area = w * h;
+                // A rectangle of fixed aspect ratio is centred in the box
+                box [0] = (l + r - w) * 0.5;
+                box [1] = (l + r + w) * 0.5;
+                box [2] = (top + bottom - h) * 0.5;
+                box [3] = (top + bottom + h) * 0.5;
+            }
+            if (b < below.size ())
             {
-                case LF_RECTILINEAR:
-                    AddCoordCallback (ModifyCoord_Geom_Rect_ERect,
-                                      500, tmp, sizeof (tmp));
-                    return true;
-
-                case LF_FISHEYE:
-                    AddCoordCallback (ModifyCoord_Geom_FishEye_ERect,
-                                      500, tmp, sizeof (tmp));
-                    return true;
-
-                case LF_PANORAMIC:
-                    AddCoordCallback (ModifyCoord_Geom_Panoramic_ERect,
-                                      500, tmp, sizeof (tmp));
-                    return true;
-
-                default:
-                    // keep gcc 4.4+ happy
-                    break;
+                if (below [b].x <= seed_x && below [b].x > l)
+                    l = below [b].x;
+                if (below [b].x >= seed_x && below [b].x < r)
+                    r = below [b].x;
             }
-        case LF_FISHEYE_ORTHOGRAPHIC:
-        case LF_FISHEYE_STEREOGRAPHIC:
-        case LF_FISHEYE_EQUISOLID:
-        case LF_FISHEYE_THOBY:
-        case LF_UNKNOWN:
-        default:
+        }
+
+        if (a < above.size ())
+        {
+            if (above [a].x <= seed_x && above [a].x > left)
+                left = above [a].x;
+            if (above [a].x >= seed_x && above [a].x < right)
+                right = above [a].x;
+        }
+        if (right <= left)
             break;
-    };
+    }
 
-    //convert from input projection to target projection via equirectangular projection
-    switch(to)
+    // Round inwards to whole pixels, and make sure that the pixels on the
+    // rim are valid, since the traced boundary is linear between the rays
+    int x0 = int (ceil (box [0])), x1 = int (floor (box [1]));
+    int y0 = int (ceil (box [2])), y1 = int (floor (box [3]));
+    for (int attempt = 0; ; attempt++)
     {
-        case LF_RECTILINEAR:
-            AddCoordCallback (ModifyCoord_Geom_Rect_ERect,
-                                500, tmp, sizeof (tmp));
-            break;
-        case LF_FISHEYE:
-            AddCoordCallback (ModifyCoord_Geom_FishEye_ERect,
-                                500, tmp, sizeof (tmp));
-            break;
-        case LF_PANORAMIC:
-            AddCoordCallback (ModifyCoord_Geom_Panoramic_ERect,
-                                500, tmp, sizeof (tmp));
-            break;
-        case LF_FISHEYE_ORTHOGRAPHIC:
-            AddCoordCallback (ModifyCoord_Geom_Orthographic_ERect,
-                                500, tmp, sizeof (tmp));
-            break;
-        case LF_FISHEYE_STEREOGRAPHIC:
-            AddCoordCallback (ModifyCoord_Geom_Stereographic_ERect,
-                                500, tmp, sizeof (tmp));
-            break;
-        case LF_FISHEYE_EQUISOLID:
-            AddCoordCallback (ModifyCoord_Geom_Equisolid_ERect,
-                                500, tmp, sizeof (tmp));
-            break;
-        case LF_FISHEYE_THOBY:
-            AddCoordCallback (ModifyCoord_Geom_Thoby_ERect,
-                                500, tmp, sizeof (tmp));
-            break;
-        case LF_EQUIRECTANGULAR:
-        default:
-            //nothing to do
+        if (x1 < x0 || y1 < y0 || attempt == CROP_ATTEMPTS)
+            return false;
+
+        int n = 0, w = x1 - x0 + 1, h = y1 - y0 + 1;
+        points.resize ((w + h) * 4);
+        valid.resize ((w + h) * 2);
+        for (int x = x0; x <= x1; x++)
+        {
+            points [n++] = x; points [n++] = y0;
+            points [n++] = x; points [n++] = y1;
+        }
+        for (int y = y0; y <= y1; y++)
+        {
+            points [n++] = x0; points [n++] = y;
+            points [n++] = x1; points [n++] = y;
+        }
+        TestValidPixels (&points [0], n / 2, &valid [0]);
+
+        bool rim_valid = true;
+        for (int i = 0; i < n / 2 && rim_valid; i++)
+            rim_valid = valid [i];
+        if (rim_valid)
             break;
-    };
-    switch(from)
+        x0++; x1--; y0++; y1--;
+    }
+
+    crop [0] = x0;
+    crop [1] = x1;
+    crop [2] = y0;
+    crop [3] = y1;
+    return true;
+}
+
+bool lfModifier::AddCoordCallbackScale (float scale, bool reverse)
+{
+    float tmp [1];
+
+    // Inverse scale factor
+    if (scale == 0.0)
     {
-        case LF_RECTILINEAR:
-            AddCoordCallback (ModifyCoord_Geom_ERect_Rect,
-                                500, tmp, sizeof (tmp));
-            break;
-        case LF_FISHEYE:
-            AddCoordCallback (ModifyCoord_Geom_ERect_FishEye,
-                                500, tmp, sizeof (tmp));
-            break;
-        case LF_PANORAMIC:
-            AddCoordCallback (ModifyCoord_Geom_ERect_Panoramic,
-                                500, tmp, sizeof (tmp));
-            break;
-        case LF_FISHEYE_ORTHOGRAPHIC:
-            AddCoordCallback (ModifyCoord_Geom_ERect_Orthographic,
-                                500, tmp, sizeof (tmp));
-            break;
-        case LF_FISHEYE_STEREOGRAPHIC:
-            AddCoordCallback (ModifyCoord_Geom_ERect_Stereographic,
-                                500, tmp, sizeof (tmp));
-            break;
-        case LF_FISHEYE_EQUISOLID:
-            AddCoordCallback (ModifyCoord_Geom_ERect_Equisolid,
-                                500, tmp, sizeof (tmp));
-            break;
-        case LF_FISHEYE_THOBY:
-            AddCoordCallback (ModifyCoord_Geom_ERect_Thoby,
-                                500, tmp, sizeof (tmp));
-            break;
-        case LF_EQUIRECTANGULAR:
-        default:
-            //nothing to do
-            break;
-    };
+        scale = GetAutoScale (reverse);
+        if (scale == 0.0)
+            return false;
+    }
+
+    tmp [0] = reverse ? scale : 1.0 / scale;
+    int priority = reverse ? 900 : 100;
+    AddCoordCallback (ModifyCoord_Scale, ModifyCoordJacobian_Scale, priority,
+                      tmp, sizeof (tmp));
     return true;
 }
 
@@ -460,22 +774,68 @@ bool lfModifier::ApplyGeometryDistortion (
 
     // All callbacks work with normalized coordinates
     xu = xu * NormScale - CenterX;
-    yu = yu * NormScale - CenterY;
 
-    for (float y = yu; height; y += NormScale, height--)
+    lfCoordColumns columns;
+    PrepareCoordColumns (xu, width, columns);
+
+    // See ApplyColorModification() for why rows do not accumulate steps
+    for (int row = 0; row < height; row++)
+    {
+        float y = (yu + row) * NormScale - CenterY;
+        int i;
+        for (i = GenerateCoordRow (xu, y, res, width, &columns);
+             i < coordCallbacks->size(); i++)
+        {
+            lfCoordCallbackData *cd = (lfCoordCallbackData *)coordCallbacks->at(i);
+            LF_PROFILE_CALLBACK (cd->callback, width);
+            cd->callback (cd->data, res, width);
+        }
+
+        // Convert normalized coordinates back into natural coordiates
+        for (i = 0; i < width; i++)
+        {
+            res [0] = (res [0] + CenterX) * NormUnScale;
+            res [1] = (res [1] + CenterY) * NormUnScale;
+            res += 2;
+        }
+    }
+
+    return true;
+}
+
+bool lfModifier::ApplyGeometryDistortionJacobian (
+    float xu, float yu, int width, int height, float *res, float *jacobian,
+    float step) const
+{
+    std::vector<lfCallbackData*>* coordCallbacks = (std::vector<lfCallbackData*>*)CoordCallbacks;
+    if (coordCallbacks->size()<= 0 || height <= 0)
+        return false; // nothing to do
+    for (int i = 0; i < coordCallbacks->size(); i++)
+        if (!((lfCoordCallbackData *)coordCallbacks->at(i))->jacobian_callback)
+            return false;
+
+    // All callbacks work with normalized coordinates.  The Jacobian is the
+    // same in pixels, since the scales to and from them cancel out.
+    xu = xu * NormScale - CenterX;
+    const float xstep = step * NormScale;
+
+    for (int row = 0; row < height; row++)
     {
+        float y = (yu + row * step) * NormScale - CenterY;
         int i;
-        float x = xu;
-        for (i = 0; i < width; i++, x += NormScale)
+        for (i = 0; i < width; i++)
         {
-            res [i * 2] = x;
+            res [i * 2] = xu + i * xstep;
             res [i * 2 + 1] = y;
+            jacobian [i * 4] = jacobian [i * 4 + 3] = 1;
+            jacobian [i * 4 + 1] = jacobian [i * 4 + 2] = 0;
         }
 
         for (i = 0; i < coordCallbacks->size(); i++)
         {
             lfCoordCallbackData *cd = (lfCoordCallbackData *)coordCallbacks->at(i);
-            cd->callback (cd->data, res, width);
+            LF_PROFILE_CALLBACK (cd->callback, width);
+            cd->jacobian_callback (cd->data, res, jacobian, width);
         }
 
         // Convert normalized coordinates back into natural coordiates
@@ -485,73 +845,422 @@ bool lfModifier::ApplyGeometryDistortion (
             res [1] = (res [1] + CenterY) * NormUnScale;
             res += 2;
         }
+        jacobian += width * 4;
     }
 
     return true;
 }
 
-void lfModifier::ModifyCoord_Scale (void *data, float *iocoord, int count)
+// The number of points which ApplyGeometryDistortionPoints() pushes through
+// the callbacks in one go, so that a block stays in the L1 cache from the
+// first callback to the last
+#define POINTS_BLOCK 1024
+// The same for the inverse search, which pushes three times as many points
+// and keeps its state for every point on the stack as well, 14 KB in all
+#define POINTS_INVERSE_BLOCK 256
+// Iterations after which the inverse search gives up on a point
+#define POINTS_NEWTON_STEPS 50
+// Initial offset in normalized coordinates of the points from which the
+// inverse search approximates the Jacobian of the callbacks
+#define POINTS_DELTA 0.001F
+
+// False for NaNs and the marker of invalid coordinates of the projections
+static inline bool valid_coord (float x, float y)
 {
-    float scale = *(float *)data;
-
-    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
-    {
-        iocoord [0] *= scale;
-        iocoord [1] *= scale;
-    }
+    return fabsf (x) < 1e15F && fabsf (y) < 1e15F;
 }
 
-void lfModifier::ModifyCoord_UnDist_Poly3 (void *data, float *iocoord, int count)
+bool lfModifier::ApplyGeometryDistortionPoints (
+    const float *coord, float *res, int count, bool inverse,
+    unsigned char *status) const
 {
-    // See "Note about PT-based distortion models" at the top of this file.
-    const float inv_k1_ = *(float *)data;
+    std::vector<lfCallbackData*>* coordCallbacks = (std::vector<lfCallbackData*>*)CoordCallbacks;
+    if (coordCallbacks->size()<= 0 || count <= 0)
+        return false; // nothing to do
 
-    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
+    float block [POINTS_BLOCK * 2];
+    unsigned char valid [POINTS_BLOCK];
+    const int block_size = inverse ? POINTS_INVERSE_BLOCK : POINTS_BLOCK;
+    for (int first = 0; first < count; first += block_size)
     {
-        float x = iocoord [0];
-        float y = iocoord [1];
-        double rd = sqrt (x * x + y * y);
-        if (rd == 0.0)
-            continue;
+        int n = std::min (count - first, block_size);
+        const float *in = coord + first * 2;
+        float *out = res + first * 2;
 
-        float rd_div_k1_ = rd * inv_k1_;
-
-        // Use Newton's method to avoid dealing with complex numbers
-        // When carefully tuned this works almost as fast as Cardano's
-        // method (and we don't use complex numbers in it, which is
-        // required for a full solution!)
-        //
-        // Original function: Rd = k1_ * Ru^3 + Ru
-        // Target function:   k1_ * Ru^3 + Ru - Rd = 0
-        // Divide by k1_:     Ru^3 + Ru/k1_ - Rd/k1_ = 0
-        // Derivative:        3 * Ru^2 + 1/k1_
-        double ru = rd;
-        for (int step = 0; ; step++)
+        // All callbacks work with normalized coordinates
+        for (int i = 0; i < n * 2; i += 2)
         {
-            double fru = ru * ru * ru + ru * inv_k1_ - rd_div_k1_;
-            if (fru >= -NEWTON_EPS && fru < NEWTON_EPS)
-                break;
-            if (step > 5)
-                // Does not converge, no real solution in this area?
-                goto next_pixel;
+            block [i] = in [i] * NormScale - CenterX;
+            block [i + 1] = in [i + 1] * NormScale - CenterY;
+        }
 
-            ru -= fru / (3 * ru * ru + inv_k1_);
+        if (inverse)
+            InvertCoordPoints (block, n, valid);
+        else
+        {
+            for (int j = 0; j < coordCallbacks->size(); j++)
+            {
+                lfCoordCallbackData *cd = (lfCoordCallbackData *)coordCallbacks->at(j);
+                LF_PROFILE_CALLBACK (cd->callback, n);
+                cd->callback (cd->data, block, n);
+            }
+            for (int i = 0; i < n; i++)
+                valid [i] = valid_coord (block [i * 2], block [i * 2 + 1]);
         }
-        if (ru < 0.0)
-            continue; // Negative radius does not make sense at all
 
-        ru /= rd;
-        iocoord [0] = x * ru;
-        iocoord [1] = y * ru;
+        // Convert normalized coordinates back into natural coordiates; the
+        // points which the inverse search missed keep their exact input
+        for (int i = 0; i < n * 2; i += 2)
+            if (valid [i / 2] || !inverse)
+            {
+                out [i] = (block [i] + CenterX) * NormUnScale;
+                out [i + 1] = (block [i + 1] + CenterY) * NormUnScale;
+            }
+            else
+            {
+                out [i] = in [i];
+                out [i + 1] = in [i + 1];
+            }
 
-    next_pixel:
-        ;
+        if (status)
+            memcpy (status + first, valid, n);
     }
+
+    return true;
 }
 
-void lfModifier::ModifyCoord_Dist_Poly3 (void *data, float *iocoord, int count)
+void lfModifier::InvertCoordPoints (float *coord, int count, unsigned char *status) const
 {
-    // See "Note about PT-based distortion models" at the top of this file.
+    std::vector<lfCallbackData*>* callbacks = (std::vector<lfCallbackData*>*)CoordCallbacks;
+
+    // Newton's method in two dimensions: for the target t, the point u is
+    // moved by J^-1 (F(u) - t), with the Jacobian J of the callbacks F taken
+    // from the points at u + (delta, 0) and u + (0, delta).  All points are
+    // iterated together, like in GetTransformedDistances(), and every
+    // unfinished point contributes these three points to every batch.  A
+    // step which does not decrease the residual is halved instead, which
+    // keeps the search from jumping out of the valid area of projections.
+    //
+    // The first guess is the target itself, which is close for all but the
+    // strongest corrections.  Where a fisheye is folded over by a projection,
+    // it may however lie beyond the fold, where the search would never get
+    // back from.  So the centre, which every radial correction keeps in
+    // place, serves as the point to fall back to from the first guess; just
+    // off it, since some projections have no defined direction there.
+    float centre [2] = { POINTS_DELTA, POINTS_DELTA };
+    for (int j = 0; j < callbacks->size(); j++)
+    {
+        lfCoordCallbackData *cd = (lfCoordCallbackData *)callbacks->at(j);
+        cd->callback (cd->data, centre, 1);
+    }
+
+    float u [POINTS_INVERSE_BLOCK * 2], prev_u [POINTS_INVERSE_BLOCK * 2];
+    float eval [POINTS_INVERSE_BLOCK * 6], delta [POINTS_INVERSE_BLOCK];
+    double prev_residual [POINTS_INVERSE_BLOCK];
+    int active [POINTS_INVERSE_BLOCK];
+    memcpy (u, coord, count * 2 * sizeof (float));
+    for (int i = 0; i < count; i++)
+    {
+        prev_u [i * 2] = prev_u [i * 2 + 1] = delta [i] = POINTS_DELTA;
+        prev_residual [i] = HUGE_VAL;
+        active [i] = i;
+        status [i] = 0;
+        if (valid_coord (centre [0], centre [1]))
+        {
+            double cx = double (centre [0]) - coord [i * 2];
+            double cy = double (centre [1]) - coord [i * 2 + 1];
+            prev_residual [i] = cx * cx + cy * cy;
+        }
+    }
+
+    int n = count;
+    for (int countdown = POINTS_NEWTON_STEPS; n; countdown--)
+    {
+        for (int k = 0; k < n; k++)
+        {
+            int i = active [k];
+            float *e = &eval [k * 6];
+            e [0] = e [4] = u [i * 2];
+            e [1] = e [3] = u [i * 2 + 1];
+            e [2] = e [0] + delta [i];
+            e [5] = e [1] + delta [i];
+        }
+
+        for (int j = 0; j < callbacks->size(); j++)
+        {
+            lfCoordCallbackData *cd = (lfCoordCallbackData *)callbacks->at(j);
+            LF_PROFILE_CALLBACK (cd->callback, n * 3);
+            cd->callback (cd->data, eval, n * 3);
+        }
+
+        int unfinished = 0;
+        for (int k = 0; k < n; k++)
+        {
+            int i = active [k];
+            const float *e = &eval [k * 6];
+            double fx = double (e [0]) - coord [i * 2];
+            double fy = double (e [1]) - coord [i * 2 + 1];
+            if (fx > -NEWTON_EPS && fx < NEWTON_EPS &&
+                fy > -NEWTON_EPS && fy < NEWTON_EPS)
+            {
+                coord [i * 2] = u [i * 2];
+                coord [i * 2 + 1] = u [i * 2 + 1];
+                status [i] = 1;
+                continue;
+            }
+            if (!countdown)
+                continue;
+
+            double residual = fx * fx + fy * fy;
+            if (!valid_coord (e [0], e [1]) || !valid_coord (e [2], e [3]) ||
+                !valid_coord (e [4], e [5]) || !(residual < prev_residual [i]))
+            {
+                // There is nothing to fall back to from the first guess
+                if (prev_residual [i] == HUGE_VAL)
+                    continue;
+                u [i * 2] = (u [i * 2] + prev_u [i * 2]) * 0.5F;
+                u [i * 2 + 1] = (u [i * 2 + 1] + prev_u [i * 2 + 1]) * 0.5F;
+                active [unfinished++] = i;
+                continue;
+            }
+
+            // Where the callbacks compress strongly, the offset points hardly
+            // move, and the differences are lost in float rounding; see
+            // GetTransformedDistances()
+            if (absolute (e [2] - e [0]) + absolute (e [3] - e [1]) < 0.00001 ||
+                absolute (e [4] - e [0]) + absolute (e [5] - e [1]) < 0.00001)
+            {
+                delta [i] *= 2;
+                active [unfinished++] = i;
+                continue;
+            }
+
+            double j00 = (double (e [2]) - e [0]) / delta [i];
+            double j10 = (double (e [3]) - e [1]) / delta [i];
+            double j01 = (double (e [4]) - e [0]) / delta [i];
+            double j11 = (double (e [5]) - e [1]) / delta [i];
+            double det = j00 * j11 - j01 * j10;
+            if (!(absolute (det) > 1e-12) || !(absolute (det) < HUGE_VAL))
+                continue; // The callbacks collapse the neighbourhood
+
+            prev_u [i * 2] = u [i * 2];
+            prev_u [i * 2 + 1] = u [i * 2 + 1];
+            prev_residual [i] = residual;
+            u [i * 2] -= (j11 * fx - j01 * fy) / det;
+            u [i * 2 + 1] -= (j00 * fy - j10 * fx) / det;
+            active [unfinished++] = i;
+        }
+        n = unfinished;
+    }
+}
+
+void lfModifier::PrepareCoordColumns (float x, int count, lfCoordColumns &columns) const
+{
+    std::vector<lfCallbackData*>* callbacks = (std::vector<lfCallbackData*>*)CoordCallbacks;
+    int first = 0;
+    float step = NormScale;
+
+    columns.Index = -1;
+    columns.Table.clear ();
+    if (count <= 0)
+        return;
+
+    // The same folding of a leading scale as in GenerateCoordRow()
+    if (first < callbacks->size() &&
+        ((lfCoordCallbackData *)callbacks->at(first))->callback == ModifyCoord_Scale)
+    {
+        float scale = *(float *)callbacks->at(first)->data;
+        x *= scale;
+        step *= scale;
+        first++;
+    }
+
+    if (first < callbacks->size())
+    {
+        lfCoordCallbackData *cd = (lfCoordCallbackData *)callbacks->at(first);
+        if (cd->columns_callback)
+        {
+            columns.Table.resize (count * 2);
+            LF_PROFILE_CALLBACK (cd->columns_callback, count);
+            cd->columns_callback (cd->data, x, step, &columns.Table [0], count);
+            columns.Index = first;
+        }
+    }
+}
+
+int lfModifier::GenerateCoordRow (float x, float y, float *res, int count,
+                                  const lfCoordColumns *columns) const
+{
+    std::vector<lfCallbackData*>* callbacks = (std::vector<lfCallbackData*>*)CoordCallbacks;
+    int first = 0;
+    float step = NormScale;
+
+    // A leading scale multiplies the whole row; fold it into the generation
+    if (first < callbacks->size() &&
+        ((lfCoordCallbackData *)callbacks->at(first))->callback == ModifyCoord_Scale)
+    {
+        float scale = *(float *)callbacks->at(first)->data;
+        x *= scale;
+        y *= scale;
+        step *= scale;
+        first++;
+    }
+
+    if (first < callbacks->size())
+    {
+        lfCoordCallbackData *cd = (lfCoordCallbackData *)callbacks->at(first);
+        if (columns && columns->Index == first)
+        {
+            LF_PROFILE_CALLBACK (cd->table_row_callback, count);
+            cd->table_row_callback (cd->data, y, &columns->Table [0], res, count);
+            return first + 1;
+        }
+        if (cd->row_callback)
+        {
+            LF_PROFILE_CALLBACK (cd->row_callback, count);
+            cd->row_callback (cd->data, x, y, step, res, count);
+            return first + 1;
+        }
+    }
+
+    // Every pixel from the row start; adding up step drifts by up to a pixel
+    // over wide rows
+    for (int i = 0; i < count; i++)
+    {
+        res [i * 2] = x + i * step;
+        res [i * 2 + 1] = y;
+    }
+    return first;
+}
+
+void lfModifier::ModifyCoord_Scale (void *data, float *iocoord, int count)
+{
+    float scale = *(float *)data;
+
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
+    {
+        iocoord [0] *= scale;
+        iocoord [1] *= scale;
+    }
+}
+
+// The Newton searches of the inverse models, shared with their Jacobian
+// versions.  They return false if the search does not converge, or if it
+// ends at a negative radius, which does not make sense at all.
+static inline bool undist_poly3_radius (double rd, float inv_k1_, double &ru
+                                        LF_PROFILE_NEWTON_PARAM)
+{
+    float rd_div_k1_ = rd * inv_k1_;
+
+    // Use Newton's method to avoid dealing with complex numbers
+    // When carefully tuned this works almost as fast as Cardano's
+    // method (and we don't use complex numbers in it, which is
+    // required for a full solution!)
+    //
+    // Original function: Rd = k1_ * Ru^3 + Ru
+    // Target function:   k1_ * Ru^3 + Ru - Rd = 0
+    // Divide by k1_:     Ru^3 + Ru/k1_ - Rd/k1_ = 0
+    // Derivative:        3 * Ru^2 + 1/k1_
+    ru = rd;
+    for (int step = 0; ; step++)
+    {
+        double fru = ru * ru * ru + ru * inv_k1_ - rd_div_k1_;
+        if (fru >= -NEWTON_EPS && fru < NEWTON_EPS)
+        {
+            LF_PROFILE_NEWTON_STEP (step);
+            break;
+        }
+        if (step > 5)
+        {
+            // Does not converge, no real solution in this area?
+            LF_PROFILE_NEWTON_FAIL ();
+            return false;
+        }
+
+        ru -= fru / (3 * ru * ru + inv_k1_);
+    }
+    return ru >= 0.0;
+}
+
+static inline bool undist_poly5_radius (double rd, float k1, float k2, double &ru
+                                        LF_PROFILE_NEWTON_PARAM)
+{
+    // Use Newton's method
+    ru = rd;
+    for (int step = 0; ; step++)
+    {
+        double ru2 = ru * ru;
+        double fru = ru * (1.0 + k1 * ru2 + k2 * ru2 * ru2) - rd;
+        if (fru >= -NEWTON_EPS && fru < NEWTON_EPS)
+        {
+            LF_PROFILE_NEWTON_STEP (step);
+            break;
+        }
+        if (step > 5)
+        {
+            // Does not converge, no real solution in this area?
+            LF_PROFILE_NEWTON_FAIL ();
+            return false;
+        }
+
+        ru -= fru / (1.0 + 3 * k1 * ru2 + 5 * k2 * ru2 * ru2);
+    }
+    return ru >= 0.0;
+}
+
+static inline bool undist_ptlens_radius (double rd, float a_, float b_, float c_,
+                                         double &ru LF_PROFILE_NEWTON_PARAM)
+{
+    // Use Newton's method
+    ru = rd;
+    for (int step = 0; ; step++)
+    {
+        double fru = ru * (a_ * ru * ru * ru + b_ * ru * ru + c_ * ru + 1) - rd;
+        if (fru >= -NEWTON_EPS && fru < NEWTON_EPS)
+        {
+            LF_PROFILE_NEWTON_STEP (step);
+            break;
+        }
+        if (step > 5)
+        {
+            // Does not converge, no real solution in this area?
+            LF_PROFILE_NEWTON_FAIL ();
+            return false;
+        }
+
+        ru -= fru / (4 * a_ * ru * ru * ru + 3 * b_ * ru * ru + 2 * c_ * ru + 1);
+    }
+    return ru >= 0.0;
+}
+
+void lfModifier::ModifyCoord_UnDist_Poly3 (void *data, float *iocoord, int count)
+{
+    // See "Note about PT-based distortion models" at the top of this file.
+    const float inv_k1_ = *(float *)data;
+
+    LF_PROFILE_NEWTON_BEGIN ();
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
+    {
+        float x = iocoord [0];
+        float y = iocoord [1];
+        double rd = sqrt (x * x + y * y);
+        if (rd == 0.0)
+            continue;
+
+        double ru;
+        if (!undist_poly3_radius (rd, inv_k1_, ru LF_PROFILE_NEWTON_ARG))
+            continue;
+
+        ru /= rd;
+        iocoord [0] = x * ru;
+        iocoord [1] = y * ru;
+    }
+    LF_PROFILE_NEWTON_END (ModifyCoord_UnDist_Poly3);
+}
+
+void lfModifier::ModifyCoord_Dist_Poly3 (void *data, float *iocoord, int count)
+{
+    // See "Note about PT-based distortion models" at the top of this file.
     // Rd = Ru * (1 + k1_ * Ru^2)
     const float k1_ = *(float *)data;
 
@@ -572,6 +1281,7 @@ void lfModifier::ModifyCoord_UnDist_Poly5 (void *data, float *iocoord, int count
     float k1 = param [0];
     float k2 = param [1];
 
+    LF_PROFILE_NEWTON_BEGIN ();
     for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
     {
         float x = iocoord [0];
@@ -580,30 +1290,15 @@ void lfModifier::ModifyCoord_UnDist_Poly5 (void *data, float *iocoord, int count
         if (rd == 0.0)
             continue;
 
-        // Use Newton's method
-        double ru = rd;
-        for (int step = 0; ; step++)
-        {
-            double ru2 = ru * ru;
-            double fru = ru * (1.0 + k1 * ru2 + k2 * ru2 * ru2) - rd;
-            if (fru >= -NEWTON_EPS && fru < NEWTON_EPS)
-                break;
-            if (step > 5)
-                // Does not converge, no real solution in this area?
-                goto next_pixel;
-
-            ru -= fru / (1.0 + 3 * k1 * ru2 + 5 * k2 * ru2 * ru2);
-        }
-        if (ru < 0.0)
-            continue; // Negative radius does not make sense at all
+        double ru;
+        if (!undist_poly5_radius (rd, k1, k2, ru LF_PROFILE_NEWTON_ARG))
+            continue;
 
         ru /= rd;
         iocoord [0] = x * ru;
         iocoord [1] = y * ru;
-
-    next_pixel:
-        ;
     }
+    LF_PROFILE_NEWTON_END (ModifyCoord_UnDist_Poly5);
 }
 
 void lfModifier::ModifyCoord_Dist_Poly5 (void *data, float *iocoord, int count)
@@ -633,6 +1328,7 @@ void lfModifier::ModifyCoord_UnDist_PTLens (void *data, float *iocoord, int coun
     float b_ = param [1];
     float c_ = param [2];
 
+    LF_PROFILE_NEWTON_BEGIN ();
     for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
     {
         float x = iocoord [0];
@@ -641,29 +1337,15 @@ void lfModifier::ModifyCoord_UnDist_PTLens (void *data, float *iocoord, int coun
         if (rd == 0.0)
             continue;
 
-        // Use Newton's method
-        double ru = rd;
-        for (int step = 0; ; step++)
-        {
-            double fru = ru * (a_ * ru * ru * ru + b_ * ru * ru + c_ * ru + 1) - rd;
-            if (fru >= -NEWTON_EPS && fru < NEWTON_EPS)
-                break;
-            if (step > 5)
-                // Does not converge, no real solution in this area?
-                goto next_pixel;
-
-            ru -= fru / (4 * a_ * ru * ru * ru + 3 * b_ * ru * ru + 2 * c_ * ru + 1);
-        }
-        if (ru < 0.0)
-            continue; // Negative radius does not make sense at all
+        double ru;
+        if (!undist_ptlens_radius (rd, a_, b_, c_, ru LF_PROFILE_NEWTON_ARG))
+            continue;
 
         ru /= rd;
         iocoord [0] = x * ru;
         iocoord [1] = y * ru;
-
-    next_pixel:
-        ;
     }
+    LF_PROFILE_NEWTON_END (ModifyCoord_UnDist_PTLens);
 }
 
 void lfModifier::ModifyCoord_Dist_PTLens (void *data, float *iocoord, int count)
@@ -712,493 +1394,294 @@ void lfModifier::ModifyCoord_Dist_ACM (void *data, float *iocoord, int count)
     }
 }
 
-void lfModifier::ModifyCoord_Geom_FishEye_Rect (void *data, float *iocoord, int count)
+bool lfModifier::IsRadialCallback (lfModifyCoordFunc callback)
 {
-    const float inv_dist = ((float *)data) [0];
-
-    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
-    {
-        float x = iocoord [0];
-        float y = iocoord [1];
-
-        float r = sqrt (x * x + y * y);
-        float rho, theta = r * inv_dist;
-
-        if (theta >= M_PI / 2.0)
-            rho = 1.6e16F;
-        else if (theta == 0.0)
-            rho = 1.0;
-        else
-            rho = tan (theta) / theta;
-
-        iocoord [0] = rho * x;
-        iocoord [1] = rho * y;
-    }
+    return callback == ModifyCoord_Dist_Poly3 || callback == ModifyCoord_UnDist_Poly3 ||
+        callback == ModifyCoord_Dist_Poly5 || callback == ModifyCoord_UnDist_Poly5 ||
+        callback == ModifyCoord_Dist_PTLens || callback == ModifyCoord_UnDist_PTLens ||
+        callback == ModifyCoord_Scale
+#ifdef VECTORIZATION_SIMD128
+        || callback == ModifyCoord_Dist_Poly3_SIMD128
+        || callback == ModifyCoord_Dist_Poly5_SIMD128
+        || callback == ModifyCoord_Dist_PTLens_SIMD128
+#endif
+        ;
 }
 
-void lfModifier::ModifyCoord_Geom_Rect_FishEye (void *data, float *iocoord, int count)
+bool lfModifier::InvertRadialCallback (
+    lfModifyCoordFunc callback, const void *data, double &r)
 {
-    const float inv_dist = ((float *)data) [0];
-
-    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
-    {
-        float x = iocoord [0];
-        float y = iocoord [1];
-
-        float theta, r = sqrt (x * x + y * y) * inv_dist;
-        if (r == 0.0)
-            theta = 1.0;
-        else
-            theta = atan (r) / r;
-
-        iocoord [0] = theta * x;
-        iocoord [1] = theta * y;
-    }
+    const float *param = (const float *)data;
+    // The Newton searches are not counted; this is not a callback run
+    LF_PROFILE_NEWTON_BEGIN ();
+
+    // The inverse of an inverse model is its forward polynomial
+    if (callback == ModifyCoord_Scale)
+        r /= param [0];
+    else if (callback == ModifyCoord_UnDist_Poly3)
+        r *= 1 + r * r / param [0];
+    else if (callback == ModifyCoord_UnDist_Poly5)
+        r *= 1 + param [0] * r * r + param [1] * r * r * r * r;
+    else if (callback == ModifyCoord_UnDist_PTLens)
+        r *= param [0] * r * r * r + param [1] * r * r + param [2] * r + 1;
+    // The one of a forward model is the search of its inverse model
+#ifdef VECTORIZATION_SIMD128
+    else if (callback == ModifyCoord_Dist_Poly3 || callback == ModifyCoord_Dist_Poly3_SIMD128)
+#else
+    else if (callback == ModifyCoord_Dist_Poly3)
+#endif
+        return !param [0] || undist_poly3_radius (r, 1 / param [0], r LF_PROFILE_NEWTON_ARG);
+#ifdef VECTORIZATION_SIMD128
+    else if (callback == ModifyCoord_Dist_Poly5 || callback == ModifyCoord_Dist_Poly5_SIMD128)
+#else
+    else if (callback == ModifyCoord_Dist_Poly5)
+#endif
+        return undist_poly5_radius (r, param [0], param [1], r LF_PROFILE_NEWTON_ARG);
+    else // ModifyCoord_Dist_PTLens
+        return undist_ptlens_radius (r, param [0], param [1], param [2],
+                                     r LF_PROFILE_NEWTON_ARG);
+    return r >= 0.0;
 }
 
-void lfModifier::ModifyCoord_Geom_Panoramic_Rect (
-    void *data, float *iocoord, int count)
+// The callbacks of the distortion models move a point p by a radial factor,
+// p' = p g (r).  Their derivative is g I + h p p^T, with h = g' (r) / r.
+static inline void chain_radial_jacobian (
+    float *jacobian, double x, double y, double g, double h)
 {
-    const float inv_dist = ((float *)data) [0];
-    const float dist = ((float *)data) [1];
-
-    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
-    {
-        float x = iocoord [0] * inv_dist;
-        float y = iocoord [1];
-
-        iocoord [0] = dist * tan (x);
-        iocoord [1] = y / cos (x);
-    }
+    _lf_chain_jacobian (jacobian, g + h * x * x, h * x * y, h * x * y, g + h * y * y);
 }
 
-
-void lfModifier::ModifyCoord_Geom_Rect_Panoramic (
-    void *data, float *iocoord, int count)
+// The inverse models are differentiated at the point p which their Newton
+// search found, as the inverse of the derivative of the forward model there
+static inline void chain_radial_jacobian_inverse (
+    float *jacobian, double x, double y, double g, double h)
 {
-    const float inv_dist = ((float *)data) [0];
-    const float dist = ((float *)data) [1];
-
-    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
-    {
-        float x = iocoord [0];
-        float y = iocoord [1];
-
-        iocoord [0] = dist * atan (x * inv_dist);
-        iocoord [1] = y * cos (iocoord [0] * inv_dist);
-    }
+    double xx = g + h * x * x, xy = h * x * y, yy = g + h * y * y;
+    double inv_det = 1.0 / (xx * yy - xy * xy);
+    _lf_chain_jacobian (jacobian, yy * inv_det, -xy * inv_det, -xy * inv_det,
+                        xx * inv_det);
 }
 
-void lfModifier::ModifyCoord_Geom_FishEye_Panoramic (
-    void *data, float *iocoord, int count)
+// Points which the Newton search of an inverse model leaves unsolved keep
+// their coordinates, like in the plain callbacks, but have no Jacobian
+static inline void unsolved_jacobian (float *jacobian)
 {
-    const float inv_dist = ((float *)data) [0];
-    const float dist = ((float *)data) [1];
-
-    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
-    {
-        float x = iocoord [0];
-        float y = iocoord [1];
-
-        double r = sqrt (x * x + y * y);
-        double theta = r * inv_dist;
-        double s = (theta == 0.0) ? inv_dist : (sin (theta) / r);
-
-        double vx = cos (theta);  //  z' -> x
-        double vy = s * x;        //  x' -> y
-
-        iocoord [0] = dist * atan2 (vy, vx);
-        iocoord [1] = dist * s * y / sqrt (vx * vx + vy * vy);
-    }
+    jacobian [0] = jacobian [1] = jacobian [2] = jacobian [3] = NAN;
 }
 
-void lfModifier::ModifyCoord_Geom_Panoramic_FishEye (
-    void *data, float *iocoord, int count)
+void lfModifier::ModifyCoordJacobian_Scale (
+    void *data, float *iocoord, float *jacobian, int count)
 {
-    const float inv_dist = ((float *)data) [0];
-    const float dist = ((float *)data) [1];
+    float scale = *(float *)data;
 
-    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2, jacobian += 4)
     {
-        float x = iocoord [0];
-        float y = iocoord [1];
-
-        double phi = x * inv_dist;
-        double s = dist * sin (phi);   // y' -> x
-        double r = sqrt (s * s + y * y);
-        double theta = 0.0;
-
-        if (r==0.0)
-            theta = 0.0;
-        else
-            theta = dist * atan2 (r, dist * cos (phi)) / r;
-
-        iocoord [0] = theta * s;
-        iocoord [1] = theta * y;
+        iocoord [0] *= scale;
+        iocoord [1] *= scale;
+        _lf_chain_jacobian (jacobian, scale, 0, 0, scale);
     }
 }
 
-void lfModifier::ModifyCoord_Geom_ERect_Rect (void *data, float *iocoord, int count)
+void lfModifier::ModifyCoordJacobian_UnDist_Poly3 (
+    void *data, float *iocoord, float *jacobian, int count)
 {
-    const float inv_dist = ((float *)data) [0];
-    const float dist = ((float *)data) [1];
+    // Rd = Ru * (1 + k1_ * Ru^2), see ModifyCoord_Dist_Poly3
+    const float inv_k1_ = *(float *)data;
+    const double k1_ = 1.0 / inv_k1_;
 
-    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
+    LF_PROFILE_NEWTON_BEGIN ();
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2, jacobian += 4)
     {
         float x = iocoord [0];
         float y = iocoord [1];
-
-        double phi = x * inv_dist;
-        double theta = -y * inv_dist + M_PI / 2.0;
-        if (theta < 0)
+        double rd = sqrt (x * x + y * y), ru;
+        if (rd != 0.0)
         {
-            theta = -theta;
-            phi += M_PI;
-        }
-        if (theta > M_PI)
-        {
-            theta = 2 * M_PI - theta;
-            phi += M_PI;
+            if (!undist_poly3_radius (rd, inv_k1_, ru LF_PROFILE_NEWTON_ARG))
+            {
+                unsolved_jacobian (jacobian);
+                continue;
+            }
+            ru /= rd;
+            iocoord [0] = x * ru;
+            iocoord [1] = y * ru;
         }
 
-        iocoord [0] = dist * tan (phi);
-        iocoord [1] = dist / (tan (theta) * cos (phi));
+        const double xu = iocoord [0];
+        const double yu = iocoord [1];
+        chain_radial_jacobian_inverse (jacobian, xu, yu, 1 + k1_ * (xu * xu + yu * yu),
+                                       2 * k1_);
     }
+    LF_PROFILE_NEWTON_END (ModifyCoord_UnDist_Poly3);
 }
 
-void lfModifier::ModifyCoord_Geom_Rect_ERect (void *data, float *iocoord, int count)
+void lfModifier::ModifyCoordJacobian_Dist_Poly3 (
+    void *data, float *iocoord, float *jacobian, int count)
 {
-    const float dist = ((float *)data) [1];
+    const float k1_ = *(float *)data;
 
-    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2, jacobian += 4)
     {
-        float x = iocoord [0];
-        float y = iocoord [1];
+        const float x = iocoord [0];
+        const float y = iocoord [1];
+        const float poly2 = 1 + k1_ * (x * x + y * y);
 
-        iocoord [0] = dist * atan2 (x, dist);
-        iocoord [1] = dist * atan2 (y, sqrt (dist * dist + x * x));
+        iocoord [0] = x * poly2;
+        iocoord [1] = y * poly2;
+        chain_radial_jacobian (jacobian, x, y, poly2, 2 * k1_);
     }
 }
 
-void lfModifier::ModifyCoord_Geom_ERect_FishEye (void *data, float *iocoord, int count)
+void lfModifier::ModifyCoordJacobian_UnDist_Poly5 (
+    void *data, float *iocoord, float *jacobian, int count)
 {
-    const float inv_dist = ((float *)data) [0];
-    const float dist = ((float *)data) [1];
+    float *param = (float *)data;
+    const float k1 = param [0];
+    const float k2 = param [1];
 
-    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
+    LF_PROFILE_NEWTON_BEGIN ();
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2, jacobian += 4)
     {
         float x = iocoord [0];
         float y = iocoord [1];
-
-        double phi = x * inv_dist;
-        double theta = -y * inv_dist + M_PI / 2;
-        if (theta < 0)
+        double rd = sqrt (x * x + y * y), ru;
+        if (rd != 0.0)
         {
-            theta = -theta;
-            phi += M_PI;
-        }
-        if (theta > M_PI)
-        {
-            theta = 2 * M_PI - theta;
-            phi += M_PI;
+            if (!undist_poly5_radius (rd, k1, k2, ru LF_PROFILE_NEWTON_ARG))
+            {
+                unsolved_jacobian (jacobian);
+                continue;
+            }
+            ru /= rd;
+            iocoord [0] = x * ru;
+            iocoord [1] = y * ru;
         }
 
-        double s = sin (theta);
-        double vx = s * sin (phi); //  y' -> x
-        double vy = cos (theta);   //  z' -> y
-
-        double r = sqrt (vx * vx + vy * vy);
-
-        theta = dist * atan2 (r, s * cos (phi));
-
-        r = 1.0 / r;
-        iocoord [0] = theta * vx * r;
-        iocoord [1] = theta * vy * r;
-    }
-}
-
-void lfModifier::ModifyCoord_Geom_FishEye_ERect (void *data, float *iocoord, int count)
-{
-    const float inv_dist = ((float *)data) [0];
-    const float dist = ((float *)data) [1];
-
-    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
-    {
-        float x = iocoord [0];
-        float y = iocoord [1];
-
-        double r = sqrt (x * x + y * y);
-        double theta = r * inv_dist;
-        double s = (theta == 0.0) ? inv_dist : (sin (theta) / r);
-
-        double vx = cos (theta);
-        double vy = s * x;
-
-        iocoord [0] = dist * atan2 (vy, vx);
-        iocoord [1] = dist * atan (s * y / sqrt (vx * vx + vy * vy));
+        const double xu = iocoord [0];
+        const double yu = iocoord [1];
+        const double ru2 = xu * xu + yu * yu;
+        chain_radial_jacobian_inverse (jacobian, xu, yu, 1 + k1 * ru2 + k2 * ru2 * ru2,
+                                       2.0 * k1 + 4.0 * k2 * ru2);
     }
+    LF_PROFILE_NEWTON_END (ModifyCoord_UnDist_Poly5);
 }
 
-void lfModifier::ModifyCoord_Geom_ERect_Panoramic (void *data, float *iocoord, int count)
+void lfModifier::ModifyCoordJacobian_Dist_Poly5 (
+    void *data, float *iocoord, float *jacobian, int count)
 {
-    const float inv_dist = ((float *)data) [0];
-    const float dist = ((float *)data) [1];
+    float *param = (float *)data;
+    const float k1 = param [0];
+    const float k2 = param [1];
 
-    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2, jacobian += 4)
     {
-        float y = iocoord [1];
-        iocoord [1] = dist * tan (y * inv_dist);
-    }
-}
-
-void lfModifier::ModifyCoord_Geom_Panoramic_ERect (void *data, float *iocoord, int count)
-{
-    const float inv_dist = ((float *)data) [0];
-    const float dist = ((float *)data) [1];
+        const float x = iocoord [0];
+        const float y = iocoord [1];
+        const float ru2 = x * x + y * y;
+        const float poly4 = (1.0 + k1 * ru2 + k2 * ru2 * ru2);
 
-    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
-    {
-        float y = iocoord [1];
-        iocoord [1] = dist * atan (y * inv_dist);
+        iocoord [0] = x * poly4;
+        iocoord [1] = y * poly4;
+        chain_radial_jacobian (jacobian, x, y, poly4, 2 * k1 + 4 * k2 * ru2);
     }
 }
 
-void lfModifier::ModifyCoord_Geom_Orthographic_ERect (void *data, float *iocoord, int count)
-{
-    const float inv_dist = ((float *)data) [0];
-    const float dist = ((float *)data) [1];
-
-    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
-    {
-        float x = iocoord [0];
-        float y = iocoord [1];
-
-        double r     = sqrt(x * x + y * y);
-        double theta = 0.0;
-
-        if (r < dist)
-            theta = asin (r * inv_dist);
-        else
-            theta = M_PI / 2.0;
-
-        double phi   = atan2 (y, x);
-
-        double s = (theta == 0.0) ? inv_dist : (sin (theta) / (theta * dist) );
-
-        double vx = cos (theta);
-        double vy = s * dist * theta * cos (phi);
-
-        iocoord [0] = dist * atan2 (vy, vx);
-        iocoord [1] = dist * atan (s * dist * theta * sin (phi) / sqrt (vx * vx + vy * vy));
-    }
-};
-
-void lfModifier::ModifyCoord_Geom_ERect_Orthographic (void *data, float *iocoord, int count)
+void lfModifier::ModifyCoordJacobian_UnDist_PTLens (
+    void *data, float *iocoord, float *jacobian, int count)
 {
-    const float inv_dist = ((float *)data) [0];
-    const float dist = ((float *)data) [1];
+    float *param = (float *)data;
+    const float a_ = param [0];
+    const float b_ = param [1];
+    const float c_ = param [2];
 
-    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
+    LF_PROFILE_NEWTON_BEGIN ();
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2, jacobian += 4)
     {
         float x = iocoord [0];
         float y = iocoord [1];
-
-        double phi   = x * inv_dist;
-        double theta = -y * inv_dist + M_PI / 2;
-        if (theta < 0)
-        {
-            theta = -theta;
-            phi += M_PI;
-        }
-        if (theta > M_PI)
-        {
-            theta = 2 * M_PI - theta;
-            phi += M_PI;
-        }
-
-        double s  = sin (theta);
-        double vx = s * sin (phi); //  y' -> x
-        double vy = cos (theta);   //  z' -> y
-
-        theta = atan2 (sqrt (vx * vx + vy * vy), s * cos (phi));
-        phi   = atan2 (vy, vx);
-        double rho  = dist * sin (theta);
-        iocoord [0] = rho * cos (phi);
-        iocoord [1] = rho * sin (phi);
-     }
-};
-
-#define EPSLN   1.0e-10
-
-void lfModifier::ModifyCoord_Geom_Stereographic_ERect (void *data, float *iocoord, int count)
-{
-    const float inv_dist = ((float *)data) [0];
-    const float dist = ((float *)data) [1];
-    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
-    {
-        float x = iocoord [0] * inv_dist;
-        float y = iocoord [1] * inv_dist;
-
-        double rh = sqrt (x * x + y * y);
-        double c  = 2.0 * atan (rh / 2.0);
-        double sinc = sin (c);
-        double cosc = cos (c);
-
-        iocoord [0] = 0;
-        if(fabs (rh) <= EPSLN)
-        {
-            iocoord [1] = 1.6e16F;
-        }
-        else
+        double rd = sqrt (x * x + y * y), ru;
+        if (rd != 0.0)
         {
-            iocoord [1] = asin (y * sinc / rh) * dist;
-            if((fabs (cosc) >= EPSLN) || (fabs (x) >= EPSLN))
+            if (!undist_ptlens_radius (rd, a_, b_, c_, ru LF_PROFILE_NEWTON_ARG))
             {
-                iocoord [0] = atan2 (x * sinc, cosc * rh) * dist;
+                unsolved_jacobian (jacobian);
+                continue;
             }
-            else
-            {
-                iocoord [0] = 1.6e16F;
-            };
-        };
-    };
-};
-
-void lfModifier::ModifyCoord_Geom_ERect_Stereographic (void *data, float *iocoord, int count)
-{
-    const float inv_dist = ((float *)data) [0];
-    const float dist = ((float *)data) [1];
-
-    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
-    {
-        float lon = iocoord [0] * inv_dist;
-        float lat = iocoord [1] * inv_dist;
-
-        double cosphi = cos (lat);
-        double ksp = dist * 2.0 / (1.0 + cosphi * cos (lon));
+            ru /= rd;
+            iocoord [0] = x * ru;
+            iocoord [1] = y * ru;
+        }
 
-        iocoord [0] = ksp * cosphi * sin (lon);
-        iocoord [1] = ksp * sin (lat);
+        const double xu = iocoord [0];
+        const double yu = iocoord [1];
+        const double ru2 = xu * xu + yu * yu;
+        const double r = sqrt (ru2);
+        // c_ / r goes with p p^T, which vanishes faster in the centre
+        chain_radial_jacobian_inverse (jacobian, xu, yu,
+                                       a_ * ru2 * r + b_ * ru2 + c_ * r + 1,
+                                       3.0 * a_ * r + 2.0 * b_ + (r > 0 ? c_ / r : 0));
     }
-};
+    LF_PROFILE_NEWTON_END (ModifyCoord_UnDist_PTLens);
+}
 
-void lfModifier::ModifyCoord_Geom_Equisolid_ERect (void *data, float *iocoord, int count)
+void lfModifier::ModifyCoordJacobian_Dist_PTLens (
+    void *data, float *iocoord, float *jacobian, int count)
 {
-    const float inv_dist = ((float *)data) [0];
-    const float dist = ((float *)data) [1];
-    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
-    {
-        float x = iocoord [0];
-        float y = iocoord [1];
-
-        double r = sqrt (x * x + y * y);
-        double theta = 0.0;
-
-        if (r < dist*2.0)
-            theta = 2.0 * asin (r * inv_dist / 2.0);
-        else
-            theta = M_PI / 2.0;
-
-        double phi = atan2 (y, x);
-        double s = (theta == 0.0) ? inv_dist : (sin (theta) / (dist * theta));
-
-        double vx = cos (theta);
-        double vy = s * dist * theta * cos (phi);
-
-        iocoord [0] = dist * atan2 (vy, vx);
-        iocoord [1] = dist * atan (s * dist * theta * sin (phi) / sqrt (vx * vx + vy * vy));
-    };
-};
+    float *param = (float *)data;
+    const float a_ = param [0];
+    const float b_ = param [1];
+    const float c_ = param [2];
 
-void lfModifier::ModifyCoord_Geom_ERect_Equisolid (void *data, float *iocoord, int count)
-{
-    const float dist = ((float *)data) [1];
-    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2, jacobian += 4)
     {
-        double lambda = iocoord [0] / dist;
-        double phi = iocoord [1] / dist;
-
-        if (fabs (cos(phi) * cos(lambda) + 1.0) <= EPSLN)
-        {
-            iocoord [0] = 1.6e16F;
-            iocoord [1] = 1.6e16F;
-        }
-        else
-        {
-            double k1 = sqrt (2.0 / (1 + cos(phi) * cos(lambda)));
-
-            iocoord [0] = dist * k1 * cos (phi) * sin (lambda);
-            iocoord [1] = dist * k1 * sin (phi);
-        };
-    };
-};
+        const float x = iocoord [0];
+        const float y = iocoord [1];
+        const float ru2 = x * x + y * y;
+        const float r = sqrtf (ru2);
+        const float poly3 = a_ * ru2 * r + b_ * ru2 + c_ * r + 1;
 
-#define THOBY_K1_PARM 1.47F
-#define THOBY_K2_PARM 0.713F
+        iocoord [0] = x * poly3;
+        iocoord [1] = y * poly3;
+        chain_radial_jacobian (jacobian, x, y, poly3,
+                               3 * a_ * r + 2 * b_ + (r > 0 ? c_ / r : 0));
+    }
+}
 
-void lfModifier::ModifyCoord_Geom_Thoby_ERect (void *data, float *iocoord, int count)
+void lfModifier::ModifyCoordJacobian_Dist_ACM (
+    void *data, float *iocoord, float *jacobian, int count)
 {
-    const float inv_dist = ((float *)data) [0];
-    const float dist = ((float *)data) [1];
-    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
-    {
-        float x = iocoord [0];
-        float y = iocoord [1];
-
-        double rho = sqrt (x * x + y * y) * inv_dist;
-        if(rho<-THOBY_K1_PARM || rho > THOBY_K1_PARM)
-        {
-            iocoord [0] = 1.6e16F;
-            iocoord [1] = 1.6e16F;
-        }
-        else
-        {
-            double theta = asin (rho / THOBY_K1_PARM) / THOBY_K2_PARM;
-            double phi   = atan2 (y, x);
-            double s     = (theta == 0.0) ? inv_dist : (sin (theta) / (dist * theta) );
-
-            double vx = cos (theta);
-            double vy = s * dist * theta * cos (phi);
-
-            iocoord [0] = dist * atan2 (vy, vx);
-            iocoord [1] = dist * atan (s * dist * theta * sin (phi) / sqrt (vx * vx + vy * vy));
-        };
-    };
-};
+    float *param = (float *)data;
+    const float k1 = param [0];
+    const float k2 = param [1];
+    const float k3 = param [2];
+    const float k4 = param [3];
+    const float k5 = param [4];
+    const float ACMScale = param [5];
+    const float ACMUnScale = param [6];
 
-void lfModifier::ModifyCoord_Geom_ERect_Thoby (void *data, float *iocoord, int count)
-{
-    const float inv_dist = ((float *)data) [0];
-    const float dist = ((float *)data) [1];
-    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2, jacobian += 4)
     {
-        float x = iocoord [0];
-        float y = iocoord [1];
-
-        double phi = x * inv_dist;
-        double theta = -y * inv_dist + M_PI / 2;
-        if (theta < 0)
-        {
-            theta = -theta;
-            phi += M_PI;
-        }
-        if (theta > M_PI)
-        {
-            theta = 2 * M_PI - theta;
-            phi += M_PI;
-        }
+        const float x = iocoord [0] * ACMScale;
+        const float y = iocoord [1] * ACMScale;
+        const float ru2 = x * x + y * y;
+        const float ru4 = ru2 * ru2;
+        const float common_term = 1.0 + k1 * ru2 + k2 * ru4 + k3 * ru4 * ru2 + 2 * (k4 * y + k5 * x);
 
-        double s  = sin (theta);
-        double vx = s * sin (phi); //  y' -> x
-        double vy = cos (theta);   //  z' -> y
-        theta = atan2 (sqrt (vx * vx + vy * vy), s * cos (phi));
-        phi   = atan2 (vy, vx);
-        double rho = THOBY_K1_PARM * dist * sin (theta * THOBY_K2_PARM);
+        iocoord [0] = (x * common_term + k5 * ru2) * ACMUnScale;
+        iocoord [1] = (y * common_term + k4 * ru2) * ACMUnScale;
 
-        iocoord [0] = rho * cos (phi);
-        iocoord [1] = rho * sin (phi);
-    };
-};
+        // The derivatives of common_term by x and y
+        const double radial = 2 * k1 + 4 * k2 * ru2 + 6 * k3 * ru4;
+        const double cx = radial * x + 2 * k5;
+        const double cy = radial * y + 2 * k4;
+        const double scale = double (ACMScale) * ACMUnScale;
+        _lf_chain_jacobian (jacobian,
+                            (common_term + x * cx + 2 * k5 * x) * scale,
+                            (x * cy + 2 * k5 * y) * scale,
+                            (y * cx + 2 * k4 * x) * scale,
+                            (common_term + y * cy + 2 * k4 * y) * scale);
+    }
+}
 
 //---------------------------// The C interface //---------------------------//
 
@@ -1215,12 +1698,6 @@ cbool lf_modifier_add_coord_callback_distortion (
     return modifier->AddCoordCallbackDistortion (*model, reverse);
 }
 
-cbool lf_modifier_add_coord_callback_geometry (
-    lfModifier *modifier, lfLensType from, lfLensType to)
-{
-    return modifier->AddCoordCallbackGeometry (from, to);
-}
-
 cbool lf_modifier_add_coord_callback_scale (
     lfModifier *modifier, float scale, cbool reverse)
 {
@@ -1232,8 +1709,29 @@ float lf_modifier_get_auto_scale (lfModifier *modifier, cbool reverse)
     return modifier->GetAutoScale (reverse);
 }
 
+cbool lf_modifier_get_valid_crop (
+    const lfModifier *modifier, float aspect, float *crop)
+{
+    return modifier->GetValidCrop (aspect, crop);
+}
+
 cbool lf_modifier_apply_geometry_distortion (
     lfModifier *modifier, float xu, float yu, int width, int height, float *res)
 {
     return modifier->ApplyGeometryDistortion (xu, yu, width, height, res);
 }
+
+cbool lf_modifier_apply_geometry_distortion_points (
+    const lfModifier *modifier, const float *coord, float *res, int count,
+    cbool inverse, unsigned char *status)
+{
+    return modifier->ApplyGeometryDistortionPoints (coord, res, count, inverse, status);
+}
+
+cbool lf_modifier_apply_geometry_distortion_jacobian (
+    const lfModifier *modifier, float xu, float yu, int width, int height,
+    float *res, float *jacobian, float step)
+{
+    return modifier->ApplyGeometryDistortionJacobian (xu, yu, width, height, res,
+                                                      jacobian, step);
+}
@@ -0,0 +1,1457 @@
+/*
+    Lens projection (geometry) conversions
+*/
+
+#include "config.h"
+#include "lensfun.h"
+#include "lensfunprv.h"
+#include <math.h>
+#include "windows/mathconstants.h"
+
+#ifdef LF_SPLIT_MODULES
+static bool _lf_add_geometry (lfModifier *modifier, lfLensType from, lfLensType to)
+{
+    return modifier->AddCoordCallbackGeometry (from, to);
+}
+
+// Makes the projections available to lfModifier::Initialize() of the core
+// as soon as this side module is loaded
+static struct lfGeometryRegistration
+{
+    lfGeometryRegistration ()
+    {
+        _lf_add_coord_callback_geometry = _lf_add_geometry;
+    }
+} geometry_registration;
+#endif
+
+bool lfModifier::AddCoordCallbackGeometry (lfLensType from, lfLensType to, float focal /*=0*/)
+{
+    float tmp [2];
+    tmp [0] = 1 / FocalLengthNormalized;
+    tmp [1] = FocalLengthNormalized;
+
+    if(from == to)
+        return false;
+    if(from == LF_UNKNOWN)
+        return false;
+    if(to == LF_UNKNOWN)
+        return false;
+    // handle special cases
+    switch (from)
+    {
+        case LF_RECTILINEAR:
+            switch (to)
+            {
+                case LF_FISHEYE:
+                    AddCoordCallback (ModifyCoord_Geom_FishEye_Rect,
+                                      ModifyCoordJacobian_Geom_FishEye_Rect,
+                                      500, tmp, sizeof (tmp));
+                    return true;
+
+                case LF_PANORAMIC:
+                    AddCoordTableCallback (ModifyCoord_Geom_Panoramic_Rect,
+                                           ModifyCoordColumns_Geom_Panoramic_Rect,
+                                           ModifyCoordTableRow_Geom_Panoramic_Rect,
+                                           ModifyCoordJacobian_Geom_Panoramic_Rect,
+                                           500, tmp, sizeof (tmp));
+                    return true;
+
+                case LF_EQUIRECTANGULAR:
+                    AddCoordCallback (ModifyCoord_Geom_ERect_Rect,
+                                      ModifyCoordJacobian_Geom_ERect_Rect,
+                                      500, tmp, sizeof (tmp));
+                    return true;
+
+                default:
+                    // keep gcc 4.4+ happy
+                    break;
+            }
+            break;
+
+        case LF_FISHEYE:
+            switch (to)
+            {
+                case LF_RECTILINEAR:
+                    AddCoordCallback (ModifyCoord_Geom_Rect_FishEye,
+                                      ModifyCoordJacobian_Geom_Rect_FishEye,
+                                      500, tmp, sizeof (tmp));
+                    return true;
+
+                case LF_PANORAMIC:
+                    AddCoordCallback (ModifyCoord_Geom_Panoramic_FishEye,
+                                      ModifyCoordJacobian_Geom_Panoramic_FishEye,
+                                      500, tmp, sizeof (tmp));
+                    return true;
+
+                case LF_EQUIRECTANGULAR:
+                    AddCoordCallback (ModifyCoord_Geom_ERect_FishEye,
+                                      ModifyCoordJacobian_Geom_ERect_FishEye,
+                                      500, tmp, sizeof (tmp));
+                    return true;
+
+                default:
+                    // keep gcc 4.4+ happy
+                    break;
+            }
+            break;
+
+        case LF_PANORAMIC:
+            switch (to)
+            {
+                case LF_RECTILINEAR:
+                    AddCoordTableCallback (ModifyCoord_Geom_Rect_Panoramic,
+                                           ModifyCoordColumns_Geom_Rect_Panoramic,
+                                           ModifyCoordTableRow_Geom_Rect_Panoramic,
+                                           ModifyCoordJacobian_Geom_Rect_Panoramic,
+                                           500, tmp, sizeof (tmp));
+                    return true;
+
+                case LF_FISHEYE:
+                    AddCoordCallback (ModifyCoord_Geom_FishEye_Panoramic,
+                                      ModifyCoordJacobian_Geom_FishEye_Panoramic,
+                                      500, tmp, sizeof (tmp));
+                    return true;
+
+                case LF_EQUIRECTANGULAR:
+                    AddCoordTableCallback (ModifyCoord_Geom_ERect_Panoramic,
+                                           ModifyCoordColumns_Geom_Identity,
+                                           ModifyCoordTableRow_Geom_ERect_Panoramic,
+                                           ModifyCoordJacobian_Geom_ERect_Panoramic,
+                                           500, tmp, sizeof (tmp));
+                    return true;
+
+                default:
+                    // keep gcc 4.4+ happy
+                    break;
+            }
+            break;
+
+        case LF_EQUIRECTANGULAR:
+            switch (to)
+            {
+                case LF_RECTILINEAR:
+                    AddCoordTableCallback (ModifyCoord_Geom_Rect_ERect,
+                                           ModifyCoordColumns_Geom_Rect_ERect,
+                                           ModifyCoordTableRow_Geom_Rect_ERect,
+                                           ModifyCoordJacobian_Geom_Rect_ERect,
+                                           500, tmp, sizeof (tmp));
+                    return true;
+
+                case LF_FISHEYE:
+                    AddCoordCallback (ModifyCoord_Geom_FishEye_ERect,
+                                      ModifyCoordJacobian_Geom_FishEye_ERect,
+                                      500, tmp, sizeof (tmp));
+                    return true;
+
+                case LF_PANORAMIC:
+                    AddCoordTableCallback (ModifyCoord_Geom_Panoramic_ERect,
+                                           ModifyCoordColumns_Geom_Identity,
+                                           ModifyCoordTableRow_Geom_Panoramic_ERect,
+                                           ModifyCoordJacobian_Geom_Panoramic_ERect,
+                                           500, tmp, sizeof (tmp));
+                    return true;
+
+                default:
+                    // keep gcc 4.4+ happy
+                    break;
+            }
+        case LF_FISHEYE_ORTHOGRAPHIC:
+        case LF_FISHEYE_STEREOGRAPHIC:
+        case LF_FISHEYE_EQUISOLID:
+        case LF_FISHEYE_THOBY:
+        case LF_UNKNOWN:
+        default:
+            break;
+    };
+
+    //convert from input projection to target projection via equirectangular projection
+    switch(to)
+    {
+        case LF_RECTILINEAR:
+            AddCoordTableCallback (ModifyCoord_Geom_Rect_ERect,
+                                   ModifyCoordColumns_Geom_Rect_ERect,
+                                   ModifyCoordTableRow_Geom_Rect_ERect,
+                                   ModifyCoordJacobian_Geom_Rect_ERect,
+                                   500, tmp, sizeof (tmp));
+            break;
+        case LF_FISHEYE:
+            AddCoordCallback (ModifyCoord_Geom_FishEye_ERect,
+                                ModifyCoordJacobian_Geom_FishEye_ERect,
+                                500, tmp, sizeof (tmp));
+            break;
+        case LF_PANORAMIC:
+            AddCoordTableCallback (ModifyCoord_Geom_Panoramic_ERect,
+                                   ModifyCoordColumns_Geom_Identity,
+                                   ModifyCoordTableRow_Geom_Panoramic_ERect,
+                                   ModifyCoordJacobian_Geom_Panoramic_ERect,
+                                   500, tmp, sizeof (tmp));
+            break;
+        case LF_FISHEYE_ORTHOGRAPHIC:
+            AddCoordCallback (ModifyCoord_Geom_Orthographic_ERect,
+                                ModifyCoordJacobian_Geom_Orthographic_ERect,
+                                500, tmp, sizeof (tmp));
+            break;
+        case LF_FISHEYE_STEREOGRAPHIC:
+            AddCoordCallback (ModifyCoord_Geom_Stereographic_ERect,
+                                ModifyCoordJacobian_Geom_Stereographic_ERect,
+                                500, tmp, sizeof (tmp));
+            break;
+        case LF_FISHEYE_EQUISOLID:
+            AddCoordCallback (ModifyCoord_Geom_Equisolid_ERect,
+                                ModifyCoordJacobian_Geom_Equisolid_ERect,
+                                500, tmp, sizeof (tmp));
+            break;
+        case LF_FISHEYE_THOBY:
+            AddCoordCallback (ModifyCoord_Geom_Thoby_ERect,
+                                ModifyCoordJacobian_Geom_Thoby_ERect,
+                                500, tmp, sizeof (tmp));
+            break;
+        case LF_EQUIRECTANGULAR:
+        default:
+            //nothing to do
+            break;
+    };
+    switch(from)
+    {
+        case LF_RECTILINEAR:
+            AddCoordCallback (ModifyCoord_Geom_ERect_Rect,
+                                ModifyCoordJacobian_Geom_ERect_Rect,
+                                500, tmp, sizeof (tmp));
+            break;
+        case LF_FISHEYE:
+            AddCoordCallback (ModifyCoord_Geom_ERect_FishEye,
+                                ModifyCoordJacobian_Geom_ERect_FishEye,
+                                500, tmp, sizeof (tmp));
+            break;
+        case LF_PANORAMIC:
+            AddCoordTableCallback (ModifyCoord_Geom_ERect_Panoramic,
+                                   ModifyCoordColumns_Geom_Identity,
+                                   ModifyCoordTableRow_Geom_ERect_Panoramic,
+                                   ModifyCoordJacobian_Geom_ERect_Panoramic,
+                                   500, tmp, sizeof (tmp));
+            break;
+        case LF_FISHEYE_ORTHOGRAPHIC:
+            AddCoordCallback (ModifyCoord_Geom_ERect_Orthographic,
+                                ModifyCoordJacobian_Geom_ERect_Orthographic,
+                                500, tmp, sizeof (tmp));
+            break;
+        case LF_FISHEYE_STEREOGRAPHIC:
+            AddCoordCallback (ModifyCoord_Geom_ERect_Stereographic,
+                                ModifyCoordJacobian_Geom_ERect_Stereographic,
+                                500, tmp, sizeof (tmp));
+            break;
+        case LF_FISHEYE_EQUISOLID:
+            AddCoordCallback (ModifyCoord_Geom_ERect_Equisolid,
+                                ModifyCoordJacobian_Geom_ERect_Equisolid,
+                                500, tmp, sizeof (tmp));
+            break;
+        case LF_FISHEYE_THOBY:
+            AddCoordCallback (ModifyCoord_Geom_ERect_Thoby,
+                                ModifyCoordJacobian_Geom_ERect_Thoby,
+                                500, tmp, sizeof (tmp));
+            break;
+        case LF_EQUIRECTANGULAR:
+        default:
+            //nothing to do
+            break;
+    };
+    return true;
+}
+
+void lfModifier::ModifyCoord_Geom_FishEye_Rect (void *data, float *iocoord, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
+    {
+        float x = iocoord [0];
+        float y = iocoord [1];
+
+        float r = sqrt (x * x + y * y);
+        float rho, theta = r * inv_dist;
+
+        if (theta >= M_PI / 2.0)
+            rho = 1.6e16F;
+        else if (theta == 0.0)
+            rho = 1.0;
+        else
+            rho = tan (theta) / theta;
+
+        iocoord [0] = rho * x;
+        iocoord [1] = rho * y;
+    }
+}
+
+void lfModifier::ModifyCoord_Geom_Rect_FishEye (void *data, float *iocoord, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
+    {
+        float x = iocoord [0];
+        float y = iocoord [1];
+
+        float theta, r = sqrt (x * x + y * y) * inv_dist;
+        if (r == 0.0)
+            theta = 1.0;
+        else
+            theta = atan (r) / r;
+
+        iocoord [0] = theta * x;
+        iocoord [1] = theta * y;
+    }
+}
+
+void lfModifier::ModifyCoord_Geom_Panoramic_Rect (
+    void *data, float *iocoord, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+    const float dist = ((float *)data) [1];
+
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
+    {
+        float x = iocoord [0] * inv_dist;
+        float y = iocoord [1];
+
+        iocoord [0] = dist * tan (x);
+        iocoord [1] = y / cos (x);
+    }
+}
+
+// x' only depends on x, and y' is y divided by cos (x)
+void lfModifier::ModifyCoordColumns_Geom_Panoramic_Rect (
+    void *data, float x, float step, float *table, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+    const float dist = ((float *)data) [1];
+
+    for (int i = 0; i < count; i++, table += 2)
+    {
+        float xi = (x + i * step) * inv_dist;
+
+        table [0] = dist * tan (xi);
+        table [1] = cos (xi);
+    }
+}
+
+void lfModifier::ModifyCoordTableRow_Geom_Panoramic_Rect (
+    void *data, float y, const float *table, float *res, int count)
+{
+    for (float *end = res + count * 2; res < end; res += 2, table += 2)
+    {
+        res [0] = table [0];
+        res [1] = y / table [1];
+    }
+}
+
+
+void lfModifier::ModifyCoord_Geom_Rect_Panoramic (
+    void *data, float *iocoord, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+    const float dist = ((float *)data) [1];
+
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
+    {
+        float x = iocoord [0];
+        float y = iocoord [1];
+
+        iocoord [0] = dist * atan (x * inv_dist);
+        iocoord [1] = y * cos (iocoord [0] * inv_dist);
+    }
+}
+
+// x' only depends on x, and y' is y times a function of x
+void lfModifier::ModifyCoordColumns_Geom_Rect_Panoramic (
+    void *data, float x, float step, float *table, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+    const float dist = ((float *)data) [1];
+
+    for (int i = 0; i < count; i++, table += 2)
+    {
+        table [0] = dist * atan ((x + i * step) * inv_dist);
+        table [1] = cos (table [0] * inv_dist);
+    }
+}
+
+void lfModifier::ModifyCoordTableRow_Geom_Rect_Panoramic (
+    void *data, float y, const float *table, float *res, int count)
+{
+    for (float *end = res + count * 2; res < end; res += 2, table += 2)
+    {
+        res [0] = table [0];
+        res [1] = y * table [1];
+    }
+}
+
+void lfModifier::ModifyCoord_Geom_FishEye_Panoramic (
+    void *data, float *iocoord, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+    const float dist = ((float *)data) [1];
+
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
+    {
+        float x = iocoord [0];
+        float y = iocoord [1];
+
+        double r = sqrt (x * x + y * y);
+        double theta = r * inv_dist;
+        double s = (theta == 0.0) ? inv_dist : (sin (theta) / r);
+
+        double vx = cos (theta);  //  z' -> x
+        double vy = s * x;        //  x' -> y
+
+        iocoord [0] = dist * atan2 (vy, vx);
+        iocoord [1] = dist * s * y / sqrt (vx * vx + vy * vy);
+    }
+}
+
+void lfModifier::ModifyCoord_Geom_Panoramic_FishEye (
+    void *data, float *iocoord, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+    const float dist = ((float *)data) [1];
+
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
+    {
+        float x = iocoord [0];
+        float y = iocoord [1];
+
+        double phi = x * inv_dist;
+        double s = dist * sin (phi);   // y' -> x
+        double r = sqrt (s * s + y * y);
+        double theta = 0.0;
+
+        if (r==0.0)
+            theta = 0.0;
+        else
+            theta = dist * atan2 (r, dist * cos (phi)) / r;
+
+        iocoord [0] = theta * s;
+        iocoord [1] = theta * y;
+    }
+}
+
+void lfModifier::ModifyCoord_Geom_ERect_Rect (void *data, float *iocoord, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+    const float dist = ((float *)data) [1];
+
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
+    {
+        float x = iocoord [0];
+        float y = iocoord [1];
+
+        double phi = x * inv_dist;
+        double theta = -y * inv_dist + M_PI / 2.0;
+        if (theta < 0)
+        {
+            theta = -theta;
+            phi += M_PI;
+        }
+        if (theta > M_PI)
+        {
+            theta = 2 * M_PI - theta;
+            phi += M_PI;
+        }
+
+        iocoord [0] = dist * tan (phi);
+        iocoord [1] = dist / (tan (theta) * cos (phi));
+    }
+}
+
+void lfModifier::ModifyCoord_Geom_Rect_ERect (void *data, float *iocoord, int count)
+{
+    const float dist = ((float *)data) [1];
+
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
+    {
+        float x = iocoord [0];
+        float y = iocoord [1];
+
+        iocoord [0] = dist * atan2 (x, dist);
+        iocoord [1] = dist * atan2 (y, sqrt (dist * dist + x * x));
+    }
+}
+
+// x' only depends on x, and y' on y and the distance of x from the axis
+void lfModifier::ModifyCoordColumns_Geom_Rect_ERect (
+    void *data, float x, float step, float *table, int count)
+{
+    const float dist = ((float *)data) [1];
+
+    for (int i = 0; i < count; i++, table += 2)
+    {
+        float xi = x + i * step;
+
+        table [0] = dist * atan2 (xi, dist);
+        table [1] = sqrt (dist * dist + xi * xi);
+    }
+}
+
+void lfModifier::ModifyCoordTableRow_Geom_Rect_ERect (
+    void *data, float y, const float *table, float *res, int count)
+{
+    const float dist = ((float *)data) [1];
+
+    for (float *end = res + count * 2; res < end; res += 2, table += 2)
+    {
+        res [0] = table [0];
+        res [1] = dist * atan2 (y, table [1]);
+    }
+}
+
+void lfModifier::ModifyCoord_Geom_ERect_FishEye (void *data, float *iocoord, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+    const float dist = ((float *)data) [1];
+
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
+    {
+        float x = iocoord [0];
+        float y = iocoord [1];
+
+        double phi = x * inv_dist;
+        double theta = -y * inv_dist + M_PI / 2;
+        if (theta < 0)
+        {
+            theta = -theta;
+            phi += M_PI;
+        }
+        if (theta > M_PI)
+        {
+            theta = 2 * M_PI - theta;
+            phi += M_PI;
+        }
+
+        double s = sin (theta);
+        double vx = s * sin (phi); //  y' -> x
+        double vy = cos (theta);   //  z' -> y
+
+        double r = sqrt (vx * vx + vy * vy);
+
+        theta = dist * atan2 (r, s * cos (phi));
+
+        r = 1.0 / r;
+        iocoord [0] = theta * vx * r;
+        iocoord [1] = theta * vy * r;
+    }
+}
+
+void lfModifier::ModifyCoord_Geom_FishEye_ERect (void *data, float *iocoord, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+    const float dist = ((float *)data) [1];
+
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
+    {
+        float x = iocoord [0];
+        float y = iocoord [1];
+
+        double r = sqrt (x * x + y * y);
+        double theta = r * inv_dist;
+        double s = (theta == 0.0) ? inv_dist : (sin (theta) / r);
+
+        double vx = cos (theta);
+        double vy = s * x;
+
+        iocoord [0] = dist * atan2 (vy, vx);
+        iocoord [1] = dist * atan (s * y / sqrt (vx * vx + vy * vy));
+    }
+}
+
+void lfModifier::ModifyCoord_Geom_ERect_Panoramic (void *data, float *iocoord, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+    const float dist = ((float *)data) [1];
+
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
+    {
+        float y = iocoord [1];
+        iocoord [1] = dist * tan (y * inv_dist);
+    }
+}
+
+// Only y changes, so a row needs a single tan ()
+void lfModifier::ModifyCoordTableRow_Geom_ERect_Panoramic (
+    void *data, float y, const float *table, float *res, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+    const float dist = ((float *)data) [1];
+    const float y_ = dist * tan (y * inv_dist);
+
+    for (float *end = res + count * 2; res < end; res += 2, table += 2)
+    {
+        res [0] = table [0];
+        res [1] = y_;
+    }
+}
+
+void lfModifier::ModifyCoord_Geom_Panoramic_ERect (void *data, float *iocoord, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+    const float dist = ((float *)data) [1];
+
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
+    {
+        float y = iocoord [1];
+        iocoord [1] = dist * atan (y * inv_dist);
+    }
+}
+
+// Only y changes, so a row needs a single atan ()
+void lfModifier::ModifyCoordTableRow_Geom_Panoramic_ERect (
+    void *data, float y, const float *table, float *res, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+    const float dist = ((float *)data) [1];
+    const float y_ = dist * atan (y * inv_dist);
+
+    for (float *end = res + count * 2; res < end; res += 2, table += 2)
+    {
+        res [0] = table [0];
+        res [1] = y_;
+    }
+}
+
+void lfModifier::ModifyCoordColumns_Geom_Identity (
+    void *data, float x, float step, float *table, int count)
+{
+    for (int i = 0; i < count; i++, table += 2)
+    {
+        table [0] = x + i * step;
+        table [1] = 0;
+    }
+}
+
+void lfModifier::ModifyCoord_Geom_Orthographic_ERect (void *data, float *iocoord, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+    const float dist = ((float *)data) [1];
+
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
+    {
+        float x = iocoord [0];
+        float y = iocoord [1];
+
+        double r     = sqrt(x * x + y * y);
+        double theta = 0.0;
+
+        if (r < dist)
+            theta = asin (r * inv_dist);
+        else
+            theta = M_PI / 2.0;
+
+        double phi   = atan2 (y, x);
+
+        double s = (theta == 0.0) ? inv_dist : (sin (theta) / (theta * dist) );
+
+        double vx = cos (theta);
+        double vy = s * dist * theta * cos (phi);
+
+        iocoord [0] = dist * atan2 (vy, vx);
+        iocoord [1] = dist * atan (s * dist * theta * sin (phi) / sqrt (vx * vx + vy * vy));
+    }
+};
+
+void lfModifier::ModifyCoord_Geom_ERect_Orthographic (void *data, float *iocoord, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+    const float dist = ((float *)data) [1];
+
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
+    {
+        float x = iocoord [0];
+        float y = iocoord [1];
+
+        double phi   = x * inv_dist;
+        double theta = -y * inv_dist + M_PI / 2;
+        if (theta < 0)
+        {
+            theta = -theta;
+            phi += M_PI;
+        }
+        if (theta > M_PI)
+        {
+            theta = 2 * M_PI - theta;
+            phi += M_PI;
+        }
+
+        double s  = sin (theta);
+        double vx = s * sin (phi); //  y' -> x
+        double vy = cos (theta);   //  z' -> y
+
+        theta = atan2 (sqrt (vx * vx + vy * vy), s * cos (phi));
+        phi   = atan2 (vy, vx);
+        double rho  = dist * sin (theta);
+        iocoord [0] = rho * cos (phi);
+        iocoord [1] = rho * sin (phi);
+     }
+};
+
+#define EPSLN   1.0e-10
+
+void lfModifier::ModifyCoord_Geom_Stereographic_ERect (void *data, float *iocoord, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+    const float dist = ((float *)data) [1];
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
+    {
+        float x = iocoord [0] * inv_dist;
+        float y = iocoord [1] * inv_dist;
+
+        double rh = sqrt (x * x + y * y);
+        double c  = 2.0 * atan (rh / 2.0);
+        double sinc = sin (c);
+        double cosc = cos (c);
+
+        iocoord [0] = 0;
+        if(fabs (rh) <= EPSLN)
+        {
+            iocoord [1] = 1.6e16F;
+        }
+        else
+        {
+            iocoord [1] = asin (y * sinc / rh) * dist;
+            if((fabs (cosc) >= EPSLN) || (fabs (x) >= EPSLN))
+            {
+                iocoord [0] = atan2 (x * sinc, cosc * rh) * dist;
+            }
+            else
+            {
+                iocoord [0] = 1.6e16F;
+            };
+        };
+    };
+};
+
+void lfModifier::ModifyCoord_Geom_ERect_Stereographic (void *data, float *iocoord, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+    const float dist = ((float *)data) [1];
+
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
+    {
+        float lon = iocoord [0] * inv_dist;
+        float lat = iocoord [1] * inv_dist;
+
+        double cosphi = cos (lat);
+        double ksp = dist * 2.0 / (1.0 + cosphi * cos (lon));
+
+        iocoord [0] = ksp * cosphi * sin (lon);
+        iocoord [1] = ksp * sin (lat);
+    }
+};
+
+void lfModifier::ModifyCoord_Geom_Equisolid_ERect (void *data, float *iocoord, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+    const float dist = ((float *)data) [1];
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
+    {
+        float x = iocoord [0];
+        float y = iocoord [1];
+
+        double r = sqrt (x * x + y * y);
+        double theta = 0.0;
+
+        if (r < dist*2.0)
+            theta = 2.0 * asin (r * inv_dist / 2.0);
+        else
+            theta = M_PI / 2.0;
+
+        double phi = atan2 (y, x);
+        double s = (theta == 0.0) ? inv_dist : (sin (theta) / (dist * theta));
+
+        double vx = cos (theta);
+        double vy = s * dist * theta * cos (phi);
+
+        iocoord [0] = dist * atan2 (vy, vx);
+        iocoord [1] = dist * atan (s * dist * theta * sin (phi) / sqrt (vx * vx + vy * vy));
+    };
+};
+
+void lfModifier::ModifyCoord_Geom_ERect_Equisolid (void *data, float *iocoord, int count)
+{
+    const float dist = ((float *)data) [1];
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
+    {
+        double lambda = iocoord [0] / dist;
+        double phi = iocoord [1] / dist;
+
+        if (fabs (cos(phi) * cos(lambda) + 1.0) <= EPSLN)
+        {
+            iocoord [0] = 1.6e16F;
+            iocoord [1] = 1.6e16F;
+        }
+        else
+        {
+            double k1 = sqrt (2.0 / (1 + cos(phi) * cos(lambda)));
+
+            iocoord [0] = dist * k1 * cos (phi) * sin (lambda);
+            iocoord [1] = dist * k1 * sin (phi);
+        };
+    };
+};
+
+#define THOBY_K1_PARM 1.47F
+#define THOBY_K2_PARM 0.713F
+
+void lfModifier::ModifyCoord_Geom_Thoby_ERect (void *data, float *iocoord, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+    const float dist = ((float *)data) [1];
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
+    {
+        float x = iocoord [0];
+        float y = iocoord [1];
+
+        double rho = sqrt (x * x + y * y) * inv_dist;
+        if(rho<-THOBY_K1_PARM || rho > THOBY_K1_PARM)
+        {
+            iocoord [0] = 1.6e16F;
+            iocoord [1] = 1.6e16F;
+        }
+        else
+        {
+            double theta = asin (rho / THOBY_K1_PARM) / THOBY_K2_PARM;
+            double phi   = atan2 (y, x);
+            double s     = (theta == 0.0) ? inv_dist : (sin (theta) / (dist * theta) );
+
+            double vx = cos (theta);
+            double vy = s * dist * theta * cos (phi);
+
+            iocoord [0] = dist * atan2 (vy, vx);
+            iocoord [1] = dist * atan (s * dist * theta * sin (phi) / sqrt (vx * vx + vy * vy));
+        };
+    };
+};
+
+void lfModifier::ModifyCoord_Geom_ERect_Thoby (void *data, float *iocoord, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+    const float dist = ((float *)data) [1];
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2)
+    {
+        float x = iocoord [0];
+        float y = iocoord [1];
+
+        double phi = x * inv_dist;
+        double theta = -y * inv_dist + M_PI / 2;
+        if (theta < 0)
+        {
+            theta = -theta;
+            phi += M_PI;
+        }
+        if (theta > M_PI)
+        {
+            theta = 2 * M_PI - theta;
+            phi += M_PI;
+        }
+
+        double s  = sin (theta);
+        double vx = s * sin (phi); //  y' -> x
+        double vy = cos (theta);   //  z' -> y
+        theta = atan2 (sqrt (vx * vx + vy * vy), s * cos (phi));
+        phi   = atan2 (vy, vx);
+        double rho = THOBY_K1_PARM * dist * sin (theta * THOBY_K2_PARM);
+
+        iocoord [0] = rho * cos (phi);
+        iocoord [1] = rho * sin (phi);
+    };
+};
+
+//-----------------------// The Jacobian versions //-----------------------//
+
+/*
+    The Jacobian versions of the callbacks above differentiate the same
+    formulas in forward mode: every intermediate value is an lfJet, which
+    carries its partial derivatives by the x and y coordinate given to the
+    callback along with it.
+*/
+struct lfJet
+{
+    double v, dx, dy;
+
+    lfJet (double v = 0, double dx = 0, double dy = 0) : v (v), dx (dx), dy (dy)
+    { }
+};
+
+static inline lfJet operator - (const lfJet &a)
+{
+    return lfJet (-a.v, -a.dx, -a.dy);
+}
+
+static inline lfJet operator + (const lfJet &a, const lfJet &b)
+{
+    return lfJet (a.v + b.v, a.dx + b.dx, a.dy + b.dy);
+}
+
+static inline lfJet operator - (const lfJet &a, const lfJet &b)
+{
+    return lfJet (a.v - b.v, a.dx - b.dx, a.dy - b.dy);
+}
+
+static inline lfJet operator * (const lfJet &a, const lfJet &b)
+{
+    return lfJet (a.v * b.v, a.dx * b.v + a.v * b.dx, a.dy * b.v + a.v * b.dy);
+}
+
+static inline lfJet operator / (const lfJet &a, const lfJet &b)
+{
+    double q = a.v / b.v;
+    return lfJet (q, (a.dx - q * b.dx) / b.v, (a.dy - q * b.dy) / b.v);
+}
+
+// A function f of a with the derivative d = f' (a)
+static inline lfJet chain (const lfJet &a, double f, double d)
+{
+    return lfJet (f, d * a.dx, d * a.dy);
+}
+
+static inline lfJet sin (const lfJet &a)
+{
+    return chain (a, sin (a.v), cos (a.v));
+}
+
+static inline lfJet cos (const lfJet &a)
+{
+    return chain (a, cos (a.v), -sin (a.v));
+}
+
+static inline lfJet tan (const lfJet &a)
+{
+    double t = tan (a.v);
+    return chain (a, t, 1 + t * t);
+}
+
+static inline lfJet atan (const lfJet &a)
+{
+    return chain (a, atan (a.v), 1 / (1 + a.v * a.v));
+}
+
+static inline lfJet asin (const lfJet &a)
+{
+    return chain (a, asin (a.v), 1 / sqrt (1 - a.v * a.v));
+}
+
+// The radii of the callbacks are only 0 where they do not use the derivative
+static inline lfJet sqrt (const lfJet &a)
+{
+    double r = sqrt (a.v);
+    return chain (a, r, r > 0 ? 0.5 / r : 0);
+}
+
+static inline lfJet atan2 (const lfJet &y, const lfJet &x)
+{
+    double r2 = x.v * x.v + y.v * y.v;
+    return lfJet (atan2 (y.v, x.v), (x.v * y.dx - y.v * x.dx) / r2,
+                  (x.v * y.dy - y.v * x.dy) / r2);
+}
+
+// Most projections go through polar coordinates around the centre, whose
+// derivatives are singular there although the projections are smooth; the
+// centre is differentiated this far to the right of it instead
+#define JET_CENTRE_OFFSET 1e-9
+
+static inline void jet_load (const float *iocoord, lfJet &x, lfJet &y)
+{
+    x = lfJet (iocoord [0], 1, 0);
+    y = lfJet (iocoord [1], 0, 1);
+    if (iocoord [0] == 0 && iocoord [1] == 0)
+        x.v = JET_CENTRE_OFFSET;
+}
+
+static inline void jet_store (const lfJet &x, const lfJet &y, float *iocoord,
+                              float *jacobian)
+{
+    iocoord [0] = x.v;
+    iocoord [1] = y.v;
+    _lf_chain_jacobian (jacobian, x.dx, x.dy, y.dx, y.dy);
+}
+
+// Stores the coordinates of a point which has no valid projection, like the
+// ModifyCoord_Geom_* callbacks do, and marks its Jacobian as undefined
+static inline void jet_store_invalid (float x, float y, float *iocoord, float *jacobian)
+{
+    iocoord [0] = x;
+    iocoord [1] = y;
+    jacobian [0] = jacobian [1] = jacobian [2] = jacobian [3] = NAN;
+}
+
+// The angles of a point of an equirectangular image, as in the callbacks
+// from it, with theta measured from the pole
+static inline void jet_erect_angles (const lfJet &x, const lfJet &y, float inv_dist,
+                                     lfJet &phi, lfJet &theta)
+{
+    phi = x * inv_dist;
+    theta = -y * inv_dist + M_PI / 2;
+    if (theta.v < 0)
+    {
+        theta = -theta;
+        phi = phi + M_PI;
+    }
+    if (theta.v > M_PI)
+    {
+        theta = 2 * M_PI - theta;
+        phi = phi + M_PI;
+    }
+}
+
+// The equirectangular position of a ray at angle theta from the axis, in
+// direction phi around it; s is sin (theta) / (theta * dist), see
+// ModifyCoord_Geom_Orthographic_ERect
+static inline void jet_store_erect (const lfJet &theta, const lfJet &phi,
+                                    const lfJet &s, float dist, float *iocoord,
+                                    float *jacobian)
+{
+    lfJet vx = cos (theta);
+    lfJet vy = s * dist * theta * cos (phi);
+
+    jet_store (dist * atan2 (vy, vx),
+               dist * atan (s * dist * theta * sin (phi) / sqrt (vx * vx + vy * vy)),
+               iocoord, jacobian);
+}
+
+void lfModifier::ModifyCoordJacobian_Geom_FishEye_Rect (
+    void *data, float *iocoord, float *jacobian, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2, jacobian += 4)
+    {
+        lfJet x, y;
+        jet_load (iocoord, x, y);
+
+        lfJet r = sqrt (x * x + y * y);
+        lfJet rho, theta = r * inv_dist;
+
+        if (theta.v >= M_PI / 2.0)
+        {
+            jet_store_invalid (1.6e16F * x.v, 1.6e16F * y.v, iocoord, jacobian);
+            continue;
+        }
+        else if (theta.v == 0.0)
+            rho = 1.0;
+        else
+            rho = tan (theta) / theta;
+
+        jet_store (rho * x, rho * y, iocoord, jacobian);
+    }
+}
+
+void lfModifier::ModifyCoordJacobian_Geom_Rect_FishEye (
+    void *data, float *iocoord, float *jacobian, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2, jacobian += 4)
+    {
+        lfJet x, y;
+        jet_load (iocoord, x, y);
+
+        lfJet theta, r = sqrt (x * x + y * y) * inv_dist;
+        if (r.v == 0.0)
+            theta = 1.0;
+        else
+            theta = atan (r) / r;
+
+        jet_store (theta * x, theta * y, iocoord, jacobian);
+    }
+}
+
+void lfModifier::ModifyCoordJacobian_Geom_Panoramic_Rect (
+    void *data, float *iocoord, float *jacobian, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+    const float dist = ((float *)data) [1];
+
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2, jacobian += 4)
+    {
+        lfJet x, y;
+        jet_load (iocoord, x, y);
+
+        x = x * inv_dist;
+        jet_store (dist * tan (x), y / cos (x), iocoord, jacobian);
+    }
+}
+
+void lfModifier::ModifyCoordJacobian_Geom_Rect_Panoramic (
+    void *data, float *iocoord, float *jacobian, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+    const float dist = ((float *)data) [1];
+
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2, jacobian += 4)
+    {
+        lfJet x, y;
+        jet_load (iocoord, x, y);
+
+        lfJet x_ = dist * atan (x * inv_dist);
+        jet_store (x_, y * cos (x_ * inv_dist), iocoord, jacobian);
+    }
+}
+
+void lfModifier::ModifyCoordJacobian_Geom_FishEye_Panoramic (
+    void *data, float *iocoord, float *jacobian, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+    const float dist = ((float *)data) [1];
+
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2, jacobian += 4)
+    {
+        lfJet x, y;
+        jet_load (iocoord, x, y);
+
+        lfJet r = sqrt (x * x + y * y);
+        lfJet theta = r * inv_dist;
+        lfJet s = (theta.v == 0.0) ? lfJet (inv_dist) : (sin (theta) / r);
+
+        lfJet vx = cos (theta);  //  z' -> x
+        lfJet vy = s * x;        //  x' -> y
+
+        jet_store (dist * atan2 (vy, vx), dist * s * y / sqrt (vx * vx + vy * vy),
+                   iocoord, jacobian);
+    }
+}
+
+void lfModifier::ModifyCoordJacobian_Geom_Panoramic_FishEye (
+    void *data, float *iocoord, float *jacobian, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+    const float dist = ((float *)data) [1];
+
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2, jacobian += 4)
+    {
+        lfJet x, y;
+        jet_load (iocoord, x, y);
+
+        lfJet phi = x * inv_dist;
+        lfJet s = dist * sin (phi);   // y' -> x
+        lfJet r = sqrt (s * s + y * y);
+        lfJet theta = 0.0;
+
+        if (r.v != 0.0)
+            theta = dist * atan2 (r, dist * cos (phi)) / r;
+
+        jet_store (theta * s, theta * y, iocoord, jacobian);
+    }
+}
+
+void lfModifier::ModifyCoordJacobian_Geom_ERect_Rect (
+    void *data, float *iocoord, float *jacobian, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+    const float dist = ((float *)data) [1];
+
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2, jacobian += 4)
+    {
+        lfJet x, y, phi, theta;
+        jet_load (iocoord, x, y);
+        jet_erect_angles (x, y, inv_dist, phi, theta);
+
+        jet_store (dist * tan (phi), dist / (tan (theta) * cos (phi)),
+                   iocoord, jacobian);
+    }
+}
+
+void lfModifier::ModifyCoordJacobian_Geom_Rect_ERect (
+    void *data, float *iocoord, float *jacobian, int count)
+{
+    const float dist = ((float *)data) [1];
+
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2, jacobian += 4)
+    {
+        lfJet x, y;
+        jet_load (iocoord, x, y);
+
+        jet_store (dist * atan2 (x, dist),
+                   dist * atan2 (y, sqrt (dist * dist + x * x)),
+                   iocoord, jacobian);
+    }
+}
+
+void lfModifier::ModifyCoordJacobian_Geom_ERect_FishEye (
+    void *data, float *iocoord, float *jacobian, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+    const float dist = ((float *)data) [1];
+
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2, jacobian += 4)
+    {
+        lfJet x, y, phi, theta;
+        jet_load (iocoord, x, y);
+        jet_erect_angles (x, y, inv_dist, phi, theta);
+
+        lfJet s = sin (theta);
+        lfJet vx = s * sin (phi); //  y' -> x
+        lfJet vy = cos (theta);   //  z' -> y
+
+        lfJet r = sqrt (vx * vx + vy * vy);
+
+        theta = dist * atan2 (r, s * cos (phi));
+
+        jet_store (theta * vx / r, theta * vy / r, iocoord, jacobian);
+    }
+}
+
+void lfModifier::ModifyCoordJacobian_Geom_FishEye_ERect (
+    void *data, float *iocoord, float *jacobian, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+    const float dist = ((float *)data) [1];
+
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2, jacobian += 4)
+    {
+        lfJet x, y;
+        jet_load (iocoord, x, y);
+
+        lfJet r = sqrt (x * x + y * y);
+        lfJet theta = r * inv_dist;
+        lfJet s = (theta.v == 0.0) ? lfJet (inv_dist) : (sin (theta) / r);
+
+        lfJet vx = cos (theta);
+        lfJet vy = s * x;
+
+        jet_store (dist * atan2 (vy, vx),
+                   dist * atan (s * y / sqrt (vx * vx + vy * vy)),
+                   iocoord, jacobian);
+    }
+}
+
+void lfModifier::ModifyCoordJacobian_Geom_ERect_Panoramic (
+    void *data, float *iocoord, float *jacobian, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+    const float dist = ((float *)data) [1];
+
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2, jacobian += 4)
+    {
+        const float y = iocoord [1];
+        const double t = tan (y * inv_dist);
+        iocoord [1] = dist * t;
+        _lf_chain_jacobian (jacobian, 1, 0, 0, 1 + t * t);
+    }
+}
+
+void lfModifier::ModifyCoordJacobian_Geom_Panoramic_ERect (
+    void *data, float *iocoord, float *jacobian, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+    const float dist = ((float *)data) [1];
+
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2, jacobian += 4)
+    {
+        const float y = iocoord [1] * inv_dist;
+        iocoord [1] = dist * atan (y);
+        _lf_chain_jacobian (jacobian, 1, 0, 0, 1 / (1 + double (y) * y));
+    }
+}
+
+void lfModifier::ModifyCoordJacobian_Geom_Orthographic_ERect (
+    void *data, float *iocoord, float *jacobian, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+    const float dist = ((float *)data) [1];
+
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2, jacobian += 4)
+    {
+        lfJet x, y;
+        jet_load (iocoord, x, y);
+
+        lfJet r = sqrt (x * x + y * y);
+        lfJet theta = M_PI / 2.0;
+
+        if (r.v < dist)
+            theta = asin (r * inv_dist);
+
+        lfJet phi = atan2 (y, x);
+        lfJet s = (theta.v == 0.0) ? lfJet (inv_dist) : (sin (theta) / (theta * dist));
+
+        jet_store_erect (theta, phi, s, dist, iocoord, jacobian);
+    }
+}
+
+void lfModifier::ModifyCoordJacobian_Geom_ERect_Orthographic (
+    void *data, float *iocoord, float *jacobian, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+    const float dist = ((float *)data) [1];
+
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2, jacobian += 4)
+    {
+        lfJet x, y, phi, theta;
+        jet_load (iocoord, x, y);
+        jet_erect_angles (x, y, inv_dist, phi, theta);
+
+        lfJet s  = sin (theta);
+        lfJet vx = s * sin (phi); //  y' -> x
+        lfJet vy = cos (theta);   //  z' -> y
+
+        theta = atan2 (sqrt (vx * vx + vy * vy), s * cos (phi));
+        phi   = atan2 (vy, vx);
+        lfJet rho = dist * sin (theta);
+        jet_store (rho * cos (phi), rho * sin (phi), iocoord, jacobian);
+    }
+}
+
+void lfModifier::ModifyCoordJacobian_Geom_Stereographic_ERect (
+    void *data, float *iocoord, float *jacobian, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+    const float dist = ((float *)data) [1];
+
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2, jacobian += 4)
+    {
+        lfJet x, y;
+        jet_load (iocoord, x, y);
+        x = x * inv_dist;
+        y = y * inv_dist;
+
+        lfJet rh = sqrt (x * x + y * y);
+        lfJet c  = 2.0 * atan (rh / 2.0);
+        lfJet sinc = sin (c);
+        lfJet cosc = cos (c);
+
+        if (fabs (rh.v) <= EPSLN)
+        {
+            jet_store_invalid (0.0F, 1.6e16F, iocoord, jacobian);
+            continue;
+        }
+        lfJet y_ = asin (y * sinc / rh) * dist;
+        if ((fabs (cosc.v) < EPSLN) && (fabs (x.v) < EPSLN))
+        {
+            jet_store_invalid (1.6e16F, y_.v, iocoord, jacobian);
+            continue;
+        }
+
+        jet_store (atan2 (x * sinc, cosc * rh) * dist, y_, iocoord, jacobian);
+    }
+}
+
+void lfModifier::ModifyCoordJacobian_Geom_ERect_Stereographic (
+    void *data, float *iocoord, float *jacobian, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+    const float dist = ((float *)data) [1];
+
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2, jacobian += 4)
+    {
+        lfJet lon, lat;
+        jet_load (iocoord, lon, lat);
+        lon = lon * inv_dist;
+        lat = lat * inv_dist;
+
+        lfJet cosphi = cos (lat);
+        lfJet ksp = dist * 2.0 / (1.0 + cosphi * cos (lon));
+
+        jet_store (ksp * cosphi * sin (lon), ksp * sin (lat), iocoord, jacobian);
+    }
+}
+
+void lfModifier::ModifyCoordJacobian_Geom_Equisolid_ERect (
+    void *data, float *iocoord, float *jacobian, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+    const float dist = ((float *)data) [1];
+
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2, jacobian += 4)
+    {
+        lfJet x, y;
+        jet_load (iocoord, x, y);
+
+        lfJet r = sqrt (x * x + y * y);
+        lfJet theta = M_PI / 2.0;
+
+        if (r.v < dist * 2.0)
+            theta = 2.0 * asin (r * inv_dist / 2.0);
+
+        lfJet phi = atan2 (y, x);
+        lfJet s = (theta.v == 0.0) ? lfJet (inv_dist) : (sin (theta) / (dist * theta));
+
+        jet_store_erect (theta, phi, s, dist, iocoord, jacobian);
+    }
+}
+
+void lfModifier::ModifyCoordJacobian_Geom_ERect_Equisolid (
+    void *data, float *iocoord, float *jacobian, int count)
+{
+    const float dist = ((float *)data) [1];
+
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2, jacobian += 4)
+    {
+        lfJet lambda, phi;
+        jet_load (iocoord, lambda, phi);
+        lambda = lambda / dist;
+        phi = phi / dist;
+
+        if (fabs (cos (phi.v) * cos (lambda.v) + 1.0) <= EPSLN)
+            jet_store_invalid (1.6e16F, 1.6e16F, iocoord, jacobian);
+        else
+        {
+            lfJet k1 = sqrt (2.0 / (1 + cos (phi) * cos (lambda)));
+
+            jet_store (dist * k1 * cos (phi) * sin (lambda), dist * k1 * sin (phi),
+                       iocoord, jacobian);
+        }
+    }
+}
+
+void lfModifier::ModifyCoordJacobian_Geom_Thoby_ERect (
+    void *data, float *iocoord, float *jacobian, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+    const float dist = ((float *)data) [1];
+
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2, jacobian += 4)
+    {
+        lfJet x, y;
+        jet_load (iocoord, x, y);
+
+        lfJet rho = sqrt (x * x + y * y) * inv_dist;
+        if (rho.v < -THOBY_K1_PARM || rho.v > THOBY_K1_PARM)
+            jet_store_invalid (1.6e16F, 1.6e16F, iocoord, jacobian);
+        else
+        {
+            lfJet theta = asin (rho / THOBY_K1_PARM) / THOBY_K2_PARM;
+            lfJet phi   = atan2 (y, x);
+            lfJet s     = (theta.v == 0.0) ? lfJet (inv_dist) : (sin (theta) / (dist * theta));
+
+            jet_store_erect (theta, phi, s, dist, iocoord, jacobian);
+        }
+    }
+}
+
+void lfModifier::ModifyCoordJacobian_Geom_ERect_Thoby (
+    void *data, float *iocoord, float *jacobian, int count)
+{
+    const float inv_dist = ((float *)data) [0];
+    const float dist = ((float *)data) [1];
+
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2, jacobian += 4)
+    {
+        lfJet x, y, phi, theta;
+        jet_load (iocoord, x, y);
+        jet_erect_angles (x, y, inv_dist, phi, theta);
+
+        lfJet s  = sin (theta);
+        lfJet vx = s * sin (phi); //  y' -> x
+        lfJet vy = cos (theta);   //  z' -> y
+        theta = atan2 (sqrt (vx * vx + vy * vy), s * cos (phi));
+        phi   = atan2 (vy, vx);
+        lfJet rho = THOBY_K1_PARM * dist * sin (theta * THOBY_K2_PARM);
+
+        jet_store (rho * cos (phi), rho * sin (phi), iocoord, jacobian);
+    }
+}
+
+//---------------------------// The C interface //---------------------------//
+
+cbool lf_modifier_add_coord_callback_geometry (
+    lfModifier *modifier, lfLensType from, lfLensType to)
+{
+    return modifier->AddCoordCallbackGeometry (from, to);
+}
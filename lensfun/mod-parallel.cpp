@@ -0,0 +1,399 @@
+/*
+    Whole-image corrections split into row bands across threads
+*/
+
+#include "config.h"
+#include "lensfun.h"
+#include "lensfunprv.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#ifdef LF_HAVE_THREADS
+#include <system_error>
+#include <thread>
+#endif
+
+// Bands are at least this many rows high, so that small images are not split
+// into more pieces than it is worth starting threads for
+#define PARALLEL_MIN_ROWS 16
+
+// Rows whose source coordinates ApplyImageResampling() computes in one call
+#define RESAMPLE_BLOCK_ROWS 16
+
+// Pixels of packed source coordinates which ApplyImageResampling() expands
+// at a time
+#define RESAMPLE_STRIP 64
+
+// Calls band (first, count) for consecutive bands of rows which together
+// cover [0, height).  The calling thread works on the first band itself and
+// also takes over bands whose thread could not be started.
+template<typename Band> static bool run_bands (int height, int threads, Band band)
+{
+    if (height <= 0)
+        return false;
+
+#ifdef LF_HAVE_THREADS
+    if (threads <= 0)
+        threads = std::thread::hardware_concurrency ();
+    int max_threads = (height + PARALLEL_MIN_ROWS - 1) / PARALLEL_MIN_ROWS;
+    if (threads > max_threads)
+        threads = max_threads;
+    if (threads <= 1)
+        return band (0, height);
+
+    std::vector<char> done (threads, 0);
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threads; t++)
+    {
+        int first = int ((long long)height * t / threads);
+        int count = int ((long long)height * (t + 1) / threads) - first;
+        char *result = &done [t];
+        try
+        {
+            workers.push_back (std::thread ([=] () { *result = band (first, count); }));
+        }
+        catch (std::system_error &e)
+        {
+            *result = band (first, count);
+        }
+    }
+    done [0] = band (0, height / threads);
+    for (size_t t = 0; t < workers.size (); t++)
+        workers [t].join ();
+
+    // Every band has the same callbacks, so they all agree
+    return done [0] != 0;
+#else
+    (void)threads;
+    return band (0, height);
+#endif
+}
+
+bool lfModifier::ApplyColorModificationParallel (
+    void *pixels, float x, float y, int width, int height, int comp_role,
+    int row_stride, int threads) const
+{
+    return run_bands (height, threads, [=] (int first, int count) {
+        return ApplyColorModification (
+            (char *)pixels + (size_t)first * row_stride, x, y + first,
+            width, count, comp_role, row_stride);
+    });
+}
+
+bool lfModifier::ApplyGeometryDistortionParallel (
+    float xu, float yu, int width, int height, float *res, int threads) const
+{
+    return run_bands (height, threads, [=] (int first, int count) {
+        return ApplyGeometryDistortion (
+            xu, yu + first, width, count, res + (size_t)first * width * 2);
+    });
+}
+
+bool lfModifier::ApplySubpixelDistortionParallel (
+    float xu, float yu, int width, int height, float *res, int threads) const
+{
+    return run_bands (height, threads, [=] (int first, int count) {
+        return ApplySubpixelDistortion (
+            xu, yu + first, width, count, res + (size_t)first * width * 2 * 3);
+    });
+}
+
+bool lfModifier::ApplySubpixelGeometryDistortionParallel (
+    float xu, float yu, int width, int height, float *res, int threads) const
+{
+    return run_bands (height, threads, [=] (int first, int count) {
+        return ApplySubpixelGeometryDistortion (
+            xu, yu + first, width, count, res + (size_t)first * width * 2 * 3);
+    });
+}
+
+// The source image as seen by the resampler
+struct lfResampleSource
+{
+    const char *Pixels;
+    int Stride, Width, Height, Components;
+};
+
+template<typename T> static inline float source_pixel (
+    const lfResampleSource &src, int x, int y, int c)
+{
+    return ((const T *)(src.Pixels + (size_t)y * src.Stride)) [x * src.Components + c];
+}
+
+static inline int clamp_index (int i, int max)
+{
+    return i < 0 ? 0 : (i > max ? max : i);
+}
+
+// Keys' cubic convolution weights for a = -0.5 and a fractional offset t
+static inline void cubic_weights (float t, float *w)
+{
+    float t2 = t * t, t3 = t2 * t;
+    w [0] = -0.5f * t3 + t2 - 0.5f * t;
+    w [1] = 1.5f * t3 - 2.5f * t2 + 1.0f;
+    w [2] = -1.5f * t3 + 2.0f * t2 + 0.5f * t;
+    w [3] = 0.5f * t3 - 0.5f * t2;
+}
+
+// Interpolates component c of the source at (x, y).  Returns false if the
+// point is outside of the image, which includes the invalid coordinates
+// produced by the coordinate callbacks.
+template<typename T> static bool sample_source (
+    const lfResampleSource &src, float x, float y, int c,
+    lfInterpolation interpolation, float &value)
+{
+    if (!(x >= -0.5f && x <= src.Width - 0.5f &&
+          y >= -0.5f && y <= src.Height - 0.5f))
+        return false;
+
+    int max_x = src.Width - 1, max_y = src.Height - 1;
+    int x0 = int (floorf (x)), y0 = int (floorf (y));
+    float fx = x - x0, fy = y - y0;
+
+    switch (interpolation)
+    {
+        case LF_INTERPOLATION_NEAREST:
+            value = source_pixel<T> (src, clamp_index (int (floorf (x + 0.5f)), max_x),
+                                     clamp_index (int (floorf (y + 0.5f)), max_y), c);
+            return true;
+
+        case LF_INTERPOLATION_BILINEAR:
+        {
+            int xa = clamp_index (x0, max_x), xb = clamp_index (x0 + 1, max_x);
+            int ya = clamp_index (y0, max_y), yb = clamp_index (y0 + 1, max_y);
+            float top = source_pixel<T> (src, xa, ya, c) * (1 - fx) +
+                        source_pixel<T> (src, xb, ya, c) * fx;
+            float bottom = source_pixel<T> (src, xa, yb, c) * (1 - fx) +
+                           source_pixel<T> (src, xb, yb, c) * fx;
+            value = top * (1 - fy) + bottom * fy;
+            return true;
+        }
+
+        case LF_INTERPOLATION_BICUBIC:
+        {
+            float wx [4], wy [4];
+            int xi [4];
+            cubic_weights (fx, wx);
+            cubic_weights (fy, wy);
+            for (int i = 0; i < 4; i++)
+                xi [i] = clamp_index (x0 - 1 + i, max_x);
+            value = 0;
+            for (int j = 0; j < 4; j++)
+            {
+                int yi = clamp_index (y0 - 1 + j, max_y);
+                float row = 0;
+                for (int i = 0; i < 4; i++)
+                    row += source_pixel<T> (src, xi [i], yi, c) * wx [i];
+                value += row * wy [j];
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+template<typename T> static inline T clamp_component (float value, float max)
+{
+    return value <= 0 ? T (0) : (value >= max ? T (max) : T (value + 0.5f));
+}
+
+// Resamples the image rows [first, first + count) into dst, which holds
+// just these rows
+template<typename T> static bool resample_rows (
+    const lfModifier *modifier, const lfResampleSource &src, char *dst,
+    int dst_stride, lfInterpolation interpolation, int first, int count,
+    bool packed, lfSubpixelFormat format)
+{
+    const float max = float (T (~0));
+    const int width = src.Width, nc = src.Components;
+    // Coordinates are computed for a few rows at once, so that per-column
+    // tables of the projection are shared by these rows.  Packed blocks are
+    // expanded a strip of pixels at a time right before they are sampled.
+    const int block = std::min (count, RESAMPLE_BLOCK_ROWS);
+    const int strip = packed ? RESAMPLE_STRIP : width;
+    std::vector<float> coords ((size_t)(packed ? strip : width * block) * 2 * 3);
+    std::vector<lfSubpixelCoord> packed_coords (packed ? (size_t)width * block : 0);
+    bool mapped = false;
+
+    for (int y = first; y < first + count; y++, dst += dst_stride)
+    {
+        T *out = (T *)dst;
+        int row = (y - first) % block;
+        if (!row)
+        {
+            int rows = std::min (block, first + count - y);
+            mapped = packed ?
+                modifier->ApplySubpixelGeometryDistortionPacked (
+                    0, y, width, rows, &packed_coords [0], format) :
+                modifier->ApplySubpixelGeometryDistortion (0, y, width, rows, &coords [0]);
+        }
+        if (!mapped)
+        {
+            memcpy (out, src.Pixels + (size_t)y * src.Stride, width * nc * sizeof (T));
+            continue;
+        }
+
+        for (int x0 = 0; x0 < width; x0 += strip)
+        {
+            int n = std::min (strip, width - x0);
+            const float *rgb = &coords [0];
+            if (packed)
+                lfModifier::UnpackSubpixelCoords (
+                    &packed_coords [(size_t)row * width + x0], n, format, &coords [0]);
+            else
+                rgb += (size_t)row * width * 6;
+            for (int x = 0; x < n; x++, rgb += 6, out += nc)
+                for (int c = 0; c < nc; c++)
+                {
+                    // Red, green and blue have their own coordinates; alpha
+                    // follows green
+                    const float *xy = rgb + 2 * (c < 3 ? c : 1);
+                    float value;
+                    out [c] = sample_source<T> (src, xy [0], xy [1], c, interpolation,
+                                                value) ?
+                        clamp_component<T> (value, max) : T (0);
+                }
+        }
+    }
+    return true;
+}
+
+static inline bool image_layout_supported (lfPixelFormat format, int components)
+{
+    return (format == LF_PF_U8 || format == LF_PF_U16) &&
+        (components == 3 || components == 4);
+}
+
+bool lfModifier::ApplyImageResampling (
+    const void *src, int src_stride, void *dst, int dst_stride, int width,
+    int height, lfPixelFormat format, int components,
+    lfInterpolation interpolation, int first_row, int row_count,
+    int threads) const
+{
+    if (!image_layout_supported (format, components) || width <= 0 ||
+        height <= 0 || first_row < 0 || row_count <= 0 ||
+        first_row + row_count > height)
+        return false;
+
+    lfResampleSource source = { (const char *)src, src_stride, width, height, components };
+    bool packed = PackedResampling;
+    lfSubpixelFormat packed_format = ResamplingFormat;
+    return run_bands (row_count, threads, [=] (int first, int count) {
+        char *out = (char *)dst + (size_t)first * dst_stride;
+        return format == LF_PF_U8 ?
+            resample_rows<lf_u8> (this, source, out, dst_stride, interpolation,
+                                  first_row + first, count, packed, packed_format) :
+            resample_rows<lf_u16> (this, source, out, dst_stride, interpolation,
+                                   first_row + first, count, packed, packed_format);
+    });
+}
+
+void lfModifier::SetPackedResampling (bool packed, lfSubpixelFormat format)
+{
+    PackedResampling = packed;
+    ResamplingFormat = format;
+}
+
+bool lfModifier::ApplyImageCorrection (
+    const void *src, int src_stride, void *dst, int dst_stride, int width,
+    int height, lfPixelFormat format, int components,
+    lfInterpolation interpolation, int threads) const
+{
+    if (!image_layout_supported (format, components) || width <= 0 || height <= 0)
+        return false;
+
+    std::vector<lfCallbackData*>* callbacks = (std::vector<lfCallbackData*>*)ColorCallbacks;
+    if (callbacks->empty ())
+        return ApplyImageResampling (src, src_stride, dst, dst_stride, width,
+                                     height, format, components, interpolation,
+                                     0, height, threads);
+
+    // The color callbacks were built for one component type
+    if (format != PixelFormat)
+        return false;
+
+    // The colors are corrected in a packed copy of the source, which the
+    // resampling reads from then
+    size_t row_size = (size_t)width * components * (format == LF_PF_U8 ? 1 : 2);
+    char *copy = (char *)malloc (row_size * height);
+    if (!copy)
+        return false;
+
+    int comp_role = components == 3 ? LF_CR_3 (RED, GREEN, BLUE) :
+                                      LF_CR_4 (RED, GREEN, BLUE, UNKNOWN);
+    run_bands (height, threads, [=] (int first, int count) {
+        for (int y = first; y < first + count; y++)
+            memcpy (copy + y * row_size, (const char *)src + (size_t)y * src_stride,
+                    row_size);
+        return ApplyColorModification (copy + first * row_size, 0, first, width,
+                                       count, comp_role, int (row_size));
+    });
+
+    bool result = ApplyImageResampling (copy, int (row_size), dst, dst_stride,
+                                        width, height, format, components,
+                                        interpolation, 0, height, threads);
+    free (copy);
+    return result;
+}
+
+//---------------------------// The C interface //---------------------------//
+
+cbool lf_modifier_apply_color_modification_parallel (
+    lfModifier *modifier, void *pixels, float x, float y, int width, int height,
+    int comp_role, int row_stride, int threads)
+{
+    return modifier->ApplyColorModificationParallel (
+        pixels, x, y, width, height, comp_role, row_stride, threads);
+}
+
+cbool lf_modifier_apply_geometry_distortion_parallel (
+    lfModifier *modifier, float xu, float yu, int width, int height, float *res,
+    int threads)
+{
+    return modifier->ApplyGeometryDistortionParallel (
+        xu, yu, width, height, res, threads);
+}
+
+cbool lf_modifier_apply_subpixel_distortion_parallel (
+    lfModifier *modifier, float xu, float yu, int width, int height, float *res,
+    int threads)
+{
+    return modifier->ApplySubpixelDistortionParallel (
+        xu, yu, width, height, res, threads);
+}
+
+cbool lf_modifier_apply_subpixel_geometry_distortion_parallel (
+    lfModifier *modifier, float xu, float yu, int width, int height, float *res,
+    int threads)
+{
+    return modifier->ApplySubpixelGeometryDistortionParallel (
+        xu, yu, width, height, res, threads);
+}
+
+cbool lf_modifier_apply_image_correction (
+    lfModifier *modifier, const void *src, int src_stride, void *dst, int dst_stride,
+    int width, int height, lfPixelFormat format, int components,
+    lfInterpolation interpolation, int threads)
+{
+    return modifier->ApplyImageCorrection (
+        src, src_stride, dst, dst_stride, width, height, format, components,
+        interpolation, threads);
+}
+
+cbool lf_modifier_apply_image_resampling (
+    lfModifier *modifier, const void *src, int src_stride, void *dst,
+    int dst_stride, int width, int height, lfPixelFormat format, int components,
+    lfInterpolation interpolation, int first_row, int row_count, int threads)
+{
+    return modifier->ApplyImageResampling (
+        src, src_stride, dst, dst_stride, width, height, format, components,
+        interpolation, first_row, row_count, threads);
+}
+
+void lf_modifier_set_packed_resampling (
+    lfModifier *modifier, cbool packed, lfSubpixelFormat format)
+{
+    modifier->SetPackedResampling (packed != 0, format);
+}
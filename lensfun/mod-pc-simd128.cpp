@@ -0,0 +1,102 @@
+/*
+    WebAssembly SIMD128 versions of the perspective correction callbacks
+*/
+
+#include "config.h"
+
+#ifdef VECTORIZATION_SIMD128
+
+#include "lensfun.h"
+#include "lensfunprv.h"
+#include <wasm_simd128.h>
+
+// SIMD128 has an exact division, so unlike the SSE version no reciprocal
+// estimate is needed.  Pixels behind the camera get the invalid marker.
+static inline void pc_project (v128_t &u, v128_t &v, v128_t z)
+{
+    const v128_t invalid = wasm_f32x4_splat (1.6e16F);
+
+    v128_t ok = wasm_f32x4_gt (z, wasm_f32x4_splat (0.0f));
+    u = wasm_v128_bitselect (wasm_f32x4_div (u, z), invalid, ok);
+    v = wasm_v128_bitselect (wasm_f32x4_div (v, z), invalid, ok);
+}
+
+static inline void pc_store (float *res, v128_t u, v128_t v)
+{
+    wasm_v128_store (res, wasm_i32x4_shuffle (u, v, 0, 4, 1, 5));
+    wasm_v128_store (res + 4, wasm_i32x4_shuffle (u, v, 2, 6, 3, 7));
+}
+
+void lfModifier::ModifyCoord_Perspective_Correction_SIMD128 (
+    void *data, float *iocoord, int count)
+{
+    const float *param = ((lfPerspectiveParams *)data)->Terms;
+    const v128_t A11 = wasm_f32x4_splat (param [0]);
+    const v128_t A12 = wasm_f32x4_splat (param [1]);
+    const v128_t A13 = wasm_f32x4_splat (param [2]);
+    const v128_t A21 = wasm_f32x4_splat (param [3]);
+    const v128_t A22 = wasm_f32x4_splat (param [4]);
+    const v128_t A23 = wasm_f32x4_splat (param [5]);
+    const v128_t A31 = wasm_f32x4_splat (param [6]);
+    const v128_t A32 = wasm_f32x4_splat (param [7]);
+    const v128_t A33 = wasm_f32x4_splat (param [8]);
+    const v128_t Delta_a = wasm_f32x4_splat (param [9]);
+    const v128_t Delta_b = wasm_f32x4_splat (param [10]);
+
+    for (; count >= 4; count -= 4, iocoord += 8)
+    {
+        v128_t c0 = wasm_v128_load (iocoord);
+        v128_t c1 = wasm_v128_load (iocoord + 4);
+        v128_t x = wasm_f32x4_add (wasm_i32x4_shuffle (c0, c1, 0, 2, 4, 6), Delta_a);
+        v128_t y = wasm_f32x4_add (wasm_i32x4_shuffle (c0, c1, 1, 3, 5, 7), Delta_b);
+
+        v128_t u = wasm_f32x4_add (wasm_f32x4_add (wasm_f32x4_mul (A11, x), wasm_f32x4_mul (A12, y)), A13);
+        v128_t v = wasm_f32x4_add (wasm_f32x4_add (wasm_f32x4_mul (A21, x), wasm_f32x4_mul (A22, y)), A23);
+        v128_t z = wasm_f32x4_add (wasm_f32x4_add (wasm_f32x4_mul (A31, x), wasm_f32x4_mul (A32, y)), A33);
+        pc_project (u, v, z);
+        pc_store (iocoord, u, v);
+    }
+
+    if (count)
+        ModifyCoord_Perspective_Correction (data, iocoord, count);
+}
+
+void lfModifier::ModifyCoordRow_Perspective_Correction_SIMD128 (
+    void *data, float x, float y, float step, float *res, int count)
+{
+    const float *param = ((lfPerspectiveParams *)data)->Terms;
+    float x_ = x + param [9];
+    float y_ = y + param [10];
+    const v128_t u0 = wasm_f32x4_splat (param [0] * x_ + param [1] * y_ + param [2]);
+    const v128_t v0 = wasm_f32x4_splat (param [3] * x_ + param [4] * y_ + param [5]);
+    const v128_t z0 = wasm_f32x4_splat (param [6] * x_ + param [7] * y_ + param [8]);
+    const v128_t du = wasm_f32x4_splat (param [0] * step);
+    const v128_t dv = wasm_f32x4_splat (param [3] * step);
+    const v128_t dz = wasm_f32x4_splat (param [6] * step);
+    const v128_t four = wasm_f32x4_splat (4.0f);
+
+    v128_t idx = wasm_f32x4_make (0.0f, 1.0f, 2.0f, 3.0f);
+    int i;
+    for (i = 0; i + 4 <= count; i += 4, res += 8, idx = wasm_f32x4_add (idx, four))
+    {
+        v128_t u = wasm_f32x4_add (u0, wasm_f32x4_mul (idx, du));
+        v128_t v = wasm_f32x4_add (v0, wasm_f32x4_mul (idx, dv));
+        v128_t z = wasm_f32x4_add (z0, wasm_f32x4_mul (idx, dz));
+        pc_project (u, v, z);
+        pc_store (res, u, v);
+    }
+
+    if (i < count)
+    {
+        float tail [8];
+        v128_t u = wasm_f32x4_add (u0, wasm_f32x4_mul (idx, du));
+        v128_t v = wasm_f32x4_add (v0, wasm_f32x4_mul (idx, dv));
+        v128_t z = wasm_f32x4_add (z0, wasm_f32x4_mul (idx, dz));
+        pc_project (u, v, z);
+        pc_store (tail, u, v);
+        for (int j = 0; j < (count - i) * 2; j++)
+            res [j] = tail [j];
+    }
+}
+
+#endif
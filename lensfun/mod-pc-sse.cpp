@@ -0,0 +1,111 @@
+/*
+    SSE versions of the perspective correction callbacks
+*/
+
+#include "config.h"
+
+#ifdef VECTORIZATION_SSE
+
+#include "lensfun.h"
+#include "lensfunprv.h"
+#include <xmmintrin.h>
+
+#define SSE_FUNC __attribute__ ((target ("sse")))
+
+// Divides u and v by z with a reciprocal estimate refined by one Newton
+// step, which is accurate to about one ulp and much cheaper than a division.
+// Pixels which end up behind the camera (z <= 0) get the invalid marker.
+SSE_FUNC static inline void pc_project (__m128 &u, __m128 &v, __m128 z)
+{
+    const __m128 two = _mm_set1_ps (2.0f);
+    const __m128 invalid = _mm_set1_ps (1.6e16F);
+
+    __m128 r = _mm_rcp_ps (z);
+    r = _mm_mul_ps (r, _mm_sub_ps (two, _mm_mul_ps (z, r)));
+    __m128 ok = _mm_cmpgt_ps (z, _mm_setzero_ps ());
+    u = _mm_or_ps (_mm_and_ps (ok, _mm_mul_ps (u, r)), _mm_andnot_ps (ok, invalid));
+    v = _mm_or_ps (_mm_and_ps (ok, _mm_mul_ps (v, r)), _mm_andnot_ps (ok, invalid));
+}
+
+SSE_FUNC static inline void pc_store (float *res, __m128 u, __m128 v)
+{
+    _mm_storeu_ps (res, _mm_unpacklo_ps (u, v));
+    _mm_storeu_ps (res + 4, _mm_unpackhi_ps (u, v));
+}
+
+SSE_FUNC void lfModifier::ModifyCoord_Perspective_Correction_SSE (
+    void *data, float *iocoord, int count)
+{
+    const float *param = ((lfPerspectiveParams *)data)->Terms;
+    const __m128 A11 = _mm_set1_ps (param [0]);
+    const __m128 A12 = _mm_set1_ps (param [1]);
+    const __m128 A13 = _mm_set1_ps (param [2]);
+    const __m128 A21 = _mm_set1_ps (param [3]);
+    const __m128 A22 = _mm_set1_ps (param [4]);
+    const __m128 A23 = _mm_set1_ps (param [5]);
+    const __m128 A31 = _mm_set1_ps (param [6]);
+    const __m128 A32 = _mm_set1_ps (param [7]);
+    const __m128 A33 = _mm_set1_ps (param [8]);
+    const __m128 Delta_a = _mm_set1_ps (param [9]);
+    const __m128 Delta_b = _mm_set1_ps (param [10]);
+
+    for (; count >= 4; count -= 4, iocoord += 8)
+    {
+        __m128 c0 = _mm_loadu_ps (iocoord);
+        __m128 c1 = _mm_loadu_ps (iocoord + 4);
+        __m128 x = _mm_add_ps (_mm_shuffle_ps (c0, c1, _MM_SHUFFLE (2, 0, 2, 0)), Delta_a);
+        __m128 y = _mm_add_ps (_mm_shuffle_ps (c0, c1, _MM_SHUFFLE (3, 1, 3, 1)), Delta_b);
+
+        __m128 u = _mm_add_ps (_mm_add_ps (_mm_mul_ps (A11, x), _mm_mul_ps (A12, y)), A13);
+        __m128 v = _mm_add_ps (_mm_add_ps (_mm_mul_ps (A21, x), _mm_mul_ps (A22, y)), A23);
+        __m128 z = _mm_add_ps (_mm_add_ps (_mm_mul_ps (A31, x), _mm_mul_ps (A32, y)), A33);
+        pc_project (u, v, z);
+        pc_store (iocoord, u, v);
+    }
+
+    if (count)
+        ModifyCoord_Perspective_Correction (data, iocoord, count);
+}
+
+SSE_FUNC void lfModifier::ModifyCoordRow_Perspective_Correction_SSE (
+    void *data, float x, float y, float step, float *res, int count)
+{
+    const float *param = ((lfPerspectiveParams *)data)->Terms;
+    float x_ = x + param [9];
+    float y_ = y + param [10];
+    const __m128 u0 = _mm_set1_ps (param [0] * x_ + param [1] * y_ + param [2]);
+    const __m128 v0 = _mm_set1_ps (param [3] * x_ + param [4] * y_ + param [5]);
+    const __m128 z0 = _mm_set1_ps (param [6] * x_ + param [7] * y_ + param [8]);
+    const __m128 du = _mm_set1_ps (param [0] * step);
+    const __m128 dv = _mm_set1_ps (param [3] * step);
+    const __m128 dz = _mm_set1_ps (param [6] * step);
+    const __m128 four = _mm_set1_ps (4.0f);
+
+    // Pixel indices are kept exact in float, so that every pixel is computed
+    // from the row start like in the scalar version and errors do not build up
+    __m128 idx = _mm_set_ps (3.0f, 2.0f, 1.0f, 0.0f);
+    int i;
+    for (i = 0; i + 4 <= count; i += 4, res += 8, idx = _mm_add_ps (idx, four))
+    {
+        __m128 u = _mm_add_ps (u0, _mm_mul_ps (idx, du));
+        __m128 v = _mm_add_ps (v0, _mm_mul_ps (idx, dv));
+        __m128 z = _mm_add_ps (z0, _mm_mul_ps (idx, dz));
+        pc_project (u, v, z);
+        pc_store (res, u, v);
+    }
+
+    if (i < count)
+    {
+        // Finish the row with a full vector into a scratch buffer
+        float tail [8];
+        __m128 u = _mm_add_ps (u0, _mm_mul_ps (idx, du));
+        __m128 v = _mm_add_ps (v0, _mm_mul_ps (idx, dv));
+        __m128 z = _mm_add_ps (z0, _mm_mul_ps (idx, dz));
+        pc_project (u, v, z);
+        pc_store (tail, u, v);
+        for (int j = 0; j < (count - i) * 2; j++)
+            res [j] = tail [j];
+    }
+}
+
+#endif
@@ -57,9 +57,12 @@
 #include "lensfun.h"
 #include "lensfunprv.h"
 #include <cmath>
+#include <limits>
 #include <vector>
-#include <numeric>
-#include <stdexcept>
+#ifdef LF_HAVE_THREADS
+#include <system_error>
+#include <thread>
+#endif
 #include "windows/mathconstants.h"
 
 using std::acos;
@@ -74,17 +77,18 @@ using std::sin;
 using std::sqrt;
 using std::isnan;
 
-dvector normalize (double x, double y)
+dvector<2> normalize (double x, double y)
 {
     double norm = sqrt (pow (x, 2) + pow (y, 2));
-    double temp[] = {x / norm, y / norm};
-    return dvector (temp, temp + 2);
+    dvector<2> result = {{x / norm, y / norm}};
+    return result;
 }
 
 /* Projects the coordinates on an x-y plane with the distance `plane_distance`
  * from the origin.  The centre of the projection is the origin.
  */
-void central_projection (dvector coordinates, double plane_distance, double &x, double &y)
+void central_projection (const dvector<3> &coordinates, double plane_distance,
+                         double &x, double &y)
 {
     double stretch_factor = plane_distance / coordinates [2];
     x = coordinates [0] * stretch_factor;
@@ -92,20 +96,16 @@ void central_projection (dvector coordinates, double plane_distance, double &x,
 }
 
 
-class svd_no_convergence: public std::runtime_error
-{
-public:
-    svd_no_convergence() : std::runtime_error ("SVD: Iterations did not converge") {}
-};
-
 /* The following SVD implementation is a modified version of an SVD
  * implementation published in “Evaluation of gaussian processes and other
  * methods for non-linear regression”, Carl Edward Rasmussen, 1996.
  */
-dvector svd (matrix M)
+template<int Rows, int n> bool svd (const matrix<Rows, n> &A, dvector<n> &result)
 {
-    const int n = M [0].size();
-    dvector S2 (n);
+    // The upper half of M is A padded with zero rows, the lower half starts
+    // as the identity and accumulates the right singular vectors.
+    matrix<2 * n, n> M = matrix<2 * n, n> ();
+    dvector<n> S2 = dvector<n> ();
     int  i, j, k, estimated_column_rank = n, counter = n, iterations = 0,
         max_cycles = (n < 120) ? 60 : n / 2;
     double epsilon = std::numeric_limits<double>::epsilon(),
@@ -113,7 +113,8 @@ dvector svd (matrix M)
         threshold = 0.2 * epsilon,
         vt, p, x0, y0, q, r, c0, s0, d1, d2;
 
-    M.resize (2 * n, dvector (n));
+    for (i = 0; i < Rows; i++)
+        M [i] = A [i];
     for (i = 0; i < n; i++)
         M [n + i][i] = 1;
 
@@ -177,27 +178,37 @@ dvector svd (matrix M)
             estimated_column_rank--;
     }
     if (iterations > max_cycles)
-        throw svd_no_convergence();
+        return false;
 
-    dvector result;
-    for (matrix::iterator it = M.begin() + n; it != M.end(); ++it)
-        result.push_back ((*it) [n - 1]);
-    return result;
+    for (i = 0; i < n; i++)
+        result [i] = M [n + i][n - 1];
+    return true;
 }
 
-void ellipse_analysis (dvector x, dvector y, double f_normalized, double &x_v, double &y_v,
-                       double &center_x, double &center_y)
+template bool svd (const matrix<5, 6> &M, dvector<6> &result);
+
+/* Fits an ellipse through the first five points of `x` and `y`.  Returns false
+ * if the fit did not converge.
+ */
+bool ellipse_analysis (const double *x, const double *y, double f_normalized,
+                       double &x_v, double &y_v, double &center_x, double &center_y)
 {
-    matrix M;
+    matrix<5, 6> M;
     double a, b, c, d, f, g, _D, x0, y0, phi, _N, _S, _R, a_, b_, radius_vertex;
 
     // Taken from http://math.stackexchange.com/a/767126/248694
     for (int i = 0; i < 5; i++)
     {
-        double temp[] = {pow (x [i], 2), x [i] * y [i], pow (y [i], 2), x [i], y [i], 1};
-        M.push_back (dvector (temp, temp + 6));
+        M [i][0] = pow (x [i], 2);
+        M [i][1] = x [i] * y [i];
+        M [i][2] = pow (y [i], 2);
+        M [i][3] = x [i];
+        M [i][4] = y [i];
+        M [i][5] = 1;
     }
-    dvector parameters = svd (M);
+    dvector<6> parameters;
+    if (!svd (M, parameters))
+        return false;
     /* Taken from http://mathworld.wolfram.com/Ellipse.html, equation (15)
        onwards. */
     a = parameters [0];
@@ -243,13 +254,14 @@ void ellipse_analysis (dvector x, dvector y, double f_normalized, double &x_v, d
     y_v = radius_vertex * cos (phi);
     center_x = x0;
     center_y = y0;
+    return true;
 }
 
 /* Returns the coordinates of the intersection of the lines defined by `x` and
  * `y`.  Both parameters need to be exactly 4 items long.  The first two items
  * defines the one line, the last two the other.
  */
-void intersection (dvector x, dvector y, double &x_i, double &y_i)
+void intersection (const double *x, const double *y, double &x_i, double &y_i)
 {
     double A, B, C, numerator_x, numerator_y;
 
@@ -281,7 +293,7 @@ void intersection (dvector x, dvector y, double &x_i, double &y_i)
            ⎝   0         0    1 ⎠
 */
 
-dvector rotate_rho_delta (double rho, double delta, double x, double y, double z)
+dvector<3> rotate_rho_delta (double rho, double delta, double x, double y, double z)
 {
     // This matrix is: Rₓ(δ) · R_y(ρ)
     double A11, A12, A13, A21, A22, A23, A31, A32, A33;
@@ -295,15 +307,15 @@ dvector rotate_rho_delta (double rho, double delta, double x, double y, double z
     A32 = sin (delta);
     A33 = cos (rho) * cos (delta);
 
-    dvector result (3);
+    dvector<3> result;
     result [0] = A11 * x + A12 * y + A13 * z;
     result [1] = A21 * x + A22 * y + A23 * z;
     result [2] = A31 * x + A32 * y + A33 * z;
     return result;
 }
 
-dvector rotate_rho_delta_rho_h (double rho, double delta, double rho_h,
-                                double x, double y, double z)
+dvector<3> rotate_rho_delta_rho_h (double rho, double delta, double rho_h,
+                                   double x, double y, double z)
 {
     // This matrix is: R_y(ρₕ) · Rₓ(δ) · R_y(ρ)
     double A11, A12, A13, A21, A22, A23, A31, A32, A33;
@@ -317,19 +329,20 @@ dvector rotate_rho_delta_rho_h (double rho, double delta, double rho_h,
     A32 = sin (delta) * cos (rho_h);
     A33 = - sin (rho) * sin (rho_h) + cos (rho) * cos (delta) * cos (rho_h);
 
-    dvector result (3);
+    dvector<3> result;
     result [0] = A11 * x + A12 * y + A13 * z;
     result [1] = A21 * x + A22 * y + A23 * z;
     result [2] = A31 * x + A32 * y + A33 * z;
     return result;
 }
 
-double determine_rho_h (double rho, double delta, dvector x, dvector y,
+/* `x` and `y` are the two points of the horizontal line.
+ */
+double determine_rho_h (double rho, double delta, const double *x, const double *y,
                         double f_normalized, double center_x, double center_y)
 {
-    dvector p0, p1;
-    p0 = rotate_rho_delta (rho, delta, x [0], y [0], f_normalized);
-    p1 = rotate_rho_delta (rho, delta, x [1], y [1], f_normalized);
+    dvector<3> p0 = rotate_rho_delta (rho, delta, x [0], y [0], f_normalized);
+    dvector<3> p1 = rotate_rho_delta (rho, delta, x [1], y [1], f_normalized);
     double x_0 = p0 [0], y_0 = p0 [1], z_0 = p0 [2];
     double x_1 = p1 [0], y_1 = p1 [1], z_1 = p1 [2];
     if (y_0 == y_1)
@@ -337,8 +350,8 @@ double determine_rho_h (double rho, double delta, dvector x, dvector y,
     else
     {
         double Delta_x, Delta_z, x_h, z_h, rho_h;
-        double temp[] = {x_1 - x_0, z_1 - z_0, y_1 - y_0};
-        central_projection (dvector (temp, temp + 3), - y_0, Delta_x, Delta_z);
+        dvector<3> temp = {{x_1 - x_0, z_1 - z_0, y_1 - y_0}};
+        central_projection (temp, - y_0, Delta_x, Delta_z);
         x_h = x_0 + Delta_x;
         z_h = z_0 + Delta_z;
         if (z_h == 0)
@@ -351,42 +364,37 @@ double determine_rho_h (double rho, double delta, dvector x, dvector y,
     }
 }
 
-void calculate_angles (dvector x, dvector y, double &f_normalized,
-                       double &rho, double &delta, double &rho_h, double &alpha,
-                       double &center_of_control_points_x, double &center_of_control_points_y)
+bool calculate_angles (const dvector<8> &x, const dvector<8> &y, int number_of_control_points,
+                       double &f_normalized, double &rho, double &delta, double &rho_h,
+                       double &alpha, double &center_of_control_points_x,
+                       double &center_of_control_points_y)
 {
-    const int number_of_control_points = x.size();
-
-    double center_x, center_y;
-    if (number_of_control_points == 6)
-    {
-        center_x = std::accumulate (x.begin(), x.begin() + 4, 0.) / 4;
-        center_y = std::accumulate (y.begin(), y.begin() + 4, 0.) / 4;
-    }
-    else
+    double center_x = 0, center_y = 0;
+    const int number_of_center_points = number_of_control_points == 6 ? 4 : number_of_control_points;
+    for (int i = 0; i < number_of_center_points; i++)
     {
-        center_x = std::accumulate (x.begin(), x.end(), 0.) / number_of_control_points;
-        center_y = std::accumulate (y.begin(), y.end(), 0.) / number_of_control_points;
+        center_x += x [i];
+        center_y += y [i];
     }
+    center_x /= number_of_center_points;
+    center_y /= number_of_center_points;
 
     double x_v, y_v;
     if (number_of_control_points == 5 || number_of_control_points == 7)
-        ellipse_analysis (dvector (x.begin(), x.begin() + 5), dvector (y.begin(), y.begin() + 5),
-                          f_normalized, x_v, y_v, center_x, center_y);
+    {
+        if (!ellipse_analysis (x.data, y.data, f_normalized, x_v, y_v, center_x, center_y))
+            return false;
+    }
     else
     {
-        intersection (dvector (x.begin(), x.begin() + 4),
-                      dvector (y.begin(), y.begin() + 4),
-                      x_v, y_v);
+        intersection (x.data, y.data, x_v, y_v);
         if (number_of_control_points == 8)
         {
             /* The problem is over-determined.  I prefer the fourth line over
                the focal length.  Maybe this is useful in cases where the focal
                length is not known. */
             double x_h, y_h;
-            intersection (dvector (x.begin() + 4, x.begin() + 8),
-                          dvector (y.begin() + 4, y.begin() + 8),
-                          x_h, y_h);
+            intersection (x.data + 4, y.data + 4, x_h, y_h);
             double radicand = - x_h * x_v - y_h * y_v;
             if (radicand >= 0)
                 f_normalized = sqrt (radicand);
@@ -401,14 +409,14 @@ void calculate_angles (dvector x, dvector y, double &f_normalized,
 
     bool swapped_verticals_and_horizontals = false;
 
-    dvector c (2);
+    dvector<2> c;
     switch (number_of_control_points) {
     case 4:
     case 6:
     case 8:
     {
-        dvector a = normalize (x_v - x [0], y_v - y [0]);
-        dvector b = normalize (x_v - x [2], y_v - y [2]);
+        dvector<2> a = normalize (x_v - x [0], y_v - y [0]);
+        dvector<2> b = normalize (x_v - x [2], y_v - y [2]);
         c [0] = a [0] + b [0];
         c [1] = a [1] + b [1];
         break;
@@ -451,7 +459,7 @@ void calculate_angles (dvector x, dvector y, double &f_normalized,
        after the vertex was moved into the zenith */
     if (number_of_control_points == 4)
     {
-        dvector x_perpendicular_line (2), y_perpendicular_line (2);
+        double x_perpendicular_line [2], y_perpendicular_line [2];
         if (swapped_verticals_and_horizontals)
         {
             x_perpendicular_line [0] = center_x;
@@ -474,24 +482,27 @@ void calculate_angles (dvector x, dvector y, double &f_normalized,
         rho_h = 0;
     else
     {
-        rho_h = determine_rho_h (rho, delta, dvector (x.begin() + 4, x.begin() + 6),
-                                 dvector (y.begin() + 4, y.begin() + 6), f_normalized, center_x, center_y);
+        rho_h = determine_rho_h (rho, delta, x.data + 4, y.data + 4,
+                                 f_normalized, center_x, center_y);
         if (isnan (rho_h))
+        {
             if (number_of_control_points == 8)
-                rho_h = determine_rho_h (rho, delta, dvector (x.begin() + 6, x.begin() + 8),
-                                         dvector (y.begin() + 6, y.begin() + 8), f_normalized, center_x, center_y);
+                rho_h = determine_rho_h (rho, delta, x.data + 6, y.data + 6,
+                                         f_normalized, center_x, center_y);
             else
                 rho_h = 0;
+        }
     }
     center_of_control_points_x = center_x;
     center_of_control_points_y = center_y;
+    return true;
 }
 
 /* Returns a rotation matrix which combines three rotations.  First, around the
  * y axis by ρ₁, then, around the x axis by δ, and finally, around the y axis
  * again by ρ₂.
  */
-matrix generate_rotation_matrix (double rho_1, double delta, double rho_2, double d)
+matrix<3, 3> generate_rotation_matrix (double rho_1, double delta, double rho_2, double d)
 {
     double s_rho_2, c_rho_2, s_delta, c_delta, s_rho_1, c_rho_1,
         w, x, y, z, theta, s_theta;
@@ -531,7 +542,7 @@ matrix generate_rotation_matrix (double rho_1, double delta, double rho_2, doubl
     /* Convert the quaternion to a rotation matrix, see e.g.
        <https://en.wikipedia.org/wiki/Rotation_matrix#Quaternion>.  This matrix
        is (if d=0): R_y(ρ2) · Rₓ(δ) · R_y(ρ1) */
-    matrix M (3, dvector (3));
+    matrix<3, 3> M;
     M [0][0] = 1 - 2 * pow (y, 2) - 2 * pow (z, 2);
     M [0][1] = 2 * x * y - 2 * z * w;
     M [0][2] = 2 * x * z + 2 * y * w;
@@ -544,42 +555,22 @@ matrix generate_rotation_matrix (double rho_1, double delta, double rho_2, doubl
     return M;
 }
 
-bool lfModifier::EnablePerspectiveCorrection (float *x, float *y, int count, float d)
+/* Generates the 11 homography terms for ModifyCoord_Perspective_Correction
+ * from a solved plan and the strength d.  Returns false if the image centre
+ * ends up behind the camera.
+ */
+static bool generate_perspective_terms (const lfPerspectivePlan &plan, float d,
+                                        float *terms)
 {
-    if (Reverse)
-    {
-        return false;
-    }
-    const int number_of_control_points = count;
-    if (number_of_control_points < 4 || number_of_control_points > 8 ||
-        FocalLengthNormalized <= 0 && number_of_control_points != 8)
-        return false;
+    const double rho = plan.Rho, delta = plan.Delta, rho_h = plan.RhoH,
+        alpha = plan.Alpha, f_normalized = plan.FocalLengthNormalized;
     if (d < -1)
         d = -1;
     if (d > 1)
         d = 1;
-    dvector x_, y_;
-    for (int i = 0; i < number_of_control_points; i++)
-    {
-        x_.push_back (x [i] * NormScale - CenterX);
-        y_.push_back (y [i] * NormScale - CenterY);
-    }
-
-    double f_normalized = FocalLengthNormalized;
-    double rho, delta, rho_h, alpha, center_of_control_points_x,
-        center_of_control_points_y, z;
-    try
-    {
-        calculate_angles (x_, y_, f_normalized, rho, delta, rho_h, alpha,
-                          center_of_control_points_x, center_of_control_points_y);
-    }
-    catch (svd_no_convergence &e)
-    {
-        return false;
-    }
 
     // Transform center point to get shift
-    z = rotate_rho_delta_rho_h (rho, delta, rho_h, 0, 0, f_normalized) [2];
+    double z = rotate_rho_delta_rho_h (rho, delta, rho_h, 0, 0, f_normalized) [2];
     /* If the image centre is too much outside, or even at infinity, take the
        center of gravity of the control points instead. */
     enum center_type { old_image_center, control_points_center };
@@ -587,8 +578,8 @@ bool lfModifier::EnablePerspectiveCorrection (float *x, float *y, int count, flo
 
     /* Generate a rotation matrix in forward direction, for getting the
        proper shift of the image center. */
-    matrix A = generate_rotation_matrix (rho, delta, rho_h, d);
-    dvector center_coords (3);
+    matrix<3, 3> A = generate_rotation_matrix (rho, delta, rho_h, d);
+    dvector<3> center_coords;
 
     switch (new_image_center) {
     case old_image_center:
@@ -600,14 +591,14 @@ bool lfModifier::EnablePerspectiveCorrection (float *x, float *y, int count, flo
     }
     case control_points_center:
     {
-        center_coords [0] = A [0][0] * center_of_control_points_x +
-                            A [0][1] * center_of_control_points_y +
+        center_coords [0] = A [0][0] * plan.ControlPointsCenterX +
+                            A [0][1] * plan.ControlPointsCenterY +
                             A [0][2] * f_normalized;
-        center_coords [1] = A [1][0] * center_of_control_points_x +
-                            A [1][1] * center_of_control_points_y +
+        center_coords [1] = A [1][0] * plan.ControlPointsCenterX +
+                            A [1][1] * plan.ControlPointsCenterY +
                             A [1][2] * f_normalized;
-        center_coords [2] = A [2][0] * center_of_control_points_x +
-                            A [2][1] * center_of_control_points_y +
+        center_coords [2] = A [2][0] * plan.ControlPointsCenterX +
+                            A [2][1] * plan.ControlPointsCenterY +
                             A [2][2] * f_normalized;
         break;
     }
@@ -619,7 +610,7 @@ bool lfModifier::EnablePerspectiveCorrection (float *x, float *y, int count, flo
 
     // Finally, generate a rotation matrix in backward (lookup) direction
     {
-        matrix A_ = generate_rotation_matrix (- rho_h, - delta, - rho, d);
+        matrix<3, 3> A_ = generate_rotation_matrix (- rho_h, - delta, - rho, d);
 
         /* Now we append the final rotation by α.  This matrix is: R_y(- ρ) ·
            Rₓ(- δ) · R_y(- ρₕ) · R_z(α). */
@@ -644,17 +635,168 @@ bool lfModifier::EnablePerspectiveCorrection (float *x, float *y, int count, flo
 
     /* The occurances of factors and denominators here avoid additional
        operations in the inner loop of perspective_correction_callback. */
-    float tmp[] = {A [0][0] * mapping_scale, A [0][1] * mapping_scale, A [0][2] * f_normalized,
-                   A [1][0] * mapping_scale, A [1][1] * mapping_scale, A [1][2] * f_normalized,
-                   A [2][0] / center_coords [2], A [2][1] / center_coords [2], A [2][2],
-                   Delta_a / mapping_scale, Delta_b / mapping_scale};
-    AddCoordCallback (ModifyCoord_Perspective_Correction, 300, tmp, sizeof (tmp));
+    terms [0] = A [0][0] * mapping_scale;
+    terms [1] = A [0][1] * mapping_scale;
+    terms [2] = A [0][2] * f_normalized;
+    terms [3] = A [1][0] * mapping_scale;
+    terms [4] = A [1][1] * mapping_scale;
+    terms [5] = A [1][2] * f_normalized;
+    terms [6] = A [2][0] / center_coords [2];
+    terms [7] = A [2][1] / center_coords [2];
+    terms [8] = A [2][2];
+    terms [9] = Delta_a / mapping_scale;
+    terms [10] = Delta_b / mapping_scale;
     return true;
 }
 
+bool lfModifier::SolvePerspectiveCorrection (float *x, float *y, int count,
+                                             lfPerspectivePlan &plan) const
+{
+    return SolvePerspective (x, y, count, plan) == LF_PERSPECTIVE_OK;
+}
+
+lfPerspectiveStatus lfModifier::SolvePerspective (
+    const float *x, const float *y, int count, lfPerspectivePlan &plan) const
+{
+    if (Reverse)
+        return LF_PERSPECTIVE_REVERSE;
+    const int number_of_control_points = count;
+    if (number_of_control_points < 4 || number_of_control_points > 8)
+        return LF_PERSPECTIVE_INVALID_COUNT;
+    if (!(FocalLengthNormalized > 0) && number_of_control_points != 8)
+        return LF_PERSPECTIVE_NO_FOCAL_LENGTH;
+    dvector<8> x_, y_;
+    for (int i = 0; i < number_of_control_points; i++)
+    {
+        x_ [i] = x [i] * NormScale - CenterX;
+        y_ [i] = y [i] * NormScale - CenterY;
+    }
+
+    double f_normalized = FocalLengthNormalized;
+    double rho, delta, rho_h, alpha, center_of_control_points_x,
+        center_of_control_points_y;
+    if (!calculate_angles (x_, y_, number_of_control_points, f_normalized, rho, delta,
+                           rho_h, alpha, center_of_control_points_x,
+                           center_of_control_points_y))
+        return LF_PERSPECTIVE_NO_CONVERGENCE;
+    // Parallel or coincident control lines have no vanishing point
+    if (isnan (rho) || isnan (delta) || isnan (rho_h) || isnan (alpha) ||
+        isnan (f_normalized) || isnan (center_of_control_points_x) ||
+        isnan (center_of_control_points_y))
+        return LF_PERSPECTIVE_DEGENERATE;
+
+    plan.Rho = rho;
+    plan.Delta = delta;
+    plan.RhoH = rho_h;
+    plan.Alpha = alpha;
+    plan.FocalLengthNormalized = f_normalized;
+    plan.ControlPointsCenterX = center_of_control_points_x;
+    plan.ControlPointsCenterY = center_of_control_points_y;
+    return LF_PERSPECTIVE_OK;
+}
+
+void lfModifier::SolvePerspectiveTasks (
+    lfPerspectiveTask *tasks, int count, int first, int stride)
+{
+    for (int i = first; i < count; i += stride)
+    {
+        lfPerspectiveTask &task = tasks [i];
+        lfModifier modifier (task.Lens, task.Crop, task.Width, task.Height);
+        modifier.FocalLengthNormalized =
+            modifier.GetRealFocalLength (task.Lens, task.Focal) /
+            modifier.NormalizedInMillimeters;
+        task.Status = modifier.SolvePerspective (task.X, task.Y, task.Count, task.Plan);
+    }
+}
+
+int lfModifier::SolvePerspectiveCorrections (
+    lfPerspectiveTask *tasks, int count, int threads)
+{
+#ifdef LF_HAVE_THREADS
+    if (threads <= 0)
+        threads = std::thread::hardware_concurrency ();
+    if (threads > count)
+        threads = count;
+
+    // Every thread takes every threads-th task.  The calling thread does its
+    // share, too, and also takes over the share of threads which could not
+    // be started.
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threads; t++)
+        try
+        {
+            workers.push_back (std::thread (SolvePerspectiveTasks, tasks, count, t, threads));
+        }
+        catch (std::system_error &e)
+        {
+            SolvePerspectiveTasks (tasks, count, t, threads);
+        }
+    SolvePerspectiveTasks (tasks, count, 0, threads > 1 ? threads : 1);
+    for (size_t t = 0; t < workers.size (); t++)
+        workers [t].join ();
+#else
+    (void)threads;
+    SolvePerspectiveTasks (tasks, count, 0, 1);
+#endif
+
+    int solved = 0;
+    for (int i = 0; i < count; i++)
+        if (tasks [i].Status == LF_PERSPECTIVE_OK)
+            solved++;
+    return solved;
+}
+
+bool lfModifier::EnablePerspectiveCorrection (const lfPerspectivePlan &plan, float d)
+{
+    if (Reverse)
+        return false;
+
+    lfPerspectiveParams params;
+    if (!generate_perspective_terms (plan, d, params.Terms))
+        return false;
+    params.Plan = plan;
+    lfModifyCoordFunc callback = ModifyCoord_Perspective_Correction;
+#if defined(VECTORIZATION_SIMD128)
+    callback = ModifyCoord_Perspective_Correction_SIMD128;
+#elif defined(VECTORIZATION_SSE)
+    if (_lf_detect_cpu_features () & LF_CPU_FLAG_SSE)
+        callback = ModifyCoord_Perspective_Correction_SSE;
+#endif
+    AddCoordRowCallback (callback, ModifyCoordRow_Perspective_Correction,
+                         ModifyCoordJacobian_Perspective_Correction, 300,
+                         &params, sizeof (params));
+    return true;
+}
+
+bool lfModifier::EnablePerspectiveCorrection (float *x, float *y, int count, float d)
+{
+    lfPerspectivePlan plan;
+    return SolvePerspectiveCorrection (x, y, count, plan) &&
+           EnablePerspectiveCorrection (plan, d);
+}
+
+bool lfModifier::SetPerspectiveCorrectionStrength (float d)
+{
+    std::vector<lfCallbackData*>* callbacks = (std::vector<lfCallbackData*>*)CoordCallbacks;
+    for (size_t i = 0; i < callbacks->size(); i++)
+    {
+        lfCoordCallbackData *cd = (lfCoordCallbackData *)callbacks->at(i);
+        if (!IsPerspectiveCallback (cd->callback))
+            continue;
+
+        lfPerspectiveParams *params = (lfPerspectiveParams *)cd->data;
+        float terms [11];
+        if (!generate_perspective_terms (params->Plan, d, terms))
+            return false;
+        memcpy (params->Terms, terms, sizeof (terms));
+        return true;
+    }
+    return false;
+}
+
 void lfModifier::ModifyCoord_Perspective_Correction (void *data, float *iocoord, int count)
 {
-    float *param = (float *)data;
+    float *param = ((lfPerspectiveParams *)data)->Terms;
     float A11 = param [0];
     float A12 = param [1];
     float A13 = param [2];
@@ -683,6 +825,91 @@ void lfModifier::ModifyCoord_Perspective_Correction (void *data, float *iocoord,
     }
 }
 
+void lfModifier::ModifyCoordRow_Perspective_Correction (
+    void *data, float x, float y, float step, float *res, int count)
+{
+#if defined(VECTORIZATION_SIMD128)
+    ModifyCoordRow_Perspective_Correction_SIMD128 (data, x, y, step, res, count);
+    return;
+#elif defined(VECTORIZATION_SSE)
+    if (_lf_detect_cpu_features () & LF_CPU_FLAG_SSE)
+    {
+        ModifyCoordRow_Perspective_Correction_SSE (data, x, y, step, res, count);
+        return;
+    }
+#endif
+
+    float *param = ((lfPerspectiveParams *)data)->Terms;
+    /* The pixel i of the row is at (x + i·step, y).  Thus, both numerators
+       and the denominator of the homography are linear in i. */
+    float x_ = x + param [9];
+    float y_ = y + param [10];
+    float u0 = param [0] * x_ + param [1] * y_ + param [2];
+    float v0 = param [3] * x_ + param [4] * y_ + param [5];
+    float z0 = param [6] * x_ + param [7] * y_ + param [8];
+    float du = param [0] * step;
+    float dv = param [3] * step;
+    float dz = param [6] * step;
+
+    for (int i = 0; i < count; i++, res += 2)
+    {
+        float z_ = z0 + i * dz;
+        if (z_ > 0)
+        {
+            res [0] = (u0 + i * du) / z_;
+            res [1] = (v0 + i * dv) / z_;
+        }
+        else
+            res [0] = res [1] = 1.6e16F;
+    }
+}
+
+void lfModifier::ModifyCoordJacobian_Perspective_Correction (
+    void *data, float *iocoord, float *jacobian, int count)
+{
+    float *param = ((lfPerspectiveParams *)data)->Terms;
+
+    for (float *end = iocoord + count * 2; iocoord < end; iocoord += 2, jacobian += 4)
+    {
+        float x, y, z_;
+        x = iocoord [0] + param [9];
+        y = iocoord [1] + param [10];
+        z_ = param [6] * x + param [7] * y + param [8];
+        if (z_ > 0)
+        {
+            float u = (param [0] * x + param [1] * y + param [2]) / z_;
+            float v = (param [3] * x + param [4] * y + param [5]) / z_;
+            iocoord [0] = u;
+            iocoord [1] = v;
+            // The quotient rule, with the quotients u and v in place of the
+            // numerators
+            _lf_chain_jacobian (jacobian,
+                                (param [0] - u * param [6]) / z_,
+                                (param [1] - u * param [7]) / z_,
+                                (param [3] - v * param [6]) / z_,
+                                (param [4] - v * param [7]) / z_);
+        }
+        else
+        {
+            // Behind the camera, like unsolved points of the inverse models
+            iocoord [0] = iocoord [1] = 1.6e16F;
+            jacobian [0] = jacobian [1] = jacobian [2] = jacobian [3] = NAN;
+        }
+    }
+}
+
+bool lfModifier::IsPerspectiveCallback (lfModifyCoordFunc callback)
+{
+    return callback == ModifyCoord_Perspective_Correction
+#ifdef VECTORIZATION_SSE
+        || callback == ModifyCoord_Perspective_Correction_SSE
+#endif
+#ifdef VECTORIZATION_SIMD128
+        || callback == ModifyCoord_Perspective_Correction_SIMD128
+#endif
+        ;
+}
+
 //---------------------------// The C interface //---------------------------//
 
 cbool lf_modifier_enable_perspective_correction (
@@ -690,3 +917,28 @@ cbool lf_modifier_enable_perspective_correction (
 {
     return modifier->EnablePerspectiveCorrection (x, y, count, d);
 }
+
+cbool lf_modifier_solve_perspective_correction (
+    const lfModifier *modifier, float *x, float *y, int count,
+    lfPerspectivePlan *plan)
+{
+    return modifier->SolvePerspectiveCorrection (x, y, count, *plan);
+}
+
+int lf_modifier_solve_perspective_corrections (
+    lfPerspectiveTask *tasks, int count, int threads)
+{
+    return lfModifier::SolvePerspectiveCorrections (tasks, count, threads);
+}
+
+cbool lf_modifier_enable_perspective_correction_plan (
+    lfModifier *modifier, const lfPerspectivePlan *plan, float d)
+{
+    return modifier->EnablePerspectiveCorrection (*plan, d);
+}
+
+cbool lf_modifier_set_perspective_correction_strength (
+    lfModifier *modifier, float d)
+{
+    return modifier->SetPerspectiveCorrectionStrength (d);
+}
@@ -0,0 +1,238 @@
+/*
+    Profiling counters of the modifier callbacks
+*/
+
+#include "config.h"
+#include "lensfun.h"
+#include "lensfunprv.h"
+
+#ifdef LF_PROFILING
+
+#include <atomic>
+
+// Distinct callbacks which can be told apart; further ones are not counted
+#define PROFILE_SLOTS 64
+
+struct lfProfileSlot
+{
+    std::atomic<const void *> Callback;
+    std::atomic<unsigned long long> Calls, Pixels, Nanoseconds;
+    std::atomic<unsigned long long> NewtonSteps [LF_PROFILE_NEWTON_BINS];
+    std::atomic<unsigned long long> NewtonFailures;
+};
+
+// Static storage, so everything starts out as zero.  Slots are claimed for
+// good; a reset only clears their counters.
+static lfProfileSlot profile_slots [PROFILE_SLOTS];
+
+static lfProfileSlot *profile_slot (const void *callback)
+{
+    for (int i = 0; i < PROFILE_SLOTS; i++)
+    {
+        const void *owner = profile_slots [i].Callback.load (std::memory_order_acquire);
+        if (!owner)
+        {
+            // A thread may claim the slot between the load and here
+            profile_slots [i].Callback.compare_exchange_strong (owner, callback);
+            if (!owner)
+                return &profile_slots [i];
+        }
+        if (owner == callback)
+            return &profile_slots [i];
+    }
+    return NULL;
+}
+
+void _lf_profile_add_call (const void *callback, int pixels, unsigned long long ns)
+{
+    lfProfileSlot *slot = profile_slot (callback);
+    if (!slot)
+        return;
+    slot->Calls.fetch_add (1, std::memory_order_relaxed);
+    slot->Pixels.fetch_add (pixels, std::memory_order_relaxed);
+    slot->Nanoseconds.fetch_add (ns, std::memory_order_relaxed);
+}
+
+void _lf_profile_add_newton (const void *callback, const lfNewtonProfile &newton)
+{
+    lfProfileSlot *slot = profile_slot (callback);
+    if (!slot)
+        return;
+    for (int i = 0; i < LF_PROFILE_NEWTON_BINS; i++)
+        if (newton.Steps [i])
+            slot->NewtonSteps [i].fetch_add (newton.Steps [i], std::memory_order_relaxed);
+    if (newton.Failures)
+        slot->NewtonFailures.fetch_add (newton.Failures, std::memory_order_relaxed);
+}
+
+#define PROFILE_NAME(func) { (const void *)lfModifier::func, #func }
+
+const char *lfModifier::ProfileName (const void *callback)
+{
+    static const struct
+    {
+        const void *callback;
+        const char *name;
+    } names [] =
+    {
+        PROFILE_NAME (ModifyCoord_Scale),
+        PROFILE_NAME (ModifyCoord_UnDist_Poly3),
+        PROFILE_NAME (ModifyCoord_Dist_Poly3),
+        PROFILE_NAME (ModifyCoord_UnDist_Poly5),
+        PROFILE_NAME (ModifyCoord_Dist_Poly5),
+        PROFILE_NAME (ModifyCoord_UnDist_PTLens),
+        PROFILE_NAME (ModifyCoord_Dist_PTLens),
+        PROFILE_NAME (ModifyCoord_Dist_ACM),
+#ifdef VECTORIZATION_SSE
+        PROFILE_NAME (ModifyCoordRow_Perspective_Correction_SSE),
+        PROFILE_NAME (ModifyCoord_Perspective_Correction_SSE),
+#endif
+#ifdef VECTORIZATION_SIMD128
+        PROFILE_NAME (ModifyCoord_Dist_Poly3_SIMD128),
+        PROFILE_NAME (ModifyCoord_Dist_Poly5_SIMD128),
+        PROFILE_NAME (ModifyCoord_Dist_PTLens_SIMD128),
+        PROFILE_NAME (ModifyCoordRow_Perspective_Correction_SIMD128),
+        PROFILE_NAME (ModifyCoord_Perspective_Correction_SIMD128),
+        PROFILE_NAME (ModifyColor_Vignetting_PA_SIMD128<lf_u8>),
+        PROFILE_NAME (ModifyColor_Vignetting_PA_SIMD128<lf_u16>),
+        PROFILE_NAME (ModifyColor_Vignetting_PA_SIMD128<lf_f32>),
+        PROFILE_NAME (ModifyColor_DeVignetting_PA_SIMD128<lf_u8>),
+        PROFILE_NAME (ModifyColor_DeVignetting_PA_SIMD128<lf_u16>),
+        PROFILE_NAME (ModifyColor_DeVignetting_PA_SIMD128<lf_f32>),
+        PROFILE_NAME (ModifyCoord_UnTCA_Poly3_SIMD128),
+        PROFILE_NAME (ModifyCoord_TCA_Poly3_SIMD128),
+        PROFILE_NAME (ModifyCoord_TCA_ACM_SIMD128),
+#endif
+#ifdef VECTORIZATION_SSE4_1
+        PROFILE_NAME (ModifyCoord_UnTCA_Poly3_SSE4),
+        PROFILE_NAME (ModifyCoord_TCA_Poly3_SSE4),
+        PROFILE_NAME (ModifyCoord_TCA_ACM_SSE4),
+#endif
+#ifdef VECTORIZATION_AVX2
+        PROFILE_NAME (ModifyCoord_UnTCA_Poly3_AVX2),
+        PROFILE_NAME (ModifyCoord_TCA_Poly3_AVX2),
+        PROFILE_NAME (ModifyCoord_TCA_ACM_AVX2),
+#endif
+        PROFILE_NAME (ModifyCoord_Geom_FishEye_Rect),
+        PROFILE_NAME (ModifyCoord_Geom_Panoramic_Rect),
+        PROFILE_NAME (ModifyCoordColumns_Geom_Panoramic_Rect),
+        PROFILE_NAME (ModifyCoordTableRow_Geom_Panoramic_Rect),
+        PROFILE_NAME (ModifyCoord_Geom_ERect_Rect),
+        PROFILE_NAME (ModifyCoord_Geom_Rect_FishEye),
+        PROFILE_NAME (ModifyCoord_Geom_Panoramic_FishEye),
+        PROFILE_NAME (ModifyCoord_Geom_ERect_FishEye),
+        PROFILE_NAME (ModifyCoord_Geom_Rect_Panoramic),
+        PROFILE_NAME (ModifyCoordColumns_Geom_Rect_Panoramic),
+        PROFILE_NAME (ModifyCoordTableRow_Geom_Rect_Panoramic),
+        PROFILE_NAME (ModifyCoord_Geom_FishEye_Panoramic),
+        PROFILE_NAME (ModifyCoord_Geom_ERect_Panoramic),
+        PROFILE_NAME (ModifyCoordTableRow_Geom_ERect_Panoramic),
+        PROFILE_NAME (ModifyCoord_Geom_Rect_ERect),
+        PROFILE_NAME (ModifyCoordColumns_Geom_Rect_ERect),
+        PROFILE_NAME (ModifyCoordTableRow_Geom_Rect_ERect),
+        PROFILE_NAME (ModifyCoord_Geom_FishEye_ERect),
+        PROFILE_NAME (ModifyCoord_Geom_Panoramic_ERect),
+        PROFILE_NAME (ModifyCoordTableRow_Geom_Panoramic_ERect),
+        PROFILE_NAME (ModifyCoordColumns_Geom_Identity),
+        PROFILE_NAME (ModifyCoord_Geom_Orthographic_ERect),
+        PROFILE_NAME (ModifyCoord_Geom_ERect_Orthographic),
+        PROFILE_NAME (ModifyCoord_Geom_Stereographic_ERect),
+        PROFILE_NAME (ModifyCoord_Geom_ERect_Stereographic),
+        PROFILE_NAME (ModifyCoord_Geom_Equisolid_ERect),
+        PROFILE_NAME (ModifyCoord_Geom_ERect_Equisolid),
+        PROFILE_NAME (ModifyCoord_Geom_Thoby_ERect),
+        PROFILE_NAME (ModifyCoord_Geom_ERect_Thoby),
+        PROFILE_NAME (ModifyCoord_Perspective_Correction),
+        PROFILE_NAME (ModifyCoordRow_Perspective_Correction),
+        PROFILE_NAME (ModifyCoord_UnTCA_Linear),
+        PROFILE_NAME (ModifyCoord_TCA_Linear),
+        PROFILE_NAME (ModifyCoord_UnTCA_Poly3),
+        PROFILE_NAME (ModifyCoord_TCA_Poly3),
+        PROFILE_NAME (ModifyCoord_TCA_ACM),
+        PROFILE_NAME (ModifyColor_Vignetting_PA<lf_u8>),
+        PROFILE_NAME (ModifyColor_Vignetting_PA<lf_u16>),
+        PROFILE_NAME (ModifyColor_Vignetting_PA<lf_u32>),
+        PROFILE_NAME (ModifyColor_Vignetting_PA<lf_f32>),
+        PROFILE_NAME (ModifyColor_Vignetting_PA<lf_f64>),
+        PROFILE_NAME (ModifyColor_DeVignetting_PA<lf_u8>),
+        PROFILE_NAME (ModifyColor_DeVignetting_PA<lf_u16>),
+        PROFILE_NAME (ModifyColor_DeVignetting_PA<lf_u32>),
+        PROFILE_NAME (ModifyColor_DeVignetting_PA<lf_f32>),
+        PROFILE_NAME (ModifyColor_DeVignetting_PA<lf_f64>),
+    };
+
+    // Names of the stock callbacks, as they are registered
+    for (size_t i = 0; i < ARRAY_LEN (names); i++)
+        if (names [i].callback == callback)
+            return names [i].name;
+    return "custom";
+}
+
+int lfModifier::GetProfileCounters (lfProfileCounters *counters, int count)
+{
+    int used = 0;
+    for (int i = 0; i < PROFILE_SLOTS; i++)
+    {
+        const lfProfileSlot &slot = profile_slots [i];
+        const void *callback = slot.Callback.load (std::memory_order_acquire);
+        if (!callback)
+            break;
+        // Slots of callbacks which only ran during setup since the last
+        // reset have nothing to report
+        if (!slot.Calls.load ())
+            continue;
+        if (used < count)
+        {
+            lfProfileCounters &c = counters [used];
+            c.Name = ProfileName (callback);
+            c.Callback = callback;
+            c.Calls = slot.Calls.load ();
+            c.Pixels = slot.Pixels.load ();
+            c.Nanoseconds = slot.Nanoseconds.load ();
+            for (int b = 0; b < LF_PROFILE_NEWTON_BINS; b++)
+                c.NewtonSteps [b] = slot.NewtonSteps [b].load ();
+            c.NewtonFailures = slot.NewtonFailures.load ();
+        }
+        used++;
+    }
+    return used;
+}
+
+void lfModifier::ResetProfileCounters ()
+{
+    for (int i = 0; i < PROFILE_SLOTS; i++)
+    {
+        lfProfileSlot &slot = profile_slots [i];
+        slot.Calls = 0;
+        slot.Pixels = 0;
+        slot.Nanoseconds = 0;
+        for (int b = 0; b < LF_PROFILE_NEWTON_BINS; b++)
+            slot.NewtonSteps [b] = 0;
+        slot.NewtonFailures = 0;
+    }
+}
+
+#else
+
+int lfModifier::GetProfileCounters (lfProfileCounters *counters, int count)
+{
+    return -1;
+}
+
+void lfModifier::ResetProfileCounters ()
+{
+}
+
+#endif
+
+//---------------------------// The C interface //---------------------------//
+
+int lf_modifier_get_profile_counters (lfProfileCounters *counters, int count)
+{
+    return lfModifier::GetProfileCounters (counters, count);
+}
+
+void lf_modifier_reset_profile_counters ()
+{
+    lfModifier::ResetProfileCounters ();
+}
@@ -0,0 +1,219 @@
+/*
+    AVX2 versions of the TCA callbacks
+*/
+
+#include "config.h"
+
+#ifdef VECTORIZATION_AVX2
+
+#include "lensfun.h"
+#include "lensfunprv.h"
+#include <immintrin.h>
+
+#define AVX2_FUNC __attribute__ ((target ("avx2")))
+
+// Eight pixels are 48 floats.  The lower 128-bit lane of every vector holds
+// the first four pixels and the upper lane the next four, so the in-lane
+// shuffles gather the red and blue coordinate pairs exactly like the SSE4.1
+// version does, and each kernel below computes one colour component of eight
+// pixels at once.
+struct tca_block
+{
+    __m256 v [6];
+    __m256 rx, ry, bx, by;
+};
+
+AVX2_FUNC static inline void tca_load (tca_block &b, const float *iocoord)
+{
+    for (int i = 0; i < 6; i++)
+        b.v [i] = _mm256_insertf128_ps (
+            _mm256_castps128_ps256 (_mm_loadu_ps (iocoord + 4 * i)),
+            _mm_loadu_ps (iocoord + 24 + 4 * i), 1);
+
+    __m256 lo = _mm256_shuffle_ps (b.v [0], b.v [1], _MM_SHUFFLE (3, 2, 1, 0));
+    __m256 hi = _mm256_shuffle_ps (b.v [3], b.v [4], _MM_SHUFFLE (3, 2, 1, 0));
+    b.rx = _mm256_shuffle_ps (lo, hi, _MM_SHUFFLE (2, 0, 2, 0));
+    b.ry = _mm256_shuffle_ps (lo, hi, _MM_SHUFFLE (3, 1, 3, 1));
+
+    lo = _mm256_shuffle_ps (b.v [1], b.v [2], _MM_SHUFFLE (3, 2, 1, 0));
+    hi = _mm256_shuffle_ps (b.v [4], b.v [5], _MM_SHUFFLE (3, 2, 1, 0));
+    b.bx = _mm256_shuffle_ps (lo, hi, _MM_SHUFFLE (2, 0, 2, 0));
+    b.by = _mm256_shuffle_ps (lo, hi, _MM_SHUFFLE (3, 1, 3, 1));
+}
+
+AVX2_FUNC static inline void tca_store_vector (float *iocoord, __m256 v)
+{
+    _mm_storeu_ps (iocoord, _mm256_castps256_ps128 (v));
+    _mm_storeu_ps (iocoord + 24, _mm256_extractf128_ps (v, 1));
+}
+
+AVX2_FUNC static inline void tca_store (const tca_block &b, float *iocoord)
+{
+    __m256 r_lo = _mm256_unpacklo_ps (b.rx, b.ry);
+    __m256 r_hi = _mm256_unpackhi_ps (b.rx, b.ry);
+    __m256 b_lo = _mm256_unpacklo_ps (b.bx, b.by);
+    __m256 b_hi = _mm256_unpackhi_ps (b.bx, b.by);
+
+    tca_store_vector (iocoord,      _mm256_shuffle_ps (r_lo, b.v [0], _MM_SHUFFLE (3, 2, 1, 0)));
+    tca_store_vector (iocoord + 4,  _mm256_shuffle_ps (b_lo, r_lo, _MM_SHUFFLE (3, 2, 1, 0)));
+    tca_store_vector (iocoord + 8,  _mm256_shuffle_ps (b.v [2], b_lo, _MM_SHUFFLE (3, 2, 1, 0)));
+    tca_store_vector (iocoord + 12, _mm256_shuffle_ps (r_hi, b.v [3], _MM_SHUFFLE (3, 2, 1, 0)));
+    tca_store_vector (iocoord + 16, _mm256_shuffle_ps (b_hi, r_hi, _MM_SHUFFLE (3, 2, 1, 0)));
+    tca_store_vector (iocoord + 20, _mm256_shuffle_ps (b.v [5], b_hi, _MM_SHUFFLE (3, 2, 1, 0)));
+}
+
+AVX2_FUNC static inline void tca_poly3 (
+    __m256 &x, __m256 &y, __m256 v, __m256 c, __m256 b, bool use_c)
+{
+    __m256 ru2 = _mm256_add_ps (_mm256_mul_ps (x, x), _mm256_mul_ps (y, y));
+    __m256 poly2 = _mm256_mul_ps (b, ru2);
+    if (use_c)
+        poly2 = _mm256_add_ps (poly2, _mm256_mul_ps (c, _mm256_sqrt_ps (ru2)));
+    poly2 = _mm256_add_ps (poly2, v);
+    x = _mm256_mul_ps (x, poly2);
+    y = _mm256_mul_ps (y, poly2);
+}
+
+AVX2_FUNC static inline void untca_poly3 (
+    __m256 &x, __m256 &y, __m256 v, __m256 c, __m256 b LF_PROFILE_NEWTON_PARAM)
+{
+    const __m256 eps = _mm256_set1_ps (NEWTON_EPS);
+    const __m256 neg_eps = _mm256_set1_ps (-NEWTON_EPS);
+    const __m256 two = _mm256_set1_ps (2.0f);
+    const __m256 three = _mm256_set1_ps (3.0f);
+
+    __m256 rd = _mm256_sqrt_ps (_mm256_add_ps (_mm256_mul_ps (x, x), _mm256_mul_ps (y, y)));
+    __m256 ru = rd;
+    // Lanes which found their root keep it, the others go on iterating.
+    // Like the scalar version, give up after seven evaluations.
+    __m256 converged = _mm256_setzero_ps ();
+#ifdef LF_PROFILING
+    int counted = 0;
+#endif
+    for (int step = 0; ; step++)
+    {
+        __m256 ru2 = _mm256_mul_ps (ru, ru);
+        __m256 fru = _mm256_sub_ps (
+            _mm256_add_ps (_mm256_add_ps (_mm256_mul_ps (_mm256_mul_ps (b, ru2), ru),
+                                    _mm256_mul_ps (c, ru2)),
+                        _mm256_mul_ps (v, ru)), rd);
+        converged = _mm256_or_ps (converged, _mm256_and_ps (
+            _mm256_cmp_ps (fru, neg_eps, _CMP_GE_OQ), _mm256_cmp_ps (fru, eps, _CMP_LT_OQ)));
+#ifdef LF_PROFILING
+        int mask = _mm256_movemask_ps (converged);
+        LF_PROFILE_NEWTON_LANES (step, mask & ~counted);
+        counted = mask;
+        if (step > 5)
+            LF_PROFILE_NEWTON_FAIL_LANES (~mask & 255);
+#endif
+        if (_mm256_movemask_ps (converged) == 255 || step > 5)
+            break;
+
+        __m256 deriv = _mm256_add_ps (
+            _mm256_add_ps (_mm256_mul_ps (_mm256_mul_ps (three, b), ru2),
+                        _mm256_mul_ps (_mm256_mul_ps (two, c), ru)), v);
+        ru = _mm256_blendv_ps (_mm256_sub_ps (ru, _mm256_div_ps (fru, deriv)), ru, converged);
+    }
+
+    // Zero or negative radii, and lanes which did not converge, stay as they are
+    __m256 ok = _mm256_and_ps (converged, _mm256_and_ps (
+        _mm256_cmp_ps (ru, _mm256_setzero_ps (), _CMP_GT_OQ), _mm256_cmp_ps (rd, _mm256_setzero_ps (), _CMP_NEQ_UQ)));
+    __m256 scale = _mm256_div_ps (ru, rd);
+    x = _mm256_blendv_ps (x, _mm256_mul_ps (x, scale), ok);
+    y = _mm256_blendv_ps (y, _mm256_mul_ps (y, scale), ok);
+}
+
+AVX2_FUNC static inline void tca_acm (__m256 &x, __m256 &y, const float *k,
+                                      __m256 acm_scale, __m256 acm_unscale)
+{
+    const __m256 one = _mm256_set1_ps (1.0f);
+    const __m256 two = _mm256_set1_ps (2.0f);
+    __m256 k0 = _mm256_set1_ps (k [0]), k1 = _mm256_set1_ps (k [2]), k2 = _mm256_set1_ps (k [4]);
+    __m256 k3 = _mm256_set1_ps (k [6]), k4 = _mm256_set1_ps (k [8]), k5 = _mm256_set1_ps (k [10]);
+
+    x = _mm256_mul_ps (x, acm_scale);
+    y = _mm256_mul_ps (y, acm_scale);
+    __m256 ru2 = _mm256_add_ps (_mm256_mul_ps (x, x), _mm256_mul_ps (y, y));
+    __m256 ru4 = _mm256_mul_ps (ru2, ru2);
+    __m256 common_term = _mm256_add_ps (
+        _mm256_add_ps (_mm256_add_ps (_mm256_add_ps (one, _mm256_mul_ps (k1, ru2)),
+                                _mm256_mul_ps (k2, ru4)),
+                    _mm256_mul_ps (_mm256_mul_ps (k3, ru4), ru2)),
+        _mm256_mul_ps (two, _mm256_add_ps (_mm256_mul_ps (k4, y), _mm256_mul_ps (k5, x))));
+    __m256 nx = _mm256_add_ps (_mm256_mul_ps (x, common_term), _mm256_mul_ps (k5, ru2));
+    __m256 ny = _mm256_add_ps (_mm256_mul_ps (y, common_term), _mm256_mul_ps (k4, ru2));
+    x = _mm256_mul_ps (_mm256_mul_ps (k0, nx), acm_unscale);
+    y = _mm256_mul_ps (_mm256_mul_ps (k0, ny), acm_unscale);
+}
+
+AVX2_FUNC void lfModifier::ModifyCoord_TCA_Poly3_AVX2 (void *data, float *iocoord, int count)
+{
+    const float *param = (float *)data;
+    const __m256 vr = _mm256_set1_ps (param [0]);
+    const __m256 vb = _mm256_set1_ps (param [1]);
+    const __m256 cr = _mm256_set1_ps (param [2]);
+    const __m256 cb = _mm256_set1_ps (param [3]);
+    const __m256 br = _mm256_set1_ps (param [4]);
+    const __m256 bb = _mm256_set1_ps (param [5]);
+    const bool use_c = param [2] != 0.0 || param [3] != 0.0;
+
+    tca_block b;
+    for (; count >= 8; count -= 8, iocoord += 8 * 6)
+    {
+        tca_load (b, iocoord);
+        tca_poly3 (b.rx, b.ry, vr, cr, br, use_c);
+        tca_poly3 (b.bx, b.by, vb, cb, bb, use_c);
+        tca_store (b, iocoord);
+    }
+
+    if (count)
+        ModifyCoord_TCA_Poly3 (data, iocoord, count);
+}
+
+AVX2_FUNC void lfModifier::ModifyCoord_UnTCA_Poly3_AVX2 (void *data, float *iocoord, int count)
+{
+    const float *param = (float *)data;
+    const __m256 vr = _mm256_set1_ps (param [0]);
+    const __m256 vb = _mm256_set1_ps (param [1]);
+    const __m256 cr = _mm256_set1_ps (param [2]);
+    const __m256 cb = _mm256_set1_ps (param [3]);
+    const __m256 br = _mm256_set1_ps (param [4]);
+    const __m256 bb = _mm256_set1_ps (param [5]);
+
+    LF_PROFILE_NEWTON_BEGIN ();
+    tca_block b;
+    for (; count >= 8; count -= 8, iocoord += 8 * 6)
+    {
+        tca_load (b, iocoord);
+        untca_poly3 (b.rx, b.ry, vr, cr, br LF_PROFILE_NEWTON_ARG);
+        untca_poly3 (b.bx, b.by, vb, cb, bb LF_PROFILE_NEWTON_ARG);
+        tca_store (b, iocoord);
+    }
+
+    LF_PROFILE_NEWTON_END (ModifyCoord_UnTCA_Poly3_AVX2);
+
+    if (count)
+        ModifyCoord_UnTCA_Poly3 (data, iocoord, count);
+}
+
+AVX2_FUNC void lfModifier::ModifyCoord_TCA_ACM_AVX2 (void *data, float *iocoord, int count)
+{
+    // Even terms are the red (alpha), odd terms the blue (beta) coefficients
+    const float *param = (float *)data;
+    const __m256 acm_scale = _mm256_set1_ps (param [12]);
+    const __m256 acm_unscale = _mm256_set1_ps (param [13]);
+
+    tca_block b;
+    for (; count >= 8; count -= 8, iocoord += 8 * 6)
+    {
+        tca_load (b, iocoord);
+        tca_acm (b.rx, b.ry, param, acm_scale, acm_unscale);
+        tca_acm (b.bx, b.by, param + 1, acm_scale, acm_unscale);
+        tca_store (b, iocoord);
+    }
+
+    if (count)
+        ModifyCoord_TCA_ACM (data, iocoord, count);
+}
+
+#endif
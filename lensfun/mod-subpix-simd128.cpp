@@ -0,0 +1,207 @@
+/*
+    WebAssembly SIMD128 versions of the TCA callbacks
+*/
+
+#include "config.h"
+
+#ifdef VECTORIZATION_SIMD128
+
+#include "lensfun.h"
+#include "lensfunprv.h"
+#include <wasm_simd128.h>
+
+// Four pixels are 24 floats or six vectors.  The red and blue coordinate
+// pairs of those pixels are gathered into X and Y vectors, so that each
+// kernel below computes one colour component of four pixels at once.
+struct tca_block
+{
+    v128_t v [6];
+    v128_t rx, ry, bx, by;
+};
+
+static inline void tca_load (tca_block &b, const float *iocoord)
+{
+    for (int i = 0; i < 6; i++)
+        b.v [i] = wasm_v128_load (iocoord + 4 * i);
+
+    v128_t lo = wasm_i32x4_shuffle (b.v [0], b.v [1], 0, 1, 6, 7);
+    v128_t hi = wasm_i32x4_shuffle (b.v [3], b.v [4], 0, 1, 6, 7);
+    b.rx = wasm_i32x4_shuffle (lo, hi, 0, 2, 4, 6);
+    b.ry = wasm_i32x4_shuffle (lo, hi, 1, 3, 5, 7);
+
+    lo = wasm_i32x4_shuffle (b.v [1], b.v [2], 0, 1, 6, 7);
+    hi = wasm_i32x4_shuffle (b.v [4], b.v [5], 0, 1, 6, 7);
+    b.bx = wasm_i32x4_shuffle (lo, hi, 0, 2, 4, 6);
+    b.by = wasm_i32x4_shuffle (lo, hi, 1, 3, 5, 7);
+}
+
+static inline void tca_store (const tca_block &b, float *iocoord)
+{
+    v128_t r_lo = wasm_i32x4_shuffle (b.rx, b.ry, 0, 4, 1, 5);
+    v128_t r_hi = wasm_i32x4_shuffle (b.rx, b.ry, 2, 6, 3, 7);
+    v128_t b_lo = wasm_i32x4_shuffle (b.bx, b.by, 0, 4, 1, 5);
+    v128_t b_hi = wasm_i32x4_shuffle (b.bx, b.by, 2, 6, 3, 7);
+
+    wasm_v128_store (iocoord, wasm_i32x4_shuffle (r_lo, b.v [0], 0, 1, 6, 7));
+    wasm_v128_store (iocoord + 4, wasm_i32x4_shuffle (b_lo, r_lo, 0, 1, 6, 7));
+    wasm_v128_store (iocoord + 8, wasm_i32x4_shuffle (b.v [2], b_lo, 0, 1, 6, 7));
+    wasm_v128_store (iocoord + 12, wasm_i32x4_shuffle (r_hi, b.v [3], 0, 1, 6, 7));
+    wasm_v128_store (iocoord + 16, wasm_i32x4_shuffle (b_hi, r_hi, 0, 1, 6, 7));
+    wasm_v128_store (iocoord + 20, wasm_i32x4_shuffle (b.v [5], b_hi, 0, 1, 6, 7));
+}
+
+static inline void tca_poly3 (
+    v128_t &x, v128_t &y, v128_t v, v128_t c, v128_t b, bool use_c)
+{
+    v128_t ru2 = wasm_f32x4_add (wasm_f32x4_mul (x, x), wasm_f32x4_mul (y, y));
+    v128_t poly2 = wasm_f32x4_mul (b, ru2);
+    if (use_c)
+        poly2 = wasm_f32x4_add (poly2, wasm_f32x4_mul (c, wasm_f32x4_sqrt (ru2)));
+    poly2 = wasm_f32x4_add (poly2, v);
+    x = wasm_f32x4_mul (x, poly2);
+    y = wasm_f32x4_mul (y, poly2);
+}
+
+static inline void untca_poly3 (
+    v128_t &x, v128_t &y, v128_t v, v128_t c, v128_t b LF_PROFILE_NEWTON_PARAM)
+{
+    const v128_t eps = wasm_f32x4_splat (NEWTON_EPS);
+    const v128_t neg_eps = wasm_f32x4_splat (-NEWTON_EPS);
+    const v128_t two = wasm_f32x4_splat (2.0f);
+    const v128_t three = wasm_f32x4_splat (3.0f);
+
+    v128_t rd = wasm_f32x4_sqrt (wasm_f32x4_add (wasm_f32x4_mul (x, x), wasm_f32x4_mul (y, y)));
+    v128_t ru = rd;
+    // Lanes which found their root keep it, the others go on iterating.
+    // Like the scalar version, give up after seven evaluations.
+    v128_t converged = wasm_f32x4_splat (0.0f);
+#ifdef LF_PROFILING
+    int counted = 0;
+#endif
+    for (int step = 0; ; step++)
+    {
+        v128_t ru2 = wasm_f32x4_mul (ru, ru);
+        v128_t fru = wasm_f32x4_sub (
+            wasm_f32x4_add (wasm_f32x4_add (wasm_f32x4_mul (wasm_f32x4_mul (b, ru2), ru),
+                                    wasm_f32x4_mul (c, ru2)),
+                        wasm_f32x4_mul (v, ru)), rd);
+        converged = wasm_v128_or (converged, wasm_v128_and (
+            wasm_f32x4_ge (fru, neg_eps), wasm_f32x4_lt (fru, eps)));
+#ifdef LF_PROFILING
+        int mask = wasm_i32x4_bitmask (converged);
+        LF_PROFILE_NEWTON_LANES (step, mask & ~counted);
+        counted = mask;
+        if (step > 5)
+            LF_PROFILE_NEWTON_FAIL_LANES (~mask & 15);
+#endif
+        if (wasm_i32x4_all_true (converged) || step > 5)
+            break;
+
+        v128_t deriv = wasm_f32x4_add (
+            wasm_f32x4_add (wasm_f32x4_mul (wasm_f32x4_mul (three, b), ru2),
+                        wasm_f32x4_mul (wasm_f32x4_mul (two, c), ru)), v);
+        ru = wasm_v128_bitselect (ru, wasm_f32x4_sub (ru, wasm_f32x4_div (fru, deriv)), converged);
+    }
+
+    // Zero or negative radii, and lanes which did not converge, stay as they are
+    v128_t ok = wasm_v128_and (converged, wasm_v128_and (
+        wasm_f32x4_gt (ru, wasm_f32x4_splat (0.0f)), wasm_f32x4_ne (rd, wasm_f32x4_splat (0.0f))));
+    v128_t scale = wasm_f32x4_div (ru, rd);
+    x = wasm_v128_bitselect (wasm_f32x4_mul (x, scale), x, ok);
+    y = wasm_v128_bitselect (wasm_f32x4_mul (y, scale), y, ok);
+}
+
+static inline void tca_acm (v128_t &x, v128_t &y, const float *k,
+                                      v128_t acm_scale, v128_t acm_unscale)
+{
+    const v128_t one = wasm_f32x4_splat (1.0f);
+    const v128_t two = wasm_f32x4_splat (2.0f);
+    v128_t k0 = wasm_f32x4_splat (k [0]), k1 = wasm_f32x4_splat (k [2]), k2 = wasm_f32x4_splat (k [4]);
+    v128_t k3 = wasm_f32x4_splat (k [6]), k4 = wasm_f32x4_splat (k [8]), k5 = wasm_f32x4_splat (k [10]);
+
+    x = wasm_f32x4_mul (x, acm_scale);
+    y = wasm_f32x4_mul (y, acm_scale);
+    v128_t ru2 = wasm_f32x4_add (wasm_f32x4_mul (x, x), wasm_f32x4_mul (y, y));
+    v128_t ru4 = wasm_f32x4_mul (ru2, ru2);
+    v128_t common_term = wasm_f32x4_add (
+        wasm_f32x4_add (wasm_f32x4_add (wasm_f32x4_add (one, wasm_f32x4_mul (k1, ru2)),
+                                wasm_f32x4_mul (k2, ru4)),
+                    wasm_f32x4_mul (wasm_f32x4_mul (k3, ru4), ru2)),
+        wasm_f32x4_mul (two, wasm_f32x4_add (wasm_f32x4_mul (k4, y), wasm_f32x4_mul (k5, x))));
+    v128_t nx = wasm_f32x4_add (wasm_f32x4_mul (x, common_term), wasm_f32x4_mul (k5, ru2));
+    v128_t ny = wasm_f32x4_add (wasm_f32x4_mul (y, common_term), wasm_f32x4_mul (k4, ru2));
+    x = wasm_f32x4_mul (wasm_f32x4_mul (k0, nx), acm_unscale);
+    y = wasm_f32x4_mul (wasm_f32x4_mul (k0, ny), acm_unscale);
+}
+
+void lfModifier::ModifyCoord_TCA_Poly3_SIMD128 (void *data, float *iocoord, int count)
+{
+    const float *param = (float *)data;
+    const v128_t vr = wasm_f32x4_splat (param [0]);
+    const v128_t vb = wasm_f32x4_splat (param [1]);
+    const v128_t cr = wasm_f32x4_splat (param [2]);
+    const v128_t cb = wasm_f32x4_splat (param [3]);
+    const v128_t br = wasm_f32x4_splat (param [4]);
+    const v128_t bb = wasm_f32x4_splat (param [5]);
+    const bool use_c = param [2] != 0.0 || param [3] != 0.0;
+
+    tca_block b;
+    for (; count >= 4; count -= 4, iocoord += 4 * 6)
+    {
+        tca_load (b, iocoord);
+        tca_poly3 (b.rx, b.ry, vr, cr, br, use_c);
+        tca_poly3 (b.bx, b.by, vb, cb, bb, use_c);
+        tca_store (b, iocoord);
+    }
+
+    if (count)
+        ModifyCoord_TCA_Poly3 (data, iocoord, count);
+}
+
+void lfModifier::ModifyCoord_UnTCA_Poly3_SIMD128 (void *data, float *iocoord, int count)
+{
+    const float *param = (float *)data;
+    const v128_t vr = wasm_f32x4_splat (param [0]);
+    const v128_t vb = wasm_f32x4_splat (param [1]);
+    const v128_t cr = wasm_f32x4_splat (param [2]);
+    const v128_t cb = wasm_f32x4_splat (param [3]);
+    const v128_t br = wasm_f32x4_splat (param [4]);
+    const v128_t bb = wasm_f32x4_splat (param [5]);
+
+    LF_PROFILE_NEWTON_BEGIN ();
+    tca_block b;
+    for (; count >= 4; count -= 4, iocoord += 4 * 6)
+    {
+        tca_load (b, iocoord);
+        untca_poly3 (b.rx, b.ry, vr, cr, br LF_PROFILE_NEWTON_ARG);
+        untca_poly3 (b.bx, b.by, vb, cb, bb LF_PROFILE_NEWTON_ARG);
+        tca_store (b, iocoord);
+    }
+
+    LF_PROFILE_NEWTON_END (ModifyCoord_UnTCA_Poly3_SIMD128);
+
+    if (count)
+        ModifyCoord_UnTCA_Poly3 (data, iocoord, count);
+}
+
+void lfModifier::ModifyCoord_TCA_ACM_SIMD128 (void *data, float *iocoord, int count)
+{
+    // Even terms are the red (alpha), odd terms the blue (beta) coefficients
+    const float *param = (float *)data;
+    const v128_t acm_scale = wasm_f32x4_splat (param [12]);
+    const v128_t acm_unscale = wasm_f32x4_splat (param [13]);
+
+    tca_block b;
+    for (; count >= 4; count -= 4, iocoord += 4 * 6)
+    {
+        tca_load (b, iocoord);
+        tca_acm (b.rx, b.ry, param, acm_scale, acm_unscale);
+        tca_acm (b.bx, b.by, param + 1, acm_scale, acm_unscale);
+        tca_store (b, iocoord);
+    }
+
+    if (count)
+        ModifyCoord_TCA_ACM (data, iocoord, count);
+}
+
+#endif
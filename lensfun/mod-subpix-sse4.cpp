@@ -0,0 +1,209 @@
+/*
+    SSE4.1 versions of the TCA callbacks
+*/
+
+#include "config.h"
+
+#ifdef VECTORIZATION_SSE4_1
+
+#include "lensfun.h"
+#include "lensfunprv.h"
+#include <smmintrin.h>
+
+#define SSE4_FUNC __attribute__ ((target ("sse4.1")))
+
+// Four pixels are 24 floats or six vectors.  The red and blue coordinate
+// pairs of those pixels are gathered into X and Y vectors, so that each
+// kernel below computes one colour component of four pixels at once.
+struct tca_block
+{
+    __m128 v [6];
+    __m128 rx, ry, bx, by;
+};
+
+SSE4_FUNC static inline void tca_load (tca_block &b, const float *iocoord)
+{
+    for (int i = 0; i < 6; i++)
+        b.v [i] = _mm_loadu_ps (iocoord + 4 * i);
+
+    __m128 lo = _mm_shuffle_ps (b.v [0], b.v [1], _MM_SHUFFLE (3, 2, 1, 0));
+    __m128 hi = _mm_shuffle_ps (b.v [3], b.v [4], _MM_SHUFFLE (3, 2, 1, 0));
+    b.rx = _mm_shuffle_ps (lo, hi, _MM_SHUFFLE (2, 0, 2, 0));
+    b.ry = _mm_shuffle_ps (lo, hi, _MM_SHUFFLE (3, 1, 3, 1));
+
+    lo = _mm_shuffle_ps (b.v [1], b.v [2], _MM_SHUFFLE (3, 2, 1, 0));
+    hi = _mm_shuffle_ps (b.v [4], b.v [5], _MM_SHUFFLE (3, 2, 1, 0));
+    b.bx = _mm_shuffle_ps (lo, hi, _MM_SHUFFLE (2, 0, 2, 0));
+    b.by = _mm_shuffle_ps (lo, hi, _MM_SHUFFLE (3, 1, 3, 1));
+}
+
+SSE4_FUNC static inline void tca_store (const tca_block &b, float *iocoord)
+{
+    __m128 r_lo = _mm_unpacklo_ps (b.rx, b.ry);
+    __m128 r_hi = _mm_unpackhi_ps (b.rx, b.ry);
+    __m128 b_lo = _mm_unpacklo_ps (b.bx, b.by);
+    __m128 b_hi = _mm_unpackhi_ps (b.bx, b.by);
+
+    _mm_storeu_ps (iocoord,      _mm_shuffle_ps (r_lo, b.v [0], _MM_SHUFFLE (3, 2, 1, 0)));
+    _mm_storeu_ps (iocoord + 4,  _mm_shuffle_ps (b_lo, r_lo, _MM_SHUFFLE (3, 2, 1, 0)));
+    _mm_storeu_ps (iocoord + 8,  _mm_shuffle_ps (b.v [2], b_lo, _MM_SHUFFLE (3, 2, 1, 0)));
+    _mm_storeu_ps (iocoord + 12, _mm_shuffle_ps (r_hi, b.v [3], _MM_SHUFFLE (3, 2, 1, 0)));
+    _mm_storeu_ps (iocoord + 16, _mm_shuffle_ps (b_hi, r_hi, _MM_SHUFFLE (3, 2, 1, 0)));
+    _mm_storeu_ps (iocoord + 20, _mm_shuffle_ps (b.v [5], b_hi, _MM_SHUFFLE (3, 2, 1, 0)));
+}
+
+SSE4_FUNC static inline void tca_poly3 (
+    __m128 &x, __m128 &y, __m128 v, __m128 c, __m128 b, bool use_c)
+{
+    __m128 ru2 = _mm_add_ps (_mm_mul_ps (x, x), _mm_mul_ps (y, y));
+    __m128 poly2 = _mm_mul_ps (b, ru2);
+    if (use_c)
+        poly2 = _mm_add_ps (poly2, _mm_mul_ps (c, _mm_sqrt_ps (ru2)));
+    poly2 = _mm_add_ps (poly2, v);
+    x = _mm_mul_ps (x, poly2);
+    y = _mm_mul_ps (y, poly2);
+}
+
+SSE4_FUNC static inline void untca_poly3 (
+    __m128 &x, __m128 &y, __m128 v, __m128 c, __m128 b LF_PROFILE_NEWTON_PARAM)
+{
+    const __m128 eps = _mm_set1_ps (NEWTON_EPS);
+    const __m128 neg_eps = _mm_set1_ps (-NEWTON_EPS);
+    const __m128 two = _mm_set1_ps (2.0f);
+    const __m128 three = _mm_set1_ps (3.0f);
+
+    __m128 rd = _mm_sqrt_ps (_mm_add_ps (_mm_mul_ps (x, x), _mm_mul_ps (y, y)));
+    __m128 ru = rd;
+    // Lanes which found their root keep it, the others go on iterating.
+    // Like the scalar version, give up after seven evaluations.
+    __m128 converged = _mm_setzero_ps ();
+#ifdef LF_PROFILING
+    int counted = 0;
+#endif
+    for (int step = 0; ; step++)
+    {
+        __m128 ru2 = _mm_mul_ps (ru, ru);
+        __m128 fru = _mm_sub_ps (
+            _mm_add_ps (_mm_add_ps (_mm_mul_ps (_mm_mul_ps (b, ru2), ru),
+                                    _mm_mul_ps (c, ru2)),
+                        _mm_mul_ps (v, ru)), rd);
+        converged = _mm_or_ps (converged, _mm_and_ps (
+            _mm_cmpge_ps (fru, neg_eps), _mm_cmplt_ps (fru, eps)));
+#ifdef LF_PROFILING
+        int mask = _mm_movemask_ps (converged);
+        LF_PROFILE_NEWTON_LANES (step, mask & ~counted);
+        counted = mask;
+        if (step > 5)
+            LF_PROFILE_NEWTON_FAIL_LANES (~mask & 15);
+#endif
+        if (_mm_movemask_ps (converged) == 15 || step > 5)
+            break;
+
+        __m128 deriv = _mm_add_ps (
+            _mm_add_ps (_mm_mul_ps (_mm_mul_ps (three, b), ru2),
+                        _mm_mul_ps (_mm_mul_ps (two, c), ru)), v);
+        ru = _mm_blendv_ps (_mm_sub_ps (ru, _mm_div_ps (fru, deriv)), ru, converged);
+    }
+
+    // Zero or negative radii, and lanes which did not converge, stay as they are
+    __m128 ok = _mm_and_ps (converged, _mm_and_ps (
+        _mm_cmpgt_ps (ru, _mm_setzero_ps ()), _mm_cmpneq_ps (rd, _mm_setzero_ps ())));
+    __m128 scale = _mm_div_ps (ru, rd);
+    x = _mm_blendv_ps (x, _mm_mul_ps (x, scale), ok);
+    y = _mm_blendv_ps (y, _mm_mul_ps (y, scale), ok);
+}
+
+SSE4_FUNC static inline void tca_acm (__m128 &x, __m128 &y, const float *k,
+                                      __m128 acm_scale, __m128 acm_unscale)
+{
+    const __m128 one = _mm_set1_ps (1.0f);
+    const __m128 two = _mm_set1_ps (2.0f);
+    __m128 k0 = _mm_set1_ps (k [0]), k1 = _mm_set1_ps (k [2]), k2 = _mm_set1_ps (k [4]);
+    __m128 k3 = _mm_set1_ps (k [6]), k4 = _mm_set1_ps (k [8]), k5 = _mm_set1_ps (k [10]);
+
+    x = _mm_mul_ps (x, acm_scale);
+    y = _mm_mul_ps (y, acm_scale);
+    __m128 ru2 = _mm_add_ps (_mm_mul_ps (x, x), _mm_mul_ps (y, y));
+    __m128 ru4 = _mm_mul_ps (ru2, ru2);
+    __m128 common_term = _mm_add_ps (
+        _mm_add_ps (_mm_add_ps (_mm_add_ps (one, _mm_mul_ps (k1, ru2)),
+                                _mm_mul_ps (k2, ru4)),
+                    _mm_mul_ps (_mm_mul_ps (k3, ru4), ru2)),
+        _mm_mul_ps (two, _mm_add_ps (_mm_mul_ps (k4, y), _mm_mul_ps (k5, x))));
+    __m128 nx = _mm_add_ps (_mm_mul_ps (x, common_term), _mm_mul_ps (k5, ru2));
+    __m128 ny = _mm_add_ps (_mm_mul_ps (y, common_term), _mm_mul_ps (k4, ru2));
+    x = _mm_mul_ps (_mm_mul_ps (k0, nx), acm_unscale);
+    y = _mm_mul_ps (_mm_mul_ps (k0, ny), acm_unscale);
+}
+
+SSE4_FUNC void lfModifier::ModifyCoord_TCA_Poly3_SSE4 (void *data, float *iocoord, int count)
+{
+    const float *param = (float *)data;
+    const __m128 vr = _mm_set1_ps (param [0]);
+    const __m128 vb = _mm_set1_ps (param [1]);
+    const __m128 cr = _mm_set1_ps (param [2]);
+    const __m128 cb = _mm_set1_ps (param [3]);
+    const __m128 br = _mm_set1_ps (param [4]);
+    const __m128 bb = _mm_set1_ps (param [5]);
+    const bool use_c = param [2] != 0.0 || param [3] != 0.0;
+
+    tca_block b;
+    for (; count >= 4; count -= 4, iocoord += 4 * 6)
+    {
+        tca_load (b, iocoord);
+        tca_poly3 (b.rx, b.ry, vr, cr, br, use_c);
+        tca_poly3 (b.bx, b.by, vb, cb, bb, use_c);
+        tca_store (b, iocoord);
+    }
+
+    if (count)
+        ModifyCoord_TCA_Poly3 (data, iocoord, count);
+}
+
+SSE4_FUNC void lfModifier::ModifyCoord_UnTCA_Poly3_SSE4 (void *data, float *iocoord, int count)
+{
+    const float *param = (float *)data;
+    const __m128 vr = _mm_set1_ps (param [0]);
+    const __m128 vb = _mm_set1_ps (param [1]);
+    const __m128 cr = _mm_set1_ps (param [2]);
+    const __m128 cb = _mm_set1_ps (param [3]);
+    const __m128 br = _mm_set1_ps (param [4]);
+    const __m128 bb = _mm_set1_ps (param [5]);
+
+    LF_PROFILE_NEWTON_BEGIN ();
+    tca_block b;
+    for (; count >= 4; count -= 4, iocoord += 4 * 6)
+    {
+        tca_load (b, iocoord);
+        untca_poly3 (b.rx, b.ry, vr, cr, br LF_PROFILE_NEWTON_ARG);
+        untca_poly3 (b.bx, b.by, vb, cb, bb LF_PROFILE_NEWTON_ARG);
+        tca_store (b, iocoord);
+    }
+
+    LF_PROFILE_NEWTON_END (ModifyCoord_UnTCA_Poly3_SSE4);
+
+    if (count)
+        ModifyCoord_UnTCA_Poly3 (data, iocoord, count);
+}
+
+SSE4_FUNC void lfModifier::ModifyCoord_TCA_ACM_SSE4 (void *data, float *iocoord, int count)
+{
+    // Even terms are the red (alpha), odd terms the blue (beta) coefficients
+    const float *param = (float *)data;
+    const __m128 acm_scale = _mm_set1_ps (param [12]);
+    const __m128 acm_unscale = _mm_set1_ps (param [13]);
+
+    tca_block b;
+    for (; count >= 4; count -= 4, iocoord += 4 * 6)
+    {
+        tca_load (b, iocoord);
+        tca_acm (b.rx, b.ry, param, acm_scale, acm_unscale);
+        tca_acm (b.bx, b.by, param + 1, acm_scale, acm_unscale);
+        tca_store (b, iocoord);
+    }
+
+    if (count)
+        ModifyCoord_TCA_ACM (data, iocoord, count);
+}
+
+#endif
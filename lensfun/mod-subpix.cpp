@@ -8,6 +8,19 @@
 #include "lensfunprv.h"
 #include <math.h>
 
+// Pick the fastest implementation of a TCA kernel for the running CPU.  The
+// vectorized kernels give the same results as the scalar ones within float
+// precision.
+#if defined(VECTORIZATION_SIMD128)
+#  define TCA_KERNEL(func) func##_SIMD128
+#elif defined(VECTORIZATION_AVX2) && defined(VECTORIZATION_SSE4_1)
+#  define TCA_KERNEL(func) \
+     ((_lf_detect_cpu_features () & LF_CPU_FLAG_AVX2) ? func##_AVX2 : \
+      (_lf_detect_cpu_features () & LF_CPU_FLAG_SSE4_1) ? func##_SSE4 : func)
+#else
+#  define TCA_KERNEL(func) func
+#endif
+
 void lfModifier::AddSubpixelCallback (
     lfSubpixelCoordFunc callback, int priority, void *data, size_t data_size)
 {
@@ -38,7 +51,7 @@ bool lfModifier::AddSubpixelCallbackTCA (lfLensCalibTCA &model, bool reverse)
                 return true;
 
             case LF_TCA_MODEL_POLY3:
-                AddSubpixelCallback (ModifyCoord_UnTCA_Poly3, 500,
+                AddSubpixelCallback (TCA_KERNEL (ModifyCoord_UnTCA_Poly3), 500,
                                      model.Terms, 6 * sizeof (float));
                 return true;
 
@@ -61,7 +74,7 @@ bool lfModifier::AddSubpixelCallbackTCA (lfLensCalibTCA &model, bool reverse)
                 return true;
 
             case LF_TCA_MODEL_POLY3:
-                AddSubpixelCallback (ModifyCoord_TCA_Poly3, 500,
+                AddSubpixelCallback (TCA_KERNEL (ModifyCoord_TCA_Poly3), 500,
                                      model.Terms, 6 * sizeof (float));
                 return true;
 
@@ -69,7 +82,7 @@ bool lfModifier::AddSubpixelCallbackTCA (lfLensCalibTCA &model, bool reverse)
                 memcpy (tmp, model.Terms, sizeof (float) * 12);
                 tmp [12] = 1.0 / FocalLengthNormalized;
                 tmp [13] = FocalLengthNormalized;
-                AddSubpixelCallback (ModifyCoord_TCA_ACM, 500,
+                AddSubpixelCallback (TCA_KERNEL (ModifyCoord_TCA_ACM), 500,
                                      tmp, 14 * sizeof (float));
                 return true;
 
@@ -90,15 +103,16 @@ bool lfModifier::ApplySubpixelDistortion (
 
     // All callbacks work with normalized coordinates
     xu = xu * NormScale - CenterX;
-    yu = yu * NormScale - CenterY;
 
-    for (float y = yu; height; y += NormScale, height--)
+    // See ApplyColorModification() for why rows do not accumulate steps
+    for (int row = 0; row < height; row++)
     {
+        float y = (yu + row) * NormScale - CenterY;
         int i;
-        float x = xu;
         float *out = res;
-        for (i = 0; i < width; i++, x += NormScale)
+        for (i = 0; i < width; i++)
         {
+            float x = xu + i * NormScale;
             out [0] = out [2] = out [4] = x;
             out [1] = out [3] = out [5] = y;
             out += 6;
@@ -108,6 +122,7 @@ bool lfModifier::ApplySubpixelDistortion (
         {
             lfSubpixelCallbackData *cd =
                 (lfSubpixelCallbackData *)callbacks->at(i);
+            LF_PROFILE_CALLBACK (cd->callback, width);
             cd->callback (cd->data, res, width);
         }
 
@@ -135,46 +150,234 @@ bool lfModifier::ApplySubpixelGeometryDistortion (
 
     // All callbacks work with normalized coordinates
     xu = xu * NormScale - CenterX;
-    yu = yu * NormScale - CenterY;
 
-    for (float y = yu; height; y += NormScale, height--)
+    lfCoordColumns columns;
+    PrepareCoordColumns (xu, width, columns);
+
+    // See ApplyColorModification() for why rows do not accumulate steps
+    for (int row = 0; row < height; row++, res += width * 2 * 3)
+        SubpixelGeometryRow (xu, (yu + row) * NormScale - CenterY, res, width,
+                             &columns);
+
+    return true;
+}
+
+void lfModifier::SubpixelGeometryRow (
+    float x, float y, float *res, int count, const lfCoordColumns *columns) const
+{
+    std::vector<lfCallbackData*>* spCallbacks = (std::vector<lfCallbackData*>*)SubpixelCallbacks;
+    std::vector<lfCallbackData*>* coordCallbacks = (std::vector<lfCallbackData*>*)CoordCallbacks;
+
+    // Generate the row as coordinate pairs and spread them to R, G, B
+    // from the end, so that no pair is overwritten before it is copied
+    int i, first = GenerateCoordRow (x, y, res, count, columns);
+    for (i = count - 1; i >= 0; i--)
     {
-        int i;
-        float x = xu;
-        float *out = res;
-        for (i = 0; i < width; i++, x += NormScale)
+        float *out = res + i * 6;
+        float x_ = res [i * 2], y_ = res [i * 2 + 1];
+        out [0] = out [2] = out [4] = x_;
+        out [1] = out [3] = out [5] = y_;
+    }
+
+    for (i = first; i < coordCallbacks->size(); i++)
+    {
+        lfCoordCallbackData *cd =
+            (lfCoordCallbackData *)coordCallbacks->at(i);
+        LF_PROFILE_CALLBACK (cd->callback, count);
+        cd->callback (cd->data, res, count * 3);
+    }
+
+    for (i = 0; i < spCallbacks->size(); i++)
+    {
+        lfSubpixelCallbackData *cd =
+            (lfSubpixelCallbackData *)spCallbacks->at(i);
+        LF_PROFILE_CALLBACK (cd->callback, count);
+        cd->callback (cd->data, res, count);
+    }
+
+    // Convert normalized coordinates back into natural coordiates
+    for (i = count * 3; i > 0; i--)
+    {
+        res [0] = (res [0] + CenterX) * NormUnScale;
+        res [1] = (res [1] + CenterY) * NormUnScale;
+        res += 2;
+    }
+}
+
+// Round a float to the nearest IEEE 754 half-precision value.  Values out of
+// range are clamped to the largest finite half instead of becoming infinite.
+static inline lf_u16 float_to_half (float f)
+{
+    union { float f; lf_u32 u; } v;
+    v.f = f;
+    lf_u32 sign = (v.u >> 16) & 0x8000;
+    lf_u32 abs = v.u & 0x7fffffff;
+
+    if (abs > 0x7f800000)
+        return sign | 0x7e00; // NaN
+    if (abs >= 0x477ff000)
+        return sign | 0x7bff; // >= 65520 rounds up beyond the largest half
+    if (abs < 0x38800000)
+    {
+        // Subnormal half, or zero
+        if (abs < 0x33000000)
+            return sign;
+        lf_u32 shift = 126 - (abs >> 23);
+        lf_u32 mant = (abs & 0x7fffff) | 0x800000;
+        lf_u32 half = mant >> shift;
+        lf_u32 rem = mant & ((1u << shift) - 1);
+        lf_u32 mid = 1u << (shift - 1);
+        if (rem > mid || (rem == mid && (half & 1)))
+            half++;
+        return sign | half;
+    }
+
+    // Rebias the exponent and round the mantissa to nearest even
+    abs -= 0x38000000;
+    abs += 0xfff + ((abs >> 13) & 1);
+    return sign | (abs >> 13);
+}
+
+static inline float half_to_float (lf_u16 h)
+{
+    union { float f; lf_u32 u; } v;
+    lf_u32 sign = (lf_u32)(h & 0x8000) << 16;
+    lf_u32 exp = (h >> 10) & 0x1f;
+    lf_u32 mant = h & 0x3ff;
+
+    if (exp == 0)
+    {
+        // Zero or subnormal: the value is mant * 2^-24
+        v.f = mant * (1.0f / 16777216.0f);
+        v.u |= sign;
+        return v.f;
+    }
+    if (exp == 0x1f)
+        v.u = sign | 0x7f800000 | (mant << 13);
+    else
+        v.u = sign | ((exp + 112) << 23) | (mant << 13);
+    return v.f;
+}
+
+static inline lf_u16 float_to_fixed (float f)
+{
+    float v = f * LF_SUBPIXEL_I16_SCALE;
+    if (!(v > -32768.0f))
+        v = -32768.0f; // also catches NaN
+    else if (v > 32767.0f)
+        v = 32767.0f;
+    return (lf_u16)(short)lrintf (v);
+}
+
+static void pack_subpixel_row (const float *src, lfSubpixelCoord *dst, int count,
+                               lfSubpixelFormat format)
+{
+    if (format == LF_SUBPIXEL_DELTA_F16)
+        for (; count; count--, src += 6, dst++)
         {
-            out [0] = out [2] = out [4] = x;
-            out [1] = out [3] = out [5] = y;
-            out += 6;
+            dst->Green [0] = src [2];
+            dst->Green [1] = src [3];
+            dst->Delta [0] = float_to_half (src [0] - src [2]);
+            dst->Delta [1] = float_to_half (src [1] - src [3]);
+            dst->Delta [2] = float_to_half (src [4] - src [2]);
+            dst->Delta [3] = float_to_half (src [5] - src [3]);
         }
-
-        for (i = 0; i < coordCallbacks->size(); i++)
+    else
+        for (; count; count--, src += 6, dst++)
         {
-            lfCoordCallbackData *cd =
-                (lfCoordCallbackData *)coordCallbacks->at(i);
-            cd->callback (cd->data, res, width * 3);
+            dst->Green [0] = src [2];
+            dst->Green [1] = src [3];
+            dst->Delta [0] = float_to_fixed (src [0] - src [2]);
+            dst->Delta [1] = float_to_fixed (src [1] - src [3]);
+            dst->Delta [2] = float_to_fixed (src [4] - src [2]);
+            dst->Delta [3] = float_to_fixed (src [5] - src [3]);
         }
+}
+
+// The number of pixels of a row which the packed outputs compute into a
+// scratch block on the stack before packing them, 6 KB
+#define PACKED_BLOCK 256
 
-        for (i = 0; i < spCallbacks->size(); i++)
+bool lfModifier::ApplySubpixelDistortionPacked (
+    float xu, float yu, int width, int height, lfSubpixelCoord *res,
+    lfSubpixelFormat format) const
+{
+    if (((std::vector<lfCallbackData*>*)SubpixelCallbacks)->size() <= 0 ||
+        height <= 0 || width <= 0)
+        return false; // nothing to do
+
+    // Compute a block of a row at a time and pack it from there
+    float block [PACKED_BLOCK * 2 * 3];
+    for (int i = 0; i < height; i++, res += width)
+        for (int first = 0; first < width; first += PACKED_BLOCK)
         {
-            lfSubpixelCallbackData *cd =
-                (lfSubpixelCallbackData *)spCallbacks->at(i);
-            cd->callback (cd->data, res, width);
+            int n = std::min (width - first, PACKED_BLOCK);
+            ApplySubpixelDistortion (xu + first, yu + i, n, 1, block);
+            pack_subpixel_row (block, res + first, n, format);
         }
 
-        // Convert normalized coordinates back into natural coordiates
-        for (i = width * 3; i > 0; i--)
+    return true;
+}
+
+bool lfModifier::ApplySubpixelGeometryDistortionPacked (
+    float xu, float yu, int width, int height, lfSubpixelCoord *res,
+    lfSubpixelFormat format) const
+{
+    if ((((std::vector<lfCallbackData*>*)SubpixelCallbacks)->size() <= 0 &&
+         ((std::vector<lfCallbackData*>*)CoordCallbacks)->size() <= 0) ||
+        height <= 0 || width <= 0)
+        return false; // nothing to do
+
+    // Like ApplySubpixelGeometryDistortion(), but a block of columns at a
+    // time, all rows of it, so that the per-column table of the block is
+    // prepared once
+    float block [PACKED_BLOCK * 2 * 3];
+    lfCoordColumns columns;
+    for (int first = 0; first < width; first += PACKED_BLOCK)
+    {
+        int n = std::min (width - first, PACKED_BLOCK);
+        float x = (xu + first) * NormScale - CenterX;
+        PrepareCoordColumns (x, n, columns);
+        for (int i = 0; i < height; i++)
         {
-            res [0] = (res [0] + CenterX) * NormUnScale;
-            res [1] = (res [1] + CenterY) * NormUnScale;
-            res += 2;
+            SubpixelGeometryRow (x, (yu + i) * NormScale - CenterY, block, n, &columns);
+            pack_subpixel_row (block, res + (size_t)i * width + first, n, format);
         }
     }
 
     return true;
 }
 
+void lfModifier::UnpackSubpixelCoords (
+    const lfSubpixelCoord *packed, int count, lfSubpixelFormat format, float *res)
+{
+    if (format == LF_SUBPIXEL_DELTA_F16)
+        for (; count > 0; count--, packed++, res += 6)
+        {
+            float gx = packed->Green [0], gy = packed->Green [1];
+            res [0] = gx + half_to_float (packed->Delta [0]);
+            res [1] = gy + half_to_float (packed->Delta [1]);
+            res [2] = gx;
+            res [3] = gy;
+            res [4] = gx + half_to_float (packed->Delta [2]);
+            res [5] = gy + half_to_float (packed->Delta [3]);
+        }
+    else
+    {
+        const float unit = 1.0f / LF_SUBPIXEL_I16_SCALE;
+        for (; count > 0; count--, packed++, res += 6)
+        {
+            float gx = packed->Green [0], gy = packed->Green [1];
+            res [0] = gx + (short)packed->Delta [0] * unit;
+            res [1] = gy + (short)packed->Delta [1] * unit;
+            res [2] = gx;
+            res [3] = gy;
+            res [4] = gx + (short)packed->Delta [2] * unit;
+            res [5] = gy + (short)packed->Delta [3] * unit;
+        }
+    }
+}
+
 void lfModifier::ModifyCoord_UnTCA_Linear (void *data, float *iocoord, int count)
 {
     float *param = (float *)data;
@@ -215,6 +418,7 @@ void lfModifier::ModifyCoord_UnTCA_Poly3 (void *data, float *iocoord, int count)
     const float br = param [4];
     const float bb = param [5];
 
+    LF_PROFILE_NEWTON_BEGIN ();
     for (float *end = iocoord + count * 2 * 3; iocoord < end; iocoord += 6)
     {
         float x, y;
@@ -238,10 +442,16 @@ void lfModifier::ModifyCoord_UnTCA_Poly3 (void *data, float *iocoord, int count)
             ru2 = ru * ru;
             double fru = br * ru2 * ru + cr * ru2 + vr * ru - rd;
             if (fru >= -NEWTON_EPS && fru < NEWTON_EPS)
+            {
+                LF_PROFILE_NEWTON_STEP (step);
                 break;
+            }
             if (step > 5)
+            {
                 // Does not converge, no real solution in this area?
+                LF_PROFILE_NEWTON_FAIL ();
                 goto next_subpixel_r;
+            }
 
             ru -= fru / (3 * br * ru2 + 2 * cr * ru + vr);
         }
@@ -266,10 +476,16 @@ next_subpixel_r:
             ru2 = ru * ru;
             double fru = bb * ru2 * ru + cb * ru2 + vb * ru - rd;
             if (fru >= -NEWTON_EPS && fru < NEWTON_EPS)
+            {
+                LF_PROFILE_NEWTON_STEP (step);
                 break;
+            }
             if (step > 5)
+            {
                 // Does not converge, no real solution in this area?
+                LF_PROFILE_NEWTON_FAIL ();
                 goto next_subpixel_b;
+            }
 
             ru -= fru / (3 * bb * ru2 + 2 * cb * ru + vb);
         }
@@ -282,6 +498,7 @@ next_subpixel_r:
         }
 next_subpixel_b:;
     }
+    LF_PROFILE_NEWTON_END (ModifyCoord_UnTCA_Poly3);
 }
 
 void lfModifier::ModifyCoord_TCA_Poly3 (void *data, float *iocoord, int count)
@@ -405,3 +622,26 @@ cbool lf_modifier_apply_subpixel_geometry_distortion (
 {
     return modifier->ApplySubpixelGeometryDistortion (xu, yu, width, height, res);
 }
+
+cbool lf_modifier_apply_subpixel_distortion_packed (
+    lfModifier *modifier, float xu, float yu, int width, int height,
+    lfSubpixelCoord *res, lfSubpixelFormat format)
+{
+    return modifier->ApplySubpixelDistortionPacked (
+        xu, yu, width, height, res, format);
+}
+
+cbool lf_modifier_apply_subpixel_geometry_distortion_packed (
+    lfModifier *modifier, float xu, float yu, int width, int height,
+    lfSubpixelCoord *res, lfSubpixelFormat format)
+{
+    return modifier->ApplySubpixelGeometryDistortionPacked (
+        xu, yu, width, height, res, format);
+}
+
+void lf_subpixel_coords_unpack (
+    const lfSubpixelCoord *packed, int count, lfSubpixelFormat format,
+    float *res)
+{
+    lfModifier::UnpackSubpixelCoords (packed, count, format, res);
+}
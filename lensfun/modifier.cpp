@@ -11,6 +11,11 @@
 #include "windows/mathconstants.h"
 #include <vector>
 
+#ifdef LF_SPLIT_MODULES
+bool (*_lf_add_coord_callback_geometry) (
+    lfModifier *modifier, lfLensType from, lfLensType to) = NULL;
+#endif
+
 int lfModifier::Initialize (
     const lfLens *lens, lfPixelFormat format, float focal, float aperture,
     float distance, float scale, lfLensType targeom, int flags, bool reverse)
@@ -43,6 +48,18 @@ int lfModifier::Initialize (
                 oflags |= LF_MODIFY_DISTORTION;
     }
 
+#ifdef LF_SPLIT_MODULES
+    // The projections are not called directly, since they are in a side
+    // module which may not have been loaded
+    if (flags & LF_MODIFY_GEOMETRY &&
+        lens->Type != targeom && _lf_add_coord_callback_geometry)
+    {
+        if (reverse ?
+            _lf_add_coord_callback_geometry (this, targeom, lens->Type) :
+            _lf_add_coord_callback_geometry (this, lens->Type, targeom))
+            oflags |= LF_MODIFY_GEOMETRY;
+    }
+#else
     if (flags & LF_MODIFY_GEOMETRY &&
         lens->Type != targeom)
     {
@@ -51,6 +68,7 @@ int lfModifier::Initialize (
             AddCoordCallbackGeometry (lens->Type, targeom))
             oflags |= LF_MODIFY_GEOMETRY;
     }
+#endif
 
     if (flags & LF_MODIFY_SCALE &&
         scale != 1.0)
@@ -58,6 +76,7 @@ int lfModifier::Initialize (
             oflags |= LF_MODIFY_SCALE;
 
     Reverse = reverse;
+    PixelFormat = format;
 
     return oflags;
 }
@@ -178,6 +197,10 @@ lfModifier::lfModifier (const lfLens *lens, float crop, int width, int height)
     SubpixelCallbacks = new std::vector<lfCallbackData*> ();
     ColorCallbacks = new std::vector<lfCallbackData*> ();
     CoordCallbacks = new std::vector<lfCallbackData*> ();
+    Reverse = false;
+    PixelFormat = LF_PF_U8;
+    PackedResampling = false;
+    ResamplingFormat = LF_SUBPIXEL_DELTA_I16;
 
     // Avoid divide overflows on singular cases.  The "- 1" is due to the fact
     // that `Width` and `Height` are measured at the pixel centres (they are
@@ -270,9 +293,13 @@ void lfModifier::AddCallback (void *arr, lfCallbackData *d,
     else
         d->data = data;
 
+    // Keep the list sorted by priority; callbacks of equal priority are
+    // called in the order they were added
     std::vector<lfCallbackData*>* callbacks = (std::vector<lfCallbackData*>*)arr;
-    //TODO: Properly do the priority.
-    callbacks->push_back(d);
+    std::vector<lfCallbackData*>::iterator it = callbacks->begin();
+    while (it != callbacks->end() && _lf_coordcb_compare (*it, d) <= 0)
+        ++it;
+    callbacks->insert (it, d);
 }
 
 //---------------------------// The C interface //---------------------------//
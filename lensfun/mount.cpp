@@ -6,6 +6,7 @@
 #include "config.h"
 #include "lensfun.h"
 #include "lensfunprv.h"
+#include <utility>
 
 lfMount::lfMount ()
 {
@@ -22,12 +23,57 @@ lfMount::~lfMount ()
     _lf_list_free ((void **)Compat);
 }
 
+lfMount::lfMount (const lfMount &other)
+{
+    memset (this, 0, sizeof (*this));
+    *this = other;
+}
+
+lfMount::lfMount (lfMount &&other)
+{
+    memcpy (this, &other, sizeof (*this));
+    memset (&other, 0, sizeof (other));
+}
+
+lfMount &lfMount::operator = (const lfMount &other)
+{
+    if (this == &other)
+        return *this;
+
+    lf_free (Name);
+    Name = lf_mlstr_dup (other.Name);
+
+    _lf_list_free ((void **)Compat); Compat = NULL;
+    if (other.Compat)
+        for (int i = 0; other.Compat [i]; i++)
+            AddCompat (other.Compat [i]);
+
+    return *this;
+}
+
+lfMount &lfMount::operator = (lfMount &&other)
+{
+    if (this != &other)
+    {
+        // The old contents go with the temporary
+        lfMount old (std::move (*this));
+        memcpy (this, &other, sizeof (*this));
+        memset (&other, 0, sizeof (other));
+    }
+    return *this;
+}
 
 void lfMount::SetName (const char *val, const char *lang)
 {
     Name = lf_mlstr_add (Name, lang, val);
 }
 
+void lfMount::AddCompat (const char *val)
+{
+    if (val)
+        _lf_addstr (&Compat, val);
+}
+
 bool lfMount::Check ()
 {
     if (!Name)
@@ -48,6 +94,11 @@ void lf_mount_destroy (lfMount *mount)
     delete mount;
 }
 
+void lf_mount_copy (lfMount *dest, const lfMount *source)
+{
+    *dest = *source;
+}
+
 cbool lf_mount_check (lfMount *mount)
 {
     return mount->Check ();
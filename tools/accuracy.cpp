@@ -0,0 +1,1394 @@
+/*
+    Accuracy check of the modifier against a double precision reference
+
+    The reference implements the coordinate, subpixel and colour pipeline of
+    lfModifier from the calibration models, independently of the callbacks:
+    in double precision, with projections done through direction vectors,
+    and with the inverse models solved exactly by a bracketed Newton search
+    in long double.  It is evaluated for every output pixel of evenly spaced
+    full-width rows, and compared to what the library returns through its
+    Apply* calls, i.e. whatever kernels the build and the CPU select.
+
+    Lenses are taken from data/db and swept over image sizes, the shortest,
+    a middle and the longest calibrated focal length, and for vignetting
+    the widest and narrowest calibrated aperture, in both directions.  Each
+    stage is checked on its own (distortion, TCA, projection, vignetting
+    per pixel format on single channel, RGB and RGBA rows) and the stages
+    together (coordinates, subpixel coordinates, both packed subpixel
+    formats).  Coordinates are only
+    compared where the reference position lies on the source image.  The
+    Jacobians of ApplyGeometryDistortionJacobian are compared with central
+    differences of the reference at every 8th pixel of the rows.
+    Perspective correction of a fixed set of control points is compared
+    with the homography of the solved rotations, through the row kernels
+    and the point callbacks, with the vectorized kernels and the scalar
+    fallbacks.
+
+    Position errors are in pixels of the source image; gain errors are the
+    difference between the output and the reference output, after the
+    clamping of integer formats, relative to the larger of input and
+    reference output.  Pixels where the vignetting polynomial drops below
+    0.01 are skipped.  A check fails when its maximum
+    error exceeds its tolerance from the table below.  Points on which the
+    library gives up while the reference has a solution keep their input
+    position, so they show up as large errors as well.
+
+    Usage: accuracy [--db DIR] [--output FILE] [--revision REV]
+                    [--rows N] [--lenses N] [--filter SUBSTRING]
+
+    The per-check statistics are written as JSON (to stdout by default); a
+    table goes to stderr.  The exit status is 1 if a check failed.
+*/
+
+#include "lensfun.h"
+#include "lensfunprv.h"
+#include "bench-db.h"
+#include <fnmatch.h>
+#include <math.h>
+
+//---------------------------// Tolerances //---------------------------//
+
+struct accuracy_tolerance
+{
+    const char *pattern;
+    double max;
+};
+
+// The first matching pattern applies.  The inverse models stop iterating
+// once the residual is below NEWTON_EPS in normalized coordinates, so their
+// position error grows with 1 / f'(r) where strong fisheyes flatten out
+// (0.155 px on 45MP for the Sigma 4.5mm circular fisheye).  The inverse
+// point search stops at the same residual per axis, which is measured on the
+// source image, i.e. up to 0.05 px per axis on 45MP.  Projections go
+// through single precision trigonometry; integer formats apply the gain in
+// fixed point (20.12 for 8 bit, 22.10 for 16 bit) and round the result.
+// Jacobian errors are relative to the largest entry of the reference; the
+// inverse ones are taken at the inexact inverse position, which again counts
+// most where fisheyes flatten out (1.9e-4 for the Sigma 8mm circular).  The
+// homography of perspective correction is evaluated from single precision
+// terms, with a reciprocal estimate and one Newton step in the SSE kernels;
+// both stay within a few float ulps of the coordinates, i.e. below 0.005 px
+// on 45MP.
+static const accuracy_tolerance tolerances [] =
+{
+    { "distortion:*:reverse", 0.2 },
+    { "distortion:*", 0.01 },
+    { "tca:*:reverse", 0.05 },
+    { "tca:*", 0.01 },
+    { "geometry:*", 0.02 },
+    { "pipeline:points-inverse*", 0.075 },
+    { "pipeline:*:reverse", 0.3 },
+    { "pipeline:*", 0.02 },
+    { "vignetting:*:u8*", 0.012 },
+    { "vignetting:*:u16*", 0.0012 },
+    { "vignetting:*", 0.0001 },
+    { "jacobian:*:reverse", 0.0005 },
+    { "jacobian:*", 0.0001 },
+    { "perspective:*", 0.005 },
+    { "*", 0.01 }
+};
+
+static double tolerance (const std::string &check)
+{
+    for (size_t i = 0; i < sizeof (tolerances) / sizeof (tolerances [0]); i++)
+        if (!fnmatch (tolerances [i].pattern, check.c_str (), 0))
+            return tolerances [i].max;
+    return 0;
+}
+
+//---------------------------// Statistics //---------------------------//
+
+// Errors are collected in logarithmic bins for the percentiles
+#define ACCURACY_DECADE_BINS 16
+#define ACCURACY_MIN_EXP -12
+#define ACCURACY_BINS (16 * ACCURACY_DECADE_BINS)
+
+struct accuracy_where
+{
+    const bench_db_lens *lens;
+    const char *size;
+    float focal, aperture;
+    int x, y;
+};
+
+struct accuracy_check
+{
+    std::string unit;
+    double tolerance;
+    unsigned long long count, skipped;
+    double sum, max;
+    unsigned long long bins [ACCURACY_BINS];
+    accuracy_where worst;
+
+    accuracy_check () : tolerance (0), count (0), skipped (0), sum (0), max (0)
+    {
+        memset (bins, 0, sizeof (bins));
+        memset (&worst, 0, sizeof (worst));
+    }
+
+    void add (double error, const accuracy_where &where)
+    {
+        // Non-finite results count as infinitely wrong
+        if (!(error < HUGE_VAL))
+            error = HUGE_VAL;
+        count++;
+        if (error < HUGE_VAL)
+            sum += error;
+        if (error > max || !worst.lens)
+        {
+            max = error > max ? error : max;
+            worst = where;
+        }
+        int bin = error > 0 ? int (floor ((log10 (error) - ACCURACY_MIN_EXP) *
+                                          ACCURACY_DECADE_BINS)) : 0;
+        bins [bin < 0 ? 0 : bin >= ACCURACY_BINS ? ACCURACY_BINS - 1 : bin]++;
+    }
+
+    // Upper edge of the bin which holds the given fraction of the errors;
+    // the largest error is a tighter bound in the last occupied bin
+    double percentile (double fraction) const
+    {
+        unsigned long long need = (unsigned long long)ceil (count * fraction), seen = 0;
+        for (int b = 0; b < ACCURACY_BINS; b++)
+            if ((seen += bins [b]) >= need && need)
+                return std::min (pow (10.0, ACCURACY_MIN_EXP +
+                                          double (b + 1) / ACCURACY_DECADE_BINS), max);
+        return 0;
+    }
+
+    bool passed () const
+    {
+        return max <= tolerance;
+    }
+};
+
+static std::map<std::string, accuracy_check> checks;
+
+static accuracy_check &check (const std::string &name, const char *unit)
+{
+    std::map<std::string, accuracy_check>::iterator i = checks.find (name);
+    if (i != checks.end ())
+        return i->second;
+    accuracy_check &c = checks [name];
+    c.unit = unit;
+    c.tolerance = tolerance (name);
+    return c;
+}
+
+//---------------------------// The reference //---------------------------//
+
+// One lens at one setting and image size, with the stages which Initialize
+// reported to be active
+struct reference
+{
+    // The coordinate systems of lfModifier, see the comment in modifier.cpp
+    double norm_scale, norm_unscale, center_x, center_y;
+    double aspect_correction, focal_normalized;
+    int width, height;
+
+    bool reverse;
+    int flags;
+    double scale;
+    lfLensType lens_type, target;
+    lfLensCalibDistortion distortion;
+    lfLensCalibTCA tca;
+    lfLensCalibVignetting vignetting;
+};
+
+static void reference_init (reference &ref, const lfLens &lens, float crop,
+                            int width, int height, float focal)
+{
+    double w = width >= 2 ? width - 1 : 1;
+    double h = height >= 2 ? height - 1 : 1;
+    double size = w < h ? w : h;
+    double image_aspect_ratio = w < h ? h / w : w / h;
+
+    ref.aspect_correction = sqrt (double (lens.AspectRatio) * lens.AspectRatio + 1);
+    double coordinate_correction = 1.0 / sqrt (image_aspect_ratio * image_aspect_ratio + 1) *
+        lens.CropFactor / crop * ref.aspect_correction;
+    double normalized_in_millimeters = sqrt (36.0 * 36.0 + 24.0 * 24.0) / 2.0 /
+        ref.aspect_correction / lens.CropFactor;
+
+    ref.norm_scale = 2.0 / size * coordinate_correction;
+    ref.norm_unscale = size * 0.5 / coordinate_correction;
+    ref.center_x = w / size * coordinate_correction + lens.CenterX;
+    ref.center_y = h / size * coordinate_correction + lens.CenterY;
+    ref.width = width;
+    ref.height = height;
+
+    // The lenses of bench_db_make_lens have no field of view, so the real
+    // focal length is the one of the distortion calibration, if any
+    double real_focal = focal;
+    lfLensCalibDistortion lcd;
+    if (lens.InterpolateDistortion (focal, lcd) && lcd.RealFocal > 0)
+        real_focal = lcd.RealFocal;
+    ref.focal_normalized = real_focal / normalized_in_millimeters;
+
+    ref.reverse = false;
+    ref.flags = 0;
+    ref.scale = 1;
+    ref.lens_type = ref.target = lens.Type;
+    memset (&ref.distortion, 0, sizeof (ref.distortion));
+    memset (&ref.tca, 0, sizeof (ref.tca));
+    memset (&ref.vignetting, 0, sizeof (ref.vignetting));
+}
+
+// Solves r * (c [0] + c [1] r + ... + c [n - 1] r^(n-1)) = rd for the first
+// root r > 0.  The root is bracketed by growing the interval from zero, then
+// narrowed with Newton steps which fall back to bisection.
+static bool reference_solve (const long double *c, int n, long double rd, long double &r)
+{
+    struct poly
+    {
+        const long double *c;
+        int n;
+        long double rd;
+
+        long double eval (long double r, long double &deriv) const
+        {
+            long double p = 0, dp = 0;
+            for (int i = n - 1; i >= 0; i--)
+            {
+                dp = dp * r + p;
+                p = p * r + c [i];
+            }
+            // d/dr (r p (r)) = p (r) + r p'(r)
+            deriv = p + r * dp;
+            return r * p - rd;
+        }
+    } f = { c, n, rd };
+
+    long double lo = 0, hi = rd / 16, deriv;
+    int grow = 0;
+    while (f.eval (hi, deriv) < 0)
+    {
+        lo = hi;
+        hi *= 2;
+        if (++grow > 40)
+            return false;
+    }
+
+    r = (lo + hi) / 2;
+    for (int step = 0; step < 200 && hi - lo > 1e-18L * hi; step++)
+    {
+        long double fr = f.eval (r, deriv);
+        if (fr == 0)
+            break;
+        if (fr < 0)
+            lo = r;
+        else
+            hi = r;
+        long double next = deriv != 0 ? r - fr / deriv : lo;
+        r = next > lo && next < hi ? next : (lo + hi) / 2;
+    }
+    return true;
+}
+
+// Moves the point at radius ru to radius rd = ru * poly (ru), or back
+static bool reference_radial (const long double *c, int n, bool reverse,
+                              double &x, double &y)
+{
+    long double r = sqrtl ((long double)x * x + (long double)y * y);
+    if (r == 0)
+        return true;
+    long double scale;
+    if (reverse)
+    {
+        long double ru;
+        if (!reference_solve (c, n, r, ru))
+            return false;
+        scale = ru / r;
+    }
+    else
+    {
+        long double p = 0;
+        for (int i = n - 1; i >= 0; i--)
+            p = p * r + c [i];
+        scale = p;
+    }
+    x *= scale;
+    y *= scale;
+    return true;
+}
+
+static bool reference_distortion (const lfLensCalibDistortion &lcd, bool reverse,
+                                  double &x, double &y)
+{
+    // The terms are rescaled the way the "Note about PT-based distortion
+    // models" in mod-coord.cpp describes
+    long double c [5] = { 1, 0, 0, 0, 0 };
+    const float *k = lcd.Terms;
+    switch (lcd.Model)
+    {
+        case LF_DIST_MODEL_POLY3:
+            c [2] = k [0] / powl (1 - (long double)k [0], 3);
+            return reference_radial (c, 3, reverse, x, y);
+
+        case LF_DIST_MODEL_POLY5:
+            c [2] = k [0];
+            c [4] = k [1];
+            return reference_radial (c, 5, reverse, x, y);
+
+        case LF_DIST_MODEL_PTLENS:
+        {
+            long double d = 1 - (long double)k [0] - k [1] - k [2];
+            c [1] = k [2] / (d * d);
+            c [2] = k [1] / (d * d * d);
+            c [3] = k [0] / (d * d * d * d);
+            return reference_radial (c, 4, reverse, x, y);
+        }
+
+        default:
+            return false;
+    }
+}
+
+// Channel 0 is red, 1 is blue
+static bool reference_tca (const lfLensCalibTCA &lctca, int channel, bool reverse,
+                           double &x, double &y)
+{
+    const float *k = lctca.Terms;
+    switch (lctca.Model)
+    {
+        case LF_TCA_MODEL_LINEAR:
+        {
+            double scale = reverse ? 1.0 / k [channel] : k [channel];
+            x *= scale;
+            y *= scale;
+            return true;
+        }
+
+        case LF_TCA_MODEL_POLY3:
+        {
+            long double c [3] = { k [channel], k [2 + channel], k [4 + channel] };
+            return reference_radial (c, 3, reverse, x, y);
+        }
+
+        default:
+            return false;
+    }
+}
+
+// Radius of a ray at angle theta from the axis in a radial projection, in
+// units of the focal length
+static bool radial_project (lfLensType type, double theta, double &rho)
+{
+    switch (type)
+    {
+        case LF_RECTILINEAR:
+            if (theta >= M_PI / 2)
+                return false;
+            rho = tan (theta);
+            return true;
+        case LF_FISHEYE:
+            rho = theta;
+            return true;
+        case LF_FISHEYE_ORTHOGRAPHIC:
+            if (theta > M_PI / 2)
+                return false;
+            rho = sin (theta);
+            return true;
+        case LF_FISHEYE_STEREOGRAPHIC:
+            rho = 2 * tan (theta / 2);
+            return true;
+        case LF_FISHEYE_EQUISOLID:
+            rho = 2 * sin (theta / 2);
+            return true;
+        case LF_FISHEYE_THOBY:
+            rho = 1.47 * sin (0.713 * theta);
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool radial_unproject (lfLensType type, double rho, double &theta)
+{
+    switch (type)
+    {
+        case LF_RECTILINEAR:
+            theta = atan (rho);
+            return true;
+        case LF_FISHEYE:
+            theta = rho;
+            return true;
+        case LF_FISHEYE_ORTHOGRAPHIC:
+            if (rho > 1)
+                return false;
+            theta = asin (rho);
+            return true;
+        case LF_FISHEYE_STEREOGRAPHIC:
+            theta = 2 * atan (rho / 2);
+            return true;
+        case LF_FISHEYE_EQUISOLID:
+            if (rho > 2)
+                return false;
+            theta = 2 * asin (rho / 2);
+            return true;
+        case LF_FISHEYE_THOBY:
+            if (rho > 1.47)
+                return false;
+            theta = asin (rho / 1.47) / 0.713;
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Direction of the ray through (x, y) of a projection with focal length f:
+// x to the right, y down, z along the optical axis
+static bool unproject (lfLensType type, double f, double x, double y, double *v)
+{
+    x /= f;
+    y /= f;
+    switch (type)
+    {
+        case LF_PANORAMIC:
+            v [0] = sin (x);
+            v [1] = y;
+            v [2] = cos (x);
+            break;
+
+        case LF_EQUIRECTANGULAR:
+            v [0] = cos (y) * sin (x);
+            v [1] = sin (y);
+            v [2] = cos (y) * cos (x);
+            break;
+
+        default:
+        {
+            double rho = sqrt (x * x + y * y), theta;
+            if (!radial_unproject (type, rho, theta))
+                return false;
+            double s = rho > 0 ? sin (theta) / rho : 1;
+            v [0] = x * s;
+            v [1] = y * s;
+            v [2] = cos (theta);
+            break;
+        }
+    }
+    double len = sqrt (v [0] * v [0] + v [1] * v [1] + v [2] * v [2]);
+    v [0] /= len;
+    v [1] /= len;
+    v [2] /= len;
+    return true;
+}
+
+static bool project (lfLensType type, double f, const double *v, double &x, double &y)
+{
+    switch (type)
+    {
+        case LF_PANORAMIC:
+            x = f * atan2 (v [0], v [2]);
+            y = f * v [1] / sqrt (v [0] * v [0] + v [2] * v [2]);
+            return true;
+
+        case LF_EQUIRECTANGULAR:
+            x = f * atan2 (v [0], v [2]);
+            y = f * asin (v [1]);
+            return true;
+
+        default:
+        {
+            double s = sqrt (v [0] * v [0] + v [1] * v [1]), rho;
+            if (!radial_project (type, atan2 (s, v [2]), rho))
+                return false;
+            x = s > 0 ? f * rho * v [0] / s : 0;
+            y = s > 0 ? f * rho * v [1] / s : 0;
+            return true;
+        }
+    }
+}
+
+// Maps coordinates of projection "to" into projection "from", like the
+// callbacks of lfModifier::AddCoordCallbackGeometry (from, to)
+static bool reference_geometry (lfLensType from, lfLensType to, double f,
+                                double &x, double &y)
+{
+    double v [3];
+    return unproject (to, f, x, y, v) && project (from, f, v, x, y);
+}
+
+// Source positions of output pixel (px, py) for red, green and blue, in
+// pixels; returns false where the reference has no solution
+static bool reference_coords (const reference &ref, double px, double py,
+                              bool subpixel, double *res)
+{
+    double x = px * ref.norm_scale - ref.center_x;
+    double y = py * ref.norm_scale - ref.center_y;
+    double f = ref.focal_normalized;
+
+    if (!ref.reverse)
+    {
+        if (ref.flags & LF_MODIFY_SCALE)
+        {
+            x /= ref.scale;
+            y /= ref.scale;
+        }
+        if ((ref.flags & LF_MODIFY_GEOMETRY) &&
+            !reference_geometry (ref.lens_type, ref.target, f, x, y))
+            return false;
+        if ((ref.flags & LF_MODIFY_DISTORTION) &&
+            !reference_distortion (ref.distortion, false, x, y))
+            return false;
+    }
+    else
+    {
+        if ((ref.flags & LF_MODIFY_DISTORTION) &&
+            !reference_distortion (ref.distortion, true, x, y))
+            return false;
+        if ((ref.flags & LF_MODIFY_GEOMETRY) &&
+            !reference_geometry (ref.target, ref.lens_type, f, x, y))
+            return false;
+        if (ref.flags & LF_MODIFY_SCALE)
+        {
+            x *= ref.scale;
+            y *= ref.scale;
+        }
+    }
+
+    for (int c = 0; c < 3; c++)
+    {
+        double cx = x, cy = y;
+        if (subpixel && c != 1 && (ref.flags & LF_MODIFY_TCA) &&
+            !reference_tca (ref.tca, c / 2, ref.reverse, cx, cy))
+            return false;
+        res [c * 2] = (cx + ref.center_x) * ref.norm_unscale;
+        res [c * 2 + 1] = (cy + ref.center_y) * ref.norm_unscale;
+    }
+    return true;
+}
+
+// The factor by which vignetting correction multiplies pixel (px, py), or
+// NaN where the polynomial drops to (almost) zero.  Some calibrations cross
+// zero before the image corner; close to that, gains beyond 100 are not
+// meaningful and single precision cancellation in c dominates the error.
+static double reference_gain (const reference &ref, double px, double py)
+{
+    // Vignetting radii are relative to the half diagonal
+    double x = (px * ref.norm_scale - ref.center_x) / ref.aspect_correction;
+    double y = (py * ref.norm_scale - ref.center_y) / ref.aspect_correction;
+    double r2 = x * x + y * y;
+    const float *k = ref.vignetting.Terms;
+    double c = 1 + k [0] * r2 + k [1] * r2 * r2 + k [2] * r2 * r2 * r2;
+    if (c < 0.01)
+        return NAN;
+    return ref.reverse ? c : 1 / c;
+}
+
+//---------------------------// Sweeps //---------------------------//
+
+struct accuracy_size
+{
+    const char *name;
+    int width, height;
+};
+
+static const accuracy_size sizes [] =
+{
+    { "6MP", 3008, 2000 },
+    { "45MP", 8256, 5504 }
+};
+
+static const char *type_names [] =
+{
+    "unknown", "rectilinear", "fisheye", "panoramic", "equirectangular",
+    "orthographic", "stereographic", "equisolid", "thoby"
+};
+
+static const char *dist_name (lfDistortionModel model)
+{
+    switch (model)
+    {
+        case LF_DIST_MODEL_POLY3: return "poly3";
+        case LF_DIST_MODEL_POLY5: return "poly5";
+        case LF_DIST_MODEL_PTLENS: return "ptlens";
+        case LF_DIST_MODEL_ACM: return "acm";
+        default: return "none";
+    }
+}
+
+static const char *tca_name (lfTCAModel model)
+{
+    switch (model)
+    {
+        case LF_TCA_MODEL_LINEAR: return "linear";
+        case LF_TCA_MODEL_POLY3: return "poly3";
+        case LF_TCA_MODEL_ACM: return "acm";
+        default: return "none";
+    }
+}
+
+static const char *filter = NULL;
+static int sample_rows = 8;
+
+static bool wanted (const std::string &name)
+{
+    return !filter || name.find (filter) != std::string::npos;
+}
+
+// Row y of the sample number r, from the first to the last row
+static int sample_row (int r, int height)
+{
+    int rows = sample_rows < height ? sample_rows : height;
+    return rows > 1 ? int ((long long)(height - 1) * r / (rows - 1)) : 0;
+}
+
+// Sets up a modifier and the matching reference; NULL if Initialize enabled
+// none of the requested stages
+static lfModifier *setup (reference &ref, const lfLens &lens, const accuracy_size &size,
+                          float focal, float aperture, float distance, lfPixelFormat format,
+                          int flags, bool reverse)
+{
+    float crop = lens.CropFactor;
+    reference_init (ref, lens, crop, size.width, size.height, focal);
+    ref.reverse = reverse;
+    ref.target = LF_RECTILINEAR;
+
+    // Autoscaling is computed by the library; the reference uses its result
+    float scale = 1;
+    if (flags & LF_MODIFY_SCALE)
+    {
+        lfModifier probe (&lens, crop, size.width, size.height);
+        probe.Initialize (&lens, format, focal, aperture, distance, 1, ref.target,
+                          flags & ~LF_MODIFY_SCALE, reverse);
+        scale = probe.GetAutoScale (reverse);
+        if (!(scale > 0) || !(scale < HUGE_VAL))
+            scale = 1;
+        flags &= ~LF_MODIFY_SCALE;
+        if (scale != 1)
+            flags |= LF_MODIFY_SCALE;
+    }
+    ref.scale = scale;
+
+    lfModifier *mod = new lfModifier (&lens, crop, size.width, size.height);
+    ref.flags = mod->Initialize (&lens, format, focal, aperture, distance, scale,
+                                 ref.target, flags, reverse);
+    if (!ref.flags)
+    {
+        delete mod;
+        return NULL;
+    }
+    lens.InterpolateDistortion (focal, ref.distortion);
+    lens.InterpolateTCA (focal, ref.tca);
+    lens.InterpolateVignetting (focal, aperture, distance, ref.vignetting);
+    return mod;
+}
+
+enum accuracy_path
+{
+    PATH_COORD,
+    PATH_SUBPIXEL,
+    PATH_SUBPIXEL_GEOMETRY,
+    PATH_PACKED_F16,
+    PATH_PACKED_I16,
+    PATH_POINTS,
+    PATH_JACOBIAN
+};
+
+// Compares one coordinate path over the sample rows
+static void compare_coords (const std::string &name, const reference &ref,
+                            const lfModifier &mod, accuracy_path path,
+                            accuracy_where where)
+{
+    if (!wanted (name))
+        return;
+    accuracy_check &c = check (name, "px");
+    bool subpixel = path != PATH_COORD && path != PATH_POINTS && path != PATH_JACOBIAN;
+    int channels = subpixel ? 3 : 1;
+    std::vector<float> res ((size_t)ref.width * 2 * channels);
+    std::vector<lfSubpixelCoord> packed (ref.width);
+    std::vector<float> points (path == PATH_POINTS ? ref.width * 2 : 0);
+    std::vector<float> jacobian (path == PATH_JACOBIAN ? ref.width * 4 : 0);
+
+    for (int r = 0; r < sample_rows && r < ref.height; r++)
+    {
+        int y = sample_row (r, ref.height);
+        switch (path)
+        {
+            case PATH_COORD:
+                mod.ApplyGeometryDistortion (0, y, ref.width, 1, &res [0]);
+                break;
+            case PATH_SUBPIXEL:
+                mod.ApplySubpixelDistortion (0, y, ref.width, 1, &res [0]);
+                break;
+            case PATH_SUBPIXEL_GEOMETRY:
+                mod.ApplySubpixelGeometryDistortion (0, y, ref.width, 1, &res [0]);
+                break;
+            case PATH_PACKED_F16:
+            case PATH_PACKED_I16:
+            {
+                lfSubpixelFormat format = path == PATH_PACKED_F16 ?
+                    LF_SUBPIXEL_DELTA_F16 : LF_SUBPIXEL_DELTA_I16;
+                mod.ApplySubpixelGeometryDistortionPacked (0, y, ref.width, 1,
+                                                           &packed [0], format);
+                lfModifier::UnpackSubpixelCoords (&packed [0], ref.width, format, &res [0]);
+                break;
+            }
+            case PATH_POINTS:
+                for (int x = 0; x < ref.width; x++)
+                {
+                    points [x * 2] = x;
+                    points [x * 2 + 1] = y;
+                }
+                mod.ApplyGeometryDistortionPoints (&points [0], &res [0], ref.width);
+                break;
+            case PATH_JACOBIAN:
+                mod.ApplyGeometryDistortionJacobian (0, y, ref.width, 1, &res [0],
+                                                     &jacobian [0]);
+                break;
+        }
+
+        where.y = y;
+        for (int x = 0; x < ref.width; x++)
+        {
+            double expect [6];
+            if (!reference_coords (ref, x, y, subpixel, expect))
+            {
+                c.skipped++;
+                continue;
+            }
+            where.x = x;
+            for (int ch = 0; ch < channels; ch++)
+            {
+                double ex = expect [subpixel ? ch * 2 : 2];
+                double ey = expect [subpixel ? ch * 2 + 1 : 3];
+                // Only positions on the source image matter
+                if (!(ex >= -1 && ex <= ref.width && ey >= -1 && ey <= ref.height))
+                {
+                    c.skipped++;
+                    continue;
+                }
+                const float *got = &res [((size_t)x * channels + ch) * 2];
+                double dx = got [0] - ex, dy = got [1] - ey;
+                c.add (sqrt (dx * dx + dy * dy), where);
+            }
+        }
+    }
+}
+
+// Maps the reference positions on the source image of the sample rows back
+// with the inverse of ApplyGeometryDistortionPoints(), and forward again.
+// The error is measured on the source image, where the search converges;
+// where a fisheye is corrected to the far corners, many pixels of the
+// corrected image map to the same source pixel.  Points for which the search
+// fails count as infinitely wrong.
+static void compare_inverse_points (const std::string &name, const reference &ref,
+                                    const lfModifier &mod, accuracy_where where)
+{
+    if (!wanted (name))
+        return;
+    accuracy_check &c = check (name, "px");
+    std::vector<float> points, res;
+    std::vector<int> pixels;
+    for (int r = 0; r < sample_rows && r < ref.height; r++)
+    {
+        int y = sample_row (r, ref.height);
+        points.clear ();
+        pixels.clear ();
+        for (int x = 0; x < ref.width; x++)
+        {
+            double expect [6];
+            if (!reference_coords (ref, x, y, false, expect) ||
+                !(expect [2] >= -1 && expect [2] <= ref.width &&
+                  expect [3] >= -1 && expect [3] <= ref.height))
+            {
+                c.skipped++;
+                continue;
+            }
+            points.push_back (expect [2]);
+            points.push_back (expect [3]);
+            pixels.push_back (x);
+        }
+        if (pixels.empty ())
+            continue;
+
+        std::vector<unsigned char> status (pixels.size ());
+        res.resize (points.size ());
+        mod.ApplyGeometryDistortionPoints (&points [0], &res [0], pixels.size (),
+                                           true, &status [0]);
+        mod.ApplyGeometryDistortionPoints (&res [0], &res [0], pixels.size ());
+        where.y = y;
+        for (size_t i = 0; i < pixels.size (); i++)
+        {
+            where.x = pixels [i];
+            double dx = res [i * 2] - points [i * 2];
+            double dy = res [i * 2 + 1] - points [i * 2 + 1];
+            c.add (status [i] ? sqrt (dx * dx + dy * dy) : HUGE_VAL, where);
+        }
+    }
+}
+
+// Distance of the grid nodes of the Jacobian check in pixels, and the offset
+// of the central differences of the reference from them
+#define JACOBIAN_STEP 8
+#define JACOBIAN_DELTA 0.01
+
+// Compares the Jacobian of ApplyGeometryDistortionJacobian() at every
+// JACOBIAN_STEP-th pixel of the sample rows with central differences of the
+// reference.  The error is the largest difference of an entry, relative to
+// the largest entry of the reference, so that it does not depend on how
+// much a fisheye is stretched or compressed at the point.
+static void compare_jacobian (const std::string &name, const reference &ref,
+                              const lfModifier &mod, accuracy_where where)
+{
+    if (!wanted (name))
+        return;
+    accuracy_check &c = check (name, "rel");
+    int nodes = (ref.width + JACOBIAN_STEP - 1) / JACOBIAN_STEP;
+    std::vector<float> res (nodes * 2), jacobian (nodes * 4);
+
+    for (int r = 0; r < sample_rows && r < ref.height; r++)
+    {
+        int y = sample_row (r, ref.height);
+        mod.ApplyGeometryDistortionJacobian (0, y, nodes, 1, &res [0], &jacobian [0],
+                                             JACOBIAN_STEP);
+        where.y = y;
+        for (int i = 0; i < nodes; i++)
+        {
+            int x = i * JACOBIAN_STEP;
+            double expect [6], dx [2][6], dy [2][6];
+            if (!reference_coords (ref, x, y, false, expect) ||
+                !(expect [2] >= -1 && expect [2] <= ref.width &&
+                  expect [3] >= -1 && expect [3] <= ref.height) ||
+                !reference_coords (ref, x - JACOBIAN_DELTA, y, false, dx [0]) ||
+                !reference_coords (ref, x + JACOBIAN_DELTA, y, false, dx [1]) ||
+                !reference_coords (ref, x, y - JACOBIAN_DELTA, false, dy [0]) ||
+                !reference_coords (ref, x, y + JACOBIAN_DELTA, false, dy [1]))
+            {
+                c.skipped++;
+                continue;
+            }
+            double j [4] =
+            {
+                (dx [1][2] - dx [0][2]) / (2 * JACOBIAN_DELTA),
+                (dy [1][2] - dy [0][2]) / (2 * JACOBIAN_DELTA),
+                (dx [1][3] - dx [0][3]) / (2 * JACOBIAN_DELTA),
+                (dy [1][3] - dy [0][3]) / (2 * JACOBIAN_DELTA)
+            };
+            // A NaN Jacobian marks a point which the library left unsolved
+            double error = 0, size = 0;
+            for (int k = 0; k < 4; k++)
+            {
+                double e = fabs (jacobian [i * 4 + k] - j [k]);
+                error = e == e ? std::max (error, e) : HUGE_VAL;
+                size = std::max (size, fabs (j [k]));
+            }
+            where.x = x;
+            c.add (error / size, where);
+        }
+    }
+}
+
+template<typename T> static void compare_gains_typed (
+    accuracy_check &c, const reference &ref, const lfModifier &mod, int comp_role,
+    int components, T value, double type_max, accuracy_where where)
+{
+    std::vector<T> pixels (ref.width * components);
+    for (int r = 0; r < sample_rows && r < ref.height; r++)
+    {
+        int y = sample_row (r, ref.height);
+        std::fill (pixels.begin (), pixels.end (), value);
+        mod.ApplyColorModification (&pixels [0], 0, y, ref.width, 1,
+                                    comp_role, ref.width * components * sizeof (T));
+        where.y = y;
+        for (int x = 0; x < ref.width; x++)
+        {
+            double gain = reference_gain (ref, x, y);
+            if (isnan (gain))
+            {
+                c.skipped++;
+                continue;
+            }
+            double expect = value * gain;
+            if (type_max && expect > type_max)
+                expect = type_max;
+            where.x = x;
+            // Relative to the larger of input and output, so that the error
+            // of strong gains is not inflated by their size.  The fourth
+            // component is an alpha channel, which has to stay as it is.
+            double error = 0;
+            for (int i = 0; i < components; i++)
+            {
+                double e = i < 3 ? expect : value;
+                error = std::max (error, fabs (double (pixels [x * components + i]) - e) /
+                                         std::max (e, double (value)));
+            }
+            c.add (error, where);
+        }
+    }
+}
+
+static void compare_gains (const std::string &name, const reference &ref,
+                           const lfModifier &mod, lfPixelFormat format, int comp_role,
+                           int components, const accuracy_where &where)
+{
+    if (!wanted (name))
+        return;
+    accuracy_check &c = check (name, "gain");
+    // Mid-range inputs leave room for gains up to 4 before integers clamp
+    switch (format)
+    {
+        case LF_PF_U8:
+            compare_gains_typed<lf_u8> (c, ref, mod, comp_role, components,
+                                        64, 255, where);
+            break;
+        case LF_PF_U16:
+            compare_gains_typed<lf_u16> (c, ref, mod, comp_role, components,
+                                         16384, 65535, where);
+            break;
+        case LF_PF_U32:
+            compare_gains_typed<lf_u32> (c, ref, mod, comp_role, components,
+                                         1u << 30, 4294967295.0, where);
+            break;
+        case LF_PF_F32:
+            compare_gains_typed<lf_f32> (c, ref, mod, comp_role, components,
+                                         0.25f, 0, where);
+            break;
+        case LF_PF_F64:
+            compare_gains_typed<lf_f64> (c, ref, mod, comp_role, components,
+                                         0.25, 0, where);
+            break;
+        default:
+            break;
+    }
+}
+
+// Control points of two converging verticals, relative to the image size, as
+// in bench-kernels
+static const float perspective_x [] = { 0.3f, 0.25f, 0.7f, 0.75f };
+static const float perspective_y [] = { 0.2f, 0.8f, 0.2f, 0.8f };
+
+static void rotation_product (const double a [3][3], const double b [3][3],
+                              double res [3][3])
+{
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            res [i][j] = a [i][0] * b [0][j] + a [i][1] * b [1][j] + a [i][2] * b [2][j];
+}
+
+// R_y(rho_2) · R_x(delta) · R_y(rho_1) · R_z(alpha)
+static void rotation_matrix (double rho_1, double delta, double rho_2, double alpha,
+                             double res [3][3])
+{
+    const double y1 [3][3] = { { cos (rho_1), 0, sin (rho_1) }, { 0, 1, 0 },
+                               { -sin (rho_1), 0, cos (rho_1) } };
+    const double x [3][3] = { { 1, 0, 0 }, { 0, cos (delta), -sin (delta) },
+                              { 0, sin (delta), cos (delta) } };
+    const double y2 [3][3] = { { cos (rho_2), 0, sin (rho_2) }, { 0, 1, 0 },
+                               { -sin (rho_2), 0, cos (rho_2) } };
+    const double z [3][3] = { { cos (alpha), -sin (alpha), 0 },
+                              { sin (alpha), cos (alpha), 0 }, { 0, 0, 1 } };
+    double a [3][3], b [3][3];
+    rotation_product (y2, x, a);
+    rotation_product (a, y1, b);
+    rotation_product (b, z, res);
+}
+
+// The homography of the full (d = 0) correction of a solved plan, built from
+// its rotations: the corrected image is scaled and shifted so that its centre
+// keeps its place and size, turned back and projected onto the sensor
+struct perspective_reference
+{
+    double f, scale, shift_x, shift_y;
+    double rotation [3][3];
+};
+
+static bool perspective_init (perspective_reference &pr, const lfPerspectivePlan &plan)
+{
+    double f = plan.FocalLengthNormalized, forward [3][3];
+    rotation_matrix (plan.Rho, plan.Delta, plan.RhoH, 0, forward);
+    // Like the library, fall back to the centre of the control points if the
+    // image centre ends up (almost) at infinity
+    double cx = 0, cy = 0;
+    if (forward [2][2] <= 0 || 1 / forward [2][2] > 10)
+    {
+        cx = plan.ControlPointsCenterX;
+        cy = plan.ControlPointsCenterY;
+    }
+    double c [3];
+    for (int i = 0; i < 3; i++)
+        c [i] = forward [i][0] * cx + forward [i][1] * cy + forward [i][2] * f;
+    if (c [2] <= 0)
+        return false;
+    double sa = sin (plan.Alpha), ca = cos (plan.Alpha);
+    pr.f = f;
+    pr.scale = f / c [2];
+    pr.shift_x = (ca * c [0] + sa * c [1]) * pr.scale;
+    pr.shift_y = (- sa * c [0] + ca * c [1]) * pr.scale;
+    rotation_matrix (- plan.RhoH, - plan.Delta, - plan.Rho, plan.Alpha, pr.rotation);
+    return true;
+}
+
+// Source position of output pixel (px, py), in pixels; false if it lies
+// behind the camera
+static bool perspective_coords (const reference &ref, const perspective_reference &pr,
+                                double px, double py, double &sx, double &sy)
+{
+    double p [3] =
+    {
+        (px * ref.norm_scale - ref.center_x) * pr.scale + pr.shift_x,
+        (py * ref.norm_scale - ref.center_y) * pr.scale + pr.shift_y,
+        pr.f
+    };
+    double q [3];
+    for (int i = 0; i < 3; i++)
+        q [i] = pr.rotation [i][0] * p [0] + pr.rotation [i][1] * p [1] +
+                pr.rotation [i][2] * p [2];
+    if (q [2] <= 0)
+        return false;
+    sx = (pr.f * q [0] / q [2] + ref.center_x) * ref.norm_unscale;
+    sy = (pr.f * q [1] / q [2] + ref.center_y) * ref.norm_unscale;
+    return true;
+}
+
+// Compares perspective correction alone through the row kernels and the
+// point callbacks, first with the kernels the CPU selects and then with the
+// scalar fallbacks.  Builds which pick their kernels at compile time run the
+// same ones twice.
+static void compare_perspective (const lfLens &lens, const accuracy_size &size,
+                                 float focal, accuracy_where where)
+{
+    static const char *const names [2][2] =
+    {
+        { "perspective:row", "perspective:points" },
+        { "perspective:row:scalar", "perspective:points:scalar" }
+    };
+    reference ref;
+    reference_init (ref, lens, lens.CropFactor, size.width, size.height, focal);
+    std::vector<float> res ((size_t)ref.width * 2), points ((size_t)ref.width * 2);
+
+    for (int scalar = 0; scalar < 2; scalar++)
+    {
+        _lf_mask_cpu_features (scalar ? 0 : ~0u);
+        lfModifier mod (&lens, lens.CropFactor, size.width, size.height);
+        mod.Initialize (&lens, LF_PF_U8, focal, 8, 1000, 1, lens.Type, 0, false);
+        float x [4], y [4];
+        for (int i = 0; i < 4; i++)
+        {
+            x [i] = perspective_x [i] * size.width;
+            y [i] = perspective_y [i] * size.height;
+        }
+        lfPerspectivePlan plan;
+        perspective_reference pr;
+        if (!mod.SolvePerspectiveCorrection (x, y, 4, plan) ||
+            !perspective_init (pr, plan) || !mod.EnablePerspectiveCorrection (plan, 0))
+            break;
+
+        for (int points_path = 0; points_path < 2; points_path++)
+        {
+            if (!wanted (names [scalar][points_path]))
+                continue;
+            accuracy_check &c = check (names [scalar][points_path], "px");
+            for (int r = 0; r < sample_rows && r < ref.height; r++)
+            {
+                int py = sample_row (r, ref.height);
+                if (points_path)
+                {
+                    for (int px = 0; px < ref.width; px++)
+                    {
+                        points [px * 2] = px;
+                        points [px * 2 + 1] = py;
+                    }
+                    mod.ApplyGeometryDistortionPoints (&points [0], &res [0], ref.width);
+                }
+                else
+                    mod.ApplyGeometryDistortion (0, py, ref.width, 1, &res [0]);
+
+                where.y = py;
+                for (int px = 0; px < ref.width; px++)
+                {
+                    double ex, ey;
+                    if (!perspective_coords (ref, pr, px, py, ex, ey) ||
+                        !(ex >= -1 && ex <= ref.width && ey >= -1 && ey <= ref.height))
+                    {
+                        c.skipped++;
+                        continue;
+                    }
+                    where.x = px;
+                    double dx = res [px * 2] - ex, dy = res [px * 2 + 1] - ey;
+                    c.add (sqrt (dx * dx + dy * dy), where);
+                }
+            }
+        }
+    }
+    _lf_mask_cpu_features (~0u);
+}
+
+// Calibrated focal lengths picked like in bench-e2e, and the calibrated
+// apertures and farthest distance of vignetting at each of them
+static void pick_focals (const bench_db_lens &entry, std::vector<float> &result)
+{
+    std::vector<float> focals;
+    for (size_t c = 0; c < entry.calibrations.size (); c++)
+        focals.push_back (entry.calibrations [c].get ("focal", 0));
+    std::sort (focals.begin (), focals.end ());
+    focals.erase (std::unique (focals.begin (), focals.end ()), focals.end ());
+    if (focals.empty ())
+        focals.push_back (50);
+    size_t picks [] = { 0, focals.size () / 2, focals.size () - 1 };
+    for (int p = 0; p < 3; p++)
+        if (!p || picks [p] != picks [p - 1])
+            result.push_back (focals [picks [p]]);
+}
+
+static void pick_apertures (const bench_db_lens &entry, float focal,
+                            std::vector<float> &apertures, float &distance)
+{
+    distance = 1000;
+    for (size_t c = 0; c < entry.calibrations.size (); c++)
+    {
+        const bench_db_element &e = entry.calibrations [c];
+        if (e.name != "vignetting" || e.get ("focal", 0) != focal)
+            continue;
+        apertures.push_back (e.get ("aperture", 0));
+        distance = std::max (distance, e.get ("distance", 1000));
+    }
+    std::sort (apertures.begin (), apertures.end ());
+    apertures.erase (std::unique (apertures.begin (), apertures.end ()), apertures.end ());
+    if (apertures.size () > 2)
+        apertures.erase (apertures.begin () + 1, apertures.end () - 1);
+}
+
+static void sweep_lens (const bench_db_lens &entry, const lfLens &lens)
+{
+    static const struct
+    {
+        lfPixelFormat format;
+        const char *name;
+    } formats [] =
+    {
+        { LF_PF_U8, "u8" }, { LF_PF_U16, "u16" }, { LF_PF_U32, "u32" },
+        { LF_PF_F32, "f32" }, { LF_PF_F64, "f64" }
+    };
+    // Single channels go through the scalar kernels only; RGB and RGBA
+    // through the vectorized ones where the build has them
+    static const struct
+    {
+        int comp_role;
+        int components;
+        const char *name;
+    } layouts [] =
+    {
+        { LF_CR_1 (INTENSITY), 1, "" },
+        { LF_CR_3 (RED, GREEN, BLUE), 3, ":rgb" },
+        { LF_CR_4 (RED, GREEN, BLUE, UNKNOWN), 4, ":rgba" }
+    };
+
+    std::vector<float> focals;
+    pick_focals (entry, focals);
+    for (size_t f = 0; f < focals.size (); f++)
+        for (size_t s = 0; s < sizeof (sizes) / sizeof (sizes [0]); s++)
+            for (int reverse = 0; reverse < 2; reverse++)
+            {
+                const char *dir = reverse ? ":reverse" : "";
+                accuracy_where where = { &entry, sizes [s].name, focals [f], 0, 0, 0 };
+                std::vector<float> apertures;
+                float distance;
+                pick_apertures (entry, focals [f], apertures, distance);
+                float aperture = apertures.empty () ? 8 : apertures [0];
+                reference ref;
+                lfModifier *mod;
+
+                // Perspective correction only works in the forward direction
+                if (!reverse)
+                    compare_perspective (lens, sizes [s], focals [f], where);
+
+                if ((mod = setup (ref, lens, sizes [s], focals [f], aperture, distance,
+                                  LF_PF_U8, LF_MODIFY_DISTORTION, reverse)))
+                {
+                    compare_coords (std::string ("distortion:") +
+                                    dist_name (ref.distortion.Model) + dir,
+                                    ref, *mod, PATH_COORD, where);
+                    compare_jacobian (std::string ("jacobian:distortion:") +
+                                      dist_name (ref.distortion.Model) + dir,
+                                      ref, *mod, where);
+                    delete mod;
+                }
+
+                if ((mod = setup (ref, lens, sizes [s], focals [f], aperture, distance,
+                                  LF_PF_U8, LF_MODIFY_TCA, reverse)))
+                {
+                    compare_coords (std::string ("tca:") + tca_name (ref.tca.Model) + dir,
+                                    ref, *mod, PATH_SUBPIXEL, where);
+                    delete mod;
+                }
+
+                if ((mod = setup (ref, lens, sizes [s], focals [f], aperture, distance,
+                                  LF_PF_U8, LF_MODIFY_GEOMETRY, reverse)))
+                {
+                    compare_coords (std::string ("geometry:") + type_names [lens.Type] +
+                                    dir, ref, *mod, PATH_COORD, where);
+                    compare_jacobian (std::string ("jacobian:geometry:") +
+                                      type_names [lens.Type] + dir, ref, *mod, where);
+                    delete mod;
+                }
+
+                if ((mod = setup (ref, lens, sizes [s], focals [f], aperture, distance,
+                                  LF_PF_U8, LF_MODIFY_ALL & ~LF_MODIFY_VIGNETTING, reverse)))
+                {
+                    std::string p = "pipeline:";
+                    compare_coords (p + "coord" + dir, ref, *mod, PATH_COORD, where);
+                    compare_coords (p + "subpixel" + dir, ref, *mod,
+                                    PATH_SUBPIXEL_GEOMETRY, where);
+                    compare_coords (p + "packed-f16" + dir, ref, *mod, PATH_PACKED_F16, where);
+                    compare_coords (p + "packed-i16" + dir, ref, *mod, PATH_PACKED_I16, where);
+                    compare_coords (p + "points" + dir, ref, *mod, PATH_POINTS, where);
+                    compare_inverse_points (p + "points-inverse" + dir, ref, *mod, where);
+                    compare_coords (p + "jacobian" + dir, ref, *mod, PATH_JACOBIAN, where);
+                    compare_jacobian ("jacobian:pipeline" + std::string (dir), ref, *mod, where);
+                    delete mod;
+                }
+
+                for (size_t a = 0; a < apertures.size (); a++)
+                    for (size_t p = 0; p < sizeof (formats) / sizeof (formats [0]); p++)
+                    {
+                        where.aperture = apertures [a];
+                        if (!(mod = setup (ref, lens, sizes [s], focals [f], apertures [a],
+                                           distance, formats [p].format,
+                                           LF_MODIFY_VIGNETTING, reverse)))
+                            continue;
+                        for (size_t l = 0; l < sizeof (layouts) / sizeof (layouts [0]); l++)
+                            compare_gains (std::string ("vignetting:pa:") + formats [p].name +
+                                           layouts [l].name + dir, ref, *mod,
+                                           formats [p].format, layouts [l].comp_role,
+                                           layouts [l].components, where);
+                        delete mod;
+                    }
+            }
+}
+
+//---------------------------// Output //---------------------------//
+
+static std::string json_string (const std::string &s)
+{
+    std::string out = "\"";
+    for (size_t i = 0; i < s.size (); i++)
+    {
+        if (s [i] == '"' || s [i] == '\\')
+            out += '\\';
+        out += s [i];
+    }
+    return out + "\"";
+}
+
+// JSON has no infinity
+static double json_number (double x)
+{
+    return x < HUGE_VAL ? x : 1e300;
+}
+
+static void usage ()
+{
+    fprintf (stderr,
+             "Usage: accuracy [--db DIR] [--output FILE] [--revision REV]\n"
+             "                [--rows N] [--lenses N] [--filter SUBSTRING]\n");
+    exit (1);
+}
+
+int main (int argc, char **argv)
+{
+    const char *dbdir = "data/db";
+    const char *output = NULL;
+    const char *revision = "unknown";
+    int max_lenses = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+            usage ();
+        if (!strcmp (argv [i], "--db"))
+            dbdir = argv [++i];
+        else if (!strcmp (argv [i], "--output"))
+            output = argv [++i];
+        else if (!strcmp (argv [i], "--revision"))
+            revision = argv [++i];
+        else if (!strcmp (argv [i], "--rows"))
+            sample_rows = atoi (argv [++i]);
+        else if (!strcmp (argv [i], "--lenses"))
+            max_lenses = atoi (argv [++i]);
+        else if (!strcmp (argv [i], "--filter"))
+            filter = argv [++i];
+        else
+            usage ();
+    }
+    if (sample_rows < 1)
+        usage ();
+
+    std::vector<bench_db_lens> entries;
+    if (!bench_db_scan (dbdir, entries) || entries.empty ())
+    {
+        fprintf (stderr, "no lenses found in %s\n", dbdir);
+        return 1;
+    }
+
+    // --lenses takes an even sample of the database
+    size_t step = max_lenses > 0 && size_t (max_lenses) < entries.size () ?
+        entries.size () / max_lenses : 1;
+    int swept = 0;
+    for (size_t i = 0; i < entries.size (); i += step)
+    {
+        lfLens lens;
+        if (!bench_db_make_lens (entries [i], lens))
+            continue;
+        sweep_lens (entries [i], lens);
+        swept++;
+        fprintf (stderr, "\r%lu/%lu lenses", (unsigned long)(i + 1),
+                 (unsigned long)entries.size ());
+    }
+    fprintf (stderr, "\n");
+
+    FILE *out = output ? fopen (output, "w") : stdout;
+    if (!out)
+    {
+        fprintf (stderr, "cannot write %s\n", output);
+        return 1;
+    }
+
+    fprintf (out, "{\n  \"revision\": %s,\n  \"rows\": %d,\n  \"lenses\": %d,\n  \"checks\": [",
+             json_string (revision).c_str (), sample_rows, swept);
+    fprintf (stderr, "%-32s %-4s %12s %10s %10s %10s %10s  %s\n", "check", "unit",
+             "points", "mean", "p99", "max", "tolerance", "result");
+
+    int failed = 0;
+    for (std::map<std::string, accuracy_check>::const_iterator i = checks.begin ();
+         i != checks.end (); ++i)
+    {
+        const accuracy_check &c = i->second;
+        double mean = c.count ? c.sum / c.count : 0;
+        bool passed = c.passed ();
+        if (!passed)
+            failed++;
+
+        fprintf (stderr, "%-32s %-4s %12llu %10.3g %10.3g %10.3g %10.3g  %s\n",
+                 i->first.c_str (), c.unit.c_str (), c.count, mean, c.percentile (0.99),
+                 c.max, c.tolerance, passed ? "ok" : "FAILED");
+        if (!passed && c.worst.lens)
+            fprintf (stderr, "    worst: %s %s (%s) at %gmm f/%g, %s, pixel %d,%d\n",
+                     c.worst.lens->maker.c_str (), c.worst.lens->model.c_str (),
+                     c.worst.lens->source.c_str (), c.worst.focal, c.worst.aperture,
+                     c.worst.size, c.worst.x, c.worst.y);
+
+        fprintf (out, "%s\n    { \"check\": %s, \"unit\": \"%s\", \"points\": %llu, "
+                 "\"skipped\": %llu, \"mean\": %.6g, \"p99\": %.6g, \"max\": %.6g, "
+                 "\"tolerance\": %g, \"passed\": %s",
+                 i == checks.begin () ? "" : ",", json_string (i->first).c_str (),
+                 c.unit.c_str (), c.count, c.skipped, json_number (mean),
+                 json_number (c.percentile (0.99)), json_number (c.max), c.tolerance,
+                 passed ? "true" : "false");
+        if (c.worst.lens)
+            fprintf (out, ",\n      \"worst\": { \"lens\": %s, \"source\": %s, \"focal\": %g, "
+                     "\"aperture\": %g, \"size\": \"%s\", \"x\": %d, \"y\": %d }",
+                     json_string (c.worst.lens->maker + " " + c.worst.lens->model).c_str (),
+                     json_string (c.worst.lens->source).c_str (), c.worst.focal,
+                     c.worst.aperture, c.worst.size, c.worst.x, c.worst.y);
+        fprintf (out, " }");
+    }
+    fprintf (out, "\n  ],\n  \"failed\": %d\n}\n", failed);
+
+    if (output)
+        fclose (out);
+    if (failed)
+        fprintf (stderr, "%d of %lu checks failed\n", failed, (unsigned long)checks.size ());
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,448 @@
+/*
+    Benchmark of loading the lens database and guessing lens parameters,
+    on data/db and on synthetically scaled up copies of it
+
+    For every scale factor, a copy of the database is written to a scratch
+    directory in which every lens is followed by scale - 1 variants of
+    itself.  Variants keep the maker, the calibrations and the layout of
+    the original entry, so that makers, file sizes and calibrations per
+    lens are distributed like in the real database; their model names get
+    the focal lengths of the original shifted to a neighbouring value with
+    a probability of one half, and one or two words appended which are
+    drawn from the words of the real model names, by frequency.  Scale 1
+    reads data/db itself.
+
+    Timed per scale, as the fastest of --runs runs:
+      load    reading and parsing all XML files (the reader of the tools)
+      build   creating an lfLens with maker, model and all calibrations for
+              every entry
+      guess   lfLens::GuessParameters on every lens, from the name and from
+              the calibrations
+
+    Along with the timings, the heap bytes which the built lenses take are
+    reported, as far as malloc can tell (glibc only).
+
+    lfDatabase has no loader and no FindCameras or FindLenses in this tree,
+    so there is no search to time yet; the scaled copies are kept with
+    --keep for whatever comes next.
+
+    Usage: bench-database [--db DIR] [--output FILE] [--revision REV]
+                          [--scales N,N,...] [--runs N] [--scratch DIR] [--keep]
+
+    Results are written as JSON (to stdout by default); a table goes to
+    stderr.
+*/
+
+#include "lensfun.h"
+#include "bench-db.h"
+#include <chrono>
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#ifdef __GLIBC__
+#  include <malloc.h>
+#endif
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef std::chrono::steady_clock bench_clock;
+
+static double elapsed_ns (bench_clock::time_point start)
+{
+    return std::chrono::duration<double, std::nano> (bench_clock::now () - start).count ();
+}
+
+//---------------------------// Scaled copies //---------------------------//
+
+// A small deterministic generator, so that every run writes the same copies
+struct bench_random
+{
+    unsigned long long state;
+
+    bench_random (unsigned long long seed) : state (seed) { }
+
+    unsigned next (unsigned range)
+    {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return unsigned (state >> 33) % range;
+    }
+};
+
+static bool has_digit (const std::string &word)
+{
+    for (size_t i = 0; i < word.size (); i++)
+        if (isdigit ((unsigned char)word [i]))
+            return true;
+    return false;
+}
+
+// All words without digits of all model names, once per occurrence, so that
+// picking one at random follows their frequency in the database
+static std::vector<std::string> model_words (const std::vector<bench_db_lens> &lenses)
+{
+    std::vector<std::string> words;
+    for (size_t i = 0; i < lenses.size (); i++)
+    {
+        const std::string &model = lenses [i].model;
+        for (size_t pos = 0; pos < model.size (); )
+        {
+            size_t end = model.find (' ', pos);
+            if (end == std::string::npos)
+                end = model.size ();
+            std::string word = model.substr (pos, end - pos);
+            if (!word.empty () && !has_digit (word) && word.find ('&') == std::string::npos &&
+                word.find ('<') == std::string::npos)
+                words.push_back (word);
+            pos = end + 1;
+        }
+    }
+    return words;
+}
+
+// A variant of a model name: numbers in front of "mm" or a '-' become a
+// neighbouring focal length, and one or two words are appended
+static std::string model_variant (const std::string &model, bench_random &rnd,
+                                  const std::vector<std::string> &words)
+{
+    static const float factors [] = { 0.8f, 0.9f, 1.1f, 1.2f, 1.5f };
+    bool shift = rnd.next (2) != 0;
+    float factor = factors [rnd.next (sizeof (factors) / sizeof (factors [0]))];
+
+    std::string out;
+    for (size_t i = 0; i < model.size (); )
+    {
+        size_t end = i;
+        while (end < model.size () && isdigit ((unsigned char)model [end]))
+            end++;
+        bool focal = end > i && end < model.size () &&
+                     (model [end] == '-' || !model.compare (end, 2, "mm")) &&
+                     (i == 0 || model [i - 1] == ' ' || model [i - 1] == '-');
+        if (focal && shift)
+        {
+            char number [16];
+            snprintf (number, sizeof (number), "%d",
+                      std::max (1, int (atoi (model.c_str () + i) * factor + 0.5f)));
+            out += number;
+            i = end;
+        }
+        else if (end > i)
+        {
+            out.append (model, i, end - i);
+            i = end;
+        }
+        else
+            out += model [i++];
+    }
+
+    if (!words.empty ())
+        for (unsigned n = 1 + rnd.next (2); n; n--)
+            out += " " + words [rnd.next (unsigned (words.size ()))];
+    return out;
+}
+
+// Replaces the text of every <model> element of a <lens> block
+static std::string lens_variant (const std::string &block, bench_random &rnd,
+                                 const std::vector<std::string> &words)
+{
+    std::string out;
+    size_t pos = 0;
+    for (size_t open = block.find ("<model"); open != std::string::npos;
+         open = block.find ("<model", pos))
+    {
+        size_t text = block.find ('>', open);
+        size_t close = block.find ("</model>", text);
+        if (text == std::string::npos || close == std::string::npos)
+            break;
+        out.append (block, pos, text + 1 - pos);
+        out += model_variant (block.substr (text + 1, close - text - 1), rnd, words);
+        pos = close;
+    }
+    out.append (block, pos, std::string::npos);
+    return out;
+}
+
+// Writes the copy of dbdir at the given scale to dir, or only counts the
+// bytes of dbdir for scale 1; returns the size in bytes, or -1 on errors
+static long long write_scaled (const char *dbdir, const std::string &dir, int scale,
+                               const std::vector<std::string> &words)
+{
+    std::vector<std::string> files;
+    if (!bench_db_files (dbdir, files) ||
+        (scale > 1 && mkdir (dir.c_str (), 0755) && errno != EEXIST))
+        return -1;
+
+    bench_random rnd (scale);
+    long long bytes = 0;
+    for (size_t f = 0; f < files.size (); f++)
+    {
+        std::string text;
+        if (!bench_db_read (std::string (dbdir) + "/" + files [f], text))
+            return -1;
+        if (scale == 1)
+        {
+            bytes += text.size ();
+            continue;
+        }
+
+        std::string out;
+        size_t pos = 0;
+        for (size_t begin = text.find ("<lens>"); begin != std::string::npos;
+             begin = text.find ("<lens>", pos))
+        {
+            size_t end = text.find ("</lens>", begin);
+            if (end == std::string::npos)
+                break;
+            end += strlen ("</lens>");
+            std::string block = text.substr (begin, end - begin);
+            out.append (text, pos, end - pos);
+            for (int copy = 1; copy < scale; copy++)
+                out += "\n\n    " + lens_variant (block, rnd, words);
+            pos = end;
+        }
+        out.append (text, pos, std::string::npos);
+
+        FILE *file = fopen ((dir + "/" + files [f]).c_str (), "wb");
+        if (!file)
+            return -1;
+        bool ok = fwrite (out.data (), 1, out.size (), file) == out.size ();
+        ok = !fclose (file) && ok;
+        if (!ok)
+            return -1;
+        bytes += out.size ();
+    }
+    return bytes;
+}
+
+static void remove_scaled (const std::string &dir)
+{
+    DIR *d = opendir (dir.c_str ());
+    if (!d)
+        return;
+    while (struct dirent *de = readdir (d))
+        if (de->d_name [0] != '.')
+            unlink ((dir + "/" + de->d_name).c_str ());
+    closedir (d);
+    rmdir (dir.c_str ());
+}
+
+//---------------------------// Timings //---------------------------//
+
+struct bench_result
+{
+    int scale;
+    size_t lenses;
+    long long bytes;
+    // Heap bytes of the lenses built from the entries, or -1 if unknown
+    long long heap_bytes;
+    double load_ms, build_ms, guess_ms;
+};
+
+// Bytes in use on the heap, or -1 where malloc cannot tell
+static long long heap_in_use ()
+{
+#if defined (__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    return (long long)mallinfo2 ().uordblks;
+#else
+    return -1;
+#endif
+}
+
+static std::vector<lfLens *> build_lenses (const std::vector<bench_db_lens> &entries)
+{
+    std::vector<lfLens *> lenses;
+    lenses.reserve (entries.size ());
+    for (size_t i = 0; i < entries.size (); i++)
+    {
+        lfLens *lens = new lfLens ();
+        lens->SetMaker (entries [i].maker.c_str ());
+        lens->SetModel (entries [i].model.c_str ());
+        bench_db_make_lens (entries [i], *lens);
+        lenses.push_back (lens);
+    }
+    return lenses;
+}
+
+static void free_lenses (std::vector<lfLens *> &lenses)
+{
+    for (size_t i = 0; i < lenses.size (); i++)
+        delete lenses [i];
+    lenses.clear ();
+}
+
+static bool time_scale (const std::string &dir, int runs, bench_result &res)
+{
+    res.load_ms = res.build_ms = res.guess_ms = HUGE_VAL;
+    std::vector<bench_db_lens> entries;
+    for (int run = 0; run < runs; run++)
+    {
+        entries.clear ();
+        bench_clock::time_point start = bench_clock::now ();
+        if (!bench_db_scan (dir.c_str (), entries))
+            return false;
+        res.load_ms = std::min (res.load_ms, elapsed_ns (start) / 1e6);
+    }
+    res.lenses = entries.size ();
+
+    for (int run = 0; run < runs; run++)
+    {
+        long long heap = heap_in_use ();
+        bench_clock::time_point start = bench_clock::now ();
+        std::vector<lfLens *> lenses = build_lenses (entries);
+        res.build_ms = std::min (res.build_ms, elapsed_ns (start) / 1e6);
+        res.heap_bytes = heap < 0 ? -1 : heap_in_use () - heap;
+
+        // Only what is unset gets guessed
+        for (size_t i = 0; i < lenses.size (); i++)
+            lenses [i]->MinFocal = lenses [i]->MaxFocal =
+                lenses [i]->MinAperture = lenses [i]->MaxAperture = 0;
+        start = bench_clock::now ();
+        for (size_t i = 0; i < lenses.size (); i++)
+            lenses [i]->GuessParameters ();
+        res.guess_ms = std::min (res.guess_ms, elapsed_ns (start) / 1e6);
+        free_lenses (lenses);
+    }
+    return true;
+}
+
+static std::string json_string (const std::string &s)
+{
+    std::string out = "\"";
+    for (size_t i = 0; i < s.size (); i++)
+    {
+        if (s [i] == '"' || s [i] == '\\')
+            out += '\\';
+        out += s [i];
+    }
+    return out + "\"";
+}
+
+static void usage ()
+{
+    fprintf (stderr,
+             "Usage: bench-database [--db DIR] [--output FILE] [--revision REV]\n"
+             "                      [--scales N,N,...] [--runs N] [--scratch DIR] [--keep]\n");
+    exit (1);
+}
+
+int main (int argc, char **argv)
+{
+    const char *dbdir = "data/db";
+    const char *output = NULL;
+    const char *revision = "unknown";
+    const char *scratch = NULL;
+    std::vector<int> scales;
+    int runs = 3;
+    bool keep = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp (argv [i], "--keep"))
+        {
+            keep = true;
+            continue;
+        }
+        if (i + 1 >= argc)
+            usage ();
+        if (!strcmp (argv [i], "--db"))
+            dbdir = argv [++i];
+        else if (!strcmp (argv [i], "--output"))
+            output = argv [++i];
+        else if (!strcmp (argv [i], "--revision"))
+            revision = argv [++i];
+        else if (!strcmp (argv [i], "--scales"))
+            for (const char *s = argv [++i]; *s; s += strcspn (s, ","), s += *s == ',')
+                scales.push_back (std::max (1, atoi (s)));
+        else if (!strcmp (argv [i], "--runs"))
+            runs = std::max (1, atoi (argv [++i]));
+        else if (!strcmp (argv [i], "--scratch"))
+            scratch = argv [++i];
+        else
+            usage ();
+    }
+    if (scales.empty ())
+    {
+        scales.push_back (1);
+        scales.push_back (10);
+        scales.push_back (100);
+    }
+
+    std::vector<bench_db_lens> entries;
+    if (!bench_db_scan (dbdir, entries) || entries.empty ())
+    {
+        fprintf (stderr, "no lenses found in %s\n", dbdir);
+        return 1;
+    }
+    std::vector<std::string> words = model_words (entries);
+
+    char tmpdir [] = "/tmp/bench-database-XXXXXX";
+    std::string base = scratch ? scratch : "";
+    if (scratch ? mkdir (scratch, 0755) && errno != EEXIST : !mkdtemp (tmpdir))
+    {
+        fprintf (stderr, "cannot create a scratch directory\n");
+        return 1;
+    }
+    if (!scratch)
+        base = tmpdir;
+
+    std::vector<bench_result> results;
+    for (size_t s = 0; s < scales.size (); s++)
+    {
+        bench_result res;
+        res.scale = scales [s];
+        std::string dir = dbdir;
+        if (scales [s] > 1)
+        {
+            char name [32];
+            snprintf (name, sizeof (name), "/x%d", scales [s]);
+            dir = base + name;
+            fprintf (stderr, "writing %s\n", dir.c_str ());
+        }
+        res.bytes = write_scaled (dbdir, dir, scales [s], words);
+
+        bool ok = res.bytes >= 0 && time_scale (dir, runs, res);
+        if (scales [s] > 1 && !keep)
+            remove_scaled (dir);
+        if (!ok)
+        {
+            fprintf (stderr, "cannot benchmark %s\n", dir.c_str ());
+            return 1;
+        }
+        results.push_back (res);
+    }
+    if (!scratch && !keep)
+        rmdir (tmpdir);
+
+    FILE *out = output ? fopen (output, "w") : stdout;
+    if (!out)
+    {
+        fprintf (stderr, "cannot write %s\n", output);
+        return 1;
+    }
+
+    fprintf (out, "{\n  \"revision\": %s,\n  \"runs\": %d,\n  \"scales\": [",
+             json_string (revision).c_str (), runs);
+    fprintf (stderr, "%6s %8s %9s %10s %10s %10s %12s %12s %12s %12s\n", "scale", "lenses",
+             "MB", "load ms", "build ms", "guess ms", "load ns/l", "build ns/l",
+             "guess ns/l", "heap B/l");
+    for (size_t s = 0; s < results.size (); s++)
+    {
+        const bench_result &r = results [s];
+        double n = r.lenses ? double (r.lenses) : 1;
+        fprintf (stderr, "%6d %8lu %9.1f %10.2f %10.2f %10.2f %12.0f %12.0f %12.0f %12.0f\n",
+                 r.scale, (unsigned long)r.lenses, r.bytes / 1e6, r.load_ms, r.build_ms,
+                 r.guess_ms, r.load_ms * 1e6 / n, r.build_ms * 1e6 / n,
+                 r.guess_ms * 1e6 / n, r.heap_bytes / n);
+        fprintf (out, "%s\n    { \"scale\": %d, \"lenses\": %lu, \"bytes\": %lld, "
+                 "\"heap_bytes\": %lld, "
+                 "\"load_ms\": %.3f, \"build_ms\": %.3f, \"guess_ms\": %.3f, "
+                 "\"load_ns_per_lens\": %.1f, \"build_ns_per_lens\": %.1f, "
+                 "\"guess_ns_per_lens\": %.1f }", s ? "," : "", r.scale,
+                 (unsigned long)r.lenses, r.bytes, r.heap_bytes, r.load_ms, r.build_ms,
+                 r.guess_ms, r.load_ms * 1e6 / n, r.build_ms * 1e6 / n, r.guess_ms * 1e6 / n);
+    }
+    fprintf (out, "\n  ]\n}\n");
+
+    if (output)
+        fclose (out);
+    return 0;
+}
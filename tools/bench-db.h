@@ -0,0 +1,320 @@
+/*
+    Minimal reader of the lens entries in data/db for the benchmarks and
+    the accuracy check
+*/
+
+#ifndef __BENCH_DB_H__
+#define __BENCH_DB_H__
+
+#include "lensfun.h"
+#include <algorithm>
+#include <dirent.h>
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// A <distortion>, <tca> or <vignetting> element of a lens calibration
+struct bench_db_element
+{
+    std::string name;
+    std::string source;
+    std::map<std::string, std::string> attr;
+
+    float get (const char *key, float def) const
+    {
+        std::map<std::string, std::string>::const_iterator i = attr.find (key);
+        return i == attr.end () ? def : (float)atof (i->second.c_str ());
+    }
+
+    std::string model () const
+    {
+        std::map<std::string, std::string>::const_iterator i = attr.find ("model");
+        return i == attr.end () ? std::string () : i->second;
+    }
+};
+
+struct bench_db_lens
+{
+    std::string maker, model, type, source;
+    float crop, aspect;
+    std::vector<bench_db_element> calibrations;
+};
+
+// Replaces the predefined XML entities
+static inline std::string bench_db_unescape (const std::string &s)
+{
+    static const char *entities [][2] =
+    {
+        { "&amp;", "&" }, { "&lt;", "<" }, { "&gt;", ">" },
+        { "&quot;", "\"" }, { "&apos;", "'" }
+    };
+    std::string out;
+    for (size_t i = 0; i < s.size (); i++)
+    {
+        size_t e = 0;
+        if (s [i] == '&')
+            for (; e < sizeof (entities) / sizeof (entities [0]); e++)
+                if (!s.compare (i, strlen (entities [e][0]), entities [e][0]))
+                    break;
+        if (s [i] == '&' && e < sizeof (entities) / sizeof (entities [0]))
+        {
+            out += entities [e][1];
+            i += strlen (entities [e][0]) - 1;
+        }
+        else
+            out += s [i];
+    }
+    return out;
+}
+
+// Text of the first <tag>...</tag> in [begin, end), or def
+static inline std::string bench_db_text (const std::string &text, size_t begin,
+                                         size_t end, const char *tag, const char *def)
+{
+    // Missing tags must not make the search run on to the end of the file
+    std::string open = std::string ("<") + tag + ">";
+    std::string::const_iterator found = std::search (
+        text.begin () + begin, text.begin () + end, open.begin (), open.end ());
+    if (found == text.begin () + end)
+        return def;
+    size_t pos = (found - text.begin ()) + open.size ();
+    size_t close = text.find ('<', pos);
+    return close >= end ? std::string (def) : bench_db_unescape (text.substr (pos, close - pos));
+}
+
+static inline void bench_db_attributes (const std::string &text, size_t pos,
+                                        bench_db_element &element)
+{
+    size_t end = text.find ('>', pos);
+    while (pos < end)
+    {
+        size_t eq = text.find ('=', pos);
+        if (eq >= end)
+            break;
+        size_t key = text.find_last_of (" \t\r\n", eq - 1) + 1;
+        char quote = text [eq + 1];
+        size_t close = text.find (quote, eq + 2);
+        if (close >= end)
+            break;
+        element.attr [text.substr (key, eq - key)] =
+            text.substr (eq + 2, close - eq - 2);
+        pos = close + 1;
+    }
+}
+
+// Aspect ratios are given either as a number or as "16:9"
+static inline float bench_db_aspect (const std::string &s)
+{
+    size_t colon = s.find (':');
+    if (colon == std::string::npos)
+        return (float)atof (s.c_str ());
+    float den = (float)atof (s.c_str () + colon + 1);
+    return den > 0 ? (float)atof (s.c_str ()) / den : 0;
+}
+
+static inline bool bench_db_read (const std::string &path, std::string &text)
+{
+    FILE *file = fopen (path.c_str (), "rb");
+    if (!file)
+        return false;
+    char buf [65536];
+    size_t n;
+    while ((n = fread (buf, 1, sizeof (buf), file)) > 0)
+        text.append (buf, n);
+    fclose (file);
+    return true;
+}
+
+// The names of the XML files in dir, sorted
+static inline bool bench_db_files (const char *dir, std::vector<std::string> &files)
+{
+    DIR *d = opendir (dir);
+    if (!d)
+        return false;
+    while (struct dirent *de = readdir (d))
+    {
+        size_t len = strlen (de->d_name);
+        if (len > 4 && !strcmp (de->d_name + len - 4, ".xml"))
+            files.push_back (de->d_name);
+    }
+    closedir (d);
+    std::sort (files.begin (), files.end ());
+    return true;
+}
+
+/**
+ * Reads the lenses of all XML files in dir, in file order.  Only what the
+ * benchmarks need is picked up; this is not a replacement for lfDatabase.
+ * Returns false if the directory cannot be read.
+ */
+static inline bool bench_db_scan (const char *dir, std::vector<bench_db_lens> &lenses)
+{
+    static const char *elements [] = { "distortion", "tca", "vignetting" };
+
+    std::vector<std::string> files;
+    if (!bench_db_files (dir, files))
+        return false;
+
+    for (size_t f = 0; f < files.size (); f++)
+    {
+        std::string text;
+        if (!bench_db_read (std::string (dir) + "/" + files [f], text))
+            continue;
+
+        // Line numbers are counted along as the scan moves forward
+        size_t line_pos = 0;
+        int line = 1;
+        #define BENCH_DB_LINE(pos) \
+            (line += (int)std::count (text.begin () + line_pos, text.begin () + (pos), '\n'), \
+             line_pos = (pos), line)
+
+        for (size_t begin = text.find ("<lens>"); begin != std::string::npos;
+             begin = text.find ("<lens>", begin + 1))
+        {
+            size_t end = text.find ("</lens>", begin);
+            if (end == std::string::npos)
+                break;
+
+            char where [32];
+            bench_db_lens lens;
+            snprintf (where, sizeof (where), ":%d", BENCH_DB_LINE (begin));
+            lens.source = files [f] + where;
+            lens.maker = bench_db_text (text, begin, end, "maker", "");
+            lens.model = bench_db_text (text, begin, end, "model", "");
+            lens.type = bench_db_text (text, begin, end, "type", "rectilinear");
+            lens.crop = (float)atof (bench_db_text (text, begin, end, "cropfactor", "1").c_str ());
+            lens.aspect = bench_db_aspect (bench_db_text (text, begin, end, "aspect-ratio", "1.5"));
+
+            // Elements in document order, so that sources are increasing
+            for (size_t pos = text.find ('<', begin + 1); pos < end;
+                 pos = text.find ('<', pos + 1))
+                for (size_t e = 0; e < sizeof (elements) / sizeof (elements [0]); e++)
+                {
+                    size_t len = strlen (elements [e]);
+                    if (text.compare (pos + 1, len, elements [e]) || text [pos + 1 + len] != ' ')
+                        continue;
+                    bench_db_element element;
+                    element.name = elements [e];
+                    snprintf (where, sizeof (where), ":%d", BENCH_DB_LINE (pos));
+                    element.source = files [f] + where;
+                    bench_db_attributes (text, pos + 1 + len, element);
+                    lens.calibrations.push_back (element);
+                }
+
+            lenses.push_back (lens);
+            begin = end;
+        }
+        #undef BENCH_DB_LINE
+    }
+    return true;
+}
+
+static inline lfLensType bench_db_lens_type (const std::string &name)
+{
+    static const struct { const char *name; lfLensType type; } types [] =
+    {
+        { "rectilinear", LF_RECTILINEAR },
+        { "fisheye", LF_FISHEYE },
+        { "panoramic", LF_PANORAMIC },
+        { "equirectangular", LF_EQUIRECTANGULAR },
+        { "orthographic", LF_FISHEYE_ORTHOGRAPHIC },
+        { "stereographic", LF_FISHEYE_STEREOGRAPHIC },
+        { "equisolid", LF_FISHEYE_EQUISOLID },
+        { "fisheye_thoby", LF_FISHEYE_THOBY }
+    };
+    for (size_t i = 0; i < sizeof (types) / sizeof (types [0]); i++)
+        if (name == types [i].name)
+            return types [i].type;
+    return LF_UNKNOWN;
+}
+
+// Builds the lfLens of a database entry; returns false if it has nothing
+// the modifier could use
+static inline bool bench_db_make_lens (const bench_db_lens &entry, lfLens &lens)
+{
+    lens.CropFactor = entry.crop > 0 ? entry.crop : 1;
+    lens.AspectRatio = entry.aspect > 0 ? entry.aspect : 1.5f;
+    lens.Type = bench_db_lens_type (entry.type);
+
+    bool any = false;
+    for (size_t i = 0; i < entry.calibrations.size (); i++)
+    {
+        const bench_db_element &e = entry.calibrations [i];
+        std::string model = e.model ();
+        if (e.name == "distortion")
+        {
+            lfLensCalibDistortion dc;
+            memset (&dc, 0, sizeof (dc));
+            dc.Focal = e.get ("focal", 0);
+            dc.RealFocal = e.get ("real-focal", dc.Focal);
+            dc.RealFocalMeasured = e.attr.count ("real-focal") != 0;
+            if (model == "poly3")
+            {
+                dc.Model = LF_DIST_MODEL_POLY3;
+                dc.Terms [0] = e.get ("k1", 0);
+            }
+            else if (model == "poly5")
+            {
+                dc.Model = LF_DIST_MODEL_POLY5;
+                dc.Terms [0] = e.get ("k1", 0);
+                dc.Terms [1] = e.get ("k2", 0);
+            }
+            else if (model == "ptlens")
+            {
+                dc.Model = LF_DIST_MODEL_PTLENS;
+                dc.Terms [0] = e.get ("a", 0);
+                dc.Terms [1] = e.get ("b", 0);
+                dc.Terms [2] = e.get ("c", 0);
+            }
+            else
+                continue;
+            lens.AddCalibDistortion (&dc);
+        }
+        else if (e.name == "tca")
+        {
+            lfLensCalibTCA tc;
+            memset (&tc, 0, sizeof (tc));
+            tc.Focal = e.get ("focal", 0);
+            if (model == "linear")
+            {
+                tc.Model = LF_TCA_MODEL_LINEAR;
+                tc.Terms [0] = e.get ("kr", 1);
+                tc.Terms [1] = e.get ("kb", 1);
+            }
+            else if (model == "poly3")
+            {
+                static const char *terms [] = { "vr", "vb", "cr", "cb", "br", "bb" };
+                tc.Model = LF_TCA_MODEL_POLY3;
+                for (int t = 0; t < 6; t++)
+                    tc.Terms [t] = e.get (terms [t], t < 2 ? 1 : 0);
+            }
+            else
+                continue;
+            lens.AddCalibTCA (&tc);
+        }
+        else if (e.name == "vignetting")
+        {
+            lfLensCalibVignetting vc;
+            memset (&vc, 0, sizeof (vc));
+            if (model != "pa")
+                continue;
+            vc.Model = LF_VIGNETTING_MODEL_PA;
+            vc.Focal = e.get ("focal", 0);
+            vc.Aperture = e.get ("aperture", 0);
+            vc.Distance = e.get ("distance", 1000);
+            vc.Terms [0] = e.get ("k1", 0);
+            vc.Terms [1] = e.get ("k2", 0);
+            vc.Terms [2] = e.get ("k3", 0);
+            lens.AddCalibVignetting (&vc);
+        }
+        else
+            continue;
+        any = true;
+    }
+    return any || (lens.Type != LF_RECTILINEAR && lens.Type != LF_UNKNOWN);
+}
+
+#endif
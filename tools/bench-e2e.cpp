@@ -0,0 +1,442 @@
+/*
+    End-to-end benchmark over all lenses of the database
+
+    For every lens in data/db a few representative settings are picked: the
+    shortest, a middle and the longest calibrated focal length, each at the
+    widest calibrated aperture and the farthest focus distance.  For every
+    setting and image size this times the construction of the modifier,
+    Initialize with automatic scaling and all corrections (projection to
+    rectilinear), and a full frame of ApplySubpixelGeometryDistortion and
+    ApplyColorModification (16 bit RGB).
+
+    By default only --rows evenly spaced rows are processed and the time is
+    scaled up to the full frame; --rows 0 processes every row.
+
+    Usage: bench-e2e [--db DIR] [--output FILE] [--revision REV]
+                     [--rows N] [--lenses N] [--top N]
+
+    Per-setting results and the summary are written as JSON (to stdout by
+    default); the summary also goes to stderr.  A library built with
+    PROFILING=1 adds the counters of every callback that ran.
+*/
+
+#include "lensfun.h"
+#include "bench-db.h"
+#include <chrono>
+#include <math.h>
+
+// Construction and Initialize are repeated; the fastest run counts
+#define BENCH_SETUP_RUNS 3
+
+struct bench_size
+{
+    const char *name;
+    int width, height;
+};
+
+static const bench_size sizes [] =
+{
+    { "12MP", 4288, 2848 },
+    { "24MP", 6000, 4000 },
+    { "45MP", 8256, 5504 }
+};
+#define BENCH_SIZES int (sizeof (sizes) / sizeof (sizes [0]))
+
+struct bench_timing
+{
+    double construct_us, initialize_us;
+    double subpixel_ns_per_px, color_ns_per_px;
+    double frame_ms;
+    int flags;
+};
+
+struct bench_point
+{
+    const bench_db_lens *lens;
+    std::string combination;
+    float focal, aperture, distance;
+    bench_timing timing [BENCH_SIZES];
+};
+
+typedef std::chrono::steady_clock bench_clock;
+
+static double elapsed_ns (bench_clock::time_point start)
+{
+    return std::chrono::duration<double, std::nano> (bench_clock::now () - start).count ();
+}
+
+//---------------------------// Lenses //---------------------------//
+
+// "type:distortion+tca+vignetting", with "-" for what is not calibrated
+static std::string combination (const bench_db_lens &entry)
+{
+    static const char *elements [] = { "distortion", "tca", "vignetting" };
+    std::string result = entry.type + ":";
+    for (int i = 0; i < 3; i++)
+    {
+        std::string model = "-";
+        for (size_t c = 0; c < entry.calibrations.size (); c++)
+            if (entry.calibrations [c].name == elements [i])
+            {
+                model = entry.calibrations [c].model ();
+                break;
+            }
+        result += (i ? "+" : "") + model;
+    }
+    return result;
+}
+
+// The shortest, middle and longest calibrated focal lengths, each with the
+// widest aperture and the farthest distance calibrated for vignetting
+static void pick_points (const bench_db_lens &entry, std::vector<bench_point> &points)
+{
+    std::vector<float> focals;
+    for (size_t c = 0; c < entry.calibrations.size (); c++)
+        focals.push_back (entry.calibrations [c].get ("focal", 0));
+    std::sort (focals.begin (), focals.end ());
+    focals.erase (std::unique (focals.begin (), focals.end ()), focals.end ());
+    if (focals.empty ())
+        focals.push_back (50);
+
+    size_t picks [] = { 0, focals.size () / 2, focals.size () - 1 };
+    std::string combo = combination (entry);
+    for (int p = 0; p < 3; p++)
+    {
+        if (p && picks [p] == picks [p - 1])
+            continue;
+        bench_point point;
+        point.lens = &entry;
+        point.combination = combo;
+        point.focal = focals [picks [p]];
+        point.aperture = 0;
+        point.distance = 1000;
+        for (size_t c = 0; c < entry.calibrations.size (); c++)
+        {
+            const bench_db_element &e = entry.calibrations [c];
+            if (e.name != "vignetting" || e.get ("focal", 0) != point.focal)
+                continue;
+            float aperture = e.get ("aperture", 0);
+            if (!point.aperture || aperture < point.aperture)
+                point.aperture = aperture;
+        }
+        for (size_t c = 0; c < entry.calibrations.size (); c++)
+        {
+            const bench_db_element &e = entry.calibrations [c];
+            if (e.name == "vignetting" && e.get ("focal", 0) == point.focal &&
+                e.get ("aperture", 0) == point.aperture)
+                point.distance = std::max (point.distance, e.get ("distance", 1000));
+        }
+        if (!point.aperture)
+            point.aperture = 8;
+        points.push_back (point);
+    }
+}
+
+//---------------------------// Timing //---------------------------//
+
+static void time_point (const lfLens &lens, bench_point &point, int sample_rows)
+{
+    for (int s = 0; s < BENCH_SIZES; s++)
+    {
+        const bench_size &size = sizes [s];
+        bench_timing &t = point.timing [s];
+        float crop = lens.CropFactor;
+
+        t.construct_us = t.initialize_us = HUGE_VAL;
+        lfModifier *mod = NULL;
+        for (int run = 0; run < BENCH_SETUP_RUNS; run++)
+        {
+            delete mod;
+            bench_clock::time_point start = bench_clock::now ();
+            mod = new lfModifier (&lens, crop, size.width, size.height);
+            t.construct_us = std::min (t.construct_us, elapsed_ns (start) / 1e3);
+
+            start = bench_clock::now ();
+            t.flags = mod->Initialize (&lens, LF_PF_U16, point.focal, point.aperture,
+                                       point.distance, 0, LF_RECTILINEAR,
+                                       LF_MODIFY_ALL, false);
+            t.initialize_us = std::min (t.initialize_us, elapsed_ns (start) / 1e3);
+        }
+
+        int rows = sample_rows > 0 && sample_rows < size.height ? sample_rows : size.height;
+        std::vector<float> coords ((size_t)size.width * 2 * 3);
+        std::vector<lf_u16> pixels ((size_t)size.width * 3);
+        double subpixel_ns = 0, color_ns = 0;
+        for (int r = 0; r < rows; r++)
+        {
+            int y = int ((long long)size.height * r / rows);
+
+            bench_clock::time_point start = bench_clock::now ();
+            mod->ApplySubpixelGeometryDistortion (0, y, size.width, 1, &coords [0]);
+            subpixel_ns += elapsed_ns (start);
+
+            std::fill (pixels.begin (), pixels.end (), 0x8000);
+            start = bench_clock::now ();
+            mod->ApplyColorModification (&pixels [0], 0, y, size.width, 1,
+                                         LF_CR_3 (RED, GREEN, BLUE),
+                                         size.width * 3 * sizeof (lf_u16));
+            color_ns += elapsed_ns (start);
+        }
+        delete mod;
+
+        double pixels_done = double (size.width) * rows;
+        t.subpixel_ns_per_px = subpixel_ns / pixels_done;
+        t.color_ns_per_px = color_ns / pixels_done;
+        t.frame_ms = (t.construct_us + t.initialize_us) / 1e3 +
+            (t.subpixel_ns_per_px + t.color_ns_per_px) *
+            size.width * size.height / 1e6;
+    }
+}
+
+//---------------------------// Statistics //---------------------------//
+
+struct bench_stats
+{
+    double mean, p50, p90, p99, max;
+};
+
+static bench_stats statistics (std::vector<double> values)
+{
+    bench_stats st = { 0, 0, 0, 0, 0 };
+    if (values.empty ())
+        return st;
+    std::sort (values.begin (), values.end ());
+    for (size_t i = 0; i < values.size (); i++)
+        st.mean += values [i];
+    st.mean /= values.size ();
+    st.p50 = values [(values.size () - 1) * 50 / 100];
+    st.p90 = values [(values.size () - 1) * 90 / 100];
+    st.p99 = values [(values.size () - 1) * 99 / 100];
+    st.max = values.back ();
+    return st;
+}
+
+static std::string json_string (const std::string &s)
+{
+    std::string out = "\"";
+    for (size_t i = 0; i < s.size (); i++)
+    {
+        if (s [i] == '"' || s [i] == '\\')
+            out += '\\';
+        out += s [i];
+    }
+    return out + "\"";
+}
+
+static void print_stats (FILE *out, const char *name, const bench_stats &st, bool last)
+{
+    fprintf (out, "        \"%s\": { \"mean\": %.4f, \"p50\": %.4f, \"p90\": %.4f, "
+             "\"p99\": %.4f, \"max\": %.4f }%s\n", name, st.mean, st.p50, st.p90,
+             st.p99, st.max, last ? "" : ",");
+}
+
+static bool by_frame_time (const bench_point *a, const bench_point *b)
+{
+    return a->timing [BENCH_SIZES - 1].frame_ms > b->timing [BENCH_SIZES - 1].frame_ms;
+}
+
+static void usage ()
+{
+    fprintf (stderr,
+             "Usage: bench-e2e [--db DIR] [--output FILE] [--revision REV]\n"
+             "                 [--rows N] [--lenses N] [--top N]\n");
+    exit (1);
+}
+
+// Per-callback counters of a build with LF_PROFILING, or nothing
+static void print_profile (FILE *out)
+{
+    int count = lfModifier::GetProfileCounters (NULL, 0);
+    if (count < 0)
+        return;
+    std::vector<lfProfileCounters> counters (count);
+    if (count)
+        count = lfModifier::GetProfileCounters (&counters [0], count);
+
+    fprintf (out, ",\n  \"profile\": [");
+    fprintf (stderr, "\n%-44s %10s %12s %9s %8s\n", "callback", "calls", "pixels",
+             "ns/px", "newton");
+    for (int i = 0; i < count; i++)
+    {
+        const lfProfileCounters &c = counters [i];
+        unsigned long long converged = 0, steps = 0;
+        for (int b = 0; b < LF_PROFILE_NEWTON_BINS; b++)
+        {
+            converged += c.NewtonSteps [b];
+            steps += c.NewtonSteps [b] * (b + 1);
+        }
+        double ns_per_px = c.Pixels ? double (c.Nanoseconds) / c.Pixels : 0.0;
+        double mean_steps = converged ? double (steps) / converged : 0.0;
+        fprintf (stderr, "%-44s %10llu %12llu %9.3f %8.2f\n", c.Name, c.Calls,
+                 c.Pixels, ns_per_px, mean_steps);
+        fprintf (out, "%s\n    { \"callback\": %s, \"calls\": %llu, \"pixels\": %llu, "
+                 "\"ns\": %llu, \"ns_per_px\": %.4f, \"newton_steps\": [",
+                 i ? "," : "", json_string (c.Name).c_str (), c.Calls, c.Pixels,
+                 c.Nanoseconds, ns_per_px);
+        for (int b = 0; b < LF_PROFILE_NEWTON_BINS; b++)
+            fprintf (out, "%s%llu", b ? ", " : "", c.NewtonSteps [b]);
+        fprintf (out, "], \"newton_failures\": %llu }", c.NewtonFailures);
+    }
+    fprintf (out, "\n  ]");
+}
+
+int main (int argc, char **argv)
+{
+    const char *dbdir = "data/db";
+    const char *output = NULL;
+    const char *revision = "unknown";
+    int sample_rows = 64, max_lenses = 0, top = 20;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+            usage ();
+        if (!strcmp (argv [i], "--db"))
+            dbdir = argv [++i];
+        else if (!strcmp (argv [i], "--output"))
+            output = argv [++i];
+        else if (!strcmp (argv [i], "--revision"))
+            revision = argv [++i];
+        else if (!strcmp (argv [i], "--rows"))
+            sample_rows = atoi (argv [++i]);
+        else if (!strcmp (argv [i], "--lenses"))
+            max_lenses = atoi (argv [++i]);
+        else if (!strcmp (argv [i], "--top"))
+            top = atoi (argv [++i]);
+        else
+            usage ();
+    }
+
+    std::vector<bench_db_lens> entries;
+    if (!bench_db_scan (dbdir, entries) || entries.empty ())
+    {
+        fprintf (stderr, "no lenses found in %s\n", dbdir);
+        return 1;
+    }
+
+    // --lenses takes an even sample of the database
+    size_t step = max_lenses > 0 && size_t (max_lenses) < entries.size () ?
+        entries.size () / max_lenses : 1;
+    std::vector<bench_point> points;
+    lfModifier::ResetProfileCounters ();
+    for (size_t i = 0; i < entries.size (); i += step)
+    {
+        lfLens lens;
+        if (!bench_db_make_lens (entries [i], lens))
+            continue;
+        size_t first = points.size ();
+        pick_points (entries [i], points);
+        for (size_t p = first; p < points.size (); p++)
+            time_point (lens, points [p], sample_rows);
+        fprintf (stderr, "\r%lu/%lu lenses", (unsigned long)(i + 1),
+                 (unsigned long)entries.size ());
+    }
+    fprintf (stderr, "\n");
+
+    FILE *out = output ? fopen (output, "w") : stdout;
+    if (!out)
+    {
+        fprintf (stderr, "cannot write %s\n", output);
+        return 1;
+    }
+
+    fprintf (out, "{\n  \"revision\": %s,\n  \"rows\": %d,\n  \"points\": [",
+             json_string (revision).c_str (), sample_rows);
+    for (size_t p = 0; p < points.size (); p++)
+    {
+        const bench_point &pt = points [p];
+        fprintf (out, "%s\n    { \"lens\": %s, \"source\": %s, \"combination\": %s, "
+                 "\"focal\": %g, \"aperture\": %g, \"distance\": %g, \"sizes\": [",
+                 p ? "," : "", json_string (pt.lens->maker + " " + pt.lens->model).c_str (),
+                 json_string (pt.lens->source).c_str (), json_string (pt.combination).c_str (),
+                 pt.focal, pt.aperture, pt.distance);
+        for (int s = 0; s < BENCH_SIZES; s++)
+        {
+            const bench_timing &t = pt.timing [s];
+            fprintf (out, "%s\n      { \"size\": \"%s\", \"flags\": %d, \"construct_us\": %.3f, "
+                     "\"initialize_us\": %.3f, \"subpixel_ns_per_px\": %.4f, "
+                     "\"color_ns_per_px\": %.4f, \"frame_ms\": %.3f }",
+                     s ? "," : "", sizes [s].name, t.flags, t.construct_us,
+                     t.initialize_us, t.subpixel_ns_per_px, t.color_ns_per_px,
+                     t.frame_ms);
+        }
+        fprintf (out, " ] }");
+    }
+    fprintf (out, "\n  ],\n  \"summary\": {\n");
+
+    for (int s = 0; s < BENCH_SIZES; s++)
+    {
+        std::vector<double> construct, initialize, subpixel, color, frame;
+        for (size_t p = 0; p < points.size (); p++)
+        {
+            const bench_timing &t = points [p].timing [s];
+            construct.push_back (t.construct_us);
+            initialize.push_back (t.initialize_us);
+            subpixel.push_back (t.subpixel_ns_per_px);
+            color.push_back (t.color_ns_per_px);
+            frame.push_back (t.frame_ms);
+        }
+        bench_stats fs = statistics (frame);
+        fprintf (stderr, "%s: frame ms mean %.1f p50 %.1f p90 %.1f p99 %.1f max %.1f; "
+                 "Initialize us p50 %.1f p99 %.1f\n", sizes [s].name, fs.mean, fs.p50,
+                 fs.p90, fs.p99, fs.max, statistics (initialize).p50,
+                 statistics (initialize).p99);
+
+        fprintf (out, "    \"%s\": {\n", sizes [s].name);
+        print_stats (out, "construct_us", statistics (construct), false);
+        print_stats (out, "initialize_us", statistics (initialize), false);
+        print_stats (out, "subpixel_ns_per_px", statistics (subpixel), false);
+        print_stats (out, "color_ns_per_px", statistics (color), false);
+        print_stats (out, "frame_ms", fs, true);
+        fprintf (out, "    },\n");
+    }
+
+    // Frame times of the largest size per model combination
+    std::map<std::string, std::vector<double> > by_combination;
+    for (size_t p = 0; p < points.size (); p++)
+        by_combination [points [p].combination].push_back (
+            points [p].timing [BENCH_SIZES - 1].frame_ms);
+    fprintf (out, "    \"combinations\": {\n");
+    fprintf (stderr, "\n%-36s %6s %9s %9s  (%s frame ms)\n", "combination", "count",
+             "p50", "max", sizes [BENCH_SIZES - 1].name);
+    for (std::map<std::string, std::vector<double> >::const_iterator i =
+             by_combination.begin (); i != by_combination.end (); )
+    {
+        bench_stats st = statistics (i->second);
+        fprintf (stderr, "%-36s %6lu %9.1f %9.1f\n", i->first.c_str (),
+                 (unsigned long)i->second.size (), st.p50, st.max);
+        fprintf (out, "      %s: { \"count\": %lu, \"p50\": %.3f, \"p90\": %.3f, "
+                 "\"max\": %.3f }", json_string (i->first).c_str (),
+                 (unsigned long)i->second.size (), st.p50, st.p90, st.max);
+        fprintf (out, ++i == by_combination.end () ? "\n" : ",\n");
+    }
+    fprintf (out, "    },\n");
+
+    std::vector<const bench_point *> slowest;
+    for (size_t p = 0; p < points.size (); p++)
+        slowest.push_back (&points [p]);
+    std::sort (slowest.begin (), slowest.end (), by_frame_time);
+    if (slowest.size () > size_t (top))
+        slowest.resize (top);
+    fprintf (out, "    \"slowest\": [");
+    fprintf (stderr, "\nslowest at %s:\n", sizes [BENCH_SIZES - 1].name);
+    for (size_t p = 0; p < slowest.size (); p++)
+    {
+        const bench_point &pt = *slowest [p];
+        const bench_timing &t = pt.timing [BENCH_SIZES - 1];
+        fprintf (stderr, "%9.1f ms  %s %s (%s) at %gmm f/%g\n", t.frame_ms,
+                 pt.lens->maker.c_str (), pt.lens->model.c_str (),
+                 pt.combination.c_str (), pt.focal, pt.aperture);
+        fprintf (out, "%s\n      { \"lens\": %s, \"combination\": %s, \"focal\": %g, "
+                 "\"aperture\": %g, \"frame_ms\": %.3f }", p ? "," : "",
+                 json_string (pt.lens->maker + " " + pt.lens->model).c_str (),
+                 json_string (pt.combination).c_str (), pt.focal, pt.aperture, t.frame_ms);
+    }
+    fprintf (out, "\n    ]\n  }");
+    print_profile (out);
+    fprintf (out, "\n}\n");
+
+    if (output)
+        fclose (out);
+    return 0;
+}
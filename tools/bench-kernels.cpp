@@ -0,0 +1,793 @@
+/*
+    Microbenchmarks for the built-in modifier callbacks
+
+    Every case sets up a modifier with exactly one stock callback, the way
+    lfModifier::Initialize does, and times the Apply* call which drives it
+    over a band of rows.  Each case runs at three image widths, chosen so
+    that the buffer being written fits into L1, into L2, or into neither.
+    The "row-setup" case measures the coordinate generation shared by all
+    coordinate callbacks; subtract it to get the cost of a kernel alone.
+    The "points" cases map scattered points with a typical PTLens profile,
+    one by one with ApplyGeometryDistortion and in a batch with
+    ApplyGeometryDistortionPoints, forward and inverse.
+
+    Parameters come from the calibrations in the XML database: for every
+    model the mildest, the median and the strongest tenth of the entries
+    are used.  Models without entries in the database (ACM) get synthetic
+    parameters.
+
+    Usage: bench-kernels [--db DIR] [--output FILE] [--revision REV]
+                         [--min-time SECONDS] [--filter SUBSTRING]
+
+    Results are written as JSON (to stdout by default); a table goes to
+    stderr.
+*/
+
+#include "lensfun.h"
+#include "bench-db.h"
+#include <chrono>
+#include <math.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#define BENCH_HAVE_TSC
+#endif
+
+// Rows processed by one call; the width is derived from the working set
+#define BENCH_ROWS 4
+// Timed samples per case and level
+#define BENCH_SAMPLES 5
+// Color callbacks change the pixels in place, so they are restored after
+// this many calls to keep the values away from saturation and denormals
+#define BENCH_RESET_CALLS 8
+
+enum bench_kind
+{
+    BENCH_COORD,
+    BENCH_SUBPIXEL,
+    BENCH_COLOR,
+    BENCH_POINTS_SINGLE,
+    BENCH_POINTS,
+    BENCH_POINTS_INVERSE,
+    BENCH_JACOBIAN
+};
+
+struct bench_level
+{
+    const char *name;
+    size_t bytes;
+};
+
+static const bench_level levels [] =
+{
+    { "L1", 16 * 1024 },
+    { "L2", 256 * 1024 },
+    { "DRAM", 64 * 1024 * 1024 }
+};
+
+struct bench_case
+{
+    std::string kernel;
+    std::string params;
+    bench_kind kind;
+    lfPixelFormat format;
+    int flags;
+    bool reverse;
+    bool perspective;
+    lfLensType type, target;
+    float focal, aperture, distance, scale;
+    lfLensCalibDistortion distortion;
+    lfLensCalibTCA tca;
+    lfLensCalibVignetting vignetting;
+};
+
+struct bench_result
+{
+    bool ok;
+    int width;
+    size_t bytes;
+    double ns_per_px, ns_per_px_min, cycles_per_px;
+};
+
+//---------------------------// Database scanning //---------------------------//
+
+// A calibration of the database along with how far it is from identity
+struct db_entry : bench_db_element
+{
+    float strength;
+};
+
+// Collects the calibrations of all lenses, keyed by "element/model"
+static void scan_database (const char *dir,
+                           std::map<std::string, std::vector<db_entry> > &entries)
+{
+    std::vector<bench_db_lens> lenses;
+    if (!bench_db_scan (dir, lenses))
+    {
+        fprintf (stderr, "warning: cannot open %s, using synthetic parameters only\n", dir);
+        return;
+    }
+
+    for (size_t l = 0; l < lenses.size (); l++)
+        for (size_t c = 0; c < lenses [l].calibrations.size (); c++)
+        {
+            db_entry entry;
+            (bench_db_element &)entry = lenses [l].calibrations [c];
+            entry.strength = 0;
+            entries [entry.name + "/" + entry.model ()].push_back (entry);
+        }
+}
+
+static bool by_strength (const db_entry &a, const db_entry &b)
+{
+    return a.strength < b.strength;
+}
+
+// Picks the mild, typical and strong entries (10th, 50th and 90th
+// percentile of strength) of a model
+static std::vector<std::pair<std::string, const db_entry *> > pick_sets (
+    std::vector<db_entry> &list)
+{
+    static const char *labels [] = { "mild", "typical", "strong" };
+    static const double quantiles [] = { 0.1, 0.5, 0.9 };
+
+    std::vector<std::pair<std::string, const db_entry *> > sets;
+    if (list.empty ())
+        return sets;
+    std::sort (list.begin (), list.end (), by_strength);
+    for (int i = 0; i < 3; i++)
+    {
+        const db_entry *e = &list [size_t (quantiles [i] * (list.size () - 1))];
+        sets.push_back (std::make_pair (std::string (labels [i]) + " " + e->source, e));
+    }
+    return sets;
+}
+
+//---------------------------// Cases //---------------------------//
+
+static bench_case new_case (const char *kernel, const std::string &params,
+                            bench_kind kind, int flags, bool reverse)
+{
+    bench_case c;
+    memset (&c.distortion, 0, sizeof (c.distortion));
+    memset (&c.tca, 0, sizeof (c.tca));
+    memset (&c.vignetting, 0, sizeof (c.vignetting));
+    c.kernel = kernel;
+    c.params = params;
+    c.kind = kind;
+    c.format = LF_PF_F32;
+    c.flags = flags;
+    c.reverse = reverse;
+    c.perspective = false;
+    c.type = c.target = LF_RECTILINEAR;
+    c.focal = 50;
+    c.aperture = 4;
+    c.distance = 1000;
+    c.scale = 1;
+    return c;
+}
+
+static void add_distortion_cases (std::vector<bench_case> &cases,
+                                  std::map<std::string, std::vector<db_entry> > &db)
+{
+    static const struct
+    {
+        const char *model, *kernel, *unkernel, *terms [5];
+        lfDistortionModel id;
+    } models [] =
+    {
+        { "poly3", "ModifyCoord_Dist_Poly3", "ModifyCoord_UnDist_Poly3",
+          { "k1" }, LF_DIST_MODEL_POLY3 },
+        { "poly5", "ModifyCoord_Dist_Poly5", "ModifyCoord_UnDist_Poly5",
+          { "k1", "k2" }, LF_DIST_MODEL_POLY5 },
+        { "ptlens", "ModifyCoord_Dist_PTLens", "ModifyCoord_UnDist_PTLens",
+          { "a", "b", "c" }, LF_DIST_MODEL_PTLENS },
+    };
+
+    for (size_t m = 0; m < sizeof (models) / sizeof (models [0]); m++)
+    {
+        std::vector<db_entry> &list = db [std::string ("distortion/") + models [m].model];
+        for (size_t i = 0; i < list.size (); i++)
+        {
+            list [i].strength = 0;
+            for (int t = 0; t < 5 && models [m].terms [t]; t++)
+                list [i].strength += fabsf (list [i].get (models [m].terms [t], 0));
+        }
+
+        std::vector<std::pair<std::string, const db_entry *> > sets = pick_sets (list);
+        for (size_t s = 0; s < sets.size (); s++)
+            for (int reverse = 0; reverse < 2; reverse++)
+            {
+                bench_case c = new_case (
+                    reverse ? models [m].unkernel : models [m].kernel,
+                    sets [s].first, BENCH_COORD, LF_MODIFY_DISTORTION, reverse);
+                c.focal = sets [s].second->get ("focal", 50);
+                c.distortion.Model = models [m].id;
+                c.distortion.Focal = c.focal;
+                for (int t = 0; t < 5 && models [m].terms [t]; t++)
+                    c.distortion.Terms [t] = sets [s].second->get (models [m].terms [t], 0);
+                cases.push_back (c);
+            }
+    }
+
+    // No ACM profiles in the database; a moderate barrel distortion with
+    // some decentering.  There is no reverse ACM kernel.
+    bench_case c = new_case ("ModifyCoord_Dist_ACM", "synthetic", BENCH_COORD,
+                             LF_MODIFY_DISTORTION, false);
+    c.distortion.Model = LF_DIST_MODEL_ACM;
+    c.distortion.Focal = c.focal;
+    c.distortion.Terms [0] = -0.05f;
+    c.distortion.Terms [1] = 0.01f;
+    c.distortion.Terms [2] = -0.001f;
+    c.distortion.Terms [3] = 0.0002f;
+    c.distortion.Terms [4] = -0.0001f;
+    cases.push_back (c);
+}
+
+static void add_tca_cases (std::vector<bench_case> &cases,
+                           std::map<std::string, std::vector<db_entry> > &db)
+{
+    static const struct
+    {
+        const char *model, *kernel, *unkernel, *terms [6];
+        float defaults [6];
+        lfTCAModel id;
+    } models [] =
+    {
+        { "linear", "ModifyCoord_TCA_Linear", "ModifyCoord_UnTCA_Linear",
+          { "kr", "kb" }, { 1, 1 }, LF_TCA_MODEL_LINEAR },
+        { "poly3", "ModifyCoord_TCA_Poly3", "ModifyCoord_UnTCA_Poly3",
+          { "vr", "vb", "cr", "cb", "br", "bb" }, { 1, 1, 0, 0, 0, 0 },
+          LF_TCA_MODEL_POLY3 },
+    };
+
+    for (size_t m = 0; m < sizeof (models) / sizeof (models [0]); m++)
+    {
+        std::vector<db_entry> &list = db [std::string ("tca/") + models [m].model];
+        for (size_t i = 0; i < list.size (); i++)
+        {
+            list [i].strength = 0;
+            for (int t = 0; t < 6 && models [m].terms [t]; t++)
+                list [i].strength += fabsf (list [i].get (models [m].terms [t],
+                                                          models [m].defaults [t]) -
+                                            models [m].defaults [t]);
+        }
+
+        std::vector<std::pair<std::string, const db_entry *> > sets = pick_sets (list);
+        for (size_t s = 0; s < sets.size (); s++)
+            for (int reverse = 0; reverse < 2; reverse++)
+            {
+                bench_case c = new_case (
+                    reverse ? models [m].unkernel : models [m].kernel,
+                    sets [s].first, BENCH_SUBPIXEL, LF_MODIFY_TCA, reverse);
+                c.focal = sets [s].second->get ("focal", 50);
+                c.tca.Model = models [m].id;
+                c.tca.Focal = c.focal;
+                for (int t = 0; t < 6 && models [m].terms [t]; t++)
+                    c.tca.Terms [t] = sets [s].second->get (models [m].terms [t],
+                                                            models [m].defaults [t]);
+                cases.push_back (c);
+            }
+    }
+
+    // Red and blue scaled by a few parts in ten thousand plus small higher
+    // order terms.  There is no reverse ACM kernel.
+    bench_case c = new_case ("ModifyCoord_TCA_ACM", "synthetic", BENCH_SUBPIXEL,
+                             LF_MODIFY_TCA, false);
+    static const float acm [12] =
+        { 1.0003f, 0.9997f, 2e-4f, -2e-4f, -1e-5f, 1e-5f, 1e-6f, -1e-6f, 0, 0, 0, 0 };
+    c.tca.Model = LF_TCA_MODEL_ACM;
+    c.tca.Focal = c.focal;
+    memcpy (c.tca.Terms, acm, sizeof (acm));
+    cases.push_back (c);
+}
+
+static void add_vignetting_cases (std::vector<bench_case> &cases,
+                                  std::map<std::string, std::vector<db_entry> > &db)
+{
+    static const struct
+    {
+        lfPixelFormat format;
+        const char *name;
+    } formats [] =
+    {
+        { LF_PF_U8, "u8" },
+        { LF_PF_U16, "u16" },
+        { LF_PF_U32, "u32" },
+        { LF_PF_F32, "f32" },
+        { LF_PF_F64, "f64" }
+    };
+
+    std::vector<db_entry> &list = db ["vignetting/pa"];
+    for (size_t i = 0; i < list.size (); i++)
+        list [i].strength = fabsf (list [i].get ("k1", 0)) +
+            fabsf (list [i].get ("k2", 0)) + fabsf (list [i].get ("k3", 0));
+
+    std::vector<std::pair<std::string, const db_entry *> > sets = pick_sets (list);
+    for (size_t f = 0; f < sizeof (formats) / sizeof (formats [0]); f++)
+        for (size_t s = 0; s < sets.size (); s++)
+            for (int reverse = 0; reverse < 2; reverse++)
+            {
+                bench_case c = new_case (
+                    reverse ? "ModifyColor_Vignetting_PA" : "ModifyColor_DeVignetting_PA",
+                    sets [s].first, BENCH_COLOR, LF_MODIFY_VIGNETTING, reverse);
+                c.kernel = c.kernel + "<" + formats [f].name + ">";
+                c.format = formats [f].format;
+                c.focal = sets [s].second->get ("focal", 50);
+                c.aperture = sets [s].second->get ("aperture", 4);
+                c.distance = sets [s].second->get ("distance", 1000);
+                c.vignetting.Model = LF_VIGNETTING_MODEL_PA;
+                c.vignetting.Focal = c.focal;
+                c.vignetting.Aperture = c.aperture;
+                c.vignetting.Distance = c.distance;
+                c.vignetting.Terms [0] = sets [s].second->get ("k1", 0);
+                c.vignetting.Terms [1] = sets [s].second->get ("k2", 0);
+                c.vignetting.Terms [2] = sets [s].second->get ("k3", 0);
+                cases.push_back (c);
+            }
+}
+
+static void add_geometry_cases (std::vector<bench_case> &cases)
+{
+    // Conversions which each install a single kernel
+    static const struct
+    {
+        lfLensType from, to;
+        const char *kernel;
+    } conversions [] =
+    {
+        { LF_RECTILINEAR, LF_FISHEYE, "ModifyCoord_Geom_FishEye_Rect" },
+        { LF_RECTILINEAR, LF_PANORAMIC, "ModifyCoord_Geom_Panoramic_Rect" },
+        { LF_RECTILINEAR, LF_EQUIRECTANGULAR, "ModifyCoord_Geom_ERect_Rect" },
+        { LF_FISHEYE, LF_RECTILINEAR, "ModifyCoord_Geom_Rect_FishEye" },
+        { LF_FISHEYE, LF_PANORAMIC, "ModifyCoord_Geom_Panoramic_FishEye" },
+        { LF_FISHEYE, LF_EQUIRECTANGULAR, "ModifyCoord_Geom_ERect_FishEye" },
+        { LF_PANORAMIC, LF_RECTILINEAR, "ModifyCoord_Geom_Rect_Panoramic" },
+        { LF_PANORAMIC, LF_FISHEYE, "ModifyCoord_Geom_FishEye_Panoramic" },
+        { LF_PANORAMIC, LF_EQUIRECTANGULAR, "ModifyCoord_Geom_ERect_Panoramic" },
+        { LF_EQUIRECTANGULAR, LF_RECTILINEAR, "ModifyCoord_Geom_Rect_ERect" },
+        { LF_EQUIRECTANGULAR, LF_FISHEYE, "ModifyCoord_Geom_FishEye_ERect" },
+        { LF_EQUIRECTANGULAR, LF_PANORAMIC, "ModifyCoord_Geom_Panoramic_ERect" },
+        { LF_EQUIRECTANGULAR, LF_FISHEYE_ORTHOGRAPHIC, "ModifyCoord_Geom_Orthographic_ERect" },
+        { LF_FISHEYE_ORTHOGRAPHIC, LF_EQUIRECTANGULAR, "ModifyCoord_Geom_ERect_Orthographic" },
+        { LF_EQUIRECTANGULAR, LF_FISHEYE_STEREOGRAPHIC, "ModifyCoord_Geom_Stereographic_ERect" },
+        { LF_FISHEYE_STEREOGRAPHIC, LF_EQUIRECTANGULAR, "ModifyCoord_Geom_ERect_Stereographic" },
+        { LF_EQUIRECTANGULAR, LF_FISHEYE_EQUISOLID, "ModifyCoord_Geom_Equisolid_ERect" },
+        { LF_FISHEYE_EQUISOLID, LF_EQUIRECTANGULAR, "ModifyCoord_Geom_ERect_Equisolid" },
+        { LF_EQUIRECTANGULAR, LF_FISHEYE_THOBY, "ModifyCoord_Geom_Thoby_ERect" },
+        { LF_FISHEYE_THOBY, LF_EQUIRECTANGULAR, "ModifyCoord_Geom_ERect_Thoby" },
+    };
+
+    for (size_t i = 0; i < sizeof (conversions) / sizeof (conversions [0]); i++)
+    {
+        // A 10.5 mm lens on an APS-C body, a common fisheye setup
+        bench_case c = new_case (conversions [i].kernel, "10.5mm", BENCH_COORD,
+                                 LF_MODIFY_GEOMETRY, false);
+        c.type = conversions [i].from;
+        c.target = conversions [i].to;
+        c.focal = 10.5f;
+        cases.push_back (c);
+    }
+}
+
+static void add_points_cases (std::vector<bench_case> &cases)
+{
+    static const struct
+    {
+        const char *kernel;
+        bench_kind kind;
+    } kinds [] =
+    {
+        { "points-single", BENCH_POINTS_SINGLE },
+        { "points", BENCH_POINTS },
+        { "points-inverse", BENCH_POINTS_INVERSE }
+    };
+
+    // The typical PTLens profile of add_distortion_cases(), which comes
+    // right before
+    const bench_case *base = NULL;
+    for (size_t i = 0; i < cases.size (); i++)
+        if (cases [i].kernel == "ModifyCoord_Dist_PTLens" &&
+            cases [i].params.compare (0, 8, "typical ") == 0)
+            base = &cases [i];
+    if (!base)
+        return;
+
+    bench_case c = *base;
+    for (size_t i = 0; i < sizeof (kinds) / sizeof (kinds [0]); i++)
+    {
+        c.kernel = kinds [i].kernel;
+        c.kind = kinds [i].kind;
+        cases.push_back (c);
+    }
+}
+
+static void add_jacobian_cases (std::vector<bench_case> &cases)
+{
+    // The same setups as their plain coordinate cases, so the cost of the
+    // derivatives is the difference to those
+    static const struct
+    {
+        const char *kernel, *params;
+    } bases [] =
+    {
+        { "ModifyCoord_Dist_PTLens", "typical " },
+        { "ModifyCoord_UnDist_PTLens", "typical " },
+        { "ModifyCoord_Geom_FishEye_Rect", "" },
+        { "ModifyCoord_Geom_ERect_Thoby", "" },
+        { "ModifyCoordRow_Perspective_Correction", "" }
+    };
+
+    size_t end = cases.size ();
+    for (size_t b = 0; b < sizeof (bases) / sizeof (bases [0]); b++)
+        for (size_t i = 0; i < end; i++)
+            if (cases [i].kind == BENCH_COORD && cases [i].kernel == bases [b].kernel &&
+                cases [i].params.compare (0, strlen (bases [b].params), bases [b].params) == 0)
+            {
+                bench_case c = cases [i];
+                c.kernel = std::string ("jacobian:") + bases [b].kernel;
+                c.kind = BENCH_JACOBIAN;
+                cases.push_back (c);
+                break;
+            }
+}
+
+static void build_cases (std::vector<bench_case> &cases, const char *dbdir)
+{
+    std::map<std::string, std::vector<db_entry> > db;
+    scan_database (dbdir, db);
+
+    // The scale callback is folded into the generation of the coordinates,
+    // so this is the overhead every coordinate callback pays on top
+    bench_case c = new_case ("row-setup", "scale 0.9", BENCH_COORD, LF_MODIFY_SCALE, false);
+    c.scale = 0.9f;
+    cases.push_back (c);
+
+    add_distortion_cases (cases, db);
+    add_points_cases (cases);
+    add_geometry_cases (cases);
+
+    c = new_case ("ModifyCoordRow_Perspective_Correction", "4 points, d=0",
+                  BENCH_COORD, 0, false);
+    c.perspective = true;
+    cases.push_back (c);
+    add_jacobian_cases (cases);
+
+    add_tca_cases (cases, db);
+    add_vignetting_cases (cases, db);
+}
+
+//---------------------------// Timing //---------------------------//
+
+static lfModifier *make_modifier (const bench_case &c, int width, int height)
+{
+    lfLens lens;
+    lens.CropFactor = 1.5f;
+    lens.AspectRatio = 1.5f;
+    lens.Type = c.type;
+    if (c.flags & LF_MODIFY_DISTORTION)
+        lens.AddCalibDistortion (&c.distortion);
+    if (c.flags & LF_MODIFY_TCA)
+        lens.AddCalibTCA (&c.tca);
+    if (c.flags & LF_MODIFY_VIGNETTING)
+        lens.AddCalibVignetting (&c.vignetting);
+
+    lfModifier *mod = new lfModifier (&lens, 1.5f, width, height);
+    int flags = mod->Initialize (&lens, c.format, c.focal, c.aperture, c.distance,
+                                 c.scale, c.target, c.flags, c.reverse);
+    bool ok = flags == c.flags;
+
+    if (c.perspective)
+    {
+        // Two converging verticals, as when tilting the camera upwards
+        float x [4] = { 0.3f * width, 0.25f * width, 0.7f * width, 0.75f * width };
+        float y [4] = { 0.2f * height, 0.8f * height, 0.2f * height, 0.8f * height };
+        ok = mod->EnablePerspectiveCorrection (x, y, 4, 0);
+    }
+
+    if (!ok)
+    {
+        delete mod;
+        return NULL;
+    }
+    return mod;
+}
+
+static size_t bytes_per_pixel (const bench_case &c)
+{
+    static const size_t component_size [] = { 1, 2, 4, 4, 8 };
+    switch (c.kind)
+    {
+        case BENCH_COORD:
+            return 2 * sizeof (float);
+        case BENCH_SUBPIXEL:
+            return 2 * 3 * sizeof (float);
+        case BENCH_COLOR:
+            return 3 * component_size [c.format];
+        case BENCH_POINTS_SINGLE:
+        case BENCH_POINTS:
+        case BENCH_POINTS_INVERSE:
+            return 2 * 2 * sizeof (float);
+        case BENCH_JACOBIAN:
+            return (2 + 4) * sizeof (float);
+    }
+    return 1;
+}
+
+// Fills the pixels with a mid grey
+static void reset_pixels (const bench_case &c, void *pixels, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        switch (c.format)
+        {
+            case LF_PF_U8: ((lf_u8 *)pixels) [i] = 0x80; break;
+            case LF_PF_U16: ((lf_u16 *)pixels) [i] = 0x8000; break;
+            case LF_PF_U32: ((lf_u32 *)pixels) [i] = 0x80000000u; break;
+            case LF_PF_F32: ((lf_f32 *)pixels) [i] = 0.5f; break;
+            case LF_PF_F64: ((lf_f64 *)pixels) [i] = 0.5; break;
+        }
+}
+
+static inline unsigned long long read_tsc ()
+{
+#ifdef BENCH_HAVE_TSC
+    return __rdtsc ();
+#else
+    return 0;
+#endif
+}
+
+static bench_result run_case (const bench_case &c, const bench_level &level,
+                              double min_time)
+{
+    typedef std::chrono::steady_clock clock;
+
+    bench_result r;
+    r.ok = false;
+    r.width = int (level.bytes / (BENCH_ROWS * bytes_per_pixel (c)));
+    if (r.width < 16)
+        r.width = 16;
+    r.bytes = (size_t)r.width * BENCH_ROWS * bytes_per_pixel (c);
+
+    // A 3:2 image of which a band of rows through the middle is processed
+    int height = r.width * 2 / 3;
+    float y = float (height / 2 - BENCH_ROWS / 2);
+    lfModifier *mod = make_modifier (c, r.width, height);
+    if (!mod)
+        return r;
+
+    std::vector<char> buffer (r.bytes);
+    void *data = &buffer [0];
+    size_t values = (size_t)r.width * BENCH_ROWS * 3;
+    int comp_role = LF_CR_3 (RED, GREEN, BLUE);
+    int stride = int (r.bytes / BENCH_ROWS);
+
+    // Scattered points all over the image for the point cases; the inverse
+    // one maps them back from where they go forward
+    int count = r.width * BENCH_ROWS;
+    std::vector<float> points;
+    if (c.kind == BENCH_POINTS_SINGLE || c.kind == BENCH_POINTS ||
+        c.kind == BENCH_POINTS_INVERSE)
+    {
+        points.resize (count * 2);
+        unsigned seed = 1;
+        for (int i = 0; i < count * 2; i += 2)
+        {
+            seed = seed * 1103515245 + 12345;
+            points [i] = (seed >> 8) * (r.width - 1.0f) / (1 << 24);
+            seed = seed * 1103515245 + 12345;
+            points [i + 1] = (seed >> 8) * (height - 1.0f) / (1 << 24);
+        }
+        if (c.kind == BENCH_POINTS_INVERSE)
+            mod->ApplyGeometryDistortionPoints (&points [0], &points [0], count);
+    }
+
+    bool ok = true;
+    struct
+    {
+        const bench_case &c;
+        lfModifier *mod;
+        void *data;
+        const float *points;
+        int width, count, comp_role, stride;
+        float y;
+        bool *ok;
+
+        void operator () ()
+        {
+            switch (c.kind)
+            {
+                case BENCH_COORD:
+                    *ok &= mod->ApplyGeometryDistortion (0, y, width, BENCH_ROWS, (float *)data);
+                    break;
+                case BENCH_SUBPIXEL:
+                    *ok &= mod->ApplySubpixelDistortion (0, y, width, BENCH_ROWS, (float *)data);
+                    break;
+                case BENCH_COLOR:
+                    *ok &= mod->ApplyColorModification (data, 0, y, width, BENCH_ROWS,
+                                                        comp_role, stride);
+                    break;
+                case BENCH_POINTS_SINGLE:
+                    for (int i = 0; i < count; i++)
+                        *ok &= mod->ApplyGeometryDistortion (points [i * 2], points [i * 2 + 1],
+                                                             1, 1, (float *)data + i * 2);
+                    break;
+                case BENCH_POINTS:
+                case BENCH_POINTS_INVERSE:
+                    *ok &= mod->ApplyGeometryDistortionPoints (
+                        points, (float *)data, count, c.kind == BENCH_POINTS_INVERSE);
+                    break;
+                case BENCH_JACOBIAN:
+                    *ok &= mod->ApplyGeometryDistortionJacobian (
+                        0, y, width, BENCH_ROWS, (float *)data,
+                        (float *)data + width * BENCH_ROWS * 2);
+                    break;
+            }
+        }
+    } call = { c, mod, data, points.empty () ? NULL : &points [0], r.width, count,
+               comp_role, stride, y, &ok };
+
+    // Warm up the caches and find how many calls make up a sample
+    if (c.kind == BENCH_COLOR)
+        reset_pixels (c, data, values);
+    clock::time_point start = clock::now ();
+    call ();
+    double once = std::chrono::duration<double> (clock::now () - start).count ();
+    long calls = long (min_time / BENCH_SAMPLES / (once > 1e-9 ? once : 1e-9));
+    if (calls < 1)
+        calls = 1;
+
+    std::vector<double> ns (BENCH_SAMPLES), cycles (BENCH_SAMPLES);
+    double pixels = double (r.width) * BENCH_ROWS * calls;
+    for (int s = 0; s < BENCH_SAMPLES && ok; s++)
+    {
+        double elapsed = 0, ticks = 0;
+        for (long done = 0; done < calls; )
+        {
+            long batch = std::min<long> (calls - done, BENCH_RESET_CALLS);
+            if (c.kind == BENCH_COLOR)
+                reset_pixels (c, data, values);
+            unsigned long long tsc = read_tsc ();
+            start = clock::now ();
+            for (long i = 0; i < batch; i++)
+                call ();
+            elapsed += std::chrono::duration<double, std::nano> (clock::now () - start).count ();
+            ticks += double (read_tsc () - tsc);
+            done += batch;
+        }
+        ns [s] = elapsed / pixels;
+        cycles [s] = ticks / pixels;
+    }
+    delete mod;
+
+    if (!ok)
+        return r;
+    std::sort (ns.begin (), ns.end ());
+    std::sort (cycles.begin (), cycles.end ());
+    r.ok = true;
+    r.ns_per_px = ns [BENCH_SAMPLES / 2];
+    r.ns_per_px_min = ns [0];
+    r.cycles_per_px = cycles [BENCH_SAMPLES / 2];
+    return r;
+}
+
+//---------------------------// Output //---------------------------//
+
+static std::string json_string (const std::string &s)
+{
+    std::string out = "\"";
+    for (size_t i = 0; i < s.size (); i++)
+    {
+        if (s [i] == '"' || s [i] == '\\')
+            out += '\\';
+        out += s [i];
+    }
+    return out + "\"";
+}
+
+static const char *kind_name (bench_kind kind)
+{
+    switch (kind)
+    {
+        case BENCH_COORD: return "coord";
+        case BENCH_SUBPIXEL: return "subpixel";
+        case BENCH_COLOR: return "color";
+        case BENCH_POINTS_SINGLE:
+        case BENCH_POINTS:
+        case BENCH_POINTS_INVERSE: return "points";
+        case BENCH_JACOBIAN: return "jacobian";
+    }
+    return "";
+}
+
+static void usage ()
+{
+    fprintf (stderr,
+             "Usage: bench-kernels [--db DIR] [--output FILE] [--revision REV]\n"
+             "                     [--min-time SECONDS] [--filter SUBSTRING]\n");
+    exit (1);
+}
+
+int main (int argc, char **argv)
+{
+    const char *dbdir = "data/db";
+    const char *output = NULL;
+    const char *revision = "unknown";
+    const char *filter = NULL;
+    double min_time = 0.1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+            usage ();
+        if (!strcmp (argv [i], "--db"))
+            dbdir = argv [++i];
+        else if (!strcmp (argv [i], "--output"))
+            output = argv [++i];
+        else if (!strcmp (argv [i], "--revision"))
+            revision = argv [++i];
+        else if (!strcmp (argv [i], "--min-time"))
+            min_time = atof (argv [++i]);
+        else if (!strcmp (argv [i], "--filter"))
+            filter = argv [++i];
+        else
+            usage ();
+    }
+
+    std::vector<bench_case> cases;
+    build_cases (cases, dbdir);
+
+    FILE *out = output ? fopen (output, "w") : stdout;
+    if (!out)
+    {
+        fprintf (stderr, "cannot write %s\n", output);
+        return 1;
+    }
+
+    fprintf (out, "{\n  \"revision\": %s,\n  \"rows\": %d,\n  \"tsc\": %s,\n  \"results\": [",
+             json_string (revision).c_str (), BENCH_ROWS,
+#ifdef BENCH_HAVE_TSC
+             "true"
+#else
+             "false"
+#endif
+             );
+    fprintf (stderr, "%-46s %-5s %9s %9s %9s %9s  %s\n", "kernel", "level",
+             "width", "Mpx/s", "ns/px", "cyc/px", "parameters");
+
+    bool first = true;
+    for (size_t i = 0; i < cases.size (); i++)
+    {
+        const bench_case &c = cases [i];
+        if (filter && c.kernel.find (filter) == std::string::npos)
+            continue;
+        for (size_t l = 0; l < sizeof (levels) / sizeof (levels [0]); l++)
+        {
+            bench_result r = run_case (c, levels [l], min_time);
+            if (!r.ok)
+            {
+                fprintf (stderr, "%-46s %-5s  not applicable: %s\n", c.kernel.c_str (),
+                         levels [l].name, c.params.c_str ());
+                continue;
+            }
+
+            fprintf (stderr, "%-46s %-5s %9d %9.1f %9.3f %9.2f  %s\n", c.kernel.c_str (),
+                     levels [l].name, r.width, 1e3 / r.ns_per_px, r.ns_per_px,
+                     r.cycles_per_px, c.params.c_str ());
+            fprintf (out, "%s\n    { \"kernel\": %s, \"kind\": \"%s\", \"params\": %s, "
+                     "\"level\": \"%s\", \"width\": %d, \"bytes\": %lu, "
+                     "\"mpx_per_s\": %.3f, \"ns_per_px\": %.4f, \"ns_per_px_min\": %.4f, "
+                     "\"cycles_per_px\": %.3f }",
+                     first ? "" : ",", json_string (c.kernel).c_str (), kind_name (c.kind),
+                     json_string (c.params).c_str (), levels [l].name, r.width,
+                     (unsigned long)r.bytes, 1e3 / r.ns_per_px, r.ns_per_px,
+                     r.ns_per_px_min, r.cycles_per_px);
+            fflush (out);
+            first = false;
+        }
+    }
+    fprintf (out, "\n  ]\n}\n");
+
+    if (output)
+        fclose (out);
+    return 0;
+}
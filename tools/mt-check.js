@@ -0,0 +1,165 @@
+// Checks that the pthreads build gives the same result on any number of
+// threads.
+//
+// Usage: node tools/mt-check.js [dist/lensfun_wasm_mt.js]
+//
+// A synthetic lens with distortion, TCA and vignetting corrects a synthetic
+// frame through every parallel call of the module, on one thread and on
+// several.  The bands of rows are independent, so the results have to be
+// bit-identical; the exit status is 1 if one differs.  The frame height is
+// not a multiple of any thread count, so the bands differ in size.
+
+'use strict';
+
+var path = require ('path');
+
+var WIDTH = 1501;
+var HEIGHT = 1003;
+var THREADS = [2, 3, 8];
+
+// LF_MODIFY_TCA | LF_MODIFY_VIGNETTING | LF_MODIFY_DISTORTION |
+// LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE
+var FLAGS = 0x3b;
+// LF_CR_3 (RED, GREEN, BLUE) and LF_CR_4 (RED, GREEN, BLUE, UNKNOWN)
+var COMP_ROLES = { 3: 0x654, 4: 0x2654 };
+
+function setTerms (calib, terms)
+{
+    for (var i = 0; i < terms.length; i++)
+        calib.set_Terms (i, terms[i]);
+}
+
+function makeLens (Module)
+{
+    var lens = new Module.lfLens ();
+    lens.set_CropFactor (1.5);
+    lens.set_AspectRatio (1.5);
+
+    var dist = new Module.lfLensCalibDistortion ();
+    dist.set_Model (Module.LF_DIST_MODEL_PTLENS);
+    dist.set_Focal (18);
+    setTerms (dist, [0.012, -0.041, 0.016]);
+    lens.AddCalibDistortion (dist);
+    Module.destroy (dist);
+
+    var tca = new Module.lfLensCalibTCA ();
+    tca.set_Model (Module.LF_TCA_MODEL_POLY3);
+    tca.set_Focal (18);
+    setTerms (tca, [1.0003, 0.9998, 0, 0, 0.0002, -0.0001]);
+    lens.AddCalibTCA (tca);
+    Module.destroy (tca);
+
+    var vig = new Module.lfLensCalibVignetting ();
+    vig.set_Model (Module.LF_VIGNETTING_MODEL_PA);
+    vig.set_Focal (18);
+    vig.set_Aperture (4);
+    vig.set_Distance (1000);
+    setTerms (vig, [-0.35, 0.12, -0.04]);
+    lens.AddCalibVignetting (vig);
+    Module.destroy (vig);
+    return lens;
+}
+
+function makeModifier (Module, lens, format)
+{
+    var modifier = new Module.lfModifier (lens, 1.5, WIDTH, HEIGHT);
+    modifier.Initialize (lens, format, 18, 4, 1000, 0, Module.LF_RECTILINEAR,
+                         FLAGS, false);
+    return modifier;
+}
+
+// A gradient with some texture, so that resampling and vignetting change
+// every pixel
+function makeFrame (type, components, max)
+{
+    var pixels = new type (WIDTH * HEIGHT * components);
+    for (var y = 0, i = 0; y < HEIGHT; y++)
+        for (var x = 0; x < WIDTH; x++)
+            for (var c = 0; c < components; c++, i++)
+                pixels[i] = c == 3 ? max :
+                    Math.round (max * (0.25 + 0.5 * ((x * (c + 1) + y * 3) % 251) / 251));
+    return pixels;
+}
+
+// Compares the bits, so that NaN coordinates match as well
+function firstDifference (a, b)
+{
+    if (!a || !b)
+        return a === b ? -1 : 0;
+    if (a.length != b.length)
+        return 0;
+    var ua = new Uint8Array (a.buffer, a.byteOffset, a.byteLength);
+    var ub = new Uint8Array (b.buffer, b.byteOffset, b.byteLength);
+    for (var i = 0; i < ua.length; i++)
+        if (ua[i] != ub[i])
+            return Math.floor (i / a.BYTES_PER_ELEMENT);
+    return -1;
+}
+
+function main (Module)
+{
+    var lens = makeLens (Module);
+    var failures = 0;
+
+    function check (name, run)
+    {
+        var start = Date.now ();
+        var expect = run (1);
+        var serial = Date.now () - start;
+        THREADS.forEach (function (threads) {
+            start = Date.now ();
+            var result = run (threads);
+            var time = Date.now () - start;
+            var diff = firstDifference (expect, result);
+            if (diff >= 0)
+                failures++;
+            console.log (name + ' threads=' + threads + ': ' +
+                         (diff < 0 ? 'ok' : 'FAILED at element ' + diff) +
+                         ' (' + time + ' ms, 1 thread ' + serial + ' ms)');
+        });
+    }
+
+    var formats = [
+        { name: 'u8', format: Module.LF_PF_U8, type: Uint8Array, max: 255 },
+        { name: 'u16', format: Module.LF_PF_U16, type: Uint16Array, max: 65535 }
+    ];
+    formats.forEach (function (f) {
+        var modifier = makeModifier (Module, lens, f.format);
+        if (f.format == Module.LF_PF_U8)
+        {
+            check ('geometry', function (threads) {
+                return Module.applyGeometryDistortion (modifier, WIDTH, HEIGHT, threads);
+            });
+            check ('subpixel', function (threads) {
+                return Module.applySubpixelDistortion (modifier, WIDTH, HEIGHT, threads);
+            });
+            check ('subpixel-geometry', function (threads) {
+                return Module.applySubpixelGeometryDistortion (modifier, WIDTH, HEIGHT, threads);
+            });
+        }
+        [3, 4].forEach (function (components) {
+            var frame = makeFrame (f.type, components, f.max);
+            var layout = f.name + (components == 3 ? ':rgb' : ':rgba');
+            check ('color:' + layout, function (threads) {
+                var pixels = frame.slice ();
+                return Module.applyColorModification (modifier, pixels, WIDTH, HEIGHT,
+                                                      COMP_ROLES[components], threads) ?
+                       pixels : null;
+            });
+            check ('image:' + layout, function (threads) {
+                return Module.correctImage (modifier, frame, WIDTH, HEIGHT, components,
+                                            Module.LF_INTERPOLATION_BILINEAR, threads);
+            });
+        });
+        Module.destroy (modifier);
+    });
+
+    Module.destroy (lens);
+    console.log (failures ? failures + ' check(s) FAILED' : 'all checks passed');
+    process.exit (failures ? 1 : 0);
+}
+
+var file = path.resolve (process.argv[2] ||
+                         path.join (__dirname, '..', 'dist', 'lensfun_wasm_mt.js'));
+// The modularized build resolves to the module once its thread pool is up
+require (file) ().then (main);
@@ -0,0 +1,264 @@
+/*
+    Stress test of sharing lenses and modifiers between threads
+
+    For an even sample of the lenses in data/db, a const lfLens and a const
+    lfModifier (all corrections, 16 bit RGB) are set up once and then shared
+    by all threads, which at the same time and in different orders:
+      - copy the lens and guess the parameters of the copy from its name
+      - interpolate distortion, TCA and vignetting from the shared lens
+      - look up the model name in different languages
+      - correct a small frame through the shared modifier, both row by row
+        and with the *Parallel calls, which start threads of their own
+    Every result is compared with the one computed on the main thread
+    before the threads start, except for the guessed parameters: they are
+    checked after the threads are done, so that the first lens names are
+    parsed by several threads at once.
+
+    "make thread-stress" builds this and the library with ThreadSanitizer,
+    which reports any data race on the way; the exit status is 1 if a
+    result differed.
+
+    Usage: thread-stress [--db DIR] [--threads N] [--rounds N] [--lenses N]
+*/
+
+#include "lensfun.h"
+#include "bench-db.h"
+#include <atomic>
+#include <thread>
+
+#define STRESS_WIDTH 320
+#define STRESS_HEIGHT 214
+
+// NULL stands for lf_mlstr_get()
+static const char *languages [] = { NULL, "en", "de", "fr" };
+#define STRESS_LANGUAGES int (sizeof (languages) / sizeof (languages [0]))
+
+struct stress_lens
+{
+    lfLens lens;
+    lfModifier *modifier;
+    float focal, aperture, distance;
+    std::string names [STRESS_LANGUAGES];
+    // Per thread and round, filled in by the threads
+    std::vector<float> guessed;
+    lfLensCalibDistortion distortion;
+    lfLensCalibTCA tca;
+    lfLensCalibVignetting vignetting;
+    bool has [3];
+    std::vector<float> coords;
+    std::vector<lf_u16> pixels;
+};
+
+static std::atomic<int> mismatches (0);
+
+static void check (bool ok, const stress_lens &s, const char *what)
+{
+    // Only the first few are worth reading
+    if (!ok && mismatches.fetch_add (1) < 10)
+        fprintf (stderr, "%s differs for %s\n", what, lf_mlstr_get (s.lens.Model));
+}
+
+static void guess (const lfLens &lens, float *guessed)
+{
+    lfLens copy (lens);
+    copy.MinFocal = copy.MaxFocal = copy.MinAperture = copy.MaxAperture = 0;
+    copy.GuessParameters ();
+    guessed [0] = copy.MinFocal;
+    guessed [1] = copy.MaxFocal;
+    guessed [2] = copy.MinAperture;
+    guessed [3] = copy.MaxAperture;
+}
+
+// What every thread computes; store fills in the expected results instead.
+// slot is where the guessed parameters of this call go.
+static void exercise (stress_lens &s, bool store, size_t slot)
+{
+    if (!store)
+        guess (s.lens, &s.guessed [slot * 4]);
+
+    std::string names [STRESS_LANGUAGES];
+    for (int l = 0; l < STRESS_LANGUAGES; l++)
+        names [l] = languages [l] ? lf_mlstr_get_lang (s.lens.Model, languages [l]) :
+                                    lf_mlstr_get (s.lens.Model);
+
+    lfLensCalibDistortion distortion;
+    lfLensCalibTCA tca;
+    lfLensCalibVignetting vignetting;
+    memset (&distortion, 0, sizeof (distortion));
+    memset (&tca, 0, sizeof (tca));
+    memset (&vignetting, 0, sizeof (vignetting));
+    bool has [3] =
+    {
+        s.lens.InterpolateDistortion (s.focal, distortion),
+        s.lens.InterpolateTCA (s.focal, tca),
+        s.lens.InterpolateVignetting (s.focal, s.aperture, s.distance, vignetting)
+    };
+
+    const lfModifier &mod = *s.modifier;
+    std::vector<float> coords ((size_t)STRESS_WIDTH * STRESS_HEIGHT * 6);
+    std::vector<lf_u16> pixels ((size_t)STRESS_WIDTH * STRESS_HEIGHT * 3, 0x8000);
+    std::vector<float> parallel_coords (coords.size ());
+    std::vector<lf_u16> parallel_pixels (pixels.size (), 0x8000);
+    for (int y = 0; y < STRESS_HEIGHT; y++)
+    {
+        mod.ApplySubpixelGeometryDistortion (0, y, STRESS_WIDTH, 1,
+                                             &coords [(size_t)y * STRESS_WIDTH * 6]);
+        mod.ApplyColorModification (&pixels [(size_t)y * STRESS_WIDTH * 3], 0, y,
+                                    STRESS_WIDTH, 1, LF_CR_3 (RED, GREEN, BLUE),
+                                    STRESS_WIDTH * 3 * sizeof (lf_u16));
+    }
+    mod.ApplySubpixelGeometryDistortionParallel (0, 0, STRESS_WIDTH, STRESS_HEIGHT,
+                                                 &parallel_coords [0], 3);
+    mod.ApplyColorModificationParallel (&parallel_pixels [0], 0, 0, STRESS_WIDTH,
+                                        STRESS_HEIGHT, LF_CR_3 (RED, GREEN, BLUE),
+                                        STRESS_WIDTH * 3 * sizeof (lf_u16), 3);
+
+    if (store)
+    {
+        for (int l = 0; l < STRESS_LANGUAGES; l++)
+            s.names [l] = names [l];
+        s.distortion = distortion;
+        s.tca = tca;
+        s.vignetting = vignetting;
+        memcpy (s.has, has, sizeof (has));
+        s.coords = coords;
+        s.pixels = pixels;
+    }
+
+    // The parallel calls must agree with the row by row ones in any case
+    check (!memcmp (&parallel_coords [0], &coords [0], coords.size () * sizeof (float)),
+           s, "parallel coordinates");
+    check (parallel_pixels == pixels, s, "parallel pixels");
+    if (store)
+        return;
+
+    for (int l = 0; l < STRESS_LANGUAGES; l++)
+        check (names [l] == s.names [l], s, "name");
+    check (!memcmp (has, s.has, sizeof (has)), s, "interpolation");
+    check (!memcmp (&distortion, &s.distortion, sizeof (distortion)), s, "distortion");
+    check (!memcmp (&tca, &s.tca, sizeof (tca)), s, "TCA");
+    check (!memcmp (&vignetting, &s.vignetting, sizeof (vignetting)), s, "vignetting");
+    check (!memcmp (&coords [0], &s.coords [0], coords.size () * sizeof (float)),
+           s, "coordinates");
+    check (pixels == s.pixels, s, "pixels");
+}
+
+// The first calibrated focal length, and the widest aperture and farthest
+// distance of vignetting there
+static void pick_setting (const bench_db_lens &entry, stress_lens &s)
+{
+    s.focal = 0;
+    s.aperture = 1000;
+    s.distance = 0;
+    for (size_t i = 0; i < entry.calibrations.size (); i++)
+        if (!s.focal)
+            s.focal = entry.calibrations [i].get ("focal", 0);
+    for (size_t i = 0; i < entry.calibrations.size (); i++)
+    {
+        const bench_db_element &e = entry.calibrations [i];
+        if (e.name != "vignetting" || e.get ("focal", 0) != s.focal)
+            continue;
+        s.aperture = std::min (s.aperture, e.get ("aperture", 1000));
+        s.distance = std::max (s.distance, e.get ("distance", 1000));
+    }
+    if (!s.focal)
+        s.focal = 10;
+    if (s.aperture == 1000)
+        s.aperture = 8;
+    if (!s.distance)
+        s.distance = 1000;
+}
+
+static void usage ()
+{
+    fprintf (stderr,
+             "Usage: thread-stress [--db DIR] [--threads N] [--rounds N] [--lenses N]\n");
+    exit (1);
+}
+
+int main (int argc, char **argv)
+{
+    const char *dbdir = "data/db";
+    int threads = 8, rounds = 2, max_lenses = 24;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+            usage ();
+        if (!strcmp (argv [i], "--db"))
+            dbdir = argv [++i];
+        else if (!strcmp (argv [i], "--threads"))
+            threads = std::max (1, atoi (argv [++i]));
+        else if (!strcmp (argv [i], "--rounds"))
+            rounds = std::max (1, atoi (argv [++i]));
+        else if (!strcmp (argv [i], "--lenses"))
+            max_lenses = atoi (argv [++i]);
+        else
+            usage ();
+    }
+
+    std::vector<bench_db_lens> entries;
+    if (!bench_db_scan (dbdir, entries) || entries.empty ())
+    {
+        fprintf (stderr, "no lenses found in %s\n", dbdir);
+        return 1;
+    }
+
+    // --lenses takes an even sample of the database
+    size_t step = max_lenses > 0 && size_t (max_lenses) < entries.size () ?
+        entries.size () / max_lenses : 1;
+    std::vector<stress_lens *> lenses;
+    for (size_t i = 0; i < entries.size (); i += step)
+    {
+        stress_lens *s = new stress_lens ();
+        if (!bench_db_make_lens (entries [i], s->lens))
+        {
+            delete s;
+            continue;
+        }
+        s->lens.SetMaker (entries [i].maker.c_str ());
+        s->lens.SetModel (entries [i].model.c_str ());
+        s->lens.SetModel ((entries [i].model + " (de)").c_str (), "de");
+        pick_setting (entries [i], *s);
+        s->modifier = new lfModifier (&s->lens, s->lens.CropFactor,
+                                      STRESS_WIDTH, STRESS_HEIGHT);
+        s->modifier->Initialize (&s->lens, LF_PF_U16, s->focal, s->aperture, s->distance,
+                                 0, LF_RECTILINEAR, LF_MODIFY_ALL, false);
+        s->guessed.resize (size_t (threads) * rounds * 4);
+        exercise (*s, true, 0);
+        lenses.push_back (s);
+    }
+
+    // Every thread starts at a different lens, so that the same lens is
+    // used by several threads at once in varying combinations
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++)
+        workers.push_back (std::thread ([&lenses, rounds, t, threads] ()
+        {
+            for (int r = 0; r < rounds; r++)
+                for (size_t i = 0; i < lenses.size (); i++)
+                    exercise (*lenses [(i + t * lenses.size () / threads) % lenses.size ()],
+                              false, size_t (t) * rounds + r);
+        }));
+    for (size_t t = 0; t < workers.size (); t++)
+        workers [t].join ();
+
+    for (size_t i = 0; i < lenses.size (); i++)
+    {
+        float expected [4];
+        guess (lenses [i]->lens, expected);
+        for (size_t slot = 0; slot < size_t (threads) * rounds; slot++)
+            check (!memcmp (&lenses [i]->guessed [slot * 4], expected, sizeof (expected)),
+                   *lenses [i], "GuessParameters");
+    }
+
+    for (size_t i = 0; i < lenses.size (); i++)
+    {
+        delete lenses [i]->modifier;
+        delete lenses [i];
+    }
+
+    fprintf (stderr, "%lu lenses, %d threads, %d rounds: %d mismatches\n",
+             (unsigned long)lenses.size (), threads, rounds, mismatches.load ());
+    return mismatches.load () ? 1 : 0;
+}
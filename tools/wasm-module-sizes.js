@@ -0,0 +1,64 @@
+// Reports download size and compile time of the WebAssembly modules in dist/.
+//
+// Usage: node tools/wasm-module-sizes.js [module.wasm ...]
+//
+// Instantiation needs the imports of the core, so it is measured in the
+// page instead: the split build records it per side module in
+// Module.sideModuleTimes.
+
+'use strict';
+
+var fs = require ('fs');
+var path = require ('path');
+var zlib = require ('zlib');
+
+var RUNS = 5;
+
+function median (values)
+{
+    values.sort (function (a, b) { return a - b; });
+    return values [values.length >> 1];
+}
+
+async function compileTime (bytes)
+{
+    var times = [];
+    for (var i = 0; i < RUNS; i++)
+    {
+        var start = process.hrtime.bigint ();
+        await WebAssembly.compile (bytes);
+        times.push (Number (process.hrtime.bigint () - start) / 1e6);
+    }
+    return median (times);
+}
+
+async function main ()
+{
+    var files = process.argv.slice (2);
+    if (!files.length)
+    {
+        var dist = path.join (__dirname, '..', 'dist');
+        files = fs.readdirSync (dist)
+            .filter (function (f) { return f.endsWith ('.wasm'); })
+            .map (function (f) { return path.join (dist, f); });
+    }
+
+    console.log ('module                              bytes     gzip   brotli  compile ms');
+    for (var i = 0; i < files.length; i++)
+    {
+        var bytes = fs.readFileSync (files [i]);
+        var gzip = zlib.gzipSync (bytes, { level: 9 }).length;
+        var brotli = zlib.brotliCompressSync (bytes).length;
+        var ms = await compileTime (bytes);
+        console.log (path.basename (files [i]).padEnd (32) +
+                     String (bytes.length).padStart (9) +
+                     String (gzip).padStart (9) +
+                     String (brotli).padStart (9) +
+                     ms.toFixed (2).padStart (12));
+    }
+}
+
+main ().catch (function (e) {
+    console.error (e.message);
+    process.exit (1);
+});